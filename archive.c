@@ -0,0 +1,1034 @@
+/***************************************************************************
+ * archive.c
+ *
+ * Routines for writing received miniSEED records to day files in an
+ * SDS or BUD directory structure.
+ *
+ * Open files are kept in a hash table and an LRU list bounded by a
+ * maximum number of open files.  Each open file has a write buffer that
+ * is written when full, when the file is closed or when the archive is
+ * flushed.  Files with written data are synchronized to storage in
+ * batches at a configurable interval instead of per record.
+ *
+ * On Linux, payloads may be moved from a socket to archive files with
+ * splice() through a pipe without being copied to user space.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+/* Needed for splice() and pipe2() on Linux */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+
+#if defined(SLP_WIN)
+  #include <direct.h>
+  #define SYNCFD(fd) _commit (fd)
+  #define TRUNCATEFD(fd, length) _chsize_s (fd, length)
+  #define MKDIR(path) _mkdir (path)
+  #define OPENFLAGS (_O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY)
+  #define OPENMODE (_S_IREAD | _S_IWRITE)
+#else
+  #include <sys/stat.h>
+  #if defined(__linux__)
+    #define SYNCFD(fd) fdatasync (fd)
+  #else
+    #define SYNCFD(fd) fsync (fd)
+  #endif
+  #define TRUNCATEFD(fd, length) ftruncate (fd, length)
+  #define MKDIR(path) mkdir (path, 0755)
+  /* Not opened in append mode as splice() cannot write to such files,
+   * the file offset is set to the end after opening */
+  #define OPENFLAGS (O_WRONLY | O_CREAT)
+  #define OPENMODE 0644
+#endif
+
+/* Number of hash buckets for open files */
+#define ARCHIVE_BUCKETS 4096
+
+/* Maximum length of archive file paths */
+#define ARCHIVE_MAXPATH 512
+
+/* Size of pipe used for splice() */
+#define SPLICE_PIPE_SIZE (1024 * 1024)
+
+/* Open archive file */
+typedef struct ArchFile
+{
+  char path[ARCHIVE_MAXPATH];  /* File path */
+  char sourceid[64];           /* Source ID of records in file */
+  uint32_t hash;               /* Hash of file path */
+  int fd;                      /* File descriptor */
+  int8_t dirty;                /* Data written since last synchronization */
+  char *buffer;                /* Write buffer */
+  uint32_t bufferlength;       /* Length of data in write buffer */
+  struct ArchFile *chain;      /* Next entry in hash bucket */
+  struct ArchFile *prev;       /* Previous (more recently used) in LRU list */
+  struct ArchFile *next;       /* Next (less recently used) in LRU list */
+} ArchFile;
+
+struct SLarchive
+{
+  char rootdir[ARCHIVE_MAXPATH]; /* Root directory of archive */
+  int layout;                  /* Directory layout, SLARCHIVE_* */
+  uint32_t maxopen;            /* Maximum open files */
+  uint32_t buffersize;         /* Write buffer size per file */
+  uint32_t openfiles;          /* Number of open files */
+  uint32_t syncinterval;       /* Synchronization interval in milliseconds, 0 to disable */
+  int64_t lastsync;            /* Time of last synchronization */
+  ArchFile *buckets[ARCHIVE_BUCKETS];
+  ArchFile *mru;               /* Most recently used open file */
+  ArchFile *lru;               /* Least recently used open file */
+  ArchFile *spare;             /* Closed file entry for reuse */
+  uint64_t records;            /* Records written */
+  uint64_t bytes;              /* Bytes written */
+  int pipefd[2];               /* Pipe for splice(), -1 if not created */
+};
+
+static ArchFile *archive_file (SLarchive *archive, const SLlog *log,
+                               const SLpacketinfo *packetinfo,
+                               const char *payload, uint32_t length);
+static int archive_path (const SLarchive *archive, const char *sourceid,
+                         int64_t starttime, char *path, size_t pathsize);
+static ArchFile *open_file (SLarchive *archive, const SLlog *log,
+                            const char *path, uint32_t hash, const char *sourceid);
+static int close_file (SLarchive *archive, const SLlog *log, ArchFile *file);
+static int flush_file (const SLlog *log, ArchFile *file);
+static int truncate_file (const SLlog *log, ArchFile *file, off_t length);
+static int sync_files (SLarchive *archive, const SLlog *log);
+static int make_dirs (char *path);
+static uint32_t hash_path (const char *path);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new miniSEED archive writer
+ *
+ * Records are written to day files in a directory structure below
+ * \a rootdir according to \a layout:
+ *
+ * ::SLARCHIVE_SDS, SeisComP Data Structure:
+ * `ROOT/YEAR/NET/STA/CHAN.D/NET.STA.LOC.CHAN.D.YEAR.DOY`
+ *
+ * ::SLARCHIVE_BUD, Buffer of Uniform Data:
+ * `ROOT/NET/STA/STA.NET.LOC.CHAN.YEAR.DOY`
+ *
+ * Up to \a maxopen files are kept open, when a new file is needed the
+ * least recently used file is closed.  Data for each file is buffered
+ * in \a buffersize bytes.  Directories are created as needed.
+ *
+ * The archive is not thread-safe, all calls must be made from the same
+ * thread or otherwise serialized.
+ *
+ * @param[in] rootdir     Root directory of archive
+ * @param[in] layout      Directory layout, ::SLARCHIVE_SDS or ::SLARCHIVE_BUD
+ * @param[in] maxopen     Maximum number of open files, 0 for a default of 256
+ * @param[in] buffersize  Write buffer size per file, 0 for a default of 64 KiB
+ *
+ * @returns An initialized ::SLarchive on success, NULL on error.
+ *
+ * @sa sl_set_archive()
+ ***************************************************************************/
+SLarchive *
+sl_initslarchive (const char *rootdir, int layout, uint32_t maxopen, uint32_t buffersize)
+{
+  SLarchive *archive;
+
+  if (!rootdir || (layout != SLARCHIVE_SDS && layout != SLARCHIVE_BUD))
+  {
+    sl_log_r (NULL, 2, 0, "%s(): invalid archive root directory or layout\n", __func__);
+    return NULL;
+  }
+
+  if (strlen (rootdir) >= ARCHIVE_MAXPATH - 128)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): archive root directory too long\n", __func__);
+    return NULL;
+  }
+
+  if ((archive = (SLarchive *)sl_malloc (sizeof (SLarchive))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (archive, 0, sizeof (SLarchive));
+
+  strcpy (archive->rootdir, rootdir);
+  archive->layout     = layout;
+  archive->maxopen    = (maxopen) ? maxopen : 256;
+  archive->buffersize = (buffersize) ? buffersize : 65536;
+  archive->pipefd[0]  = -1;
+  archive->pipefd[1]  = -1;
+
+  return archive;
+} /* End of sl_initslarchive() */
+
+/**********************************************************************/ /**
+ * @brief Flush, close and free all resources of an archive writer
+ *
+ * @param[in] archive  Archive writer to free
+ * @param[in] log      Logging parameters, or NULL
+ *
+ * @returns 0 on success and -1 if an error occurred writing or closing files.
+ ***************************************************************************/
+int
+sl_freeslarchive (SLarchive *archive, const SLlog *log)
+{
+  int retval = 0;
+
+  if (!archive)
+    return 0;
+
+  if (archive->syncinterval && sync_files (archive, log))
+    retval = -1;
+
+  while (archive->mru)
+  {
+    if (close_file (archive, log, archive->mru))
+      retval = -1;
+  }
+
+  if (archive->spare)
+  {
+    sl_free (archive->spare->buffer);
+    sl_free (archive->spare);
+  }
+
+  if (archive->pipefd[0] >= 0)
+  {
+    close (archive->pipefd[0]);
+    close (archive->pipefd[1]);
+  }
+
+  sl_free (archive);
+
+  return retval;
+} /* End of sl_freeslarchive() */
+
+/**********************************************************************/ /**
+ * @brief Set the synchronization interval of an archive writer
+ *
+ * Files with data written are synchronized to storage (fdatasync() or
+ * the platform equivalent) in a batch at most every \a interval_ms
+ * milliseconds, checked as records are written and when
+ * sl_archive_flush() is called.  Files are always synchronized when
+ * closed if the interval is non-zero.
+ *
+ * By default synchronization is disabled and data is left to the
+ * operating system to write.
+ *
+ * @param[in] archive      Archive writer
+ * @param[in] interval_ms  Synchronization interval in milliseconds, 0 to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_archive_set_sync (SLarchive *archive, uint32_t interval_ms)
+{
+  if (!archive)
+    return -1;
+
+  archive->syncinterval = interval_ms;
+  archive->lastsync     = sl_nstime ();
+
+  return 0;
+} /* End of sl_archive_set_sync() */
+
+/**********************************************************************/ /**
+ * @brief Write a miniSEED record to an archive
+ *
+ * The record is appended to the day file for its source identifier
+ * and start time.  When the first record of a new day is written for
+ * a source, the file for the previous day is flushed and closed.
+ * Other payload types are ignored.
+ *
+ * @param[in] archive     Archive writer
+ * @param[in] log         Logging parameters, or NULL
+ * @param[in] packetinfo  Packet details as returned by sl_collect()
+ * @param[in] payload     Packet payload
+ *
+ * @retval  1 : record written
+ * @retval  0 : record ignored
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_archive_write (SLarchive *archive, const SLlog *log,
+                  const SLpacketinfo *packetinfo, const char *payload)
+{
+  ArchFile *file;
+  uint32_t length;
+  off_t start;
+
+  if (!archive || !packetinfo || !payload)
+    return -1;
+
+  if (packetinfo->payloadformat != SLPAYLOAD_MSEED2 &&
+      packetinfo->payloadformat != SLPAYLOAD_MSEED3)
+    return 0;
+
+  length = packetinfo->payloadlength;
+
+  if ((file = archive_file (archive, log, packetinfo, payload, length)) == NULL)
+    return -1;
+
+  /* Write buffer if the record does not fit */
+  if (file->bufferlength + length > archive->buffersize && flush_file (log, file))
+    return -1;
+
+  /* Records larger than the buffer are written directly */
+  if (length > archive->buffersize)
+  {
+    if ((start = lseek (file->fd, 0, SEEK_CUR)) < 0)
+    {
+      sl_log_rl (log, 2, 0, "%s(): error seeking %s: %s\n", __func__, file->path, strerror (errno));
+      return -1;
+    }
+
+    if (write (file->fd, payload, length) != (int)length)
+    {
+      sl_log_rl (log, 2, 0, "%s(): error writing %s: %s\n", __func__, file->path, strerror (errno));
+      truncate_file (log, file, start);
+      return -1;
+    }
+
+    file->dirty = 1;
+  }
+  else
+  {
+    memcpy (file->buffer + file->bufferlength, payload, length);
+    file->bufferlength += length;
+  }
+
+  archive->records++;
+  archive->bytes += length;
+
+  if (archive->syncinterval &&
+      sl_nstime () - archive->lastsync >= (int64_t)archive->syncinterval * 1000000)
+  {
+    if (sync_files (archive, log))
+      return -1;
+  }
+
+  return 1;
+} /* End of sl_archive_write() */
+
+/**********************************************************************/ /**
+ * @brief Move a miniSEED record from a socket to an archive with splice()
+ *
+ * The record payload of \a packetinfo.payloadlength bytes is moved
+ * from \a sockfd to the archive file through a pipe using splice(),
+ * without copying the data to user space.  The file is determined
+ * from \a header, the first \a headerlength bytes of the payload read
+ * from the socket with MSG_PEEK, which must include the fixed header
+ * of the record.
+ *
+ * The complete payload must be available to read from the socket,
+ * otherwise nothing is read and 0 is returned, so this never waits
+ * for data.  If the record cannot be written to the file the file is
+ * truncated to its length before the record, and the rest of the
+ * payload is read from the socket and discarded.
+ *
+ * This is used by sl_collect() in splice mode, see sl_set_splicemode().
+ * Only supported on Linux, on other platforms 0 is always returned.
+ *
+ * @param[in] archive       Archive writer
+ * @param[in] log           Logging parameters, or NULL
+ * @param[in] packetinfo    Packet details of the record to move
+ * @param[in] header        Copy of the start of the payload
+ * @param[in] headerlength  Length of \a header
+ * @param[in] sockfd        Socket to move the payload from
+ *
+ * @retval  1 : payload read from the socket, moved to the archive unless
+ *              an error writing the file was logged
+ * @retval  0 : record not archived, no data read from the socket
+ * @retval -1 : error, the payload was partially read from the socket
+ ***************************************************************************/
+int
+sl_archive_splice (SLarchive *archive, const SLlog *log,
+                   const SLpacketinfo *packetinfo, const char *header,
+                   uint32_t headerlength, int sockfd)
+{
+#if defined(__linux__)
+  char discard[4096];
+  ArchFile *file;
+  uint32_t remaining;
+  uint32_t inpipe  = 0;
+  int writefailed  = 0;
+  int available    = 0;
+  off_t start;
+  ssize_t moved;
+
+  if (!archive || !packetinfo || !header)
+    return 0;
+
+  if (packetinfo->payloadformat != SLPAYLOAD_MSEED2 &&
+      packetinfo->payloadformat != SLPAYLOAD_MSEED3)
+    return 0;
+
+  /* Only move complete payloads, partial payloads are collected as usual */
+  if (ioctl (sockfd, FIONREAD, &available) || available < 0 ||
+      (uint32_t)available < packetinfo->payloadlength)
+    return 0;
+
+  if (archive->pipefd[0] < 0)
+  {
+    if (pipe2 (archive->pipefd, O_CLOEXEC))
+    {
+      sl_log_rl (log, 2, 0, "%s(): cannot create pipe: %s\n", __func__, strerror (errno));
+      archive->pipefd[0] = archive->pipefd[1] = -1;
+      return 0;
+    }
+
+    /* Larger pipe to move records in fewer calls, failure is not fatal */
+    fcntl (archive->pipefd[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+  }
+
+  if ((file = archive_file (archive, log, packetinfo, header, headerlength)) == NULL)
+    return 0;
+
+  /* Buffered records precede this one in the file */
+  if (flush_file (log, file))
+    return 0;
+
+  if ((start = lseek (file->fd, 0, SEEK_CUR)) < 0)
+    return 0;
+
+  remaining = packetinfo->payloadlength;
+
+  while (remaining > 0 || inpipe > 0)
+  {
+    if (remaining > 0)
+    {
+      moved = splice (sockfd, NULL, archive->pipefd[1], NULL, remaining,
+                      SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+
+      if (moved > 0)
+      {
+        remaining -= moved;
+        inpipe += moved;
+      }
+      else if (moved == 0)
+      {
+        sl_log_rl (log, 2, 0, "%s(): connection closed during payload\n", __func__);
+        break;
+      }
+      else if (errno == EINTR || (errno == EAGAIN && inpipe > 0))
+      {
+        /* Retry, or empty a full pipe before reading more */
+      }
+      else
+      {
+        sl_log_rl (log, 2, 0, "%s(): error reading payload: %s\n", __func__, strerror (errno));
+        break;
+      }
+    }
+
+    /* Write data in the pipe to the file, or discard it after a write error */
+    while (inpipe > 0)
+    {
+      if (writefailed)
+        moved = read (archive->pipefd[0], discard,
+                      (inpipe < sizeof (discard)) ? inpipe : sizeof (discard));
+      else
+        moved = splice (archive->pipefd[0], NULL, file->fd, NULL, inpipe,
+                        SPLICE_F_MOVE | SPLICE_F_MORE);
+
+      if (moved < 0 && errno == EINTR)
+        continue;
+
+      if (moved > 0)
+      {
+        inpipe -= moved;
+      }
+      else if (writefailed)
+      {
+        break;
+      }
+      else
+      {
+        sl_log_rl (log, 2, 0, "%s(): error writing %s: %s\n", __func__, file->path,
+                   (moved == 0) ? "no data written" : strerror (errno));
+        writefailed = 1;
+      }
+    }
+
+    if (inpipe > 0)
+      break;
+  }
+
+  /* Remove a partially written record from the file */
+  if (remaining > 0 || inpipe > 0 || writefailed)
+    truncate_file (log, file, start);
+
+  if (remaining > 0 || inpipe > 0)
+  {
+    /* Discard data left in the pipe */
+    close (archive->pipefd[0]);
+    close (archive->pipefd[1]);
+    archive->pipefd[0] = archive->pipefd[1] = -1;
+
+    return -1;
+  }
+
+  if (writefailed)
+    return 1;
+
+  file->dirty = 1;
+
+  archive->records++;
+  archive->bytes += packetinfo->payloadlength;
+
+  /* Synchronization failures are logged, the record was moved */
+  if (archive->syncinterval &&
+      sl_nstime () - archive->lastsync >= (int64_t)archive->syncinterval * 1000000)
+  {
+    sync_files (archive, log);
+  }
+
+  return 1;
+#else
+  (void)archive;
+  (void)log;
+  (void)packetinfo;
+  (void)header;
+  (void)headerlength;
+  (void)sockfd;
+
+  return 0;
+#endif
+} /* End of sl_archive_splice() */
+
+/**********************************************************************/ /**
+ * @brief Flush buffered data of an archive writer
+ *
+ * Write buffered data of all open files, and synchronize them to
+ * storage if a synchronization interval is set.
+ *
+ * @param[in] archive  Archive writer
+ * @param[in] log      Logging parameters, or NULL
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sl_archive_flush (SLarchive *archive, const SLlog *log)
+{
+  ArchFile *file;
+  int retval = 0;
+
+  if (!archive)
+    return -1;
+
+  for (file = archive->mru; file; file = file->next)
+  {
+    if (flush_file (log, file))
+      retval = -1;
+  }
+
+  if (archive->syncinterval && sync_files (archive, log))
+    retval = -1;
+
+  return retval;
+} /* End of sl_archive_flush() */
+
+/**********************************************************************/ /**
+ * @brief Return statistics of an archive writer
+ *
+ * @param[in]  archive    Archive writer
+ * @param[out] records    Number of records written, or NULL
+ * @param[out] bytes      Number of bytes written, or NULL
+ * @param[out] openfiles  Number of files currently open, or NULL
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sl_archive_stats (const SLarchive *archive, uint64_t *records,
+                  uint64_t *bytes, uint32_t *openfiles)
+{
+  if (!archive)
+    return -1;
+
+  if (records)
+    *records = archive->records;
+  if (bytes)
+    *bytes = archive->bytes;
+  if (openfiles)
+    *openfiles = archive->openfiles;
+
+  return 0;
+} /* End of sl_archive_stats() */
+
+/***************************************************************************
+ * archive_file:
+ *
+ * Find the open file for a record, opening it if needed, and move it
+ * to the head of the LRU list.  Only the fixed header of the record is
+ * needed in \a payload.  When a file is opened, files of previous days
+ * for the same source are closed.
+ *
+ * Returns a pointer to the file entry on success, NULL on error.
+ ***************************************************************************/
+static ArchFile *
+archive_file (SLarchive *archive, const SLlog *log,
+              const SLpacketinfo *packetinfo, const char *payload, uint32_t length)
+{
+  ArchFile *file;
+  ArchFile *other;
+  char sourceid[64] = {0};
+  char path[ARCHIVE_MAXPATH];
+  uint32_t hash;
+  int64_t starttime;
+
+  if (sl_payload_info (log, packetinfo, payload, length,
+                       sourceid, sizeof (sourceid), NULL, 0, NULL, NULL) == -1)
+    return NULL;
+
+  if ((starttime = sl_payload_starttime (log, packetinfo, payload, length)) == SLTERROR)
+    return NULL;
+
+  if (archive_path (archive, sourceid, starttime, path, sizeof (path)))
+  {
+    sl_log_rl (log, 2, 0, "%s(): cannot create archive path for %s\n", __func__, sourceid);
+    return NULL;
+  }
+
+  hash = hash_path (path);
+
+  /* Find open file */
+  for (file = archive->buckets[hash % ARCHIVE_BUCKETS]; file; file = file->chain)
+  {
+    if (file->hash == hash && strcmp (file->path, path) == 0)
+      break;
+  }
+
+  if (file == NULL)
+  {
+    /* Close files of previous days for this source, e.g. at day boundaries */
+    for (other = archive->mru; other;)
+    {
+      ArchFile *next = other->next;
+
+      if (strcmp (other->sourceid, sourceid) == 0 && strcmp (other->path, path) < 0)
+        close_file (archive, log, other);
+
+      other = next;
+    }
+
+    return open_file (archive, log, path, hash, sourceid);
+  }
+
+  /* Move to the head of the LRU list */
+  if (file != archive->mru)
+  {
+    file->prev->next = file->next;
+
+    if (file->next)
+      file->next->prev = file->prev;
+    else
+      archive->lru = file->prev;
+
+    file->prev         = NULL;
+    file->next         = archive->mru;
+    archive->mru->prev = file;
+    archive->mru       = file;
+  }
+
+  return file;
+} /* End of archive_file() */
+
+/***************************************************************************
+ * archive_path:
+ *
+ * Create the archive file path for a source ID and time.  The source
+ * ID is split into network, station, location and channel codes, with
+ * the channel being the band, source and subsource codes combined.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+archive_path (const SLarchive *archive, const char *sourceid,
+              int64_t starttime, char *path, size_t pathsize)
+{
+  char net[16] = {0};
+  char sta[16] = {0};
+  char loc[16] = {0};
+  char band[16] = {0};
+  char source[16] = {0};
+  char subsource[16] = {0};
+  char chan[48];
+  int year;
+  int yday;
+  int length;
+
+  if (strncmp (sourceid, "FDSN:", 5) == 0)
+    sourceid += 5;
+
+  /* NET_STA_LOC_BAND_SOURCE_SUBSOURCE, location may be empty */
+  if (sscanf (sourceid, "%15[^_]_%15[^_]_", net, sta) != 2)
+    return -1;
+
+  sourceid = strchr (strchr (sourceid, '_') + 1, '_') + 1;
+
+  if (*sourceid == '_')
+    sourceid++;
+  else if (sscanf (sourceid, "%15[^_]_", loc) == 1)
+    sourceid += strlen (loc) + 1;
+  else
+    return -1;
+
+  if (sscanf (sourceid, "%15[^_]_%15[^_]_%15s", band, source, subsource) != 3)
+    return -1;
+
+  snprintf (chan, sizeof (chan), "%s%s%s", band, source, subsource);
+
+  if (sl_nstime2time (starttime, &year, &yday, NULL, NULL, NULL, NULL))
+    return -1;
+
+  if (archive->layout == SLARCHIVE_SDS)
+    length = snprintf (path, pathsize, "%s/%04d/%s/%s/%s.D/%s.%s.%s.%s.D.%04d.%03d",
+                       archive->rootdir, year, net, sta, chan,
+                       net, sta, loc, chan, year, yday);
+  else
+    length = snprintf (path, pathsize, "%s/%s/%s/%s.%s.%s.%s.%04d.%03d",
+                       archive->rootdir, net, sta,
+                       sta, net, loc, chan, year, yday);
+
+  return (length < 0 || (size_t)length >= pathsize) ? -1 : 0;
+} /* End of archive_path() */
+
+/***************************************************************************
+ * open_file:
+ *
+ * Open an archive file for appending, creating directories as needed,
+ * and add it to the hash table and the head of the LRU list.  The least
+ * recently used file is closed if the maximum are already open.
+ *
+ * Returns a pointer to the file entry on success, NULL on error.
+ ***************************************************************************/
+static ArchFile *
+open_file (SLarchive *archive, const SLlog *log,
+           const char *path, uint32_t hash, const char *sourceid)
+{
+  ArchFile *file;
+  char dirpath[ARCHIVE_MAXPATH];
+  int fd;
+
+  if (archive->openfiles >= archive->maxopen && archive->lru)
+    close_file (archive, log, archive->lru);
+
+  if ((fd = open (path, OPENFLAGS, OPENMODE)) < 0 && errno == ENOENT)
+  {
+    strcpy (dirpath, path);
+
+    if (make_dirs (dirpath))
+    {
+      sl_log_rl (log, 2, 0, "%s(): cannot create directories for %s: %s\n",
+                 __func__, path, strerror (errno));
+      return NULL;
+    }
+
+    fd = open (path, OPENFLAGS, OPENMODE);
+  }
+
+  if (fd < 0)
+  {
+    sl_log_rl (log, 2, 0, "%s(): cannot open %s: %s\n", __func__, path, strerror (errno));
+    return NULL;
+  }
+
+#if !defined(SLP_WIN)
+  if (lseek (fd, 0, SEEK_END) < 0)
+  {
+    sl_log_rl (log, 2, 0, "%s(): cannot seek to end of %s: %s\n", __func__, path, strerror (errno));
+    close (fd);
+    return NULL;
+  }
+#endif
+
+  /* Reuse a closed entry and buffer if available */
+  if (archive->spare)
+  {
+    file           = archive->spare;
+    archive->spare = NULL;
+  }
+  else if ((file = (ArchFile *)sl_malloc (sizeof (ArchFile))) == NULL ||
+           (file->buffer = (char *)sl_malloc (archive->buffersize)) == NULL)
+  {
+    sl_log_rl (log, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_free (file);
+    close (fd);
+    return NULL;
+  }
+
+  strncpy (file->path, path, sizeof (file->path) - 1);
+  file->path[sizeof (file->path) - 1] = '\0';
+  strncpy (file->sourceid, sourceid, sizeof (file->sourceid) - 1);
+  file->sourceid[sizeof (file->sourceid) - 1] = '\0';
+  file->hash         = hash;
+  file->fd           = fd;
+  file->dirty        = 0;
+  file->bufferlength = 0;
+
+  file->chain = archive->buckets[hash % ARCHIVE_BUCKETS];
+  archive->buckets[hash % ARCHIVE_BUCKETS] = file;
+
+  file->prev = NULL;
+  file->next = archive->mru;
+
+  if (archive->mru)
+    archive->mru->prev = file;
+  else
+    archive->lru = file;
+
+  archive->mru = file;
+  archive->openfiles++;
+
+  sl_log_rl (log, 1, 2, "Opened archive file %s\n", path);
+
+  return file;
+} /* End of open_file() */
+
+/***************************************************************************
+ * close_file:
+ *
+ * Flush, optionally synchronize, and close an archive file, removing
+ * it from the hash table and LRU list.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+close_file (SLarchive *archive, const SLlog *log, ArchFile *file)
+{
+  ArchFile **link;
+  int retval = 0;
+
+  if (flush_file (log, file))
+    retval = -1;
+
+  if (archive->syncinterval && file->dirty && SYNCFD (file->fd))
+  {
+    sl_log_rl (log, 2, 0, "%s(): error synchronizing %s: %s\n", __func__, file->path, strerror (errno));
+    retval = -1;
+  }
+
+  if (close (file->fd))
+  {
+    sl_log_rl (log, 2, 0, "%s(): error closing %s: %s\n", __func__, file->path, strerror (errno));
+    retval = -1;
+  }
+
+  sl_log_rl (log, 1, 2, "Closed archive file %s\n", file->path);
+
+  /* Remove from hash bucket */
+  for (link = &archive->buckets[file->hash % ARCHIVE_BUCKETS]; *link; link = &(*link)->chain)
+  {
+    if (*link == file)
+    {
+      *link = file->chain;
+      break;
+    }
+  }
+
+  /* Remove from LRU list */
+  if (file->prev)
+    file->prev->next = file->next;
+  else
+    archive->mru = file->next;
+
+  if (file->next)
+    file->next->prev = file->prev;
+  else
+    archive->lru = file->prev;
+
+  archive->openfiles--;
+
+  /* Keep one entry for reuse */
+  if (archive->spare == NULL)
+  {
+    archive->spare = file;
+  }
+  else
+  {
+    sl_free (file->buffer);
+    sl_free (file);
+  }
+
+  return retval;
+} /* End of close_file() */
+
+/***************************************************************************
+ * flush_file:
+ *
+ * Write buffered data of an archive file.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+flush_file (const SLlog *log, ArchFile *file)
+{
+  uint32_t written = 0;
+  off_t start;
+  int rv;
+
+  if (file->bufferlength == 0)
+    return 0;
+
+  if ((start = lseek (file->fd, 0, SEEK_CUR)) < 0)
+  {
+    sl_log_rl (log, 2, 0, "%s(): error seeking %s: %s\n", __func__, file->path, strerror (errno));
+    return -1;
+  }
+
+  while (written < file->bufferlength)
+  {
+    rv = write (file->fd, file->buffer + written, file->bufferlength - written);
+
+    if (rv < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      /* Buffered data is kept and written again on the next flush */
+      sl_log_rl (log, 2, 0, "%s(): error writing %s: %s\n", __func__, file->path, strerror (errno));
+      truncate_file (log, file, start);
+      return -1;
+    }
+
+    written += rv;
+  }
+
+  if (file->bufferlength > 0)
+    file->dirty = 1;
+
+  file->bufferlength = 0;
+
+  return 0;
+} /* End of flush_file() */
+
+/***************************************************************************
+ * truncate_file:
+ *
+ * Remove partially written records from the end of an archive file by
+ * truncating it to the specified length, which becomes the offset of
+ * the next write.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+truncate_file (const SLlog *log, ArchFile *file, off_t length)
+{
+  if (TRUNCATEFD (file->fd, length) || lseek (file->fd, length, SEEK_SET) < 0)
+  {
+    sl_log_rl (log, 2, 0, "%s(): cannot truncate %s: %s\n", __func__, file->path, strerror (errno));
+    return -1;
+  }
+
+  return 0;
+} /* End of truncate_file() */
+
+/***************************************************************************
+ * sync_files:
+ *
+ * Write buffered data of all open files and synchronize the files with
+ * data written since the last synchronization.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+sync_files (SLarchive *archive, const SLlog *log)
+{
+  ArchFile *file;
+  int retval = 0;
+
+  for (file = archive->mru; file; file = file->next)
+  {
+    if (flush_file (log, file))
+      retval = -1;
+
+    if (file->dirty)
+    {
+      if (SYNCFD (file->fd))
+      {
+        sl_log_rl (log, 2, 0, "%s(): error synchronizing %s: %s\n",
+                   __func__, file->path, strerror (errno));
+        retval = -1;
+      }
+
+      file->dirty = 0;
+    }
+  }
+
+  archive->lastsync = sl_nstime ();
+
+  return retval;
+} /* End of sync_files() */
+
+/***************************************************************************
+ * make_dirs:
+ *
+ * Create all directories of a file path.  The path is modified during
+ * processing and restored.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+make_dirs (char *path)
+{
+  char *cp;
+
+  for (cp = strchr (path + 1, '/'); cp; cp = strchr (cp + 1, '/'))
+  {
+    *cp = '\0';
+
+    if (MKDIR (path) && errno != EEXIST)
+    {
+      *cp = '/';
+      return -1;
+    }
+
+    *cp = '/';
+  }
+
+  return 0;
+} /* End of make_dirs() */
+
+/***************************************************************************
+ * hash_path:
+ *
+ * Compute the 32-bit FNV-1a hash of a path.
+ ***************************************************************************/
+static uint32_t
+hash_path (const char *path)
+{
+  uint32_t hash = 2166136261U;
+
+  while (*path)
+  {
+    hash ^= (uint8_t)*path++;
+    hash *= 16777619U;
+  }
+
+  return hash;
+} /* End of hash_path() */
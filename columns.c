@@ -0,0 +1,393 @@
+/***************************************************************************
+ * columns.c
+ *
+ * Routines for collecting packet metadata into columnar arrays.
+ *
+ * Packets are collected in blocks, the fixed header of each packet is
+ * staged at a fixed stride and each block is decoded one column at a
+ * time.  Source identifiers are dictionary encoded in an Arrow
+ * compatible string layout.  No memory is allocated.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+#include "mseedformat.h"
+
+/* Number of packets staged before decoding */
+#define COL_BLOCK 64
+
+/* Bytes of each payload staged, fixed header and source identifier */
+#define COL_STRIDE 128
+
+/* Staged header kinds */
+#define COL_OTHER   0
+#define COL_MSEED2  1
+#define COL_MSEED3  2
+
+/* Packet headers staged for decoding, 8-byte aligned rows */
+typedef struct ColBlock
+{
+  uint64_t header[COL_BLOCK][COL_STRIDE / 8];
+  uint8_t kind[COL_BLOCK];
+  uint8_t length[COL_BLOCK];
+  uint8_t swapflag[COL_BLOCK];
+  uint32_t count;
+} ColBlock;
+
+static void decode_block (SLcolumns *columns, ColBlock *block, uint32_t firstrow);
+static int32_t dictionary_index (SLcolumns *columns, const char *sourceid, uint32_t length);
+
+/**********************************************************************/ /**
+ * @brief Collect packets and write their metadata to columns
+ *
+ * Packets are collected with sl_collect() into \a plbuffer and the
+ * metadata of each is written as a row of the column arrays in
+ * \a columns, starting at row 0, until SLcolumns.capacity rows are
+ * written or sl_collect() returns a status other than ::SLPACKET.  The
+ * payloads themselves are not retained.
+ *
+ * Each column array is provided by the caller and must have room for
+ * SLcolumns.capacity values, columns that are NULL are not written.
+ * For use with Arrow the arrays should be 64-byte aligned.  The fixed
+ * headers of packets are staged in blocks and each block is decoded
+ * one column at a time.
+ *
+ * Source identifiers are dictionary encoded: SLcolumns.sourceid
+ * contains indexes into a dictionary in the Arrow string layout of
+ * SLcolumns.dictoffsets and SLcolumns.dictdata.  The dictionary is
+ * kept across calls, new identifiers are appended.  When
+ * SLcolumns.dictslots is provided it is used as a hash table for
+ * dictionary lookup, otherwise the dictionary is searched.  Rows
+ * without a source identifier, i.e. payloads that are not miniSEED,
+ * or whose identifier does not fit in the dictionary have an index of
+ * -1.
+ *
+ * With a blocking connection this function returns when the columns
+ * are full or the connection is terminated.  With a non-blocking
+ * connection it returns when no more packets are available.
+ *
+ * @param[in] slconn  SeedLink connection description
+ * @param[in,out] columns  Column arrays to write, SLcolumns.length is set
+ * @param[out] plbuffer  Buffer for packet payloads
+ * @param[in] plbuffersize  Size of payload buffer
+ * @param[out] status  Status returned by the last call to sl_collect(), or NULL
+ *
+ * @returns The number of rows written, -1 on error.
+ *
+ * @sa sl_collect()
+ ***************************************************************************/
+int
+sl_collect_columns (SLCD *slconn, SLcolumns *columns,
+                    char *plbuffer, uint32_t plbuffersize, int *status)
+{
+  const SLpacketinfo *packetinfo = NULL;
+  ColBlock block;
+  uint32_t firstrow = 0;
+  uint32_t length;
+  uint32_t row;
+  int rv = SLNOPACKET;
+
+  if (!slconn || !columns || !plbuffer)
+    return -1;
+
+  columns->length = 0;
+  block.count     = 0;
+
+  while (columns->length < columns->capacity)
+  {
+    rv = sl_collect (slconn, &packetinfo, plbuffer, plbuffersize);
+
+    if (rv != SLPACKET)
+      break;
+
+    row = columns->length++;
+
+    /* Values from packet info */
+    if (columns->seqnum)
+      columns->seqnum[row] = packetinfo->seqnum;
+    if (columns->arrivaltime)
+      columns->arrivaltime[row] = sl_nstime ();
+    if (columns->payloadlength)
+      columns->payloadlength[row] = packetinfo->payloadlength;
+    if (columns->format)
+      columns->format[row] = packetinfo->payloadformat;
+
+    /* Stage fixed header for decoding */
+    length = (packetinfo->payloadlength < COL_STRIDE) ? packetinfo->payloadlength : COL_STRIDE;
+
+    if (packetinfo->payloadformat == SLPAYLOAD_MSEED2 && length >= 48)
+      block.kind[block.count] = COL_MSEED2;
+    else if (packetinfo->payloadformat == SLPAYLOAD_MSEED3 && length >= MS3FSDH_LENGTH)
+      block.kind[block.count] = COL_MSEED3;
+    else
+      block.kind[block.count] = COL_OTHER;
+
+    memcpy (block.header[block.count], plbuffer, length);
+    block.length[block.count] = (uint8_t)length;
+
+    if (++block.count == COL_BLOCK)
+    {
+      decode_block (columns, &block, firstrow);
+      firstrow += block.count;
+      block.count = 0;
+    }
+  }
+
+  if (block.count > 0)
+    decode_block (columns, &block, firstrow);
+
+  if (status)
+    *status = rv;
+
+  return (int)columns->length;
+} /* End of sl_collect_columns() */
+
+/***************************************************************************
+ * decode_block:
+ *
+ * Decode the staged headers of a block into the column rows starting
+ * at firstrow, one column at a time.
+ ***************************************************************************/
+static void
+decode_block (SLcolumns *columns, ColBlock *block, uint32_t firstrow)
+{
+  const char *header;
+  char sourceid[COL_STRIDE];
+  uint32_t idx;
+  uint32_t length;
+  int16_t factor;
+  int16_t multiplier;
+  double samplerate;
+  uint8_t bigendianhost = (sl_littleendianhost ()) ? 0 : 1;
+
+  /* Byte order, miniSEED 2 determined from year and day */
+  for (idx = 0; idx < block->count; idx++)
+  {
+    header = (const char *)block->header[idx];
+
+    if (block->kind[idx] == COL_MSEED2)
+      block->swapflag[idx] = (MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (header), *pMS2FSDH_DAY (header))) ? 0 : 1;
+    else
+      block->swapflag[idx] = bigendianhost;
+  }
+
+  if (columns->starttime)
+  {
+    int64_t *starttime = columns->starttime + firstrow;
+
+    for (idx = 0; idx < block->count; idx++)
+    {
+      header = (const char *)block->header[idx];
+
+      if (block->kind[idx] == COL_MSEED2)
+        starttime[idx] = sl_time2nstime (HO2u (*pMS2FSDH_YEAR (header), block->swapflag[idx]),
+                                         HO2u (*pMS2FSDH_DAY (header), block->swapflag[idx]),
+                                         *pMS2FSDH_HOUR (header),
+                                         *pMS2FSDH_MIN (header),
+                                         *pMS2FSDH_SEC (header),
+                                         (uint32_t)HO2u (*pMS2FSDH_FSEC (header), block->swapflag[idx]) * 100000);
+      else if (block->kind[idx] == COL_MSEED3)
+        starttime[idx] = sl_time2nstime (HO2u (*pMS3FSDH_YEAR (header), block->swapflag[idx]),
+                                         HO2u (*pMS3FSDH_DAY (header), block->swapflag[idx]),
+                                         *pMS3FSDH_HOUR (header),
+                                         *pMS3FSDH_MIN (header),
+                                         *pMS3FSDH_SEC (header),
+                                         HO4u (*pMS3FSDH_NSEC (header), block->swapflag[idx]));
+      else
+        starttime[idx] = SLTERROR;
+    }
+  }
+
+  if (columns->samplerate)
+  {
+    double *rate = columns->samplerate + firstrow;
+
+    for (idx = 0; idx < block->count; idx++)
+    {
+      header     = (const char *)block->header[idx];
+      samplerate = 0.0;
+
+      if (block->kind[idx] == COL_MSEED2)
+      {
+        factor     = HO2d (*pMS2FSDH_SAMPLERATEFACT (header), block->swapflag[idx]);
+        multiplier = HO2d (*pMS2FSDH_SAMPLERATEMULT (header), block->swapflag[idx]);
+
+        if (factor > 0)
+          samplerate = (double)factor;
+        else if (factor < 0)
+          samplerate = -1.0 / (double)factor;
+
+        if (multiplier > 0)
+          samplerate = samplerate * (double)multiplier;
+        else if (multiplier < 0)
+          samplerate = -1.0 * (samplerate / (double)multiplier);
+      }
+      else if (block->kind[idx] == COL_MSEED3)
+      {
+        samplerate = HO8f (*pMS3FSDH_SAMPLERATE (header), block->swapflag[idx]);
+
+        /* Negative values are sample periods in seconds */
+        if (samplerate < 0.0)
+          samplerate = -1.0 / samplerate;
+      }
+
+      rate[idx] = samplerate;
+    }
+  }
+
+  if (columns->samplecount)
+  {
+    uint32_t *count = columns->samplecount + firstrow;
+
+    for (idx = 0; idx < block->count; idx++)
+    {
+      header = (const char *)block->header[idx];
+
+      if (block->kind[idx] == COL_MSEED2)
+        count[idx] = HO2u (*pMS2FSDH_NUMSAMPLES (header), block->swapflag[idx]);
+      else if (block->kind[idx] == COL_MSEED3)
+        count[idx] = HO4u (*pMS3FSDH_NUMSAMPLES (header), block->swapflag[idx]);
+      else
+        count[idx] = 0;
+    }
+  }
+
+  if (columns->sourceid)
+  {
+    int32_t *index = columns->sourceid + firstrow;
+
+    for (idx = 0; idx < block->count; idx++)
+    {
+      header = (const char *)block->header[idx];
+
+      if (block->kind[idx] == COL_MSEED2)
+      {
+        /* FDSN:NET_STA_LOC_B_S_SS from SEED codes, as sl_payload_info() */
+        memcpy (sourceid, "FDSN:", 5);
+        length = 5;
+        length += sl_strncpclean (sourceid + length, pMS2FSDH_NETWORK (header), 2);
+        sourceid[length++] = '_';
+        length += sl_strncpclean (sourceid + length, pMS2FSDH_STATION (header), 5);
+        sourceid[length++] = '_';
+        length += sl_strncpclean (sourceid + length, pMS2FSDH_LOCATION (header), 2);
+        sourceid[length++] = '_';
+        sourceid[length++] = pMS2FSDH_CHANNEL (header)[0];
+        sourceid[length++] = '_';
+        sourceid[length++] = pMS2FSDH_CHANNEL (header)[1];
+        sourceid[length++] = '_';
+        sourceid[length++] = pMS2FSDH_CHANNEL (header)[2];
+
+        index[idx] = dictionary_index (columns, sourceid, length);
+      }
+      else if (block->kind[idx] == COL_MSEED3 &&
+               MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH (header) <= block->length[idx])
+      {
+        index[idx] = dictionary_index (columns, pMS3FSDH_SID (header),
+                                       *pMS3FSDH_SIDLENGTH (header));
+      }
+      else
+      {
+        index[idx] = -1;
+      }
+    }
+  }
+} /* End of decode_block() */
+
+/***************************************************************************
+ * dictionary_index:
+ *
+ * Find a source identifier in the dictionary of columns, adding it if
+ * not present.  The hash slots, when provided, contain dictionary
+ * index + 1 for each identifier with 0 marking empty slots.
+ *
+ * Returns the dictionary index on success and -1 if the identifier
+ * does not fit in the dictionary.
+ ***************************************************************************/
+static int32_t
+dictionary_index (SLcolumns *columns, const char *sourceid, uint32_t length)
+{
+  uint32_t hash = 2166136261u;
+  uint32_t mask;
+  uint32_t slot;
+  uint32_t idx;
+  int32_t offset;
+
+  if (!columns->dictoffsets || !columns->dictdata)
+    return -1;
+
+  if (columns->dictslots && columns->dictslotcount > 0)
+  {
+    /* FNV-1a hash with linear probing */
+    for (idx = 0; idx < length; idx++)
+      hash = (hash ^ (uint8_t)sourceid[idx]) * 16777619u;
+
+    mask = columns->dictslotcount - 1;
+
+    for (slot = hash & mask; columns->dictslots[slot] != 0; slot = (slot + 1) & mask)
+    {
+      idx    = columns->dictslots[slot] - 1;
+      offset = columns->dictoffsets[idx];
+
+      if ((uint32_t)(columns->dictoffsets[idx + 1] - offset) == length &&
+          memcmp (columns->dictdata + offset, sourceid, length) == 0)
+        return (int32_t)idx;
+    }
+
+    /* Keep at least one empty slot to terminate probing */
+    if (columns->dictlength + 1 >= columns->dictslotcount)
+      return -1;
+  }
+  else
+  {
+    slot = 0;
+
+    for (idx = 0; idx < columns->dictlength; idx++)
+    {
+      offset = columns->dictoffsets[idx];
+
+      if ((uint32_t)(columns->dictoffsets[idx + 1] - offset) == length &&
+          memcmp (columns->dictdata + offset, sourceid, length) == 0)
+        return (int32_t)idx;
+    }
+  }
+
+  /* Append new identifier */
+  if (columns->dictlength >= columns->dictcapacity)
+    return -1;
+
+  offset = (columns->dictlength) ? columns->dictoffsets[columns->dictlength] : 0;
+
+  if ((uint32_t)offset + length > columns->dictdatasize)
+    return -1;
+
+  idx = columns->dictlength++;
+
+  memcpy (columns->dictdata + offset, sourceid, length);
+  columns->dictoffsets[idx]     = offset;
+  columns->dictoffsets[idx + 1] = offset + (int32_t)length;
+
+  if (columns->dictslots && columns->dictslotcount > 0)
+    columns->dictslots[slot] = idx + 1;
+
+  return (int32_t)idx;
+} /* End of dictionary_index() */
@@ -22,12 +22,28 @@
  * @author Chad Trabant, EarthScope Data Services
  ***************************************************************************/
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "globmatch.h"
 #include "libslink.h"
 
+/* Maximum length of a single selector */
+#define SELECTOR_LENGTH 32
+
+static int normalize_selectors (SLstream *stream);
+static int combine_selectors (SLstream *stream, const SLinvstation *station);
+static char *selector_key (char *key, const char *selector, int level);
+static int match_stream (const char *selector, const char *streamid);
+static int compatible_streams (const SLstream *a, const SLstream *b);
+static int same_selectors (const SLstream *a, const SLstream *b);
+static int wildcard_station (const char *stationid);
+static int compare_selectors (const void *a, const void *b);
+static void free_stream (SLstream *stream);
+
 /**********************************************************************/ /**
  * @brief Add a list of streams and selectors from a file to the ::SLCD
  *
@@ -181,7 +197,7 @@ sl_add_streamlist (SLCD *slconn, const char *streamlist,
     return -1;
 
   /* Make a copy that can freely be modified */
-  parselist = strdup (streamlist);
+  parselist = sl_strdup (streamlist);
 
   stream = parselist;
   while (stream)
@@ -212,7 +228,596 @@ sl_add_streamlist (SLCD *slconn, const char *streamlist,
     stream = nextstream;
   }
 
-  free (parselist);
+  sl_free (parselist);
 
   return streamcount;
 } /* End of sl_parse_streamlist() */
+
+/**********************************************************************/ /**
+ * @brief Compact the stream list of a ::SLCD to shrink negotiation
+ *
+ * Stream lists generated from an inventory often name every station
+ * of a network explicitly with identical selectors, each entry is
+ * negotiated with a STATION command followed by SELECT and DATA
+ * commands.  This routine rewrites the stream list to an equivalent,
+ * shorter list.  It should be called after the stream list is
+ * configured and before the connection is established, or changes are
+ * only negotiated on the next connection.
+ *
+ * The following transformations are applied:
+ *
+ *  - Selectors of each entry are sorted and duplicates removed.
+ *  - Entries that duplicate another entry are removed.
+ *  - Entries covered by a wildcard entry, e.g. \c "GE_WLF" by
+ *    \c "GE_*", with the same selectors are removed.
+ *
+ * When an inventory is provided, which should be the result of a
+ * current INFO STATIONS or INFO STREAMS request to the same server:
+ *
+ *  - Entries for every station of a network in the inventory, with the
+ *    same selectors and no other entries matching them, are replaced
+ *    with a single wildcard entry, e.g. \c "GE_*".  Stations added to
+ *    the network on the server later will also be received.
+ *  - For stations with streams in the inventory, selectors that share
+ *    a prefix are combined into a wildcard selector, e.g.
+ *    \c "BHE BHN BHZ" to \c "BH?", if no other streams of the station
+ *    would be selected.
+ *
+ * Only entries with a compatible resume state are merged: no saved
+ * sequence number (::SL_UNSETSEQUENCE or ::SL_ALLDATASEQUENCE) and
+ * the same start time stamp.  Entries with saved sequence numbers are
+ * never merged, but their selectors may be combined.  Selectors
+ * containing negations are not combined.
+ *
+ * Wildcard station IDs are supported by all v4 servers, v3 servers
+ * may not support them in multi-station mode.
+ *
+ * @param[in] slconn  SeedLink connection description
+ * @param[in] inv     Inventory of the server, NULL if not available
+ *
+ * @returns the number of stream list entries removed or -1 on error.
+ *
+ * @sa sl_add_stream(), sl_add_streamlist(), sl_inventory_parse()
+ ***************************************************************************/
+int
+sl_compact_streams (SLCD *slconn, const SLinventory *inv)
+{
+  const SLinvstation *station;
+  SLstream *stream;
+  SLstream *other;
+  SLstream *first;
+  SLstream *last;
+  SLstream *next;
+  SLstream *wild;
+  SLstream *previous;
+  SLstream **link;
+  char pattern[SL_MAX_STATIONID];
+  uint32_t low;
+  uint32_t high;
+  uint32_t mid;
+  uint32_t count;
+  size_t netlength;
+  int entries = 0;
+  int removed = 0;
+  int members;
+  int uniform;
+  int drop;
+
+  if (!slconn)
+    return -1;
+
+  if (slconn->multistation == 0)
+    return 0;
+
+  for (stream = slconn->streams; stream; stream = stream->next)
+  {
+    entries++;
+
+    if (normalize_selectors (stream))
+    {
+      sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+      return -1;
+    }
+
+    /* Combine selectors using the streams of the station */
+    if (inv && !wildcard_station (stream->stationid) &&
+        (station = sl_inventory_station (inv, stream->stationid)) != NULL &&
+        station->streamcount > 0)
+    {
+      if (combine_selectors (stream, station) < 0)
+      {
+        sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+        return -1;
+      }
+    }
+  }
+
+  /* Replace entries for all stations of a network with a network wildcard.
+   * Entries without wildcards are sorted, so entries of a network are adjacent. */
+  link = (inv) ? &slconn->streams : NULL;
+  while (link && *link)
+  {
+    first = *link;
+    last  = first;
+
+    if (wildcard_station (first->stationid) ||
+        strchr (first->stationid, '_') == NULL)
+    {
+      link = &first->next;
+      continue;
+    }
+
+    netlength = strchr (first->stationid, '_') - first->stationid + 1;
+    members   = 1;
+    uniform   = compatible_streams (first, first) &&
+                sl_inventory_station (inv, first->stationid) != NULL;
+
+    while (last->next && !wildcard_station (last->next->stationid) &&
+           strncmp (last->next->stationid, first->stationid, netlength) == 0)
+    {
+      last = last->next;
+      members++;
+
+      if (!compatible_streams (first, last) || !same_selectors (first, last) ||
+          sl_inventory_station (inv, last->stationid) == NULL)
+        uniform = 0;
+    }
+
+    /* Count stations of the network in the inventory from the lower bound */
+    for (low = 0, high = inv->stationcount; uniform && low < high;)
+    {
+      mid = low + (high - low) / 2;
+
+      if (strncmp (inv->stations[mid].stationid, first->stationid, netlength) < 0)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    for (count = 0; uniform && low + count < inv->stationcount &&
+                    strncmp (inv->stations[low + count].stationid, first->stationid, netlength) == 0;
+         count++)
+      ;
+
+    if (count != (uint32_t)members || members < 2)
+      uniform = 0;
+
+    /* Wildcard entries matching these stations must select the same streams */
+    for (wild = last->next; wild && !wildcard_station (wild->stationid); wild = wild->next)
+      ;
+
+    for (other = wild; uniform && other; other = other->next)
+    {
+      for (stream = first; stream != last->next; stream = stream->next)
+      {
+        if (sl_globmatch (stream->stationid, other->stationid) &&
+            !same_selectors (first, other))
+        {
+          uniform = 0;
+          break;
+        }
+      }
+    }
+
+    if (!uniform)
+    {
+      link = &last->next;
+      continue;
+    }
+
+    snprintf (pattern, sizeof (pattern), "%.*s*", (int)netlength, first->stationid);
+
+    /* Added to the wildcard partition, after the station entries */
+    if (sl_add_stream (slconn, pattern, first->selectors, first->seqnum,
+                       (first->timestamp[0]) ? first->timestamp : NULL))
+      return -1;
+
+    *link      = last->next;
+    last->next = NULL;
+
+    for (stream = first; stream; stream = next)
+    {
+      next = stream->next;
+      free_stream (stream);
+    }
+
+    removed += members - 1;
+  }
+
+  /* Find the first wildcard entry, wildcard partitions follow all others */
+  for (wild = slconn->streams; wild && !wildcard_station (wild->stationid); wild = wild->next)
+    ;
+
+  /* Remove duplicate entries and station entries covered by a wildcard entry */
+  previous = NULL;
+  link     = &slconn->streams;
+  while ((stream = *link) != NULL)
+  {
+    drop = 0;
+
+    /* Duplicates are adjacent in the sorted list, the first is kept */
+    if (previous && strcmp (previous->stationid, stream->stationid) == 0 &&
+        compatible_streams (previous, stream) && same_selectors (previous, stream))
+    {
+      drop = 1;
+    }
+    else if (!wildcard_station (stream->stationid))
+    {
+      for (other = wild; other; other = other->next)
+      {
+        if (sl_globmatch (stream->stationid, other->stationid) &&
+            compatible_streams (stream, other) && same_selectors (stream, other))
+        {
+          drop = 1;
+          break;
+        }
+      }
+    }
+
+    if (drop)
+    {
+      *link = stream->next;
+      free_stream (stream);
+      removed++;
+    }
+    else
+    {
+      previous = stream;
+      link     = &stream->next;
+    }
+  }
+
+  if (removed > 0)
+    sl_log_r (slconn, 1, 1, "[%s] Compacted stream list from %d to %d entries\n",
+              slconn->sladdr, entries, entries - removed);
+
+  return removed;
+} /* End of sl_compact_streams() */
+
+/***************************************************************************
+ * normalize_selectors:
+ *
+ * Sort the space-separated selectors of a stream list entry and remove
+ * duplicates, so that entries selecting the same streams have identical
+ * selector strings.  Empty selectors are set to NULL.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+normalize_selectors (SLstream *stream)
+{
+  char **tokens;
+  char *copy;
+  char *cp;
+  size_t count = 0;
+  size_t length = 0;
+  size_t idx;
+
+  if (stream->selectors == NULL)
+    return 0;
+
+  if ((copy = sl_strdup (stream->selectors)) == NULL)
+    return -1;
+
+  for (cp = copy; *(cp += strspn (cp, " ")); cp += strcspn (cp, " "))
+    count++;
+
+  if (count == 0)
+  {
+    sl_free (copy);
+    sl_free (stream->selectors);
+    stream->selectors = NULL;
+    return 0;
+  }
+
+  if ((tokens = (char **)sl_malloc (count * sizeof (char *))) == NULL)
+  {
+    sl_free (copy);
+    return -1;
+  }
+
+  for (cp = copy, idx = 0; *(cp += strspn (cp, " ")); idx++)
+  {
+    tokens[idx] = cp;
+    cp += strcspn (cp, " ");
+
+    if (*cp)
+      *cp++ = '\0';
+  }
+
+  qsort (tokens, count, sizeof (char *), compare_selectors);
+
+  /* Join unique selectors, never longer than the original */
+  for (idx = 0; idx < count; idx++)
+  {
+    if (idx > 0 && strcmp (tokens[idx], tokens[idx - 1]) == 0)
+      continue;
+
+    if (length > 0)
+      stream->selectors[length++] = ' ';
+
+    strcpy (stream->selectors + length, tokens[idx]);
+    length += strlen (tokens[idx]);
+  }
+
+  stream->selectors[length] = '\0';
+
+  sl_free (tokens);
+  sl_free (copy);
+
+  return 0;
+} /* End of normalize_selectors() */
+
+/***************************************************************************
+ * combine_selectors:
+ *
+ * Combine selectors of a stream list entry that differ only in one of
+ * the band, source or subsource codes into a single selector with a
+ * '?' wildcard, e.g. "BHE BHN BHZ" to "BH?", repeated for each code
+ * from the end.  Selectors are only combined when the combined selector
+ * does not match any other stream of the station in the inventory.
+ *
+ * Returns the number of selectors removed, or -1 on error.
+ ***************************************************************************/
+static int
+combine_selectors (SLstream *stream, const SLinvstation *station)
+{
+  char (*tokens)[SELECTOR_LENGTH];
+  char key[SELECTOR_LENGTH];
+  char other[SELECTOR_LENGTH];
+  char *cp;
+  size_t count = 0;
+  size_t length;
+  size_t idx;
+  size_t jdx;
+  uint32_t sdx;
+  int combined = 0;
+  int members;
+  int covered;
+  int level;
+
+  if (stream->selectors == NULL)
+    return 0;
+
+  for (cp = stream->selectors; *(cp += strspn (cp, " ")); cp += length)
+  {
+    length = strcspn (cp, " ");
+
+    /* Negations and long selectors are not combined */
+    if (*cp == '!' || length >= SELECTOR_LENGTH)
+      return 0;
+
+    count++;
+  }
+
+  if (count < 2)
+    return 0;
+
+  if ((tokens = sl_malloc (count * SELECTOR_LENGTH)) == NULL)
+    return -1;
+
+  for (cp = stream->selectors, idx = 0; *(cp += strspn (cp, " ")); cp += length, idx++)
+  {
+    length = strcspn (cp, " ");
+    memcpy (tokens[idx], cp, length);
+    tokens[idx][length] = '\0';
+  }
+
+  /* Combine subsource, then source, then band codes */
+  for (level = 0; level < 3; level++)
+  {
+    for (idx = 0; idx < count; idx++)
+    {
+      if (tokens[idx][0] == '\0' || selector_key (key, tokens[idx], level) == NULL)
+        continue;
+
+      members = 1;
+      for (jdx = idx + 1; jdx < count; jdx++)
+      {
+        if (tokens[jdx][0] && selector_key (other, tokens[jdx], level) &&
+            strcmp (key, other) == 0)
+          members++;
+      }
+
+      if (members < 2)
+        continue;
+
+      /* Streams matching the combined selector must already be selected */
+      covered = 1;
+      for (sdx = 0; covered && sdx < station->streamcount; sdx++)
+      {
+        if ((covered = match_stream (key, station->streams[sdx].streamid)) != 1)
+        {
+          covered = (covered == 0);
+          continue;
+        }
+
+        covered = 0;
+        for (jdx = idx; jdx < count && !covered; jdx++)
+        {
+          if (tokens[jdx][0] && selector_key (other, tokens[jdx], level) &&
+              strcmp (key, other) == 0)
+            covered = (match_stream (tokens[jdx], station->streams[sdx].streamid) == 1);
+        }
+      }
+
+      if (!covered)
+        continue;
+
+      for (jdx = idx + 1; jdx < count; jdx++)
+      {
+        if (tokens[jdx][0] && selector_key (other, tokens[jdx], level) &&
+            strcmp (key, other) == 0)
+          tokens[jdx][0] = '\0';
+      }
+
+      strcpy (tokens[idx], key);
+      combined += members - 1;
+    }
+  }
+
+  /* Rebuild selectors, never longer than the original */
+  if (combined > 0)
+  {
+    for (idx = 0, length = 0; idx < count; idx++)
+    {
+      if (tokens[idx][0] == '\0')
+        continue;
+
+      if (length > 0)
+        stream->selectors[length++] = ' ';
+
+      strcpy (stream->selectors + length, tokens[idx]);
+      length += strlen (tokens[idx]);
+    }
+
+    stream->selectors[length] = '\0';
+  }
+
+  sl_free (tokens);
+
+  if (combined > 0 && normalize_selectors (stream))
+    return -1;
+
+  return combined;
+} /* End of combine_selectors() */
+
+/***************************************************************************
+ * selector_key:
+ *
+ * Copy a selector to key with the code at the specified level, counted
+ * from the end of the stream ID ignoring '_' separators, replaced with
+ * a '?' wildcard.  Level 0 is the subsource code, 1 the source code
+ * and 2 the band code.
+ *
+ * Returns key on success or NULL if the selector has no such code.
+ ***************************************************************************/
+static char *
+selector_key (char *key, const char *selector, int level)
+{
+  char *end;
+
+  strcpy (key, selector);
+
+  if ((end = strchr (key, '.')) == NULL)
+    end = key + strlen (key);
+
+  while (end > key)
+  {
+    end--;
+
+    if (*end == '_')
+      continue;
+
+    if (!isalnum ((int)*end) && *end != '?')
+      return NULL;
+
+    if (level-- == 0)
+    {
+      *end = '?';
+      return key;
+    }
+  }
+
+  return NULL;
+} /* End of selector_key() */
+
+/***************************************************************************
+ * match_stream:
+ *
+ * Match an inventory stream ID, e.g. "00_B_H_Z", against a v3 or v4
+ * selector, ignoring any type suffix.
+ *
+ * Returns 1 on match, 0 on no match and -1 if the selector cannot be
+ * converted.
+ ***************************************************************************/
+static int
+match_stream (const char *selector, const char *streamid)
+{
+  char pattern[SELECTOR_LENGTH];
+  char *type;
+
+  if (strchr (selector, '_'))
+  {
+    if (strlen (selector) >= sizeof (pattern))
+      return -1;
+
+    strcpy (pattern, selector);
+  }
+  else if (sl_v3to4selector (pattern, sizeof (pattern), selector) == NULL)
+  {
+    return -1;
+  }
+
+  if ((type = strchr (pattern, '.')))
+    *type = '\0';
+
+  return (sl_globmatch ((char *)streamid, pattern)) ? 1 : 0;
+} /* End of match_stream() */
+
+/***************************************************************************
+ * compatible_streams:
+ *
+ * Determine if two stream list entries have a resume state that allows
+ * them to be merged: no saved sequence number and the same time stamp.
+ *
+ * Returns 1 if compatible, otherwise 0.
+ ***************************************************************************/
+static int
+compatible_streams (const SLstream *a, const SLstream *b)
+{
+  if (a->seqnum != SL_UNSETSEQUENCE && a->seqnum != SL_ALLDATASEQUENCE)
+    return 0;
+
+  return (a->seqnum == b->seqnum && strcmp (a->timestamp, b->timestamp) == 0) ? 1 : 0;
+} /* End of compatible_streams() */
+
+/***************************************************************************
+ * same_selectors:
+ *
+ * Returns 1 if two normalized stream list entries have the same
+ * selectors, otherwise 0.
+ ***************************************************************************/
+static int
+same_selectors (const SLstream *a, const SLstream *b)
+{
+  if (a->selectors == NULL || b->selectors == NULL)
+    return (a->selectors == b->selectors) ? 1 : 0;
+
+  return (strcmp (a->selectors, b->selectors) == 0) ? 1 : 0;
+} /* End of same_selectors() */
+
+/***************************************************************************
+ * wildcard_station:
+ *
+ * Returns 1 if a station ID contains wildcards, otherwise 0.
+ ***************************************************************************/
+static int
+wildcard_station (const char *stationid)
+{
+  return (strchr (stationid, '*') || strchr (stationid, '?')) ? 1 : 0;
+} /* End of wildcard_station() */
+
+/***************************************************************************
+ * compare_selectors:
+ *
+ * qsort() comparison of selector strings.
+ ***************************************************************************/
+static int
+compare_selectors (const void *a, const void *b)
+{
+  return strcmp (*(char *const *)a, *(char *const *)b);
+} /* End of compare_selectors() */
+
+/***************************************************************************
+ * free_stream:
+ *
+ * Free a stream list entry.
+ ***************************************************************************/
+static void
+free_stream (SLstream *stream)
+{
+  if (stream->selectors != NULL)
+    sl_free (stream->selectors);
+  sl_free (stream);
+} /* End of free_stream() */
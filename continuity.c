@@ -0,0 +1,715 @@
+/***************************************************************************
+ * continuity.c
+ *
+ * Routines for tracking the continuity of data per source, an index of
+ * contiguous segments with gap and overlap statistics.
+ *
+ * Segments for each source are kept in a time-sorted array.  Records
+ * arriving in order extend the last segment, records filling a gap or
+ * overlapping existing data are merged with their neighbors.  The
+ * number of segments per source is bounded, when exceeded the oldest
+ * segments are compacted into summary totals.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+
+/* Number of hash buckets for sources */
+#define CONTINUITY_BUCKETS 1024
+
+#define HEADER_V1 "#V1 SourceID  Start  End"
+
+/* Segment index for a single source */
+typedef struct ContSource
+{
+  char sourceid[64];           /* FDSN source identifier */
+  SLsegment *segments;         /* Segments sorted by start time */
+  uint32_t segmentcount;       /* Number of segments */
+  uint32_t segmentsize;        /* Allocated segments */
+  int64_t tolerance;           /* Time tolerance for current sample rate */
+  int64_t compactedend;        /* End of last compacted segment, or SLTERROR */
+  SLcontinuitystats stats;     /* Gap and overlap statistics */
+  struct ContSource *chain;    /* Next entry in hash bucket */
+  struct ContSource *next;     /* Next source in insertion order */
+} ContSource;
+
+struct SLcontinuity
+{
+  ContSource *buckets[CONTINUITY_BUCKETS];
+  ContSource *sources;         /* Sources in insertion order */
+  ContSource *lastsource;      /* Last source in insertion order */
+  uint32_t maxsegments;        /* Maximum segments per source */
+  int64_t tolerance;           /* Time tolerance in nanoseconds, -1 for half a sample period */
+};
+
+static ContSource *find_source (const SLcontinuity *cont, const char *sourceid, int create);
+static int insert_segment (ContSource *source, int64_t starttime, int64_t endtime);
+static void compact_source (ContSource *source, uint32_t count);
+static uint32_t hash_sourceid (const char *sourceid);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new continuity index
+ *
+ * Allocate an index of contiguous segments per data source, retaining
+ * at most \a maxsegments segments for each source.  When a source has
+ * more segments the oldest are compacted: they are removed from the
+ * segment list and their coverage, gaps and overlaps are retained as
+ * totals in the source statistics.
+ *
+ * The index may be fed from one or more connections with
+ * sl_set_continuity(), or by calling sl_continuity_add() directly.
+ * The index is not thread-safe, all calls must be made from the same
+ * thread or otherwise serialized.
+ *
+ * @param[in] maxsegments  Maximum segments retained per source, 0 for a default of 1000
+ *
+ * @returns An initialized ::SLcontinuity on success, NULL on error.
+ ***************************************************************************/
+SLcontinuity *
+sl_initslcontinuity (uint32_t maxsegments)
+{
+  SLcontinuity *cont;
+
+  if ((cont = (SLcontinuity *)sl_malloc (sizeof (SLcontinuity))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (cont, 0, sizeof (SLcontinuity));
+
+  cont->maxsegments = (maxsegments) ? maxsegments : 1000;
+  cont->tolerance   = -1;
+
+  return cont;
+} /* End of sl_initslcontinuity() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a continuity index
+ *
+ * @param[in] cont  Continuity index to free
+ ***************************************************************************/
+void
+sl_freeslcontinuity (SLcontinuity *cont)
+{
+  ContSource *source;
+  ContSource *next;
+
+  if (!cont)
+    return;
+
+  for (source = cont->sources; source; source = next)
+  {
+    next = source->next;
+    sl_free (source->segments);
+    sl_free (source);
+  }
+
+  sl_free (cont);
+} /* End of sl_freeslcontinuity() */
+
+/**********************************************************************/ /**
+ * @brief Set the time tolerance for coalescing segments
+ *
+ * Records that start within \a tolerance seconds of the end of a
+ * segment extend the segment.  The default tolerance is half a sample
+ * period of the record.
+ *
+ * @param[in] cont       Continuity index
+ * @param[in] tolerance  Tolerance in seconds, negative for half a sample period
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_continuity_set_tolerance (SLcontinuity *cont, double tolerance)
+{
+  if (!cont)
+    return -1;
+
+  cont->tolerance = (tolerance < 0.0) ? -1 : (int64_t)(tolerance * 1e9 + 0.5);
+
+  return 0;
+} /* End of sl_continuity_set_tolerance() */
+
+/**********************************************************************/ /**
+ * @brief Add a miniSEED record to a continuity index
+ *
+ * The time coverage of a miniSEED record is determined from the start
+ * time, sample rate and number of samples in its header.  The coverage
+ * extends to one sample period after the last sample, so that
+ * contiguous records abut.  Records without samples or a sample rate
+ * (e.g. log records) and other payload types are ignored.
+ *
+ * @param[in] cont        Continuity index
+ * @param[in] log         Logging parameters, or NULL
+ * @param[in] packetinfo  Packet details as returned by sl_collect()
+ * @param[in] payload     Packet payload
+ *
+ * @retval  1 : record added
+ * @retval  0 : record ignored
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_continuity_add (SLcontinuity *cont, const SLlog *log,
+                   const SLpacketinfo *packetinfo, const char *payload)
+{
+  ContSource *source;
+  char sourceid[64] = {0};
+  double samplerate = 0.0;
+  uint32_t samplecount = 0;
+  int64_t starttime;
+  int64_t endtime;
+
+  if (!cont || !packetinfo || !payload)
+    return -1;
+
+  if (packetinfo->payloadformat != SLPAYLOAD_MSEED2 &&
+      packetinfo->payloadformat != SLPAYLOAD_MSEED3)
+    return 0;
+
+  if (sl_payload_info (log, packetinfo, payload, packetinfo->payloadlength,
+                       sourceid, sizeof (sourceid), NULL, 0,
+                       &samplerate, &samplecount) == -1)
+    return -1;
+
+  if (samplecount == 0 || samplerate <= 0.0)
+    return 0;
+
+  if ((starttime = sl_payload_starttime (log, packetinfo, payload,
+                                         packetinfo->payloadlength)) == SLTERROR)
+    return -1;
+
+  endtime = starttime + (int64_t)((double)samplecount * 1e9 / samplerate + 0.5);
+
+  if ((source = find_source (cont, sourceid, 1)) == NULL)
+  {
+    sl_log_rl (log, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  source->tolerance = (cont->tolerance >= 0) ? cont->tolerance : (int64_t)(0.5e9 / samplerate);
+
+  if (insert_segment (source, starttime, endtime))
+  {
+    sl_log_rl (log, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  if (source->segmentcount > cont->maxsegments)
+    compact_source (source, source->segmentcount - cont->maxsegments);
+
+  return 1;
+} /* End of sl_continuity_add() */
+
+/**********************************************************************/ /**
+ * @brief Return the segments of a source from a continuity index
+ *
+ * Copy up to \a maxsegments contiguous segments of \a sourceid, in
+ * order of start time, to \a segments.  Segment end times are the end
+ * of coverage, i.e. one sample period after the last sample.
+ *
+ * @param[in]  cont         Continuity index
+ * @param[in]  sourceid     FDSN source identifier, e.g. "FDSN:IU_COLA_00_B_H_Z"
+ * @param[out] segments     Array for segments, may be NULL to count
+ * @param[in]  maxsegments  Maximum entries in \a segments
+ *
+ * @returns The number of segments retained for the source, which may
+ * be more than \a maxsegments, or -1 on error.
+ ***************************************************************************/
+int64_t
+sl_continuity_segments (const SLcontinuity *cont, const char *sourceid,
+                        SLsegment *segments, uint32_t maxsegments)
+{
+  ContSource *source;
+  uint32_t count;
+
+  if (!cont || !sourceid)
+    return -1;
+
+  if ((source = find_source (cont, sourceid, 0)) == NULL)
+    return 0;
+
+  if (segments)
+  {
+    count = (source->segmentcount < maxsegments) ? source->segmentcount : maxsegments;
+    memcpy (segments, source->segments, count * sizeof (SLsegment));
+  }
+
+  return source->segmentcount;
+} /* End of sl_continuity_segments() */
+
+/**********************************************************************/ /**
+ * @brief Return continuity statistics of a source
+ *
+ * Statistics include compacted history as well as retained segments.
+ *
+ * @param[in]  cont      Continuity index
+ * @param[in]  sourceid  FDSN source identifier
+ * @param[out] stats     Statistics of source
+ *
+ * @retval  1 : statistics returned
+ * @retval  0 : source not found
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_continuity_stats (const SLcontinuity *cont, const char *sourceid,
+                     SLcontinuitystats *stats)
+{
+  ContSource *source;
+
+  if (!cont || !sourceid || !stats)
+    return -1;
+
+  if ((source = find_source (cont, sourceid, 0)) == NULL)
+    return 0;
+
+  *stats = source->stats;
+  stats->segmentcount = source->segmentcount;
+
+  return 1;
+} /* End of sl_continuity_stats() */
+
+/**********************************************************************/ /**
+ * @brief Iterate over the sources of a continuity index
+ *
+ * Return the source identifier of the next source, in order of first
+ * appearance.  The \a cursor must be set to NULL before the first call
+ * and is updated for subsequent calls.
+ *
+ * @param[in]     cont    Continuity index
+ * @param[in,out] cursor  Iteration state, initialize to NULL
+ *
+ * @returns The next source identifier, or NULL when no more sources.
+ ***************************************************************************/
+const char *
+sl_continuity_next (const SLcontinuity *cont, void **cursor)
+{
+  ContSource *source;
+
+  if (!cont || !cursor)
+    return NULL;
+
+  source = (*cursor) ? ((ContSource *)*cursor)->next : cont->sources;
+
+  *cursor = source;
+
+  return (source) ? source->sourceid : NULL;
+} /* End of sl_continuity_next() */
+
+/**********************************************************************/ /**
+ * @brief Compact the history of a continuity index before a time
+ *
+ * Remove segments ending before \a before from all sources, their
+ * coverage and gaps are retained as totals in the source statistics.
+ * A segment spanning \a before is retained.
+ *
+ * @param[in] cont    Continuity index
+ * @param[in] before  Compact segments that end before this time
+ *
+ * @returns The number of segments removed, or -1 on error.
+ ***************************************************************************/
+int64_t
+sl_continuity_compact (SLcontinuity *cont, int64_t before)
+{
+  ContSource *source;
+  uint32_t count;
+  int64_t total = 0;
+
+  if (!cont)
+    return -1;
+
+  for (source = cont->sources; source; source = source->next)
+  {
+    for (count = 0; count < source->segmentcount; count++)
+    {
+      if (source->segments[count].endtime >= before)
+        break;
+    }
+
+    if (count > 0)
+    {
+      compact_source (source, count);
+      total += count;
+    }
+  }
+
+  return total;
+} /* End of sl_continuity_compact() */
+
+/**********************************************************************/ /**
+ * @brief Save the segments of a continuity index to a file
+ *
+ * The file is a simple text file with one line per segment containing
+ * the source identifier and the start and end times of the segment.
+ *
+ * The "V1" line format is (header line and example):
+ * ```
+ *   #V1 SourceID  Start  End
+ *   FDSN:IU_COLA_00_B_H_Z 2024-08-03T17:23:18.019538000Z 2024-08-03T18:01:02.869538000Z
+ * ```
+ *
+ * @param cont      Continuity index
+ * @param log       Logging parameters, or NULL
+ * @param filename  The name of the file to write
+ *
+ * @returns 0 on success and -1 on error
+ ***************************************************************************/
+int
+sl_continuity_save (const SLcontinuity *cont, const SLlog *log, const char *filename)
+{
+  ContSource *source;
+  FILE *fp;
+  char starttime[32];
+  char endtime[32];
+  uint32_t idx;
+
+  if (!cont || !filename)
+    return -1;
+
+  if ((fp = fopen (filename, "wb")) == NULL)
+  {
+    sl_log_rl (log, 2, 0, "cannot open continuity file for writing: %s\n", filename);
+    return -1;
+  }
+
+  fputs (HEADER_V1 "\n", fp);
+
+  for (source = cont->sources; source; source = source->next)
+  {
+    for (idx = 0; idx < source->segmentcount; idx++)
+    {
+      if (fprintf (fp, "%s %s %s\n", source->sourceid,
+                   sl_nstime2isotime (source->segments[idx].starttime, starttime, sizeof (starttime)),
+                   sl_nstime2isotime (source->segments[idx].endtime, endtime, sizeof (endtime))) < 0)
+      {
+        sl_log_rl (log, 2, 0, "cannot write to continuity file, %s\n", strerror (errno));
+        fclose (fp);
+        return -1;
+      }
+    }
+  }
+
+  if (fclose (fp))
+  {
+    sl_log_rl (log, 2, 0, "cannot close continuity file, %s\n", strerror (errno));
+    return -1;
+  }
+
+  return 0;
+} /* End of sl_continuity_save() */
+
+/***************************************************************************
+ * find_source:
+ *
+ * Find the entry for a source ID, optionally creating it.
+ *
+ * Returns a pointer to the entry, or NULL if not found or on error.
+ ***************************************************************************/
+static ContSource *
+find_source (const SLcontinuity *cont, const char *sourceid, int create)
+{
+  SLcontinuity *mcont = (SLcontinuity *)cont;
+  ContSource *source;
+  uint32_t bucket;
+
+  bucket = hash_sourceid (sourceid) % CONTINUITY_BUCKETS;
+
+  for (source = cont->buckets[bucket]; source; source = source->chain)
+  {
+    if (strcmp (source->sourceid, sourceid) == 0)
+      return source;
+  }
+
+  if (!create)
+    return NULL;
+
+  if ((source = (ContSource *)sl_calloc (1, sizeof (ContSource))) == NULL)
+    return NULL;
+
+  strncpy (source->sourceid, sourceid, sizeof (source->sourceid) - 1);
+  source->stats.earliest = SLTERROR;
+  source->stats.latest   = SLTERROR;
+  source->compactedend   = SLTERROR;
+
+  source->chain = mcont->buckets[bucket];
+  mcont->buckets[bucket] = source;
+
+  if (mcont->lastsource)
+    mcont->lastsource->next = source;
+  else
+    mcont->sources = source;
+
+  mcont->lastsource = source;
+
+  return source;
+} /* End of find_source() */
+
+/***************************************************************************
+ * insert_segment:
+ *
+ * Insert a time range into the segments of a source, merging with
+ * segments within tolerance and updating gap and overlap statistics.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+insert_segment (ContSource *source, int64_t starttime, int64_t endtime)
+{
+  SLsegment *segments = source->segments;
+  SLsegment *newsegments;
+  int64_t tolerance = source->tolerance;
+  int64_t overlap;
+  uint32_t low;
+  uint32_t high;
+  uint32_t mid;
+  uint32_t idx;
+  uint32_t last;
+
+  if (source->stats.earliest == SLTERROR || starttime < source->stats.earliest)
+    source->stats.earliest = starttime;
+  if (source->stats.latest == SLTERROR || endtime > source->stats.latest)
+    source->stats.latest = endtime;
+
+  /* Common case: record extends the last segment */
+  if (source->segmentcount > 0)
+  {
+    SLsegment *lastseg = &segments[source->segmentcount - 1];
+
+    if (starttime >= lastseg->endtime - tolerance &&
+        starttime <= lastseg->endtime + tolerance)
+    {
+      if (endtime > lastseg->endtime)
+      {
+        source->stats.coverage += endtime - lastseg->endtime;
+        lastseg->endtime = endtime;
+      }
+
+      return 0;
+    }
+  }
+
+  /* Find first segment with an end time not before the start, less tolerance */
+  low  = 0;
+  high = source->segmentcount;
+  while (low < high)
+  {
+    mid = low + (high - low) / 2;
+
+    if (segments[mid].endtime < starttime - tolerance)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  idx = low;
+
+  /* No segment touched: insert a new segment at idx */
+  if (idx == source->segmentcount || segments[idx].starttime > endtime + tolerance)
+  {
+    if (source->segmentcount == source->segmentsize)
+    {
+      uint32_t newsize = (source->segmentsize) ? source->segmentsize * 2 : 8;
+
+      if ((newsegments = (SLsegment *)sl_realloc (segments, newsize * sizeof (SLsegment))) == NULL)
+        return -1;
+
+      source->segments    = segments = newsegments;
+      source->segmentsize = newsize;
+    }
+
+    memmove (&segments[idx + 1], &segments[idx],
+             (source->segmentcount - idx) * sizeof (SLsegment));
+
+    segments[idx].starttime = starttime;
+    segments[idx].endtime   = endtime;
+    source->segmentcount++;
+
+    source->stats.coverage += endtime - starttime;
+
+    /* A new segment after existing data is a new gap, one before or between is not */
+    if (idx == source->segmentcount - 1 && idx > 0)
+    {
+      source->stats.gaps++;
+      source->stats.gaptime += starttime - segments[idx - 1].endtime;
+    }
+    /* A new segment inside an existing gap splits the gap */
+    else if (idx > 0 && idx < source->segmentcount - 1)
+    {
+      source->stats.gaps++;
+      source->stats.gaptime -= endtime - starttime;
+    }
+    /* A new segment before all retained data follows compacted history,
+     * which is treated as the segment before it */
+    else if (idx == 0 && source->compactedend != SLTERROR)
+    {
+      if (starttime > source->compactedend + tolerance)
+      {
+        source->stats.gaps++;
+
+        if (source->segmentcount > 1)
+          source->stats.gaptime -= endtime - starttime;
+        else
+          source->stats.gaptime += starttime - source->compactedend;
+      }
+      else if (source->segmentcount > 1 && endtime > source->compactedend)
+      {
+        source->stats.gaptime -= endtime - source->compactedend;
+      }
+    }
+    /* A new segment before all data adds a gap to the following segment */
+    else if (idx == 0 && source->segmentcount > 1)
+    {
+      source->stats.gaps++;
+      source->stats.gaptime += segments[1].starttime - endtime;
+    }
+
+    return 0;
+  }
+
+  /* Merge with segment idx and any following segments the range touches */
+  overlap = 0;
+
+  if (starttime < segments[idx].endtime - tolerance &&
+      endtime > segments[idx].starttime + tolerance)
+  {
+    int64_t ostart = (starttime > segments[idx].starttime) ? starttime : segments[idx].starttime;
+    int64_t oend   = (endtime < segments[idx].endtime) ? endtime : segments[idx].endtime;
+    overlap = oend - ostart;
+  }
+
+  if (starttime < segments[idx].starttime)
+  {
+    source->stats.coverage += segments[idx].starttime - starttime;
+
+    /* Range extends back into the gap before this segment */
+    if (idx > 0)
+    {
+      source->stats.gaptime -= segments[idx].starttime - starttime;
+    }
+    /* Range extends back into the gap after compacted history */
+    else if (source->compactedend != SLTERROR)
+    {
+      if (starttime <= source->compactedend + tolerance)
+      {
+        source->stats.gaps--;
+        source->stats.gaptime -= segments[idx].starttime - source->compactedend;
+      }
+      else
+      {
+        source->stats.gaptime -= segments[idx].starttime - starttime;
+      }
+    }
+
+    segments[idx].starttime = starttime;
+  }
+
+  last = idx;
+
+  while (last + 1 < source->segmentcount &&
+         segments[last + 1].starttime <= endtime + tolerance)
+  {
+    /* Gap between last and last+1 is closed */
+    source->stats.gaps--;
+    source->stats.gaptime -= segments[last + 1].starttime - segments[last].endtime;
+    source->stats.coverage += segments[last + 1].starttime - segments[last].endtime;
+
+    if (endtime > segments[last + 1].starttime + tolerance)
+    {
+      int64_t oend = (endtime < segments[last + 1].endtime) ? endtime : segments[last + 1].endtime;
+      overlap += oend - segments[last + 1].starttime;
+    }
+
+    segments[idx].endtime = segments[last + 1].endtime;
+    last++;
+  }
+
+  if (endtime > segments[idx].endtime)
+  {
+    source->stats.coverage += endtime - segments[idx].endtime;
+
+    /* Range extends into the gap after the merged segments */
+    if (last + 1 < source->segmentcount)
+      source->stats.gaptime -= endtime - segments[idx].endtime;
+
+    segments[idx].endtime = endtime;
+  }
+
+  if (overlap > 0)
+  {
+    source->stats.overlaps++;
+    source->stats.overlaptime += overlap;
+  }
+
+  /* Remove merged segments */
+  if (last > idx)
+  {
+    memmove (&segments[idx + 1], &segments[last + 1],
+             (source->segmentcount - last - 1) * sizeof (SLsegment));
+    source->segmentcount -= (last - idx);
+  }
+
+  return 0;
+} /* End of insert_segment() */
+
+/***************************************************************************
+ * compact_source:
+ *
+ * Remove the oldest segments of a source.  Coverage and gap totals
+ * already include them, only the segment details are discarded.
+ ***************************************************************************/
+static void
+compact_source (ContSource *source, uint32_t count)
+{
+  if (count > source->segmentcount)
+    count = source->segmentcount;
+
+  if (count > 0)
+    source->compactedend = source->segments[count - 1].endtime;
+
+  memmove (&source->segments[0], &source->segments[count],
+           (source->segmentcount - count) * sizeof (SLsegment));
+
+  source->segmentcount -= count;
+  source->stats.compacted += count;
+} /* End of compact_source() */
+
+/***************************************************************************
+ * hash_sourceid:
+ *
+ * Compute the 32-bit FNV-1a hash of a source ID.
+ ***************************************************************************/
+static uint32_t
+hash_sourceid (const char *sourceid)
+{
+  uint32_t hash = 2166136261U;
+
+  while (*sourceid)
+  {
+    hash ^= (uint8_t)*sourceid++;
+    hash *= 16777619U;
+  }
+
+  return hash;
+} /* End of hash_sourceid() */
@@ -0,0 +1,724 @@
+/***************************************************************************
+ * dispatch.c
+ *
+ * Routines for dispatching packets from a connection group by priority
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globmatch.h"
+#include "libslink.h"
+
+/* Initial payload buffer size for each slot, grown as needed */
+#define DISPATCH_PAYLOAD_SIZE 512
+
+/* Marker for no slot */
+#define NOSLOT UINT32_MAX
+
+/* Buffered packet */
+typedef struct DispatchSlot
+{
+  SLCD *slconn;                /* Connection that returned the packet */
+  SLpacketinfo packetinfo;     /* Copy of packet details */
+  char *payload;               /* Payload buffer */
+  uint32_t payloadsize;        /* Size of payload buffer */
+  int64_t arrivaltime;         /* Time packet was received */
+  int priority;                /* Priority class of packet */
+  uint32_t next;               /* Next slot in class queue */
+} DispatchSlot;
+
+/* Source ID pattern assigning a priority class */
+typedef struct DispatchRule
+{
+  char *pattern;               /* Source ID glob pattern */
+  int priority;                /* Priority class */
+} DispatchRule;
+
+/* Queue of packets for a priority class */
+typedef struct DispatchQueue
+{
+  uint32_t head;               /* Oldest queued slot */
+  uint32_t tail;               /* Newest queued slot */
+  SLdispatchstat stat;         /* Class statistics */
+} DispatchQueue;
+
+/* Priority dispatch of a connection group */
+struct SLdispatch
+{
+  SLCG *group;                 /* Connection group to collect from */
+  DispatchSlot *slots;         /* Pool of packet slots, one more than maximum queued */
+  uint32_t slotcount;          /* Number of slots in pool */
+  uint32_t *freeslots;         /* Stack of free slot indexes */
+  uint32_t freecount;          /* Number of free slots */
+  uint32_t queued;             /* Number of slots in all queues */
+  uint32_t returned;           /* Slot returned to caller, released on next call */
+  DispatchQueue *queues;       /* Queues indexed by priority class, 0 is highest */
+  int classes;                 /* Number of priority classes */
+  DispatchRule *rules;         /* Rules assigning priority classes, first match wins */
+  int rulecount;               /* Number of rules */
+  void (*spill)(SLCD *slconn, const SLpacketinfo *packetinfo,
+                const char *payload, int priority, void *spill_data);
+  void *spill_data;            /* Spill callback data */
+  int8_t noblock;              /* Control blocking on collection */
+  int8_t draining;             /* Group has terminated, return remaining */
+};
+
+static int classify (SLdispatch *dispatch, DispatchSlot *slot);
+static int enqueue (SLdispatch *dispatch, uint32_t slotidx);
+static uint32_t dequeue (SLdispatch *dispatch, int priority);
+static void release_slot (SLdispatch *dispatch, uint32_t slotidx);
+static int return_slot (SLdispatch *dispatch, uint32_t slotidx, int64_t current_time,
+                        SLCD **slconn, const SLpacketinfo **packetinfo,
+                        const char **payload, int *priority);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new ::SLdispatch for a connection group
+ *
+ * Allocate a new priority dispatch of packets collected from the
+ * specified connection group.  Packets are assigned to one of
+ * \a classes priority classes with sl_dispatch_add_class() and
+ * returned by sl_dispatch_collect() highest priority first, class 0
+ * being the highest.  Packets not assigned to a class are in the
+ * lowest class, \a classes - 1.
+ *
+ * At most \a maxpackets packets are queued, when this limit is
+ * reached packets of the lowest priority are shed, see
+ * sl_dispatch_collect().
+ *
+ * The group is collected in non-blocking mode, the blocking behavior
+ * of sl_dispatch_collect() is controlled by
+ * sl_dispatch_set_blockingmode().  The group remains owned by the
+ * caller and must not be collected from directly while the dispatch
+ * is in use.
+ *
+ * @param[in] group       Connection group to collect from
+ * @param[in] maxpackets  Maximum number of packets to queue
+ * @param[in] classes     Number of priority classes, 1 to ::SLDISPATCH_MAXCLASSES
+ *
+ * @returns An initialized ::SLdispatch on success, NULL on error.
+ ***************************************************************************/
+SLdispatch *
+sl_initsldispatch (SLCG *group, uint32_t maxpackets, int classes)
+{
+  SLdispatch *dispatch;
+  uint32_t idx;
+
+  if (!group || maxpackets == 0 || maxpackets >= NOSLOT - 1)
+    return NULL;
+
+  if (classes < 1 || classes > SLDISPATCH_MAXCLASSES)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): unsupported number of priority classes: %d\n", __func__, classes);
+    return NULL;
+  }
+
+  dispatch = (SLdispatch *)sl_malloc (sizeof (SLdispatch));
+
+  if (dispatch == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (dispatch, 0, sizeof (SLdispatch));
+
+  /* One slot more than the maximum queued to receive into when full */
+  dispatch->slots     = (DispatchSlot *)sl_calloc (maxpackets + 1, sizeof (DispatchSlot));
+  dispatch->freeslots = (uint32_t *)sl_malloc ((maxpackets + 1) * sizeof (uint32_t));
+  dispatch->queues    = (DispatchQueue *)sl_calloc (classes, sizeof (DispatchQueue));
+
+  if (dispatch->slots == NULL || dispatch->freeslots == NULL || dispatch->queues == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_freesldispatch (dispatch);
+    return NULL;
+  }
+
+  dispatch->group      = group;
+  dispatch->slotcount  = maxpackets + 1;
+  dispatch->queued     = 0;
+  dispatch->returned   = NOSLOT;
+  dispatch->classes    = classes;
+  dispatch->rules      = NULL;
+  dispatch->rulecount  = 0;
+  dispatch->spill      = NULL;
+  dispatch->spill_data = NULL;
+  dispatch->noblock    = 0;
+  dispatch->draining   = 0;
+
+  for (idx = 0; idx < (uint32_t)classes; idx++)
+  {
+    dispatch->queues[idx].head = NOSLOT;
+    dispatch->queues[idx].tail = NOSLOT;
+  }
+
+  /* All slots are initially free, stacked so that slot 0 is used first */
+  for (idx = 0; idx < dispatch->slotcount; idx++)
+  {
+    dispatch->freeslots[idx] = dispatch->slotcount - idx - 1;
+
+    if ((dispatch->slots[idx].payload = (char *)sl_malloc (DISPATCH_PAYLOAD_SIZE)) == NULL)
+    {
+      sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+      sl_freesldispatch (dispatch);
+      return NULL;
+    }
+
+    dispatch->slots[idx].payloadsize = DISPATCH_PAYLOAD_SIZE;
+  }
+
+  dispatch->freecount = dispatch->slotcount;
+
+  sl_group_set_blockingmode (group, 1);
+
+  return dispatch;
+} /* End of sl_initsldispatch() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a ::SLdispatch
+ *
+ * Any packets remaining in the queues are discarded.  The connection
+ * group is not freed, it remains owned by the caller.
+ *
+ * @param[in] dispatch  Priority dispatch to free
+ ***************************************************************************/
+void
+sl_freesldispatch (SLdispatch *dispatch)
+{
+  uint32_t idx;
+  int priority;
+
+  if (!dispatch)
+    return;
+
+  if (dispatch->queues)
+  {
+    for (priority = 0; priority < dispatch->classes; priority++)
+    {
+      if (dispatch->queues[priority].stat.shed > 0)
+        sl_log_r (NULL, 1, 1, "Dispatch shed %" PRIu64 " packet(s) of priority class %d\n",
+                  dispatch->queues[priority].stat.shed, priority);
+    }
+  }
+
+  if (dispatch->slots)
+  {
+    for (idx = 0; idx < dispatch->slotcount; idx++)
+      sl_free (dispatch->slots[idx].payload);
+  }
+
+  if (dispatch->rules)
+  {
+    for (idx = 0; idx < (uint32_t)dispatch->rulecount; idx++)
+      sl_free (dispatch->rules[idx].pattern);
+  }
+
+  sl_free (dispatch->slots);
+  sl_free (dispatch->freeslots);
+  sl_free (dispatch->queues);
+  sl_free (dispatch->rules);
+  sl_free (dispatch);
+} /* End of sl_freesldispatch() */
+
+/**********************************************************************/ /**
+ * @brief Set or unset the ::SLdispatch blocking mode
+ *
+ * In blocking mode sl_dispatch_collect() will wait until a packet is
+ * available or all group members have terminated.  In non-blocking
+ * mode sl_dispatch_collect() will return quickly.
+ *
+ * By default, the dispatch is set to blocking mode.
+ *
+ * @param dispatch  Priority dispatch
+ * @param nonblock  Boolean flag, if non-zero set to non-blocking mode
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_dispatch_set_blockingmode (SLdispatch *dispatch, int nonblock)
+{
+  if (!dispatch)
+    return -1;
+
+  dispatch->noblock = (nonblock) ? 1 : 0;
+
+  return 0;
+} /* End of sl_dispatch_set_blockingmode() */
+
+/**********************************************************************/ /**
+ * @brief Assign packets matching a source ID pattern to a priority class
+ *
+ * The \a pattern is a glob matched against the FDSN source identifier
+ * of miniSEED records, e.g. \c "FDSN:*_H_N_?" for strong-motion
+ * channels or \c "FDSN:IU_*" for a network.  Patterns are tested in
+ * the order they are added and the first match determines the class,
+ * packets not matching any pattern are in the lowest class.
+ *
+ * @param dispatch  Priority dispatch
+ * @param pattern   Source ID glob pattern
+ * @param priority  Priority class, 0 is the highest
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_dispatch_add_class (SLdispatch *dispatch, const char *pattern, int priority)
+{
+  DispatchRule *rules;
+
+  if (!dispatch || !pattern)
+    return -1;
+
+  if (priority < 0 || priority >= dispatch->classes)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): priority class %d not in range 0 to %d\n",
+              __func__, priority, dispatch->classes - 1);
+    return -1;
+  }
+
+  rules = (DispatchRule *)sl_realloc (dispatch->rules,
+                                      sizeof (DispatchRule) * (dispatch->rulecount + 1));
+
+  if (rules == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  dispatch->rules = rules;
+
+  if ((rules[dispatch->rulecount].pattern = sl_strdup (pattern)) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  rules[dispatch->rulecount].priority = priority;
+  dispatch->rulecount++;
+
+  return 0;
+} /* End of sl_dispatch_add_class() */
+
+/**********************************************************************/ /**
+ * @brief Set a handler for packets shed from a ::SLdispatch
+ *
+ * When the queues are full, packets of the lowest priority are shed
+ * to make room.  By default shed packets are dropped, if a handler is
+ * set they are passed to it instead, e.g. to spill them to disk for
+ * later processing.  The \a payload is only valid during the call.
+ *
+ * @param dispatch    Priority dispatch
+ * @param spill       Handler for shed packets, NULL to drop them
+ * @param spill_data  Pointer passed to the handler
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_dispatch_set_spill (SLdispatch *dispatch,
+                       void (*spill) (SLCD *slconn, const SLpacketinfo *packetinfo,
+                                      const char *payload, int priority,
+                                      void *spill_data),
+                       void *spill_data)
+{
+  if (!dispatch)
+    return -1;
+
+  dispatch->spill      = spill;
+  dispatch->spill_data = spill_data;
+
+  return 0;
+} /* End of sl_dispatch_set_spill() */
+
+/**********************************************************************/ /**
+ * @brief Collect packets from a ::SLdispatch in priority order
+ *
+ * Designed to run in a loop of a client program in the same way as
+ * sl_collect().  All packets available from the group are queued by
+ * priority class and the oldest packet of the highest priority class
+ * is returned, so packets of high priority do not wait behind bulk
+ * traffic received on the same or other connections.
+ *
+ * When the queues hold \a maxpackets packets, the oldest packet of
+ * the lowest priority class with queued packets is shed for each
+ * packet of a higher class received.  A packet received for the
+ * lowest queued class, or lower, is shed itself.  Shed packets are
+ * dropped or passed to the handler set with sl_dispatch_set_spill().
+ *
+ * Payloads that are not miniSEED, and segments of payloads from
+ * members in chunked mode, are returned immediately with the lowest
+ * priority.
+ *
+ * The returned \a packetinfo and \a payload are owned by the dispatch
+ * and valid until the next call to sl_dispatch_collect().
+ *
+ * When all group members have terminated, the packets remaining in
+ * the queues are returned in priority order before ::SLTERMINATE.
+ *
+ * @param[in]  dispatch    Priority dispatch
+ * @param[out] slconn      Pointer to the member ::SLCD that returned the packet
+ * @param[out] packetinfo  Pointer to pointer to ::SLpacketinfo describing payload
+ * @param[out] payload     Pointer to packet payload
+ * @param[out] priority    Priority class of packet, may be NULL
+ *
+ * @returns @ref collect-status
+ * @retval SLPACKET Complete packet returned
+ * @retval SLTERMINATE All members have terminated and queues are empty, or error
+ * @retval SLNOPACKET  No packet available, call again
+ * @retval SLCHUNK  Segment of payload returned, chunked mode only
+ *
+ * @sa sl_group_collect()
+ ***************************************************************************/
+int
+sl_dispatch_collect (SLdispatch *dispatch, SLCD **slconn,
+                     const SLpacketinfo **packetinfo, const char **payload,
+                     int *priority)
+{
+  const SLpacketinfo *grouppacketinfo = NULL;
+  SLCD *groupslconn = NULL;
+  DispatchSlot *slot;
+  uint32_t slotidx;
+  uint32_t received = 0;
+  int64_t current_time;
+  char *newpayload;
+  int status;
+  int idx;
+
+  if (!dispatch || !slconn || !packetinfo || !payload)
+    return SLTERMINATE;
+
+  *slconn     = NULL;
+  *packetinfo = NULL;
+  *payload    = NULL;
+
+  /* Release slot returned by previous call */
+  if (dispatch->returned != NOSLOT)
+  {
+    release_slot (dispatch, dispatch->returned);
+    dispatch->returned = NOSLOT;
+  }
+
+  while (1)
+  {
+    /* Queue all packets available from the group, bounded to avoid starving the caller,
+     * the top free slot remains receiving until a packet or segment is complete */
+    while (!dispatch->draining && received < dispatch->slotcount)
+    {
+      slotidx = dispatch->freeslots[dispatch->freecount - 1];
+      slot    = &dispatch->slots[slotidx];
+
+      status = sl_group_collect (dispatch->group, &groupslconn, &grouppacketinfo,
+                                 slot->payload, slot->payloadsize);
+
+      if (status == SLTOOLARGE)
+      {
+        newpayload = (char *)sl_realloc (slot->payload, grouppacketinfo->payloadlength);
+
+        if (newpayload == NULL)
+        {
+          sl_log_r (groupslconn, 2, 0, "%s(): error allocating memory\n", __func__);
+          return SLTERMINATE;
+        }
+
+        slot->payload     = newpayload;
+        slot->payloadsize = grouppacketinfo->payloadlength;
+        continue;
+      }
+      else if (status == SLTERMINATE)
+      {
+        dispatch->draining = 1;
+        break;
+      }
+      else if (status == SLNOPACKET)
+      {
+        break;
+      }
+
+      /* Packet received, populate slot */
+      dispatch->freecount--;
+      received++;
+
+      slot->slconn      = groupslconn;
+      slot->packetinfo  = *grouppacketinfo;
+      slot->arrivaltime = sl_nstime ();
+      slot->priority    = dispatch->classes - 1;
+
+      /* Return packets without a source ID, and payload segments, immediately */
+      if (status == SLCHUNK || classify (dispatch, slot))
+      {
+        return_slot (dispatch, slotidx, slot->arrivaltime,
+                     slconn, packetinfo, payload, priority);
+        return status;
+      }
+
+      enqueue (dispatch, slotidx);
+    }
+
+    /* Return the oldest packet of the highest priority class */
+    if (dispatch->queued > 0)
+    {
+      for (idx = 0; idx < dispatch->classes; idx++)
+      {
+        if (dispatch->queues[idx].head != NOSLOT)
+          break;
+      }
+
+      current_time = sl_nstime ();
+      slotidx      = dequeue (dispatch, idx);
+
+      return return_slot (dispatch, slotidx, current_time,
+                          slconn, packetinfo, payload, priority);
+    }
+
+    if (dispatch->draining)
+      return SLTERMINATE;
+
+    if (dispatch->noblock)
+      return SLNOPACKET;
+
+    /* Wait for data up to 1/10 second */
+    sl_group_poll (dispatch->group, 100);
+    received = 0;
+  }
+} /* End of sl_dispatch_collect() */
+
+/**********************************************************************/ /**
+ * @brief Get statistics of a ::SLdispatch priority class
+ *
+ * The statistics include the number of packets returned and shed, the
+ * number currently queued and the total and maximum time returned
+ * packets waited in the queue.  The mean queue delay is \a delay_total
+ * divided by \a packets.
+ *
+ * If \a reset is non-zero the counters, except the number queued, are
+ * reset after being copied, e.g. for periodic reporting.
+ *
+ * @param[in]  dispatch  Priority dispatch
+ * @param[in]  priority  Priority class
+ * @param[out] stat      Destination for class statistics
+ * @param[in]  reset     Boolean flag to reset the counters
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_dispatch_stats (SLdispatch *dispatch, int priority, SLdispatchstat *stat, int reset)
+{
+  DispatchQueue *queue;
+
+  if (!dispatch || !stat || priority < 0 || priority >= dispatch->classes)
+    return -1;
+
+  queue = &dispatch->queues[priority];
+
+  *stat = queue->stat;
+
+  if (reset)
+  {
+    queue->stat.packets     = 0;
+    queue->stat.shed        = 0;
+    queue->stat.delay_total = 0;
+    queue->stat.delay_max   = 0;
+  }
+
+  return 0;
+} /* End of sl_dispatch_stats() */
+
+/***************************************************************************
+ * classify:
+ *
+ * Determine the priority class of a slot by matching the source ID of
+ * miniSEED records against the rules, packets not matching any rule
+ * are in the lowest class.
+ *
+ * Returns 0 on success and 1 if the payload has no source ID.
+ ***************************************************************************/
+static int
+classify (SLdispatch *dispatch, DispatchSlot *slot)
+{
+  char sourceid[64] = {0};
+  int idx;
+
+  if (slot->packetinfo.payloadformat != SLPAYLOAD_MSEED2 &&
+      slot->packetinfo.payloadformat != SLPAYLOAD_MSEED3)
+    return 1;
+
+  if (dispatch->rulecount == 0)
+    return 0;
+
+  if (sl_payload_info (slot->slconn->log, &slot->packetinfo, slot->payload,
+                       slot->packetinfo.payloadlength,
+                       sourceid, sizeof (sourceid), NULL, 0, NULL, NULL) == -1)
+    return 1;
+
+  for (idx = 0; idx < dispatch->rulecount; idx++)
+  {
+    if (sl_globmatch (sourceid, dispatch->rules[idx].pattern))
+    {
+      slot->priority = dispatch->rules[idx].priority;
+      break;
+    }
+  }
+
+  return 0;
+} /* End of classify() */
+
+/***************************************************************************
+ * enqueue:
+ *
+ * Add a slot to the queue of its priority class.  If the queues are
+ * full the oldest packet of the lowest priority queued class is shed,
+ * or the new packet if its class is not higher.
+ *
+ * Returns 1 if a packet was shed, otherwise 0.
+ ***************************************************************************/
+static int
+enqueue (SLdispatch *dispatch, uint32_t slotidx)
+{
+  DispatchSlot *slot = &dispatch->slots[slotidx];
+  DispatchSlot *shedslot;
+  DispatchQueue *queue;
+  uint32_t shedidx = slotidx;
+  int lowest;
+
+  /* Queues are full when only the receiving slot remains */
+  if (dispatch->queued >= dispatch->slotcount - 1)
+  {
+    for (lowest = dispatch->classes - 1; lowest > 0; lowest--)
+    {
+      if (dispatch->queues[lowest].head != NOSLOT)
+        break;
+    }
+
+    if (lowest > slot->priority)
+      shedidx = dequeue (dispatch, lowest);
+
+    shedslot = &dispatch->slots[shedidx];
+
+    dispatch->queues[shedslot->priority].stat.shed++;
+
+    if (dispatch->spill)
+      dispatch->spill (shedslot->slconn, &shedslot->packetinfo, shedslot->payload,
+                       shedslot->priority, dispatch->spill_data);
+
+    dispatch->freeslots[dispatch->freecount++] = shedidx;
+
+    if (shedidx == slotidx)
+      return 1;
+  }
+
+  queue      = &dispatch->queues[slot->priority];
+  slot->next = NOSLOT;
+
+  if (queue->tail != NOSLOT)
+    dispatch->slots[queue->tail].next = slotidx;
+  else
+    queue->head = slotidx;
+
+  queue->tail = slotidx;
+  queue->stat.queued++;
+  dispatch->queued++;
+
+  return (shedidx != slotidx);
+} /* End of enqueue() */
+
+/***************************************************************************
+ * dequeue:
+ *
+ * Remove and return the oldest slot of a priority class, which must
+ * not be empty.
+ ***************************************************************************/
+static uint32_t
+dequeue (SLdispatch *dispatch, int priority)
+{
+  DispatchQueue *queue = &dispatch->queues[priority];
+  uint32_t slotidx     = queue->head;
+
+  queue->head = dispatch->slots[slotidx].next;
+
+  if (queue->head == NOSLOT)
+    queue->tail = NOSLOT;
+
+  queue->stat.queued--;
+  dispatch->queued--;
+
+  return slotidx;
+} /* End of dequeue() */
+
+/***************************************************************************
+ * release_slot:
+ *
+ * Return a slot to the free stack below the top slot.  The top slot is
+ * the receiving slot and may hold a partially collected payload, e.g.
+ * after the slot was reallocated for SLTOOLARGE, so it must remain at
+ * the top until its packet is complete.
+ ***************************************************************************/
+static void
+release_slot (SLdispatch *dispatch, uint32_t slotidx)
+{
+  if (dispatch->freecount == 0)
+  {
+    dispatch->freeslots[dispatch->freecount++] = slotidx;
+    return;
+  }
+
+  dispatch->freeslots[dispatch->freecount] = dispatch->freeslots[dispatch->freecount - 1];
+  dispatch->freeslots[dispatch->freecount - 1] = slotidx;
+  dispatch->freecount++;
+} /* End of release_slot() */
+
+/***************************************************************************
+ * return_slot:
+ *
+ * Set the return values to the contents of a slot and update the queue
+ * delay statistics of its class, the slot is released on the next call
+ * to sl_dispatch_collect().
+ *
+ * Returns SLPACKET.
+ ***************************************************************************/
+static int
+return_slot (SLdispatch *dispatch, uint32_t slotidx, int64_t current_time,
+             SLCD **slconn, const SLpacketinfo **packetinfo,
+             const char **payload, int *priority)
+{
+  DispatchSlot *slot   = &dispatch->slots[slotidx];
+  SLdispatchstat *stat = &dispatch->queues[slot->priority].stat;
+  int64_t delay        = current_time - slot->arrivaltime;
+
+  stat->packets++;
+  stat->delay_total += delay;
+
+  if (delay > stat->delay_max)
+    stat->delay_max = delay;
+
+  dispatch->returned = slotidx;
+
+  *slconn     = slot->slconn;
+  *packetinfo = &slot->packetinfo;
+  *payload    = slot->payload;
+
+  if (priority)
+    *priority = slot->priority;
+
+  return SLPACKET;
+} /* End of return_slot() */
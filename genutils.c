@@ -29,6 +29,7 @@
 
 #include "libslink.h"
 
+#include "mbedtls/include/mbedtls/platform.h"
 
 /**********************************************************************/ /**
  * @brief Return true if the byte order of the host is little endian
@@ -92,6 +93,147 @@ sl_doy2md (int year, int jday, int *month, int *mday)
   return 0;
 } /* End of sl_doy2md() */
 
+/**********************************************************************/ /**
+ * @brief Convert time components to a nanosecond epoch time
+ *
+ * Convert a year, day-of-year, hour, minute, second and nanosecond
+ * into a high precision epoch time, i.e. nanoseconds since the
+ * Unix/POSIX epoch.  Leap seconds are not accounted for.
+ *
+ * @returns Nanosecond epoch time on success and ::SLTERROR on error.
+ ***************************************************************************/
+int64_t
+sl_time2nstime (int year, int yday, int hour, int min, int sec, uint32_t nsec)
+{
+  int64_t days;
+  int64_t shortyear;
+  int64_t a4, a100, a400;
+  int64_t intervening_leap_days;
+
+  /* Sanity check the input values */
+  if (year < 1900 || year > 2100 ||
+      yday < 1 || yday > 366 ||
+      hour < 0 || hour > 23 ||
+      min < 0 || min > 59 ||
+      sec < 0 || sec > 60 ||
+      nsec > 999999999)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): time component(s) out of range: %d,%d,%d,%d,%d,%u\n",
+              __func__, year, yday, hour, min, sec, nsec);
+    return SLTERROR;
+  }
+
+  /* Count leap days between the epoch and the start of the year */
+  shortyear = year - 1900;
+
+  a4   = (shortyear >> 2) + 475 - !(shortyear & 3);
+  a100 = a4 / 25 - (a4 % 25 < 0);
+  a400 = a100 >> 2;
+  intervening_leap_days = (a4 - 492) - (a100 - 19) + (a400 - 4);
+
+  days = (365 * (shortyear - 70) + intervening_leap_days + (yday - 1));
+
+  return (int64_t)(60 * (60 * ((int64_t)24 * days + hour) + min) + sec) * SLTMODULUS + nsec;
+} /* End of sl_time2nstime() */
+
+/**********************************************************************/ /**
+ * @brief Convert a nanosecond epoch time to time components
+ *
+ * The inverse of sl_time2nstime(), split a nanosecond epoch time into
+ * year, day-of-year, hour, minute, second and nanosecond.  Leap
+ * seconds are not accounted for.  Any component pointer may be NULL.
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sl_nstime2time (int64_t nstime, int *year, int *yday, int *hour,
+                int *min, int *sec, uint32_t *nsec)
+{
+  int64_t days;
+  int64_t secofday;
+  int64_t era;
+  int64_t doe, yoe, doy, mp;
+  int64_t civilyear;
+  int month, mday;
+  int leap;
+  static const int cumdays[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+  if (nstime == SLTERROR)
+    return -1;
+
+  /* Split into days and nanoseconds of day, flooring for negative times */
+  days     = nstime / ((int64_t)86400 * SLTMODULUS);
+  secofday = nstime % ((int64_t)86400 * SLTMODULUS);
+
+  if (secofday < 0)
+  {
+    secofday += (int64_t)86400 * SLTMODULUS;
+    days--;
+  }
+
+  if (nsec)
+    *nsec = (uint32_t)(secofday % SLTMODULUS);
+
+  secofday /= SLTMODULUS;
+
+  if (hour)
+    *hour = (int)(secofday / 3600);
+  if (min)
+    *min = (int)((secofday / 60) % 60);
+  if (sec)
+    *sec = (int)(secofday % 60);
+
+  /* Civil date from days since epoch, proleptic Gregorian calendar */
+  days += 719468;
+  era  = ((days >= 0) ? days : days - 146096) / 146097;
+  doe  = days - era * 146097;
+  yoe  = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  doy  = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  mp   = (5 * doy + 2) / 153;
+  mday  = (int)(doy - (153 * mp + 2) / 5 + 1);
+  month = (int)((mp < 10) ? mp + 3 : mp - 9);
+  civilyear = yoe + era * 400 + (month <= 2);
+
+  leap = ((civilyear % 4 == 0 && civilyear % 100 != 0) || civilyear % 400 == 0);
+
+  if (year)
+    *year = (int)civilyear;
+  if (yday)
+    *yday = cumdays[month - 1] + mday + ((month > 2) ? leap : 0);
+
+  return 0;
+} /* End of sl_nstime2time() */
+
+/**********************************************************************/ /**
+ * @brief Format a nanosecond epoch time as an ISO 8601 time string
+ *
+ * The time string is formatted as "YYYY-MM-DDThh:mm:ss.nnnnnnnnnZ".
+ *
+ * @param[in]  nstime       Nanosecond epoch time
+ * @param[out] isotime      Buffer for time string, at least 31 bytes
+ * @param[in]  isotimesize  Size of \a isotime buffer
+ *
+ * @returns Pointer to \a isotime on success and NULL on error.
+ ***************************************************************************/
+char *
+sl_nstime2isotime (int64_t nstime, char *isotime, size_t isotimesize)
+{
+  int year, yday, hour, min, sec;
+  int month = 0;
+  int mday  = 0;
+  uint32_t nsec;
+
+  if (!isotime || sl_nstime2time (nstime, &year, &yday, &hour, &min, &sec, &nsec))
+    return NULL;
+
+  sl_doy2md (year, yday, &month, &mday);
+
+  snprintf (isotime, isotimesize, "%04d-%02d-%02dT%02d:%02d:%02d.%09uZ",
+            year, month, mday, hour, min, sec, nsec);
+
+  return isotime;
+} /* End of sl_nstime2isotime() */
+
 /***********************************************************************/ /**
  * @brief Return protocol details for a specified type
  *
@@ -184,6 +326,16 @@ sl_formatstr (char format, char subformat)
       return "JSON";
     }
     break;
+  case SLPAYLOAD_XML:
+    switch (subformat)
+    {
+    case SLPAYLOAD_XML_INFO:
+      return "INFO in XML";
+      break;
+    default:
+      return "XML";
+    }
+    break;
   default:
     return "Unrecognized payload type";
   }
@@ -608,3 +760,180 @@ sl_strncpclean (char *dest, const char *source, int length)
 
   return didx;
 } /* End of sl_strncpclean() */
+
+/* Allocator used for all memory allocated by the library */
+static struct
+{
+  void *(*malloc) (size_t size, void *data);
+  void *(*realloc) (void *ptr, size_t size, void *data);
+  void (*free) (void *ptr, void *data);
+  void *data;
+} sl_allocator = {NULL, NULL, NULL, NULL};
+
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+/***************************************************************************
+ * tls_calloc:
+ *
+ * Allocation wrapper for mbedtls, which requires calloc() semantics.
+ ***************************************************************************/
+static void *
+tls_calloc (size_t count, size_t size)
+{
+  return sl_calloc (count, size);
+} /* End of tls_calloc() */
+#endif
+
+/**********************************************************************/ /**
+ * @brief Set the memory allocator used by the library
+ *
+ * All memory allocated by the library, including by the TLS
+ * implementation, is allocated and released using the provided
+ * functions, each of which is passed \a data as the last argument.
+ * The functions must be thread-safe if the library is used from
+ * multiple threads.
+ *
+ * This must be called before any other library function, memory
+ * allocated with one allocator must not be released by another.  Pass
+ * NULL for all functions to restore the system allocator.
+ *
+ * @param malloc_fn   Allocate memory, as malloc()
+ * @param realloc_fn  Reallocate memory, as realloc()
+ * @param free_fn     Release memory, as free()
+ * @param data        Pointer passed to the functions
+ *
+ * @retval  0 : success
+ * @retval -1 : error, either all or none of the functions must be set
+ ***************************************************************************/
+int
+sl_set_allocator (void *(*malloc_fn) (size_t size, void *data),
+                  void *(*realloc_fn) (void *ptr, size_t size, void *data),
+                  void (*free_fn) (void *ptr, void *data),
+                  void *data)
+{
+    if ((malloc_fn || realloc_fn || free_fn) &&
+        (!malloc_fn || !realloc_fn || !free_fn))
+        return -1;
+
+    sl_allocator.malloc  = malloc_fn;
+    sl_allocator.realloc = realloc_fn;
+    sl_allocator.free    = free_fn;
+    sl_allocator.data    = data;
+
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+    if (malloc_fn)
+        mbedtls_platform_set_calloc_free (tls_calloc, sl_free);
+    else
+        mbedtls_platform_set_calloc_free (calloc, free);
+#endif
+
+    return 0;
+} /* End of sl_set_allocator() */
+
+/**********************************************************************/ /**
+ * @brief Allocate memory with the library allocator
+ *
+ * @param size  Number of bytes to allocate
+ *
+ * @returns A pointer to the allocated memory or NULL on error.
+ *
+ * @sa sl_set_allocator()
+ ***************************************************************************/
+void *
+sl_malloc (size_t size)
+{
+  if (sl_allocator.malloc)
+    return sl_allocator.malloc (size, sl_allocator.data);
+
+  return malloc (size);
+} /* End of sl_malloc() */
+
+/**********************************************************************/ /**
+ * @brief Allocate zeroed memory for an array with the library allocator
+ *
+ * @param count  Number of elements
+ * @param size   Size of each element in bytes
+ *
+ * @returns A pointer to the allocated memory or NULL on error.
+ *
+ * @sa sl_set_allocator()
+ ***************************************************************************/
+void *
+sl_calloc (size_t count, size_t size)
+{
+  void *ptr;
+
+  if (!sl_allocator.malloc)
+    return calloc (count, size);
+
+  if (size && count > (size_t)-1 / size)
+    return NULL;
+
+  if ((ptr = sl_allocator.malloc (count * size, sl_allocator.data)) != NULL)
+    memset (ptr, 0, count * size);
+
+  return ptr;
+} /* End of sl_calloc() */
+
+/**********************************************************************/ /**
+ * @brief Reallocate memory with the library allocator
+ *
+ * @param ptr   Memory to reallocate, or NULL to allocate
+ * @param size  New size in bytes
+ *
+ * @returns A pointer to the reallocated memory or NULL on error.
+ *
+ * @sa sl_set_allocator()
+ ***************************************************************************/
+void *
+sl_realloc (void *ptr, size_t size)
+{
+  if (sl_allocator.realloc)
+    return sl_allocator.realloc (ptr, size, sl_allocator.data);
+
+  return realloc (ptr, size);
+} /* End of sl_realloc() */
+
+/**********************************************************************/ /**
+ * @brief Duplicate a string with the library allocator
+ *
+ * @param string  String to duplicate
+ *
+ * @returns A pointer to the new string or NULL on error.
+ *
+ * @sa sl_set_allocator()
+ ***************************************************************************/
+char *
+sl_strdup (const char *string)
+{
+  size_t length;
+  char *copy;
+
+  if (!string)
+    return NULL;
+
+  length = strlen (string) + 1;
+
+  if ((copy = (char *)sl_malloc (length)) != NULL)
+    memcpy (copy, string, length);
+
+  return copy;
+} /* End of sl_strdup() */
+
+/**********************************************************************/ /**
+ * @brief Release memory allocated by the library
+ *
+ * @param ptr  Memory to release, NULL is ignored
+ *
+ * @sa sl_set_allocator()
+ ***************************************************************************/
+void
+sl_free (void *ptr)
+{
+  if (!ptr)
+    return;
+
+  if (sl_allocator.free)
+    sl_allocator.free (ptr, sl_allocator.data);
+  else
+    free (ptr);
+} /* End of sl_free() */
@@ -0,0 +1,2685 @@
+/***************************************************************************
+ * group.c
+ *
+ * Routines for collecting packets from a group of SeedLink connections
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globmatch.h"
+#include "libslink.h"
+
+/* Use epoll() for polling members on Linux, otherwise select() */
+#if defined(__linux__)
+  #include <sys/epoll.h>
+  #define SLCG_EPOLL 1
+#endif
+
+/* Optionally receive with io_uring on Linux, when the kernel headers
+ * include multishot receive with provided buffer rings */
+#if defined(SLCG_EPOLL) && defined(__has_include)
+  #if __has_include(<linux/io_uring.h>)
+    #include <linux/io_uring.h>
+    #if defined(IORING_RECV_MULTISHOT)
+      #include <sys/mman.h>
+      #include <sys/syscall.h>
+      #include <unistd.h>
+      #define SLCG_URING 1
+    #endif
+  #endif
+#endif
+
+/* Maximum events returned by a single epoll_wait() */
+#define POLL_EVENTS 256
+
+#if defined(SLCG_URING)
+/* Submission queue entries of the io_uring instance */
+#define URING_ENTRIES 256
+
+/* Maximum number of provided receive buffers */
+#define URING_MAXBUFFERS 32768
+
+/* Buffer group ID of the provided buffer ring */
+#define URING_BGID 0
+
+/* Event data of the io_uring descriptor in the epoll set */
+#define URING_EVENT UINT32_MAX
+
+/* No buffer or member */
+#define URING_NONE UINT32_MAX
+
+/* Multishot receive of a member connection */
+typedef struct UringRecv
+{
+  uint32_t member;             /* Member index, URING_NONE after the member is released */
+  uint32_t head;               /* First received buffer not yet provided to the member */
+  uint32_t tail;               /* Last received buffer */
+  uint32_t lent;               /* Buffer provided to the member connection */
+  int8_t armed;                /* Multishot receive is pending */
+  int8_t closed;               /* End of stream received (1) and reported (2) */
+  int error;                   /* Receive error number, 0 at end of stream */
+  struct UringRecv *next;      /* Next receive of the group */
+} UringRecv;
+
+/* io_uring instance with a ring of provided receive buffers */
+typedef struct Uring
+{
+  int fd;                      /* io_uring descriptor */
+  void *sqring;                /* Submission queue ring mapping */
+  size_t sqringsize;
+  void *cqring;                /* Completion queue ring mapping, may be sqring */
+  size_t cqringsize;
+  struct io_uring_sqe *sqes;   /* Submission queue entries mapping */
+  size_t sqessize;
+  uint32_t *sqhead;
+  uint32_t *sqtail;
+  uint32_t *sqflags;
+  uint32_t *sqarray;
+  uint32_t sqmask;
+  uint32_t sqentries;
+  uint32_t pending;            /* Entries queued but not yet submitted */
+  uint32_t *cqhead;
+  uint32_t *cqtail;
+  uint32_t cqmask;
+  struct io_uring_cqe *cqes;
+  struct io_uring_buf_ring *bufring; /* Provided buffer ring mapping */
+  size_t bufringsize;
+  uint8_t *buffers;            /* Receive buffers */
+  uint32_t buffercount;        /* Number of receive buffers, a power of 2 */
+  uint32_t buffersize;         /* Size of each receive buffer */
+  uint32_t buffertail;         /* Tail of provided buffer ring */
+  uint32_t available;          /* Buffers available to the kernel */
+  uint32_t *nextbuffer;        /* Next received buffer of the same receive */
+  uint32_t *bufferlength;      /* Length of data in received buffers */
+  UringRecv *receives;         /* All receives, including released receives still pending */
+  int8_t rearm;                /* Receives ended for lack of buffers must be submitted again */
+  int8_t received;             /* Data has been received */
+  int8_t unsupported;          /* Multishot receive is not supported, fall back to epoll */
+} Uring;
+#endif
+
+/* Number of hash buckets for per-station deduplication windows */
+#define DEDUP_BUCKETS 4096
+
+/* Per-station window of recently seen record keys */
+typedef struct DedupStation
+{
+  char stationid[SL_MAX_STATIONID];
+  uint32_t next;               /* Next position to write in the window */
+  struct DedupStation *chain;  /* Next entry in hash bucket */
+  uint64_t keys[];             /* Window of record keys, 0 is unused */
+} DedupStation;
+
+/* Group member details */
+typedef struct SLCGmember
+{
+  SLCD *slconn;
+  int8_t finished;             /* Member has terminated */
+  int8_t ready;                /* Member is readable or has buffered data */
+  SOCKET polled;               /* Socket registered for polling, -1 if none */
+  int8_t backfill;             /* Member is a group-managed backfill connection */
+  uint64_t lastseq;            /* Last sequence number to backfill */
+  SLCD *primary;               /* Connection an auxiliary member adds streams to */
+  int8_t alldata;              /* Member requested all data for a stream when added */
+  int8_t throttled;            /* Member is waiting for rate limit tokens */
+  int64_t datatime;            /* Latest record start time received, live members */
+  char *payload;               /* Staging buffer for a partially received payload */
+  uint32_t payloadsize;        /* Size of staging buffer */
+  uint32_t staged;             /* Length of payload in staging buffer */
+  struct UringRecv *uring;     /* io_uring receive, NULL if not used */
+} SLCGmember;
+
+/* Queued backfill request */
+typedef struct BackfillRequest
+{
+  const SLCD *primary;         /* Connection to copy parameters from */
+  char stationid[SL_MAX_STATIONID];
+  uint64_t firstseq;           /* First missing sequence number */
+  uint64_t lastseq;            /* Last missing sequence number */
+  struct BackfillRequest *next;
+} BackfillRequest;
+
+/* SeedLink Connection Group */
+struct SLCG
+{
+  SLCGmember *members;         /* Array of group members */
+  uint32_t membercount;        /* Number of group members */
+  uint32_t nextmember;         /* Index of next member to collect from */
+  int8_t noblock;              /* Control blocking on collection */
+  uint32_t dedupwindow;        /* Records to track per station, 0 = disabled */
+  DedupStation **dedup;        /* Hash table of per-station windows */
+  uint64_t duplicates;         /* Count of duplicate records discarded */
+  int maxbackfill;             /* Maximum concurrent backfill connections */
+  BackfillRequest *backfills;  /* Queue of pending backfill requests */
+  int8_t terminate;            /* Group termination has been triggered */
+  int pollfd;                  /* epoll descriptor, -1 to use select() */
+  SLratelimit ratelimit;       /* Rate limit shared by backfilling members */
+  int maxlag;                  /* Live lag engaging the rate limit (seconds), 0 = always */
+  struct Uring *uring;         /* io_uring for receiving, NULL if not used */
+};
+
+static int member_add (SLCG *group, SLCD *slconn, int8_t backfill, uint64_t lastseq,
+                       SLCD *primary);
+static int member_collect (SLCG *group, SLCGmember *member,
+                           const SLpacketinfo **packetinfo,
+                           char *plbuffer, uint32_t plbuffersize);
+static void maintain_members (SLCG *group);
+static int member_idle (const SLCGmember *member, int64_t current_time);
+static int member_limited (const SLCGmember *member);
+static int ratelimit_engaged (SLCG *group, int64_t current_time);
+static void member_register (SLCG *group, uint32_t idx);
+static void member_receive (SLCG *group, uint32_t idx);
+static int member_provide (SLCG *group, SLCGmember *member);
+static int member_received (const SLCGmember *member);
+static void member_release (SLCG *group, SLCGmember *member);
+#if defined(SLCG_URING)
+static int uring_init (SLCG *group, uint32_t buffers, uint32_t buffersize);
+static void uring_free (SLCG *group);
+static void uring_reap (SLCG *group);
+static void uring_fallback (SLCG *group);
+static int uring_push (Uring *uring, const struct io_uring_sqe *sqe);
+static int uring_submit (Uring *uring);
+static void uring_recycle (Uring *uring, uint32_t bid);
+#endif
+static SLCD *backfill_connection (const BackfillRequest *request);
+static SLCD *copy_connection (const SLCD *primary);
+static SLCGmember *find_auxiliary (SLCG *group, const SLCD *primary);
+static void merge_auxiliary (SLCG *group, SLCGmember *primary);
+static void backfill_gap_handler (SLCD *slconn, const char *stationid,
+                                  uint64_t firstseq, uint64_t lastseq,
+                                  void *gap_data);
+static int dedup_check (SLCG *group, const SLCD *slconn,
+                        const SLpacketinfo *packetinfo, const char *payload);
+static void dedup_free (SLCG *group);
+static uint64_t hash_fnv1a (uint64_t hash, const void *data, size_t length);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new ::SLCG
+ *
+ * Allocate a new, empty SeedLink Connection Group.  Connections are
+ * added with sl_group_add() and packets are collected from all members
+ * with sl_group_collect().
+ *
+ * @returns An initialized ::SLCG on success, NULL on error.
+ ***************************************************************************/
+SLCG *
+sl_initslcg (void)
+{
+  SLCG *group;
+
+  group = (SLCG *)sl_malloc (sizeof (SLCG));
+
+  if (group == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (group, 0, sizeof (SLCG));
+
+  group->members     = NULL;
+  group->membercount = 0;
+  group->nextmember  = 0;
+  group->noblock     = 0;
+  group->dedupwindow = 0;
+  group->dedup       = NULL;
+  group->duplicates  = 0;
+  group->maxbackfill = 0;
+  group->backfills   = NULL;
+  group->terminate   = 0;
+  group->pollfd      = -1;
+  group->maxlag      = 0;
+  group->uring       = NULL;
+
+#if defined(SLCG_EPOLL)
+  if ((group->pollfd = epoll_create1 (EPOLL_CLOEXEC)) < 0)
+  {
+    sl_log_r (NULL, 1, 2, "%s(): epoll unavailable, using select(): %s\n",
+              __func__, strerror (errno));
+    group->pollfd = -1;
+  }
+#endif
+
+  return group;
+} /* End of sl_initslcg() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a ::SLCG
+ *
+ * The member connections are not freed, they remain owned by the caller.
+ * Any backfill and auxiliary connections created by the group are
+ * disconnected and freed.
+ *
+ * @param[in] group  SeedLink connection group to free
+ ***************************************************************************/
+void
+sl_freeslcg (SLCG *group)
+{
+  BackfillRequest *request;
+  uint32_t idx;
+
+  if (!group)
+    return;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    sl_free (group->members[idx].payload);
+
+    /* Data received with io_uring is discarded, so members are disconnected
+     * and resume from their sequence numbers when collected again */
+    if (group->members[idx].uring)
+    {
+      if (group->members[idx].slconn->link != -1)
+      {
+        sl_disconnect (group->members[idx].slconn);
+        group->members[idx].slconn->link = -1;
+      }
+
+      member_release (group, &group->members[idx]);
+    }
+
+    if (group->members[idx].backfill || group->members[idx].primary)
+    {
+      if (group->members[idx].slconn->link != -1)
+        sl_disconnect (group->members[idx].slconn);
+
+      sl_freeslcd (group->members[idx].slconn);
+      continue;
+    }
+
+    if (group->members[idx].slconn->gap_handler == backfill_gap_handler)
+      sl_set_gap_handler (group->members[idx].slconn, NULL, NULL);
+
+    /* Members remain usable without the group rate limit */
+    group->members[idx].slconn->sharedlimit = NULL;
+  }
+
+  while (group->backfills)
+  {
+    request          = group->backfills;
+    group->backfills = request->next;
+    sl_free (request);
+  }
+
+  dedup_free (group);
+
+#if defined(SLCG_URING)
+  uring_free (group);
+#endif
+
+#if defined(SLCG_EPOLL)
+  if (group->pollfd >= 0)
+    close (group->pollfd);
+#endif
+
+  sl_free (group->members);
+  sl_free (group);
+} /* End of sl_freeslcg() */
+
+/**********************************************************************/ /**
+ * @brief Add a connection to a ::SLCG
+ *
+ * The connection should be fully configured before it is added to the
+ * group.  Group members are always collected in non-blocking mode, the
+ * blocking behavior of sl_group_collect() is controlled by
+ * sl_group_set_blockingmode().
+ *
+ * @param[in] group   SeedLink connection group
+ * @param[in] slconn  SeedLink connection description to add
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_group_add (SLCG *group, SLCD *slconn)
+{
+  uint32_t idx;
+
+  if (!group || !slconn)
+    return -1;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    if (group->members[idx].slconn == slconn)
+    {
+      sl_log_r (slconn, 2, 0, "[%s] %s(): connection is already a group member\n",
+                slconn->sladdr, __func__);
+      return -1;
+    }
+  }
+
+  if (member_add (group, slconn, 0, 0, NULL))
+    return -1;
+
+  if (group->maxbackfill > 0 && slconn->gap_handler == NULL)
+    sl_set_gap_handler (slconn, backfill_gap_handler, group);
+
+  return 0;
+} /* End of sl_group_add() */
+
+/**********************************************************************/ /**
+ * @brief Set or unset the ::SLCG blocking mode
+ *
+ * In blocking mode sl_group_collect() will wait until a packet is
+ * available from any member or all members have terminated.  In
+ * non-blocking mode sl_group_collect() will return quickly.
+ *
+ * By default, the group is set to blocking mode.
+ *
+ * @param group     SeedLink connection group
+ * @param nonblock  Boolean flag, if non-zero set to non-blocking mode
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_group_set_blockingmode (SLCG *group, int nonblock)
+{
+  if (!group)
+    return -1;
+
+  group->noblock = (nonblock) ? 1 : 0;
+
+  return 0;
+} /* End of sl_group_set_blockingmode() */
+
+/**********************************************************************/ /**
+ * @brief Enable or disable deduplication of records for a ::SLCG
+ *
+ * When enabled, miniSEED records are identified by station ID,
+ * record start time and source identifier.  The first copy of a record
+ * received from any group member is returned and subsequent copies are
+ * discarded.
+ *
+ * A sliding window of the last \a window record keys is kept for each
+ * station, using 8 bytes per record.  The window should be large enough
+ * to cover the largest expected delay between redundant feeds, in
+ * number of records per station.
+ *
+ * Payloads that are not miniSEED, e.g. INFO responses, are never
+ * considered duplicates.
+ *
+ * The window size cannot be changed once set, but deduplication may
+ * be disabled, discarding all tracked record keys, and then enabled
+ * again with a different window.
+ *
+ * @param group   SeedLink connection group
+ * @param window  Number of record keys to track per station, 0 to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_group_set_dedup (SLCG *group, uint32_t window)
+{
+  if (!group)
+    return -1;
+
+  if (window == 0)
+  {
+    dedup_free (group);
+    return 0;
+  }
+
+  if (group->dedup && window != group->dedupwindow)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): deduplication window cannot be changed once set\n", __func__);
+    return -1;
+  }
+
+  if (group->dedup == NULL)
+  {
+    group->dedup = (DedupStation **)sl_calloc (DEDUP_BUCKETS, sizeof (DedupStation *));
+
+    if (group->dedup == NULL)
+    {
+      sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+      return -1;
+    }
+  }
+
+  group->dedupwindow = window;
+
+  return 0;
+} /* End of sl_group_set_dedup() */
+
+/**********************************************************************/ /**
+ * @brief Enable or disable automatic backfill of sequence gaps for a ::SLCG
+ *
+ * When enabled, a gap handler is set for all members that do not
+ * already have one, see sl_set_gap_handler().  Each sequence gap
+ * detected is then queued for backfill with sl_group_backfill().
+ *
+ * The \a maxconnections value limits the number of backfill
+ * connections that are open concurrently, further requests are
+ * queued until a running backfill completes.
+ *
+ * Gap detection assumes that servers number packets per station, see
+ * sl_set_gap_handler().  Automatic backfill must not be enabled for
+ * groups with members connected to servers that use a single sequence
+ * for all stations, e.g. ringserver, as nearly every packet would be
+ * reported as a gap and queued for backfill.
+ *
+ * @param group           SeedLink connection group
+ * @param maxconnections  Maximum concurrent backfill connections, 0 to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_group_set_backfill (SLCG *group, int maxconnections)
+{
+  uint32_t idx;
+  SLCD *slconn;
+
+  if (!group || maxconnections < 0)
+    return -1;
+
+  group->maxbackfill = maxconnections;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    if (group->members[idx].backfill)
+      continue;
+
+    slconn = group->members[idx].slconn;
+
+    if (maxconnections > 0 && slconn->gap_handler == NULL)
+      sl_set_gap_handler (slconn, backfill_gap_handler, group);
+    else if (maxconnections == 0 && slconn->gap_handler == backfill_gap_handler)
+      sl_set_gap_handler (slconn, NULL, NULL);
+  }
+
+  return 0;
+} /* End of sl_group_set_backfill() */
+
+/**********************************************************************/ /**
+ * @brief Set a rate limit shared by the backfilling members of a ::SLCG
+ *
+ * Limit the combined rate at which data is read by backfilling
+ * members to \a rate bytes per second, so that catching up does not
+ * starve the real-time members on a shared link.  The limit is a
+ * single token bucket applied in the read path of sl_collect() in
+ * addition to any limit set for a member with sl_set_ratelimit(),
+ * throttled members are not read and TCP flow control slows the
+ * server.
+ *
+ * Members are considered backfilling when they are group-managed
+ * backfill connections, are in dial-up mode, have a time window set
+ * with sl_set_timewindow(), or requested ::SL_ALLDATASEQUENCE for
+ * any stream when added to the group.  All other members, excluding
+ * auxiliary connections, are considered live.
+ *
+ * If \a maxlag is greater than 0 the limit is only engaged while the
+ * latest miniSEED record received by any live member started more
+ * than \a maxlag seconds ago, or no record has been received by a live
+ * member yet.  Otherwise, or if there are no live members,
+ * backfilling is not limited.  If \a maxlag is 0 the limit is always
+ * engaged.
+ *
+ * The limit may be changed at any time, including while collecting.
+ *
+ * @param group   SeedLink connection group
+ * @param rate    Maximum combined bytes per second, 0 to disable the limit
+ * @param maxlag  Live lag in seconds that engages the limit, 0 for always
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_set_ratelimit()
+ ***************************************************************************/
+int
+sl_group_set_ratelimit (SLCG *group, uint32_t rate, int maxlag)
+{
+  if (!group || maxlag < 0)
+    return -1;
+
+  group->ratelimit.rate = rate;
+  group->maxlag         = maxlag;
+
+  if (group->ratelimit.tokens > (int64_t)rate)
+    group->ratelimit.tokens = rate;
+
+  return 0;
+} /* End of sl_group_set_ratelimit() */
+
+/**********************************************************************/ /**
+ * @brief Receive data for members of a ::SLCG with io_uring
+ *
+ * On Linux, receive the data of plain TCP members with io_uring instead
+ * of polling with epoll and calling recv() for each member.  A multishot
+ * receive is submitted once for each streaming member, and the kernel
+ * fills buffers from a ring of \a buffers provided buffers of
+ * \a buffersize bytes as data arrives.  The filled buffers are parsed
+ * in place by sl_collect() without copying them to the receive buffer
+ * of the connection, only data split between buffers is copied.
+ *
+ * The buffers are shared by all members.  When all buffers hold data
+ * not yet collected, receiving pauses until buffers are processed and
+ * TCP flow control slows the servers, as when collection falls behind
+ * with epoll.
+ *
+ * Members connected with TLS, in splice mode, with a rate limit set
+ * with sl_set_ratelimit() or subject to the shared rate limit of the
+ * group are polled with epoll as before.
+ *
+ * io_uring cannot be disabled once enabled.  Data received for a member
+ * but not yet collected is lost when the group is freed, so members
+ * receiving with io_uring are disconnected by sl_freeslcg() and resume
+ * from their sequence numbers when collected again.
+ *
+ * Multishot receive requires Linux 6.0 or later.  If io_uring is not
+ * available, or not permitted, members are polled with epoll.
+ *
+ * @param group       SeedLink connection group
+ * @param buffers     Number of receive buffers, rounded up to a power of 2,
+ *                    at most 32768
+ * @param buffersize  Size of each receive buffer in bytes
+ *
+ * @retval  0 : success, io_uring is used
+ * @retval  1 : io_uring is not available, members are polled with epoll
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_group_set_iouring (SLCG *group, uint32_t buffers, uint32_t buffersize)
+{
+#if defined(SLCG_URING)
+  uint32_t count;
+#endif
+
+  if (!group || buffers == 0 || buffersize == 0)
+    return -1;
+
+#if defined(SLCG_URING)
+  if (group->uring)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): io_uring is already enabled\n", __func__);
+    return -1;
+  }
+
+  if (buffers > URING_MAXBUFFERS)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): number of buffers (%u) is larger than maximum (%u)\n",
+              __func__, buffers, URING_MAXBUFFERS);
+    return -1;
+  }
+
+  for (count = 1; count < buffers; count <<= 1)
+    ;
+
+  if (group->pollfd < 0 || uring_init (group, count, buffersize))
+    return 1;
+
+  return 0;
+#else
+  sl_log_r (NULL, 1, 2, "%s(): io_uring is not supported on this platform\n", __func__);
+
+  return 1;
+#endif
+} /* End of sl_group_set_iouring() */
+
+/**********************************************************************/ /**
+ * @brief Queue a range of sequence numbers to be backfilled
+ *
+ * Queue a request for a temporary dial-up connection that fetches the
+ * sequence range \a firstseq to \a lastseq, inclusive, for a single
+ * station.  The server address, TLS mode, authentication and timeout
+ * parameters, and the stream selectors for the station, are copied
+ * from the \a primary connection, which must remain valid until the
+ * backfill has started.
+ *
+ * Backfill connections are started by sl_group_collect() and packets
+ * received are returned along with packets from other members.
+ * Packets beyond \a lastseq are discarded and the backfill connection
+ * is terminated when the range is complete.  Enable deduplication with
+ * sl_group_set_dedup() if the range may overlap data received from
+ * other members.
+ *
+ * This routine is safe to call from a gap handler callback, i.e.
+ * during sl_group_collect().
+ *
+ * @param group      SeedLink connection group
+ * @param primary    Connection to copy parameters from
+ * @param stationid  Station ID to backfill, must not contain wildcards
+ * @param firstseq   First sequence number to backfill
+ * @param lastseq    Last sequence number to backfill
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_set_gap_handler()
+ ***************************************************************************/
+int
+sl_group_backfill (SLCG *group, const SLCD *primary, const char *stationid,
+                   uint64_t firstseq, uint64_t lastseq)
+{
+  BackfillRequest *request;
+  BackfillRequest *last;
+
+  if (!group || !primary || !stationid)
+    return -1;
+
+  if (group->terminate)
+    return -1;
+
+  if (strchr (stationid, '*') || strchr (stationid, '?') ||
+      strlen (stationid) >= SL_MAX_STATIONID)
+  {
+    sl_log_r (primary, 2, 0, "[%s] %s(): invalid station ID for backfill: '%s'\n",
+              primary->sladdr, __func__, stationid);
+    return -1;
+  }
+
+  if (firstseq == 0 || firstseq > lastseq || lastseq >= SL_ALLDATASEQUENCE)
+  {
+    sl_log_r (primary, 2, 0, "[%s] %s(): invalid sequence range for backfill: %" PRIu64 " to %" PRIu64 "\n",
+              primary->sladdr, __func__, firstseq, lastseq);
+    return -1;
+  }
+
+  request = (BackfillRequest *)sl_malloc (sizeof (BackfillRequest));
+
+  if (request == NULL)
+  {
+    sl_log_r (primary, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  request->primary = primary;
+  strcpy (request->stationid, stationid);
+  request->firstseq = firstseq;
+  request->lastseq  = lastseq;
+  request->next     = NULL;
+
+  /* Append to the queue */
+  if (group->backfills == NULL)
+  {
+    group->backfills = request;
+  }
+  else
+  {
+    for (last = group->backfills; last->next; last = last->next)
+      ;
+
+    last->next = request;
+  }
+
+  return 0;
+} /* End of sl_group_backfill() */
+
+/**********************************************************************/ /**
+ * @brief Add a stream to a group member without renegotiation
+ *
+ * Add a stream to the \a primary connection, a member of the group in
+ * multi-station mode, without disrupting the streams already flowing.
+ *
+ * If the primary is not connected the stream is added to its stream
+ * list with sl_add_stream() and negotiated on the next connection.
+ * Otherwise the stream is negotiated on an auxiliary connection managed
+ * by the group, with parameters copied from the primary as described for
+ * sl_group_backfill().  Streams added before the auxiliary connection is
+ * established share the same connection.  Packets received on auxiliary
+ * connections are returned by sl_group_collect() along with packets
+ * from other members, with the auxiliary connection in \a slconn.
+ *
+ * When the primary next reconnects, after the auxiliary connection has
+ * successfully negotiated and is streaming, the streams are merged into
+ * the primary stream list resuming from the last packets returned and
+ * the auxiliary connection is closed.  A long-lived primary connection
+ * is never interrupted for additions.
+ *
+ * This routine must not be called during sl_group_collect(), e.g. from
+ * a callback.
+ *
+ * @param group      SeedLink connection group
+ * @param primary    Group member to add the stream to
+ * @param stationid  Station ID
+ * @param selectors  Selectors for the station ID, NULL if none
+ * @param seqnum     Last received sequence number or special value
+ * @param timestamp  Start time for the stream, NULL if not used
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_add_stream(), sl_group_remove_stream()
+ ***************************************************************************/
+int
+sl_group_add_stream (SLCG *group, SLCD *primary, const char *stationid,
+                     const char *selectors, uint64_t seqnum,
+                     const char *timestamp)
+{
+  SLCGmember *member;
+  SLCD *slconn;
+  uint32_t idx;
+
+  if (!group || !primary || !stationid)
+    return -1;
+
+  if (group->terminate)
+    return -1;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    if (group->members[idx].slconn == primary &&
+        !group->members[idx].backfill && !group->members[idx].primary)
+      break;
+  }
+
+  if (idx == group->membercount)
+  {
+    sl_log_r (primary, 2, 0, "[%s] %s(): connection is not a group member\n",
+              primary->sladdr, __func__);
+    return -1;
+  }
+
+  if (primary->streams && primary->multistation == 0)
+  {
+    sl_log_r (primary, 2, 0, "[%s] %s(): all-station mode already configured!\n",
+              primary->sladdr, __func__);
+    return -1;
+  }
+
+  /* Negotiated on the next connection */
+  if (primary->link == -1)
+    return sl_add_stream (primary, stationid, selectors, seqnum, timestamp);
+
+  /* Add to an auxiliary connection that has not yet connected */
+  if ((member = find_auxiliary (group, primary)) != NULL)
+    return sl_add_stream (member->slconn, stationid, selectors, seqnum, timestamp);
+
+  if ((slconn = copy_connection (primary)) == NULL)
+  {
+    sl_log_r (primary, 2, 0, "[%s] %s(): cannot create auxiliary connection\n",
+              primary->sladdr, __func__);
+    return -1;
+  }
+
+  if (sl_set_dialupmode (slconn, primary->dialup) ||
+      sl_add_stream (slconn, stationid, selectors, seqnum, timestamp) ||
+      member_add (group, slconn, 0, 0, primary))
+  {
+    sl_freeslcd (slconn);
+    return -1;
+  }
+
+  sl_log_r (slconn, 1, 1, "[%s] Starting auxiliary connection for added streams\n",
+            slconn->sladdr);
+
+  return 0;
+} /* End of sl_group_add_stream() */
+
+/**********************************************************************/ /**
+ * @brief Remove a stream from a group member without renegotiation
+ *
+ * Remove the station ID from the \a primary connection with
+ * sl_remove_stream(), packets for the station are filtered client-side
+ * until the primary next reconnects.  Auxiliary connections carrying
+ * the station, created by sl_group_add_stream(), are updated in the
+ * same way or terminated if no other streams remain.
+ *
+ * @param group      SeedLink connection group
+ * @param primary    Group member to remove the stream from
+ * @param stationid  Station ID of entries to remove
+ *
+ * @retval  0 : success
+ * @retval -1 : error or no matching entries
+ *
+ * @sa sl_remove_stream(), sl_group_add_stream()
+ ***************************************************************************/
+int
+sl_group_remove_stream (SLCG *group, SLCD *primary, const char *stationid)
+{
+  SLCGmember *member;
+  SLstream *stream;
+  uint32_t idx;
+  int found = 0;
+  int other;
+
+  if (!group || !primary || !stationid)
+    return -1;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    member = &group->members[idx];
+
+    if (member->primary != primary || member->finished)
+      continue;
+
+    found = 0;
+    other = 0;
+    for (stream = member->slconn->streams; stream; stream = stream->next)
+    {
+      if (strcmp (stream->stationid, stationid) == 0)
+        found = 1;
+      else
+        other = 1;
+    }
+
+    if (!found)
+      continue;
+
+    if (other)
+    {
+      if (sl_remove_stream (member->slconn, stationid))
+        return -1;
+    }
+    else if (!member->slconn->terminate)
+    {
+      sl_terminate (member->slconn);
+    }
+
+    return 0;
+  }
+
+  return sl_remove_stream (primary, stationid);
+} /* End of sl_group_remove_stream() */
+
+/**********************************************************************/ /**
+ * @brief Collect packets from all members of a ::SLCG
+ *
+ * Designed to run in a loop of a client program in the same way as
+ * sl_collect(), this routine calls sl_collect() for each member of
+ * the group in a round-robin fashion and returns the first packet
+ * available.
+ *
+ * Members that are waiting to reconnect are skipped until their
+ * reconnect delay has elapsed, so an outage of one member does not
+ * delay delivery from the others.
+ *
+ * The member connection that returned the packet is returned in
+ * \a slconn.  If \a SLTOOLARGE is returned the caller may reallocate
+ * \a plbuffer as described for sl_collect(), the next call will
+ * continue collection from the same member.  The same applies to
+ * segments returned with \a SLCHUNK for members in chunked mode.
+ *
+ * Payloads are received into a staging buffer for each member and
+ * copied to \a plbuffer when complete, so a payload partially received
+ * from one member is not overwritten by packets from other members.
+ * The contents of \a plbuffer are only defined after ::SLPACKET or
+ * ::SLCHUNK is returned, but the same buffer, or a larger one after
+ * ::SLTOOLARGE, must be passed on every call as the staging buffers
+ * are sized to match.
+ *
+ * @param[in]  group   SeedLink connection group
+ * @param[out] slconn  Pointer to the member ::SLCD that returned the packet
+ * @param[out] packetinfo  Pointer to pointer to ::SLpacketinfo describing payload
+ * @param[out] plbuffer  Destination buffer for packet payload
+ * @param[in]  plbuffersize  Length of destination buffer
+ *
+ * @returns @ref collect-status
+ * @retval SLPACKET Complete packet returned
+ * @retval SLTERMINATE All members have terminated or error
+ * @retval SLNOPACKET  No packet available, call again
+ * @retval SLTOOLARGE  Payload is larger than allowed maximum
+ * @retval SLCHUNK  Segment of payload returned, chunked mode only
+ *
+ * @sa sl_collect()
+ ***************************************************************************/
+int
+sl_group_collect (SLCG *group, SLCD **slconn,
+                  const SLpacketinfo **packetinfo,
+                  char *plbuffer, uint32_t plbuffersize)
+{
+  SLCGmember *member;
+  int64_t current_time;
+  uint32_t count;
+  uint32_t idx;
+  uint32_t aux;
+  int64_t starttime;
+  int polled = 0;
+  int engaged;
+  int active;
+  int state;
+  int status;
+
+  if (!group || !slconn || !packetinfo)
+    return SLTERMINATE;
+
+  *slconn     = NULL;
+  *packetinfo = NULL;
+
+  while (1)
+  {
+    maintain_members (group);
+
+#if defined(SLCG_URING)
+    /* Queue data received with io_uring for members */
+    if (group->uring)
+      uring_reap (group);
+#endif
+
+    active  = 0;
+    engaged = ratelimit_engaged (group, sl_nstime ());
+
+    for (count = 0; count < group->membercount; count++)
+    {
+      idx    = (group->nextmember + count) % group->membercount;
+      member = &group->members[idx];
+
+      if (member->finished)
+        continue;
+
+      active++;
+
+      /* Skip members waiting for reconnect delay, sl_collect() would throttle */
+      current_time = sl_nstime ();
+      if (member->slconn->link == -1 &&
+          member->slconn->stat->netdly_time &&
+          member->slconn->stat->netdly_time > current_time)
+      {
+        continue;
+      }
+
+      /* Skip members waiting for rate limit tokens, polling resumes after */
+      if (member->throttled)
+      {
+        if (member->slconn->stat->ratelimit_time > current_time)
+          continue;
+
+        member->throttled = 0;
+        member->ready     = 1;
+        member_register (group, idx);
+      }
+
+      /* Skip idle members, collected again when polled readable or timers expire */
+      if (member_idle (member, current_time))
+        continue;
+
+      /* Apply the shared rate limit to backfilling members while engaged */
+      member->slconn->sharedlimit = (engaged && member_limited (member)) ?
+                                    &group->ratelimit : NULL;
+
+      /* Merge auxiliary streams into primary connections before reconnecting */
+      if (member->slconn->link == -1 && !member->backfill && !member->primary)
+        merge_auxiliary (group, member);
+
+      state  = member->slconn->stat->conn_state;
+      status = member_collect (group, member, packetinfo, plbuffer, plbuffersize);
+
+      /* Submit or release the io_uring receive for the member's connection */
+      member_receive (group, idx);
+
+      /* Members without buffered data are not ready until polled readable,
+       * after SLTOOLARGE the payload may be complete without further data */
+      member->ready = (status == SLTOOLARGE ||
+                       (status != SLNOPACKET && member->slconn->recvdatalen > 0) ||
+                       member_received (member));
+
+      /* Stop polling members throttled by a rate limit, readable sockets would not be read */
+      if (status == SLNOPACKET &&
+          member->slconn->stat->ratelimit_time > current_time)
+      {
+        member->throttled = 1;
+        member_register (group, idx);
+      }
+      /* Register new sockets, descriptor numbers are reused after reconnection */
+      else if (member->slconn->link != member->polled || state != STREAMING)
+      {
+        member_register (group, idx);
+      }
+
+      if (status == SLTERMINATE)
+      {
+        if (member->backfill)
+          sl_log_r (member->slconn, 1, 1, "[%s] Backfill of %s finished\n",
+                    member->slconn->sladdr, member->slconn->streams->stationid);
+        else if (member->primary)
+          sl_log_r (member->slconn, 1, 1, "[%s] Auxiliary connection terminated\n",
+                    member->slconn->sladdr);
+        else
+          sl_log_r (member->slconn, 1, 1, "[%s] Connection group member terminated\n",
+                    member->slconn->sladdr);
+
+        member->finished = 1;
+
+        /* Auxiliary connections of a terminated primary are not merged */
+        for (aux = 0; aux < group->membercount; aux++)
+        {
+          if (group->members[aux].primary == member->slconn &&
+              !group->members[aux].slconn->terminate)
+            sl_terminate (group->members[aux].slconn);
+        }
+        continue;
+      }
+      else if (status == SLNOPACKET)
+      {
+        continue;
+      }
+      else if (status == SLTOOLARGE || status == SLCHUNK)
+      {
+        /* Resume with the same member on the next call */
+        group->nextmember = idx;
+        *slconn           = member->slconn;
+        return status;
+      }
+
+      /* Limit backfill connections to the requested range */
+      if (member->backfill && (*packetinfo)->seqnum != SL_UNSETSEQUENCE)
+      {
+        if ((*packetinfo)->seqnum > member->lastseq)
+        {
+          if (!member->slconn->terminate)
+            sl_terminate (member->slconn);
+
+          continue;
+        }
+
+        if ((*packetinfo)->seqnum == member->lastseq)
+          sl_terminate (member->slconn);
+      }
+
+      /* Track the data time of live members to gate the shared rate limit */
+      if (group->ratelimit.rate && group->maxlag > 0 &&
+          !member_limited (member) && !member->primary &&
+          ((*packetinfo)->payloadformat == SLPAYLOAD_MSEED2 ||
+           (*packetinfo)->payloadformat == SLPAYLOAD_MSEED3))
+      {
+        starttime = sl_payload_starttime (member->slconn->log, *packetinfo, plbuffer,
+                                          (*packetinfo)->payloadlength);
+
+        if (starttime != SLTERROR && starttime > member->datatime)
+          member->datatime = starttime;
+      }
+
+      /* Discard records already received from another member */
+      if (group->dedup &&
+          dedup_check (group, member->slconn, *packetinfo, plbuffer))
+      {
+        group->duplicates++;
+        continue;
+      }
+
+      group->nextmember = (idx + 1) % group->membercount;
+      *slconn           = member->slconn;
+      return status;
+    }
+
+    if (active == 0)
+    {
+      *packetinfo = NULL;
+      return SLTERMINATE;
+    }
+
+    if (group->noblock)
+    {
+      /* Check once for readable members without waiting */
+      if (!polled++ && sl_group_poll (group, 0) > 0)
+        continue;
+
+      *packetinfo = NULL;
+      return SLNOPACKET;
+    }
+
+    /* Wait up to 1/10 second for data on any member */
+    sl_group_poll (group, 100);
+  }
+} /* End of sl_group_collect() */
+
+/**********************************************************************/ /**
+ * @brief Poll the network connections of all ::SLCG members
+ *
+ * Poll the connected sockets of all active members for readability
+ * for a specified amount of time.  Readable members are collected by
+ * the next call to sl_group_collect(), connected members that are not
+ * readable are skipped until their keepalive or network timeout
+ * expires.  If no members are connected this routine sleeps for the
+ * timeout.
+ *
+ * On Linux epoll() is used, with sockets registered once per
+ * connection, otherwise select() is used.
+ *
+ * @param group       SeedLink connection group
+ * @param timeout_ms  The timeout in milliseconds
+ *
+ * @retval >=1 : success, number of readable connections
+ * @retval   0 : if time-out expires
+ * @retval  <0 : errors
+ ***************************************************************************/
+int
+sl_group_poll (SLCG *group, int timeout_ms)
+{
+  fd_set readset;
+  struct timeval to;
+  SOCKET maxfd = -1;
+  SLCGmember *member;
+  uint32_t idx;
+  int connected = 0;
+  int count;
+
+  if (!group || timeout_ms < 0)
+    return -1;
+
+  FD_ZERO (&readset);
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    member = &group->members[idx];
+
+    if (member->finished || member->slconn->link == -1)
+      continue;
+
+    connected++;
+
+    if (group->pollfd >= 0)
+    {
+      if (member->slconn->link != member->polled)
+        member_register (group, idx);
+
+      continue;
+    }
+
+    /* Members throttled by a rate limit are not read even if readable */
+    if (member->throttled)
+      continue;
+
+#if !defined(SLP_WIN)
+    /* Sockets beyond the select() limit are always collected */
+    if (member->slconn->link >= FD_SETSIZE)
+    {
+      member->ready = 1;
+      continue;
+    }
+#endif
+
+    FD_SET (member->slconn->link, &readset);
+
+    if (member->slconn->link > maxfd)
+      maxfd = member->slconn->link;
+  }
+
+  /* Nothing to wait on, sleep for the timeout */
+  if (connected == 0)
+  {
+    sl_usleep ((unsigned long int)timeout_ms * 1000);
+    return 0;
+  }
+
+#if defined(SLCG_EPOLL)
+  if (group->pollfd >= 0)
+  {
+    struct epoll_event events[POLL_EVENTS];
+
+    count = epoll_wait (group->pollfd, events, POLL_EVENTS, timeout_ms);
+
+    for (idx = 0; count > 0 && idx < (uint32_t)count; idx++)
+    {
+      if (events[idx].data.u32 < group->membercount)
+        group->members[events[idx].data.u32].ready = 1;
+#if defined(SLCG_URING)
+      else if (events[idx].data.u32 == URING_EVENT && group->uring)
+        uring_reap (group);
+#endif
+    }
+
+    if (count < 0 && errno == EINTR)
+      count = 0;
+
+    return count;
+  }
+#endif
+
+  if (maxfd == -1)
+    return connected;
+
+  to.tv_sec  = timeout_ms / 1000;
+  to.tv_usec = (timeout_ms % 1000) * 1000;
+
+  count = select (maxfd + 1, &readset, NULL, NULL, &to);
+
+  for (idx = 0; count > 0 && idx < group->membercount; idx++)
+  {
+    member = &group->members[idx];
+
+    if (!member->finished && member->slconn->link != -1 &&
+        FD_ISSET (member->slconn->link, &readset))
+      member->ready = 1;
+  }
+
+  return count;
+} /* End of sl_group_poll() */
+
+/**********************************************************************/ /**
+ * @brief Trigger termination of all ::SLCG members
+ *
+ * Call sl_terminate() for each member, causing sl_group_collect() to
+ * return any packets already received and then ::SLTERMINATE.
+ *
+ * @param[in] group  SeedLink connection group
+ ***************************************************************************/
+void
+sl_group_terminate (SLCG *group)
+{
+  uint32_t idx;
+
+  if (!group)
+    return;
+
+  /* No further backfill connections will be started */
+  group->terminate = 1;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    if (!group->members[idx].finished)
+      sl_terminate (group->members[idx].slconn);
+  }
+} /* End of sl_group_terminate() */
+
+/***************************************************************************
+ * member_add:
+ *
+ * Add a connection to the group member array and set non-blocking
+ * mode, members are polled by the group.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+member_add (SLCG *group, SLCD *slconn, int8_t backfill, uint64_t lastseq,
+            SLCD *primary)
+{
+  SLCGmember *members;
+  SLstream *stream;
+
+  members = (SLCGmember *)sl_realloc (group->members,
+                                   sizeof (SLCGmember) * (group->membercount + 1));
+
+  if (members == NULL)
+  {
+    sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  group->members = members;
+  group->members[group->membercount].slconn   = slconn;
+  group->members[group->membercount].finished = 0;
+  group->members[group->membercount].ready    = 1;
+  group->members[group->membercount].polled   = -1;
+  group->members[group->membercount].backfill = backfill;
+  group->members[group->membercount].lastseq  = lastseq;
+  group->members[group->membercount].primary  = primary;
+  group->members[group->membercount].alldata  = 0;
+  group->members[group->membercount].throttled = 0;
+  group->members[group->membercount].datatime = 0;
+  group->members[group->membercount].payload  = NULL;
+  group->members[group->membercount].payloadsize = 0;
+  group->members[group->membercount].staged   = 0;
+  group->members[group->membercount].uring    = NULL;
+
+  for (stream = slconn->streams; stream; stream = stream->next)
+  {
+    if (stream->seqnum == SL_ALLDATASEQUENCE)
+      group->members[group->membercount].alldata = 1;
+  }
+
+  group->membercount++;
+
+  sl_set_blockingmode (slconn, 1);
+
+  return 0;
+} /* End of member_add() */
+
+/***************************************************************************
+ * member_collect:
+ *
+ * Collect from a member directly into the caller's buffer.  A payload
+ * that is partially received when collection returns is moved to the
+ * member's staging buffer, so collecting other members into the
+ * caller's buffer cannot overwrite it, and is restored to the caller's
+ * buffer before collection of the member resumes.  Packets received
+ * completely in one call are never copied.
+ *
+ * Buffers received with io_uring are provided to the connection one
+ * at a time until a packet is returned or none remain.
+ *
+ * Returns the status of sl_collect() or SLTERMINATE on error.
+ ***************************************************************************/
+static int
+member_collect (SLCG *group, SLCGmember *member,
+                const SLpacketinfo **packetinfo,
+                char *plbuffer, uint32_t plbuffersize)
+{
+  const SLpacketinfo *current = &member->slconn->stat->packetinfo;
+  char *payload;
+  int status;
+
+  /* Restore a partially received payload, unless the caller's buffer is
+   * now too small, then sl_collect() returns SLTOOLARGE without using it */
+  if (member->staged > 0 && member->staged <= plbuffersize)
+  {
+    memcpy (plbuffer, member->payload, member->staged);
+    member->staged = 0;
+  }
+
+  /* Process buffers received with io_uring until a packet is returned */
+  member_provide (group, member);
+
+  status = sl_collect (member->slconn, packetinfo, plbuffer, plbuffersize);
+
+  while (status == SLNOPACKET && member_provide (group, member))
+    status = sl_collect (member->slconn, packetinfo, plbuffer, plbuffersize);
+
+  /* Stage a partially received payload, segments of chunked payloads are
+   * not retained between calls */
+  if (status != SLPACKET && status != SLCHUNK && member->staged == 0 &&
+      member->slconn->stat->stream_state == PAYLOAD &&
+      current->payloadcollected > 0 && current->payloadcollected <= plbuffersize &&
+      !(member->slconn->chunkmode && current->payloadlength > plbuffersize &&
+        current->payloadformat != SLPAYLOAD_MSEED2 &&
+        current->payloadformat != SLPAYLOAD_MSEED3))
+  {
+    if (current->payloadcollected > member->payloadsize)
+    {
+      if ((payload = (char *)sl_realloc (member->payload, plbuffersize)) == NULL)
+      {
+        sl_log_r (member->slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+        return SLTERMINATE;
+      }
+
+      member->payload     = payload;
+      member->payloadsize = plbuffersize;
+    }
+
+    memcpy (member->payload, plbuffer, current->payloadcollected);
+    member->staged = current->payloadcollected;
+  }
+
+  return status;
+} /* End of member_collect() */
+
+/***************************************************************************
+ * maintain_members:
+ *
+ * Remove and free finished backfill and auxiliary connections and
+ * start queued backfill requests up to the concurrent connection limit.
+ *
+ * Requests that cannot be started are logged and discarded.
+ ***************************************************************************/
+static void
+maintain_members (SLCG *group)
+{
+  BackfillRequest *request;
+  SLCD *slconn;
+  uint32_t idx;
+  uint32_t keep;
+  int running = 0;
+  int limit;
+
+  /* Remove finished backfill members, compacting the array */
+  for (idx = 0, keep = 0; idx < group->membercount; idx++)
+  {
+    if ((group->members[idx].backfill || group->members[idx].primary) &&
+        group->members[idx].finished)
+    {
+      member_release (group, &group->members[idx]);
+      sl_freeslcd (group->members[idx].slconn);
+      sl_free (group->members[idx].payload);
+      continue;
+    }
+
+    if (group->members[idx].backfill)
+      running++;
+
+    if (keep != idx)
+    {
+      group->members[keep] = group->members[idx];
+
+      /* Update the member index registered for polling */
+      if (group->members[keep].polled != -1)
+      {
+        group->members[keep].polled = -1;
+        member_register (group, keep);
+      }
+
+#if defined(SLCG_URING)
+      /* Update the member index of the io_uring receive */
+      if (group->members[keep].uring)
+        group->members[keep].uring->member = keep;
+#endif
+    }
+
+    keep++;
+  }
+
+  if (keep != group->membercount)
+  {
+    group->membercount = keep;
+    group->nextmember  = 0;
+  }
+
+  if (group->terminate)
+    return;
+
+  limit = (group->maxbackfill > 0) ? group->maxbackfill : 1;
+
+  /* Start queued backfills */
+  while (group->backfills && running < limit)
+  {
+    request          = group->backfills;
+    group->backfills = request->next;
+
+    if ((slconn = backfill_connection (request)) == NULL)
+    {
+      sl_log_r (request->primary, 2, 0, "[%s] Cannot start backfill of %s, %" PRIu64 " to %" PRIu64 "\n",
+                request->primary->sladdr, request->stationid,
+                request->firstseq, request->lastseq);
+    }
+    else if (member_add (group, slconn, 1, request->lastseq, NULL))
+    {
+      sl_freeslcd (slconn);
+    }
+    else
+    {
+      sl_log_r (slconn, 1, 1, "[%s] Starting backfill of %s, %" PRIu64 " to %" PRIu64 "\n",
+                slconn->sladdr, request->stationid,
+                request->firstseq, request->lastseq);
+      running++;
+    }
+
+    sl_free (request);
+  }
+} /* End of maintain_members() */
+
+/***************************************************************************
+ * member_idle:
+ *
+ * Determine if a member can be skipped during collection: connected
+ * and streaming, not readable, and with no pending request, reassembled
+ * INFO response, keepalive or network timeout that requires sl_collect()
+ * to be called.  TLS connections are never idle as data may be buffered
+ * by the TLS layer.
+ *
+ * Returns 1 if the member is idle, otherwise 0.
+ ***************************************************************************/
+static int
+member_idle (const SLCGmember *member, int64_t current_time)
+{
+  const SLCD *slconn = member->slconn;
+
+  if (member->ready || slconn->link == -1 || slconn->tlsctx ||
+      slconn->terminate || slconn->info || slconn->infoready ||
+      slconn->stat->conn_state != STREAMING)
+    return 0;
+
+  if (slconn->netto && slconn->stat->netto_time &&
+      slconn->stat->netto_time < current_time)
+    return 0;
+
+  if (slconn->keepalive && slconn->stat->keepalive_time &&
+      slconn->stat->keepalive_time < current_time)
+    return 0;
+
+  return 1;
+} /* End of member_idle() */
+
+/***************************************************************************
+ * member_limited:
+ *
+ * Determine if a member is backfilling and subject to the shared rate
+ * limit: a group-managed backfill connection, in dial-up mode, with a
+ * time window, or requesting all data for any stream when added.
+ *
+ * Returns 1 if the member is backfilling, otherwise 0.
+ ***************************************************************************/
+static int
+member_limited (const SLCGmember *member)
+{
+  return (member->backfill || member->alldata ||
+          member->slconn->dialup || member->slconn->start_time) ? 1 : 0;
+} /* End of member_limited() */
+
+/***************************************************************************
+ * ratelimit_engaged:
+ *
+ * Determine if the shared rate limit applies to backfilling members,
+ * either always or when the data of any live member lags behind the
+ * current time by more than the maximum lag or has not been received.
+ *
+ * Returns 1 if the rate limit is engaged, otherwise 0.
+ ***************************************************************************/
+static int
+ratelimit_engaged (SLCG *group, int64_t current_time)
+{
+  const SLCGmember *member;
+  uint32_t idx;
+
+  if (group->ratelimit.rate == 0)
+    return 0;
+
+  if (group->maxlag <= 0)
+    return 1;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    member = &group->members[idx];
+
+    if (member->finished || member->primary || member_limited (member))
+      continue;
+
+    /* Live members without data yet are assumed to lag */
+    if (member->datatime == 0 ||
+        current_time - member->datatime > SL_EPOCH2SLTIME (group->maxlag))
+      return 1;
+  }
+
+  return 0;
+} /* End of ratelimit_engaged() */
+
+/***************************************************************************
+ * member_register:
+ *
+ * Register the socket of a member for polling with epoll, using the
+ * member index as event data.  Closed sockets are removed from the
+ * epoll set by the kernel, so only the new socket is registered.
+ * Nothing is done when select() is used.
+ ***************************************************************************/
+static void
+member_register (SLCG *group, uint32_t idx)
+{
+#if defined(SLCG_EPOLL)
+  SLCGmember *member = &group->members[idx];
+  struct epoll_event event;
+
+  if (group->pollfd < 0)
+    return;
+
+  if (member->slconn->link == -1)
+  {
+    member->polled = -1;
+    return;
+  }
+
+#if defined(SLCG_URING)
+  /* Sockets receiving with io_uring are not polled */
+  if (member->uring)
+  {
+    epoll_ctl (group->pollfd, EPOLL_CTL_DEL, member->slconn->link, NULL);
+    member->polled = member->slconn->link;
+    return;
+  }
+#endif
+
+  /* Throttled members remain registered without readability events */
+  memset (&event, 0, sizeof (event));
+  event.events   = (member->throttled) ? 0 : EPOLLIN;
+  event.data.u32 = idx;
+
+  if (epoll_ctl (group->pollfd, EPOLL_CTL_MOD, member->slconn->link, &event) &&
+      (errno != ENOENT ||
+       epoll_ctl (group->pollfd, EPOLL_CTL_ADD, member->slconn->link, &event)))
+  {
+    sl_log_r (member->slconn, 2, 0, "[%s] %s(): cannot register socket for polling: %s\n",
+              member->slconn->sladdr, __func__, strerror (errno));
+
+    /* Collect unconditionally if polling is not possible */
+    member->ready  = 1;
+    member->polled = -1;
+    return;
+  }
+
+  member->polled = member->slconn->link;
+#else
+  (void)group;
+  (void)idx;
+#endif
+} /* End of member_register() */
+
+/***************************************************************************
+ * member_receive:
+ *
+ * Manage the io_uring receive of a member after collection.  A buffer
+ * that has been processed is returned to the ring, the receive is
+ * released when the connection was closed, and a receive is submitted
+ * for streaming plain TCP connections without rate limits.  Nothing is
+ * done when io_uring is not used.
+ ***************************************************************************/
+static void
+member_receive (SLCG *group, uint32_t idx)
+{
+#if defined(SLCG_URING)
+  SLCGmember *member = &group->members[idx];
+  SLCD *slconn       = member->slconn;
+  UringRecv *recv    = member->uring;
+  Uring *uring       = group->uring;
+  struct io_uring_sqe sqe;
+
+  if (uring == NULL)
+    return;
+
+  if (recv)
+  {
+    /* Return a processed buffer to the ring */
+    if (recv->lent != URING_NONE && slconn->extdatalen == 0)
+    {
+      uring_recycle (uring, recv->lent);
+      recv->lent      = URING_NONE;
+      slconn->extdata = NULL;
+    }
+
+    /* The connection was closed by sl_disconnect() */
+    if (!slconn->extrecv)
+      member_release (group, member);
+
+    return;
+  }
+
+  if (uring->unsupported || slconn->link == -1 || slconn->tlsctx ||
+      slconn->terminate || slconn->stat->conn_state != STREAMING ||
+      slconn->splicemode || slconn->ratelimit.rate || member->throttled ||
+      (group->ratelimit.rate && member_limited (member)))
+    return;
+
+  if ((recv = (UringRecv *)sl_malloc (sizeof (UringRecv))) == NULL)
+  {
+    sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+    return;
+  }
+
+  recv->member = idx;
+  recv->head   = URING_NONE;
+  recv->tail   = URING_NONE;
+  recv->lent   = URING_NONE;
+  recv->armed  = 1;
+  recv->closed = 0;
+  recv->error  = 0;
+
+  /* Multishot receive into buffers selected from the provided buffer ring */
+  memset (&sqe, 0, sizeof (sqe));
+  sqe.opcode    = IORING_OP_RECV;
+  sqe.fd        = slconn->link;
+  sqe.ioprio    = IORING_RECV_MULTISHOT;
+  sqe.flags     = IOSQE_BUFFER_SELECT;
+  sqe.buf_group = URING_BGID;
+  sqe.user_data = (uint64_t)(uintptr_t)recv;
+
+  if (uring_push (uring, &sqe) || uring_submit (uring))
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): cannot submit receive, polling with epoll\n",
+              slconn->sladdr, __func__);
+    sl_free (recv);
+    return;
+  }
+
+  recv->next      = uring->receives;
+  uring->receives = recv;
+
+  member->uring   = recv;
+  slconn->extrecv = 1;
+
+  /* Remove the socket from the epoll set */
+  member_register (group, idx);
+#else
+  (void)group;
+  (void)idx;
+#endif
+} /* End of member_receive() */
+
+/***************************************************************************
+ * member_provide:
+ *
+ * Provide the next buffer received with io_uring to the member
+ * connection when the previous buffer has been processed, returning
+ * the previous buffer to the ring.  At the end of the stream, after
+ * all received buffers, the connection is set to terminate as when
+ * closed by the server during recv().
+ *
+ * Returns 1 if data or the end of the stream was provided, otherwise 0.
+ ***************************************************************************/
+static int
+member_provide (SLCG *group, SLCGmember *member)
+{
+#if defined(SLCG_URING)
+  SLCD *slconn    = member->slconn;
+  UringRecv *recv = member->uring;
+  Uring *uring    = group->uring;
+  uint32_t bid;
+
+  if (uring == NULL || recv == NULL || !slconn->extrecv || slconn->extdatalen > 0)
+    return 0;
+
+  if (recv->lent != URING_NONE)
+  {
+    uring_recycle (uring, recv->lent);
+    recv->lent      = URING_NONE;
+    slconn->extdata = NULL;
+  }
+
+  if (recv->head != URING_NONE)
+  {
+    bid        = recv->head;
+    recv->head = uring->nextbuffer[bid];
+
+    if (recv->head == URING_NONE)
+      recv->tail = URING_NONE;
+
+    recv->lent         = bid;
+    slconn->extdata    = uring->buffers + (size_t)bid * uring->buffersize;
+    slconn->extdatalen = uring->bufferlength[bid];
+
+    return 1;
+  }
+
+  if (recv->closed == 1)
+  {
+    recv->closed = 2;
+
+    if (recv->error && recv->error != ECONNRESET)
+      sl_log_r (slconn, 2, 0, "[%s] %s(): receive error: %s\n",
+                slconn->sladdr, __func__, strerror (recv->error));
+
+    /* Set termination flag to initial state if connection was closed */
+    if (slconn->terminate == 0)
+      slconn->terminate = 1;
+
+    return 1;
+  }
+#else
+  (void)group;
+  (void)member;
+#endif
+
+  return 0;
+} /* End of member_provide() */
+
+/***************************************************************************
+ * member_received:
+ *
+ * Determine if a member has data received with io_uring that has not
+ * been processed, or an end of stream that has not been reported.
+ *
+ * Returns 1 if data or end of stream is pending, otherwise 0.
+ ***************************************************************************/
+static int
+member_received (const SLCGmember *member)
+{
+#if defined(SLCG_URING)
+  if (member->uring &&
+      (member->slconn->extdatalen > 0 || member->uring->head != URING_NONE ||
+       member->uring->closed == 1))
+    return 1;
+#else
+  (void)member;
+#endif
+
+  return 0;
+} /* End of member_received() */
+
+/***************************************************************************
+ * member_release:
+ *
+ * Release the io_uring receive of a member, returning all received
+ * buffers to the ring and cancelling the receive if still pending.  A
+ * pending receive is freed when its final completion is reaped.  The
+ * connection is no longer read by the group and is polled with epoll
+ * when registered again.
+ ***************************************************************************/
+static void
+member_release (SLCG *group, SLCGmember *member)
+{
+#if defined(SLCG_URING)
+  UringRecv *recv = member->uring;
+  Uring *uring    = group->uring;
+  UringRecv **prev;
+  struct io_uring_sqe sqe;
+  uint32_t bid;
+
+  if (uring == NULL || recv == NULL)
+    return;
+
+  if (recv->lent != URING_NONE)
+    uring_recycle (uring, recv->lent);
+
+  while ((bid = recv->head) != URING_NONE)
+  {
+    recv->head = uring->nextbuffer[bid];
+    uring_recycle (uring, bid);
+  }
+
+  recv->lent   = URING_NONE;
+  recv->tail   = URING_NONE;
+  recv->member = URING_NONE;
+
+  if (recv->armed)
+  {
+    memset (&sqe, 0, sizeof (sqe));
+    sqe.opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe.addr      = (uint64_t)(uintptr_t)recv;
+    sqe.user_data = 0;
+
+    if (uring_push (uring, &sqe) == 0)
+      uring_submit (uring);
+  }
+  else
+  {
+    for (prev = &uring->receives; *prev; prev = &(*prev)->next)
+    {
+      if (*prev == recv)
+      {
+        *prev = recv->next;
+        break;
+      }
+    }
+
+    sl_free (recv);
+  }
+
+  member->uring              = NULL;
+  member->polled             = -1;
+  member->slconn->extrecv    = 0;
+  member->slconn->extdata    = NULL;
+  member->slconn->extdatalen = 0;
+#else
+  (void)group;
+  (void)member;
+#endif
+} /* End of member_release() */
+
+#if defined(SLCG_URING)
+/***************************************************************************
+ * uring_init:
+ *
+ * Set up an io_uring instance and register a ring of provided receive
+ * buffers, then add the io_uring descriptor to the epoll set so that
+ * completions wake sl_group_poll().
+ *
+ * Returns 0 on success and -1 if io_uring cannot be used.
+ ***************************************************************************/
+static int
+uring_init (SLCG *group, uint32_t buffers, uint32_t buffersize)
+{
+  struct io_uring_params params;
+  struct io_uring_buf_reg reg;
+  struct epoll_event event;
+  Uring *uring;
+  uint32_t bid;
+
+  if ((uring = (Uring *)sl_malloc (sizeof (Uring))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  memset (uring, 0, sizeof (Uring));
+  uring->sqring  = MAP_FAILED;
+  uring->cqring  = MAP_FAILED;
+  uring->sqes    = MAP_FAILED;
+  uring->bufring = MAP_FAILED;
+
+  /* Completions include one per filled buffer */
+  memset (&params, 0, sizeof (params));
+  params.flags      = IORING_SETUP_CQSIZE;
+  params.cq_entries = (buffers * 2 > URING_ENTRIES * 4) ? buffers * 2 : URING_ENTRIES * 4;
+
+  if ((uring->fd = (int)syscall (__NR_io_uring_setup, URING_ENTRIES, &params)) < 0)
+  {
+    sl_log_r (NULL, 1, 1, "%s(): io_uring unavailable, using epoll: %s\n",
+              __func__, strerror (errno));
+    sl_free (uring);
+    return -1;
+  }
+
+  group->uring = uring;
+
+  uring->sqringsize = params.sq_off.array + params.sq_entries * sizeof (uint32_t);
+  uring->cqringsize = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+  uring->sqessize   = params.sq_entries * sizeof (struct io_uring_sqe);
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (uring->cqringsize > uring->sqringsize)
+      uring->sqringsize = uring->cqringsize;
+    uring->cqringsize = 0;
+  }
+
+  uring->sqring = mmap (NULL, uring->sqringsize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING);
+
+  if (uring->sqring != MAP_FAILED && uring->cqringsize == 0)
+    uring->cqring = uring->sqring;
+  else if (uring->sqring != MAP_FAILED)
+    uring->cqring = mmap (NULL, uring->cqringsize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_CQ_RING);
+
+  if (uring->cqring != MAP_FAILED)
+    uring->sqes = (struct io_uring_sqe *)mmap (NULL, uring->sqessize, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, uring->fd,
+                                               IORING_OFF_SQES);
+
+  if (uring->sqes == MAP_FAILED)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): cannot map io_uring queues: %s\n", __func__, strerror (errno));
+    uring_free (group);
+    return -1;
+  }
+
+  uring->sqhead    = (uint32_t *)((char *)uring->sqring + params.sq_off.head);
+  uring->sqtail    = (uint32_t *)((char *)uring->sqring + params.sq_off.tail);
+  uring->sqflags   = (uint32_t *)((char *)uring->sqring + params.sq_off.flags);
+  uring->sqarray   = (uint32_t *)((char *)uring->sqring + params.sq_off.array);
+  uring->sqmask    = *(uint32_t *)((char *)uring->sqring + params.sq_off.ring_mask);
+  uring->sqentries = params.sq_entries;
+  uring->cqhead    = (uint32_t *)((char *)uring->cqring + params.cq_off.head);
+  uring->cqtail    = (uint32_t *)((char *)uring->cqring + params.cq_off.tail);
+  uring->cqmask    = *(uint32_t *)((char *)uring->cqring + params.cq_off.ring_mask);
+  uring->cqes      = (struct io_uring_cqe *)((char *)uring->cqring + params.cq_off.cqes);
+
+  /* Provided buffer ring, page aligned as required by the kernel */
+  uring->bufringsize = buffers * sizeof (struct io_uring_buf);
+  uring->bufring     = (struct io_uring_buf_ring *)mmap (NULL, uring->bufringsize,
+                                                         PROT_READ | PROT_WRITE,
+                                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  uring->buffercount  = buffers;
+  uring->buffersize   = buffersize;
+  uring->buffers      = (uint8_t *)sl_malloc ((size_t)buffers * buffersize);
+  uring->nextbuffer   = (uint32_t *)sl_malloc (buffers * sizeof (uint32_t));
+  uring->bufferlength = (uint32_t *)sl_malloc (buffers * sizeof (uint32_t));
+
+  if (uring->bufring == MAP_FAILED || uring->buffers == NULL ||
+      uring->nextbuffer == NULL || uring->bufferlength == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating receive buffers\n", __func__);
+    uring_free (group);
+    return -1;
+  }
+
+  memset (&reg, 0, sizeof (reg));
+  reg.ring_addr    = (uint64_t)(uintptr_t)uring->bufring;
+  reg.ring_entries = buffers;
+  reg.bgid         = URING_BGID;
+
+  if (syscall (__NR_io_uring_register, uring->fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+  {
+    sl_log_r (NULL, 1, 1, "%s(): provided buffer rings unavailable, using epoll: %s\n",
+              __func__, strerror (errno));
+    uring_free (group);
+    return -1;
+  }
+
+  for (bid = 0; bid < buffers; bid++)
+    uring_recycle (uring, bid);
+
+  memset (&event, 0, sizeof (event));
+  event.events   = EPOLLIN;
+  event.data.u32 = URING_EVENT;
+
+  if (epoll_ctl (group->pollfd, EPOLL_CTL_ADD, uring->fd, &event))
+  {
+    sl_log_r (NULL, 2, 0, "%s(): cannot register io_uring for polling: %s\n",
+              __func__, strerror (errno));
+    uring_free (group);
+    return -1;
+  }
+
+  return 0;
+} /* End of uring_init() */
+
+/***************************************************************************
+ * uring_free:
+ *
+ * Close the io_uring instance of a group, which cancels all pending
+ * receives, and free the buffers and receives.  Members must have been
+ * released.
+ ***************************************************************************/
+static void
+uring_free (SLCG *group)
+{
+  Uring *uring = group->uring;
+  UringRecv *recv;
+
+  if (uring == NULL)
+    return;
+
+  if (uring->fd >= 0)
+    close (uring->fd);
+
+  if (uring->sqes != MAP_FAILED)
+    munmap (uring->sqes, uring->sqessize);
+  if (uring->cqring != MAP_FAILED && uring->cqring != uring->sqring)
+    munmap (uring->cqring, uring->cqringsize);
+  if (uring->sqring != MAP_FAILED)
+    munmap (uring->sqring, uring->sqringsize);
+  if (uring->bufring != MAP_FAILED)
+    munmap (uring->bufring, uring->bufringsize);
+
+  while (uring->receives)
+  {
+    recv            = uring->receives;
+    uring->receives = recv->next;
+    sl_free (recv);
+  }
+
+  sl_free (uring->buffers);
+  sl_free (uring->nextbuffer);
+  sl_free (uring->bufferlength);
+  sl_free (uring);
+
+  group->uring = NULL;
+} /* End of uring_free() */
+
+/***************************************************************************
+ * uring_reap:
+ *
+ * Process io_uring completions.  Filled buffers are queued in order for
+ * the receiving member, which is marked ready, and buffers received for
+ * released receives are returned to the ring.  Receives ended for lack
+ * of buffers are submitted again when buffers are available.
+ ***************************************************************************/
+static void
+uring_reap (SLCG *group)
+{
+  Uring *uring = group->uring;
+  struct io_uring_cqe *cqe;
+  UringRecv *recv;
+  UringRecv **prev;
+  struct io_uring_sqe sqe;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t bid;
+
+  do
+  {
+    head = *uring->cqhead;
+    tail = __atomic_load_n (uring->cqtail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++)
+    {
+      cqe  = &uring->cqes[head & uring->cqmask];
+      recv = (UringRecv *)(uintptr_t)cqe->user_data;
+
+      /* Completions of cancellations */
+      if (recv == NULL)
+        continue;
+
+      bid = URING_NONE;
+      if (cqe->flags & IORING_CQE_F_BUFFER)
+      {
+        bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        uring->available--;
+      }
+
+      if (recv->member != URING_NONE && cqe->res > 0 && bid != URING_NONE)
+      {
+        uring->nextbuffer[bid]   = URING_NONE;
+        uring->bufferlength[bid] = (uint32_t)cqe->res;
+
+        if (recv->tail == URING_NONE)
+          recv->head = bid;
+        else
+          uring->nextbuffer[recv->tail] = bid;
+
+        recv->tail      = bid;
+        uring->received = 1;
+
+        group->members[recv->member].ready = 1;
+      }
+      else
+      {
+        if (bid != URING_NONE)
+          uring_recycle (uring, bid);
+
+        /* Multishot receive not supported if no data was ever received */
+        if (cqe->res == -EINVAL && !uring->received)
+        {
+          uring->unsupported = 1;
+        }
+        else if (recv->member != URING_NONE && cqe->res != -ENOBUFS && cqe->res <= 0)
+        {
+          recv->closed = 1;
+          recv->error  = -cqe->res;
+
+          group->members[recv->member].ready = 1;
+        }
+      }
+
+      /* Final completion of the receive */
+      if (!(cqe->flags & IORING_CQE_F_MORE))
+      {
+        recv->armed = 0;
+
+        if (recv->member == URING_NONE)
+        {
+          for (prev = &uring->receives; *prev; prev = &(*prev)->next)
+          {
+            if (*prev == recv)
+            {
+              *prev = recv->next;
+              break;
+            }
+          }
+
+          sl_free (recv);
+        }
+        else if (!recv->closed)
+        {
+          uring->rearm = 1;
+        }
+      }
+    }
+
+    __atomic_store_n (uring->cqhead, head, __ATOMIC_RELEASE);
+
+    /* Flush completions that overflowed the completion queue */
+    if (__atomic_load_n (uring->sqflags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)
+      syscall (__NR_io_uring_enter, uring->fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+  } while (head != __atomic_load_n (uring->cqtail, __ATOMIC_ACQUIRE));
+
+  if (uring->unsupported)
+  {
+    uring_fallback (group);
+    return;
+  }
+
+  /* Submit receives again that ended when no buffers were available */
+  if (uring->rearm && uring->available > 0)
+  {
+    uring->rearm = 0;
+
+    for (recv = uring->receives; recv; recv = recv->next)
+    {
+      if (recv->armed || recv->closed || recv->member == URING_NONE)
+        continue;
+
+      memset (&sqe, 0, sizeof (sqe));
+      sqe.opcode    = IORING_OP_RECV;
+      sqe.fd        = group->members[recv->member].slconn->link;
+      sqe.ioprio    = IORING_RECV_MULTISHOT;
+      sqe.flags     = IOSQE_BUFFER_SELECT;
+      sqe.buf_group = URING_BGID;
+      sqe.user_data = (uint64_t)(uintptr_t)recv;
+
+      if (uring_push (uring, &sqe))
+      {
+        uring->rearm = 1;
+        break;
+      }
+
+      recv->armed = 1;
+    }
+
+    uring_submit (uring);
+  }
+} /* End of uring_reap() */
+
+/***************************************************************************
+ * uring_fallback:
+ *
+ * Release all members and close the io_uring instance when multishot
+ * receive is not supported by the kernel, members are polled with
+ * epoll instead.  No data has been received with io_uring.
+ ***************************************************************************/
+static void
+uring_fallback (SLCG *group)
+{
+  uint32_t idx;
+
+  sl_log_r (NULL, 1, 1, "%s(): multishot receive not supported, using epoll\n", __func__);
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    if (group->members[idx].uring)
+    {
+      member_release (group, &group->members[idx]);
+      group->members[idx].ready = 1;
+    }
+  }
+
+  uring_free (group);
+} /* End of uring_fallback() */
+
+/***************************************************************************
+ * uring_push:
+ *
+ * Queue a submission queue entry, submitting queued entries first if
+ * the queue is full.
+ *
+ * Returns 0 on success and -1 if the queue is full.
+ ***************************************************************************/
+static int
+uring_push (Uring *uring, const struct io_uring_sqe *sqe)
+{
+  uint32_t tail = *uring->sqtail;
+  uint32_t index;
+
+  if (tail - __atomic_load_n (uring->sqhead, __ATOMIC_ACQUIRE) >= uring->sqentries)
+  {
+    uring_submit (uring);
+
+    if (tail - __atomic_load_n (uring->sqhead, __ATOMIC_ACQUIRE) >= uring->sqentries)
+      return -1;
+  }
+
+  index              = tail & uring->sqmask;
+  uring->sqes[index] = *sqe;
+  uring->sqarray[index] = index;
+
+  __atomic_store_n (uring->sqtail, tail + 1, __ATOMIC_RELEASE);
+  uring->pending++;
+
+  return 0;
+} /* End of uring_push() */
+
+/***************************************************************************
+ * uring_submit:
+ *
+ * Submit all queued submission queue entries.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+uring_submit (Uring *uring)
+{
+  long submitted;
+
+  while (uring->pending > 0)
+  {
+    submitted = syscall (__NR_io_uring_enter, uring->fd, uring->pending, 0, 0, NULL, 0);
+
+    if (submitted < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      /* Resources are temporarily exhausted, entries remain queued */
+      if (errno == EAGAIN || errno == EBUSY)
+        return 0;
+
+      sl_log_r (NULL, 2, 0, "%s(): cannot submit to io_uring: %s\n", __func__, strerror (errno));
+      return -1;
+    }
+
+    uring->pending -= (uint32_t)submitted;
+  }
+
+  return 0;
+} /* End of uring_submit() */
+
+/***************************************************************************
+ * uring_recycle:
+ *
+ * Return a receive buffer to the provided buffer ring.
+ ***************************************************************************/
+static void
+uring_recycle (Uring *uring, uint32_t bid)
+{
+  struct io_uring_buf *buf;
+
+  buf       = &uring->bufring->bufs[uring->buffertail & (uring->buffercount - 1)];
+  buf->addr = (uint64_t)(uintptr_t)(uring->buffers + (size_t)bid * uring->buffersize);
+  buf->len  = uring->buffersize;
+  buf->bid  = (uint16_t)bid;
+
+  uring->buffertail++;
+  uring->available++;
+
+  __atomic_store_n (&uring->bufring->tail, (uint16_t)uring->buffertail, __ATOMIC_RELEASE);
+} /* End of uring_recycle() */
+#endif /* SLCG_URING */
+
+/***************************************************************************
+ * backfill_connection:
+ *
+ * Create a dial-up connection for a backfill request, copying the
+ * connection parameters and the station's selectors from the primary
+ * connection.  The stream is set to resume after the sequence number
+ * preceding the requested range.
+ *
+ * Returns a new ::SLCD on success and NULL on error.
+ ***************************************************************************/
+static SLCD *
+backfill_connection (const BackfillRequest *request)
+{
+  const SLCD *primary = request->primary;
+  SLstream *stream;
+  SLCD *slconn;
+
+  /* Find stream list entry matching the station in the primary connection */
+  for (stream = primary->streams; stream; stream = stream->next)
+  {
+    if (sl_globmatch ((char *)request->stationid, stream->stationid))
+      break;
+  }
+
+  if (stream == NULL)
+    return NULL;
+
+  if ((slconn = copy_connection (primary)) == NULL)
+    return NULL;
+
+  if (sl_set_dialupmode (slconn, 1) ||
+      sl_add_stream (slconn, request->stationid, stream->selectors,
+                     request->firstseq - 1, NULL))
+  {
+    sl_freeslcd (slconn);
+    return NULL;
+  }
+
+  return slconn;
+} /* End of backfill_connection() */
+
+/***************************************************************************
+ * copy_connection:
+ *
+ * Create a new connection with the server address, TLS mode,
+ * authentication, timeout, logging and client-side filter parameters
+ * copied from the primary connection.  The stream list is empty.
+ *
+ * Returns a new ::SLCD on success and NULL on error.
+ ***************************************************************************/
+static SLCD *
+copy_connection (const SLCD *primary)
+{
+  SLCD *slconn;
+  const char *pattern;
+  size_t length;
+
+  if ((slconn = sl_initslcd (primary->clientname, primary->clientversion)) == NULL)
+    return NULL;
+
+  /* Copy logging parameters, owned by each connection */
+  if (primary->log)
+  {
+    if ((slconn->log = (SLlog *)sl_malloc (sizeof (SLlog))) == NULL)
+    {
+      sl_freeslcd (slconn);
+      return NULL;
+    }
+
+    memcpy (slconn->log, primary->log, sizeof (SLlog));
+  }
+
+  /* Copy packed filter patterns, terminated by an empty pattern */
+  if (primary->filter)
+  {
+    for (pattern = primary->filter; *pattern; pattern += strlen (pattern) + 1)
+      ;
+
+    length = pattern - primary->filter + 1;
+
+    if ((slconn->filter = (char *)sl_malloc (length)) == NULL)
+    {
+      sl_freeslcd (slconn);
+      return NULL;
+    }
+
+    memcpy (slconn->filter, primary->filter, length);
+  }
+
+  if (sl_set_serveraddress (slconn, primary->sladdr) ||
+      sl_set_tlsmode (slconn, primary->tls) ||
+      sl_set_auth_params (slconn, primary->auth_value, primary->auth_finish, primary->auth_data) ||
+      sl_set_keepalive (slconn, primary->keepalive) ||
+      sl_set_iotimeout (slconn, primary->iotimeout) ||
+      sl_set_idletimeout (slconn, primary->netto) ||
+      sl_set_reconnectdelay (slconn, primary->netdly))
+  {
+    sl_freeslcd (slconn);
+    return NULL;
+  }
+
+  return slconn;
+} /* End of copy_connection() */
+
+/***************************************************************************
+ * find_auxiliary:
+ *
+ * Find an auxiliary member for the primary connection that has not
+ * yet connected, to which further streams can be added.
+ *
+ * Returns the member if found, otherwise NULL.
+ ***************************************************************************/
+static SLCGmember *
+find_auxiliary (SLCG *group, const SLCD *primary)
+{
+  SLCGmember *member;
+  uint32_t idx;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    member = &group->members[idx];
+
+    if (member->primary == primary && !member->finished &&
+        member->slconn->link == -1 &&
+        member->slconn->stat->conn_state == DOWN &&
+        !member->slconn->terminate)
+      return member;
+  }
+
+  return NULL;
+} /* End of find_auxiliary() */
+
+/***************************************************************************
+ * merge_auxiliary:
+ *
+ * Merge the streams of stable auxiliary members into the stream list
+ * of a primary connection that is about to reconnect, so that they are
+ * negotiated along with the existing streams.  Auxiliary members are
+ * stable once negotiation has succeeded and they are streaming.
+ *
+ * The sequence numbers and time stamps of the last packets returned
+ * from the auxiliary connection are carried over and the auxiliary
+ * connection is closed, the primary resumes each stream without gaps
+ * or duplicates.  Auxiliary members that are not yet streaming are
+ * left running and merged at a later reconnect.
+ ***************************************************************************/
+static void
+merge_auxiliary (SLCG *group, SLCGmember *primary)
+{
+  SLCGmember *member;
+  SLstream *stream;
+  uint32_t idx;
+  int merged;
+
+  for (idx = 0; idx < group->membercount; idx++)
+  {
+    member = &group->members[idx];
+
+    if (member->primary != primary->slconn || member->finished ||
+        member->slconn->link == -1 ||
+        member->slconn->stat->conn_state != STREAMING)
+      continue;
+
+    merged = 0;
+    for (stream = member->slconn->streams; stream; stream = stream->next)
+    {
+      if (sl_add_stream (primary->slconn, stream->stationid, stream->selectors,
+                         stream->seqnum, (stream->timestamp[0]) ? stream->timestamp : NULL))
+      {
+        sl_log_r (primary->slconn, 2, 0, "[%s] %s(): cannot merge stream %s, left on auxiliary connection\n",
+                  primary->slconn->sladdr, __func__, stream->stationid);
+        break;
+      }
+
+      merged++;
+    }
+
+    /* Streams already merged are now negotiated by the primary */
+    while (merged-- > 0)
+      sl_remove_stream (member->slconn, member->slconn->streams->stationid);
+
+    if (stream != NULL)
+      continue;
+
+    sl_log_r (primary->slconn, 1, 1, "[%s] Merged streams of auxiliary connection\n",
+              primary->slconn->sladdr);
+
+    sl_disconnect (member->slconn);
+    member->finished = 1;
+  }
+} /* End of merge_auxiliary() */
+
+/***************************************************************************
+ * backfill_gap_handler:
+ *
+ * Gap handler set for group members when automatic backfill is enabled,
+ * queues a backfill request for the missing range.
+ ***************************************************************************/
+static void
+backfill_gap_handler (SLCD *slconn, const char *stationid,
+                      uint64_t firstseq, uint64_t lastseq,
+                      void *gap_data)
+{
+  sl_group_backfill ((SLCG *)gap_data, slconn, stationid, firstseq, lastseq);
+} /* End of backfill_gap_handler() */
+
+/***************************************************************************
+ * dedup_check:
+ *
+ * Check if a record has been seen before by searching the window of
+ * record keys for the station.  Records not yet seen are added to the
+ * window, replacing the oldest entry.
+ *
+ * Payloads that are not miniSEED or cannot be parsed are never
+ * considered duplicates.
+ *
+ * Returns 1 if the record is a duplicate, otherwise 0.
+ ***************************************************************************/
+static int
+dedup_check (SLCG *group, const SLCD *slconn,
+             const SLpacketinfo *packetinfo, const char *payload)
+{
+  DedupStation *station;
+  char sourceid[64] = {0};
+  int64_t starttime;
+  uint64_t key;
+  uint32_t bucket;
+  uint32_t idx;
+
+  if (packetinfo->payloadformat != SLPAYLOAD_MSEED2 &&
+      packetinfo->payloadformat != SLPAYLOAD_MSEED3)
+    return 0;
+
+  starttime = sl_payload_starttime (slconn->log, packetinfo, payload,
+                                    packetinfo->payloadlength);
+
+  if (starttime == SLTERROR ||
+      sl_payload_info (slconn->log, packetinfo, payload, packetinfo->payloadlength,
+                       sourceid, sizeof (sourceid), NULL, 0, NULL, NULL) == -1)
+  {
+    return 0;
+  }
+
+  /* Key is a hash of the source identifier and start time, 0 is reserved for unused */
+  key = hash_fnv1a (UINT64_C (14695981039346656037), sourceid, strlen (sourceid));
+  key = hash_fnv1a (key, &starttime, sizeof (starttime));
+
+  if (key == 0)
+    key = 1;
+
+  /* Find or create per-station window */
+  bucket = (uint32_t)(hash_fnv1a (UINT64_C (14695981039346656037),
+                                  packetinfo->stationid,
+                                  strlen (packetinfo->stationid)) %
+                      DEDUP_BUCKETS);
+
+  for (station = group->dedup[bucket]; station; station = station->chain)
+  {
+    if (strcmp (station->stationid, packetinfo->stationid) == 0)
+      break;
+  }
+
+  if (station == NULL)
+  {
+    station = (DedupStation *)sl_calloc (1, sizeof (DedupStation) +
+                                             sizeof (uint64_t) * group->dedupwindow);
+
+    if (station == NULL)
+    {
+      sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+      return 0;
+    }
+
+    strncpy (station->stationid, packetinfo->stationid, sizeof (station->stationid) - 1);
+    station->chain       = group->dedup[bucket];
+    group->dedup[bucket] = station;
+  }
+
+  /* Search window for record key */
+  for (idx = 0; idx < group->dedupwindow; idx++)
+  {
+    if (station->keys[idx] == key)
+      return 1;
+  }
+
+  /* Add record key to window, replacing oldest */
+  station->keys[station->next] = key;
+  station->next = (station->next + 1) % group->dedupwindow;
+
+  return 0;
+} /* End of dedup_check() */
+
+/***************************************************************************
+ * dedup_free:
+ *
+ * Free the deduplication table and all per-station windows, disabling
+ * deduplication.  The count of duplicates discarded is logged.
+ ***************************************************************************/
+static void
+dedup_free (SLCG *group)
+{
+  DedupStation *station;
+  DedupStation *nextstation;
+  uint32_t idx;
+
+  if (group->dedup == NULL)
+    return;
+
+  if (group->duplicates > 0)
+    sl_log_r (NULL, 1, 1, "Connection group discarded %" PRIu64 " duplicate record(s)\n",
+              group->duplicates);
+
+  for (idx = 0; idx < DEDUP_BUCKETS; idx++)
+  {
+    station = group->dedup[idx];
+
+    while (station)
+    {
+      nextstation = station->chain;
+      sl_free (station);
+      station = nextstation;
+    }
+  }
+
+  sl_free (group->dedup);
+
+  group->dedup       = NULL;
+  group->dedupwindow = 0;
+  group->duplicates  = 0;
+} /* End of dedup_free() */
+
+/***************************************************************************
+ * hash_fnv1a:
+ *
+ * Continue a 64-bit FNV-1a hash over the specified data.
+ ***************************************************************************/
+static uint64_t
+hash_fnv1a (uint64_t hash, const void *data, size_t length)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  size_t idx;
+
+  for (idx = 0; idx < length; idx++)
+  {
+    hash ^= bytes[idx];
+    hash *= UINT64_C (1099511628211);
+  }
+
+  return hash;
+} /* End of hash_fnv1a() */
@@ -0,0 +1,943 @@
+/***************************************************************************
+ * inventory.c
+ *
+ * Routines for parsing SeedLink v4 JSON INFO responses into a station
+ * and stream inventory.
+ *
+ * The parser is a streaming tokenizer that does not allocate memory
+ * while parsing, input may be supplied in any number of segments.
+ * Station and stream entries are stored in a single arena, stations
+ * from the front and streams from the back, that is only grown when
+ * exhausted.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globmatch.h"
+#include "libslink.h"
+
+/* Maximum JSON nesting depth tracked, deeper structures are an error */
+#define INV_MAX_DEPTH 16
+
+/* Maximum length of keys and scalar values retained, longer are truncated */
+#define INV_MAX_TOKEN 256
+#define INV_MAX_KEY   24
+
+/* Semantic context of a JSON container */
+typedef enum
+{
+  CTX_OTHER,          /* Ignored container */
+  CTX_ROOT,           /* Root object */
+  CTX_STATIONS,       /* Array of station objects */
+  CTX_STATION,        /* Station object */
+  CTX_STREAMS,        /* Array of stream objects */
+  CTX_STREAM          /* Stream object */
+} InvContext;
+
+/* Lexer state */
+typedef enum
+{
+  LEX_NONE,           /* Between tokens */
+  LEX_STRING,         /* In string */
+  LEX_ESCAPE,         /* After backslash in string */
+  LEX_UNICODE,        /* In \uXXXX escape */
+  LEX_SCALAR          /* In number or literal */
+} InvLexer;
+
+/* Parse stack level */
+typedef struct InvLevel
+{
+  InvContext context;
+  int8_t isobject;    /* Container is an object, otherwise array */
+  int8_t expectkey;   /* Object is expecting a key */
+  char key[INV_MAX_KEY]; /* Most recent key in object */
+} InvLevel;
+
+/* Parser state, preserved between input segments */
+struct SLinvparser
+{
+  InvLevel stack[INV_MAX_DEPTH];
+  int depth;
+  InvLexer lexer;
+  char token[INV_MAX_TOKEN];
+  uint32_t tokenlength;
+  uint32_t unicode;   /* Code point of \u escape being parsed */
+  int unicodedigits;  /* Digits of \u escape parsed */
+  int8_t stationsreset; /* Station table has been reset for this document */
+  int8_t error;       /* Parse error, input ignored until reset */
+  uint32_t station;   /* Index of current station */
+  size_t stationsused; /* Bytes of arena used by stations */
+  size_t streamsused;  /* Bytes of arena used by streams */
+};
+
+static int arena_reserve (SLinventory *inv, const SLlog *log, size_t size);
+static int token_value (SLinventory *inv, const SLlog *log, int isstring);
+static int container_start (SLinventory *inv, const SLlog *log, int isobject);
+static void inventory_finish (SLinventory *inv);
+static void token_append (struct SLinvparser *parser, char c);
+static int64_t parse_isotime (const char *isotime);
+static int compare_stations (const void *a, const void *b);
+static int compare_streams (const void *a, const void *b);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new ::SLinventory
+ *
+ * Allocate a new, empty inventory and an arena of \a arenasize bytes
+ * for station and stream entries.  The arena is grown if exhausted,
+ * an appropriate initial size avoids reallocation during parsing.
+ * Each station requires sizeof(::SLinvstation) and each stream
+ * sizeof(::SLinvstream) bytes.
+ *
+ * @param[in] arenasize  Initial size of arena in bytes, 0 for a default
+ *
+ * @returns An initialized ::SLinventory on success, NULL on error.
+ ***************************************************************************/
+SLinventory *
+sl_initslinventory (size_t arenasize)
+{
+  SLinventory *inv;
+
+  if (arenasize == 0)
+    arenasize = 65536;
+
+  inv = (SLinventory *)sl_malloc (sizeof (SLinventory));
+
+  if (inv == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (inv, 0, sizeof (SLinventory));
+
+  inv->parser = (struct SLinvparser *)sl_malloc (sizeof (struct SLinvparser));
+  inv->arena  = (char *)sl_malloc (arenasize);
+
+  if (inv->parser == NULL || inv->arena == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_freeslinventory (inv);
+    return NULL;
+  }
+
+  inv->arenasize = arenasize;
+
+  memset (inv->parser, 0, sizeof (struct SLinvparser));
+
+  return inv;
+} /* End of sl_initslinventory() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a ::SLinventory
+ *
+ * @param[in] inv  Inventory to free
+ ***************************************************************************/
+void
+sl_freeslinventory (SLinventory *inv)
+{
+  if (!inv)
+    return;
+
+  sl_free (inv->arena);
+  sl_free (inv->parser);
+  sl_free (inv);
+} /* End of sl_freeslinventory() */
+
+/**********************************************************************/ /**
+ * @brief Parse a v4 JSON INFO response into a ::SLinventory
+ *
+ * Parse a segment of a JSON INFO response, e.g. a payload returned by
+ * sl_collect() with format ::SLPAYLOAD_JSON and subformat
+ * ::SLPAYLOAD_JSON_INFO.  A response may be supplied in any number of
+ * segments, such as returned in chunked mode, see sl_set_chunkmode().
+ * When the final segment of a response has been parsed the station and
+ * stream tables are sorted and ready for use, and 1 is returned.
+ *
+ * Responses to INFO ID, STATIONS and STREAMS requests are recognized.
+ * The `software` and `organization` values are retained from any
+ * response.  A response containing a `station` list replaces the
+ * station and stream tables, other responses, e.g. INFO ID or
+ * CONNECTIONS, leave the tables unchanged.  Unrecognized values are
+ * ignored.
+ *
+ * No memory is allocated while parsing unless the arena is exhausted.
+ *
+ * @param[in] inv     Inventory to populate
+ * @param[in] log     Logging parameters, or NULL
+ * @param[in] json    JSON text segment
+ * @param[in] length  Length of JSON text segment
+ *
+ * @retval  1 : response complete, tables are ready
+ * @retval  0 : segment parsed, response not complete
+ * @retval -1 : error, parsing is reset
+ *
+ * @sa sl_inventory_reset()
+ ***************************************************************************/
+int
+sl_inventory_parse (SLinventory *inv, const SLlog *log,
+                    const char *json, uint32_t length)
+{
+  struct SLinvparser *parser;
+  InvLevel *level;
+  uint32_t idx;
+  char c;
+
+  if (!inv || (!json && length > 0))
+    return -1;
+
+  parser = inv->parser;
+
+  for (idx = 0; idx < length; idx++)
+  {
+    c = json[idx];
+
+    /* Process string characters */
+    if (parser->lexer == LEX_STRING)
+    {
+      if (c == '"')
+      {
+        parser->lexer = LEX_NONE;
+
+        if (token_value (inv, log, 1))
+          goto error;
+      }
+      else if (c == '\\')
+      {
+        parser->lexer = LEX_ESCAPE;
+      }
+      else
+      {
+        token_append (parser, c);
+      }
+
+      continue;
+    }
+    else if (parser->lexer == LEX_ESCAPE)
+    {
+      parser->lexer = LEX_STRING;
+
+      switch (c)
+      {
+      case 'b': token_append (parser, '\b'); break;
+      case 'f': token_append (parser, '\f'); break;
+      case 'n': token_append (parser, '\n'); break;
+      case 'r': token_append (parser, '\r'); break;
+      case 't': token_append (parser, '\t'); break;
+      case 'u':
+        parser->lexer         = LEX_UNICODE;
+        parser->unicode       = 0;
+        parser->unicodedigits = 0;
+        break;
+      default: token_append (parser, c); break;
+      }
+
+      continue;
+    }
+    else if (parser->lexer == LEX_UNICODE)
+    {
+      if (c >= '0' && c <= '9')
+        parser->unicode = (parser->unicode << 4) | (uint32_t)(c - '0');
+      else if (c >= 'a' && c <= 'f')
+        parser->unicode = (parser->unicode << 4) | (uint32_t)(c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F')
+        parser->unicode = (parser->unicode << 4) | (uint32_t)(c - 'A' + 10);
+      else
+      {
+        sl_log_rl (log, 2, 0, "%s(): invalid unicode escape in JSON\n", __func__);
+        goto error;
+      }
+
+      if (++parser->unicodedigits == 4)
+      {
+        parser->lexer = LEX_STRING;
+
+        /* Encode as UTF-8, surrogates are replaced */
+        if (parser->unicode < 0x80)
+        {
+          token_append (parser, (char)parser->unicode);
+        }
+        else if (parser->unicode < 0x800)
+        {
+          token_append (parser, (char)(0xC0 | (parser->unicode >> 6)));
+          token_append (parser, (char)(0x80 | (parser->unicode & 0x3F)));
+        }
+        else if (parser->unicode >= 0xD800 && parser->unicode <= 0xDFFF)
+        {
+          token_append (parser, '?');
+        }
+        else
+        {
+          token_append (parser, (char)(0xE0 | (parser->unicode >> 12)));
+          token_append (parser, (char)(0x80 | ((parser->unicode >> 6) & 0x3F)));
+          token_append (parser, (char)(0x80 | (parser->unicode & 0x3F)));
+        }
+      }
+
+      continue;
+    }
+    else if (parser->lexer == LEX_SCALAR)
+    {
+      if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+          c == '-' || c == '+' || c == '.' || c == 'E')
+      {
+        token_append (parser, c);
+        continue;
+      }
+
+      parser->lexer = LEX_NONE;
+
+      if (token_value (inv, log, 0))
+        goto error;
+
+      /* Fall through to process the terminating character */
+    }
+
+    /* Process structural characters */
+    switch (c)
+    {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      break;
+
+    case '{':
+    case '[':
+      if (container_start (inv, log, (c == '{')))
+        goto error;
+      break;
+
+    case '}':
+    case ']':
+      if (parser->depth == 0 ||
+          parser->stack[parser->depth - 1].isobject != (c == '}'))
+      {
+        sl_log_rl (log, 2, 0, "%s(): unbalanced JSON at '%c'\n", __func__, c);
+        goto error;
+      }
+
+      parser->depth--;
+
+      /* Root closed, response is complete */
+      if (parser->depth == 0)
+      {
+        inventory_finish (inv);
+        return 1;
+      }
+      break;
+
+    case ':':
+      if (parser->depth == 0 || !parser->stack[parser->depth - 1].isobject)
+      {
+        sl_log_rl (log, 2, 0, "%s(): unexpected ':' in JSON\n", __func__);
+        goto error;
+      }
+      break;
+
+    case ',':
+      if (parser->depth == 0)
+      {
+        sl_log_rl (log, 2, 0, "%s(): unexpected ',' in JSON\n", __func__);
+        goto error;
+      }
+
+      level = &parser->stack[parser->depth - 1];
+
+      if (level->isobject)
+        level->expectkey = 1;
+      break;
+
+    case '"':
+      if (parser->depth == 0)
+      {
+        sl_log_rl (log, 2, 0, "%s(): JSON response is not an object\n", __func__);
+        goto error;
+      }
+
+      parser->lexer       = LEX_STRING;
+      parser->tokenlength = 0;
+      break;
+
+    default:
+      if (parser->depth == 0)
+      {
+        sl_log_rl (log, 2, 0, "%s(): JSON response is not an object\n", __func__);
+        goto error;
+      }
+
+      parser->lexer       = LEX_SCALAR;
+      parser->tokenlength = 0;
+      token_append (parser, c);
+      break;
+    }
+  }
+
+  return 0;
+
+error:
+  sl_inventory_reset (inv);
+  return -1;
+} /* End of sl_inventory_parse() */
+
+/**********************************************************************/ /**
+ * @brief Reset the parser of a ::SLinventory
+ *
+ * Discard any partially parsed response, the next segment passed to
+ * sl_inventory_parse() is treated as the start of a new response.
+ * Tables from the last completed response are retained unless the
+ * partial response had started replacing them.
+ *
+ * @param[in] inv  Inventory to reset
+ ***************************************************************************/
+void
+sl_inventory_reset (SLinventory *inv)
+{
+  if (!inv)
+    return;
+
+  /* Discard partially populated tables */
+  if (inv->parser->stationsreset)
+  {
+    inv->stations     = NULL;
+    inv->stationcount = 0;
+    inv->streamcount  = 0;
+  }
+
+  memset (inv->parser, 0, sizeof (struct SLinvparser));
+} /* End of sl_inventory_reset() */
+
+/**********************************************************************/ /**
+ * @brief Find a station in a ::SLinventory
+ *
+ * @param[in] inv        Inventory to search
+ * @param[in] stationid  Station ID to find, e.g. "NET_STA"
+ *
+ * @returns Pointer to ::SLinvstation if found, otherwise NULL.
+ ***************************************************************************/
+const SLinvstation *
+sl_inventory_station (const SLinventory *inv, const char *stationid)
+{
+  SLinvstation key;
+
+  if (!inv || !stationid || inv->stationcount == 0)
+    return NULL;
+
+  memset (&key, 0, sizeof (key));
+  strncpy (key.stationid, stationid, sizeof (key.stationid) - 1);
+
+  return (const SLinvstation *)bsearch (&key, inv->stations, inv->stationcount,
+                                        sizeof (SLinvstation), compare_stations);
+} /* End of sl_inventory_station() */
+
+/**********************************************************************/ /**
+ * @brief Find a stream of a station in a ::SLinventory
+ *
+ * @param[in] station   Station to search, as returned by sl_inventory_station()
+ * @param[in] streamid  Stream ID to find, e.g. "00_B_H_Z"
+ * @param[in] format    Stream format, or 0 to match the first of any format
+ *
+ * @returns Pointer to ::SLinvstream if found, otherwise NULL.
+ ***************************************************************************/
+const SLinvstream *
+sl_inventory_stream (const SLinvstation *station, const char *streamid, char format)
+{
+  uint32_t low;
+  uint32_t high;
+  uint32_t mid;
+  int cmp;
+
+  if (!station || !streamid || station->streamcount == 0)
+    return NULL;
+
+  /* Find first entry not less than streamid */
+  low  = 0;
+  high = station->streamcount;
+  while (low < high)
+  {
+    mid = low + (high - low) / 2;
+
+    if (strcmp (station->streams[mid].streamid, streamid) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  /* Search entries with matching stream ID for format */
+  for (; low < station->streamcount; low++)
+  {
+    cmp = strcmp (station->streams[low].streamid, streamid);
+
+    if (cmp != 0)
+      break;
+
+    if (format == 0 || station->streams[low].format == format)
+      return &station->streams[low];
+  }
+
+  return NULL;
+} /* End of sl_inventory_stream() */
+
+/**********************************************************************/ /**
+ * @brief Select streams from a ::SLinventory with wildcard patterns
+ *
+ * Find all streams with a station ID matching \a stationpattern and
+ * a stream ID matching \a streampattern, using the same globbing
+ * wildcards (`*` and `?`) as stream selections.  Up to \a maxstreams
+ * matching streams are returned in \a streams, in sorted order.
+ *
+ * The owning station of each stream is available from the
+ * \a stationindex of the stream.
+ *
+ * @param[in]  inv             Inventory to search
+ * @param[in]  stationpattern  Station ID pattern, NULL matches all
+ * @param[in]  streampattern   Stream ID pattern, NULL matches all
+ * @param[out] streams         Array for matching streams, may be NULL to count
+ * @param[in]  maxstreams      Maximum entries in \a streams
+ *
+ * @returns The number of matching streams, which may be more than
+ * \a maxstreams.
+ ***************************************************************************/
+uint32_t
+sl_inventory_select (const SLinventory *inv,
+                     const char *stationpattern, const char *streampattern,
+                     const SLinvstream **streams, uint32_t maxstreams)
+{
+  SLinvstation *station;
+  uint32_t stationidx;
+  uint32_t streamidx;
+  uint32_t count = 0;
+
+  if (!inv)
+    return 0;
+
+  for (stationidx = 0; stationidx < inv->stationcount; stationidx++)
+  {
+    station = &inv->stations[stationidx];
+
+    if (stationpattern && !sl_globmatch (station->stationid, (char *)stationpattern))
+      continue;
+
+    for (streamidx = 0; streamidx < station->streamcount; streamidx++)
+    {
+      if (streampattern && !sl_globmatch (station->streams[streamidx].streamid, (char *)streampattern))
+        continue;
+
+      if (streams && count < maxstreams)
+        streams[count] = &station->streams[streamidx];
+
+      count++;
+    }
+  }
+
+  return count;
+} /* End of sl_inventory_select() */
+
+/***************************************************************************
+ * token_append:
+ *
+ * Append a character to the current token, characters beyond the
+ * maximum token length are discarded.
+ ***************************************************************************/
+static void
+token_append (struct SLinvparser *parser, char c)
+{
+  if (parser->tokenlength < INV_MAX_TOKEN - 1)
+    parser->token[parser->tokenlength++] = c;
+} /* End of token_append() */
+
+/***************************************************************************
+ * arena_reserve:
+ *
+ * Ensure the arena has space for an additional entry of the specified
+ * size, growing the arena if needed.  Streams at the back of the arena
+ * are moved to the end of a grown arena.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+arena_reserve (SLinventory *inv, const SLlog *log, size_t size)
+{
+  struct SLinvparser *parser = inv->parser;
+  size_t newsize;
+  char *newarena;
+
+  if (parser->stationsused + parser->streamsused + size <= inv->arenasize)
+    return 0;
+
+  newsize = inv->arenasize * 2;
+
+  while (parser->stationsused + parser->streamsused + size > newsize)
+    newsize *= 2;
+
+  if ((newarena = (char *)sl_realloc (inv->arena, newsize)) == NULL)
+  {
+    sl_log_rl (log, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  memmove (newarena + newsize - parser->streamsused,
+           newarena + inv->arenasize - parser->streamsused,
+           parser->streamsused);
+
+  inv->arena     = newarena;
+  inv->arenasize = newsize;
+
+  return 0;
+} /* End of arena_reserve() */
+
+/***************************************************************************
+ * container_start:
+ *
+ * Push a new object or array to the parse stack, determining the
+ * context from the parent and the key.  New station and stream
+ * entries are added when their objects are started.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+container_start (SLinventory *inv, const SLlog *log, int isobject)
+{
+  struct SLinvparser *parser = inv->parser;
+  InvContext parentcontext;
+  InvContext context = CTX_OTHER;
+  InvLevel *parent = NULL;
+  SLinvstation *station;
+  SLinvstream *stream;
+
+  if (parser->depth >= INV_MAX_DEPTH)
+  {
+    sl_log_rl (log, 2, 0, "%s(): JSON nesting too deep\n", __func__);
+    return -1;
+  }
+
+  if (parser->depth == 0)
+  {
+    if (!isobject)
+    {
+      sl_log_rl (log, 2, 0, "%s(): JSON response is not an object\n", __func__);
+      return -1;
+    }
+
+    context                = CTX_ROOT;
+    parser->stationsreset  = 0;
+  }
+  else
+  {
+    parent        = &parser->stack[parser->depth - 1];
+    parentcontext = parent->context;
+
+    if (parent->isobject && parent->expectkey)
+    {
+      sl_log_rl (log, 2, 0, "%s(): JSON object key expected\n", __func__);
+      return -1;
+    }
+
+    if (parentcontext == CTX_ROOT && !isobject && strcmp (parent->key, "station") == 0)
+      context = CTX_STATIONS;
+    else if (parentcontext == CTX_STATIONS && isobject)
+      context = CTX_STATION;
+    else if (parentcontext == CTX_STATION && !isobject && strcmp (parent->key, "stream") == 0)
+      context = CTX_STREAMS;
+    else if (parentcontext == CTX_STREAMS && isobject)
+      context = CTX_STREAM;
+  }
+
+  /* Replace station and stream tables with those in this response */
+  if (context == CTX_STATIONS && !parser->stationsreset)
+  {
+    inv->stations        = NULL;
+    inv->stationcount    = 0;
+    inv->streamcount     = 0;
+    parser->stationsused = 0;
+    parser->streamsused  = 0;
+    parser->stationsreset = 1;
+  }
+
+  /* Add station entry at the front of the arena */
+  if (context == CTX_STATION)
+  {
+    if (arena_reserve (inv, log, sizeof (SLinvstation)))
+      return -1;
+
+    station = (SLinvstation *)(inv->arena + parser->stationsused);
+    memset (station, 0, sizeof (SLinvstation));
+    station->start_seq = SL_UNSETSEQUENCE;
+    station->end_seq   = SL_UNSETSEQUENCE;
+
+    parser->station = inv->stationcount++;
+    parser->stationsused += sizeof (SLinvstation);
+  }
+
+  /* Add stream entry at the back of the arena */
+  if (context == CTX_STREAM)
+  {
+    if (arena_reserve (inv, log, sizeof (SLinvstream)))
+      return -1;
+
+    parser->streamsused += sizeof (SLinvstream);
+
+    stream = (SLinvstream *)(inv->arena + inv->arenasize - parser->streamsused);
+    memset (stream, 0, sizeof (SLinvstream));
+    stream->stationindex = parser->station;
+    stream->start_time   = SLTERROR;
+    stream->end_time     = SLTERROR;
+
+    inv->streamcount++;
+  }
+
+  /* Object or array is the value for the key in the parent, expect next key */
+  if (parent && parent->isobject)
+    parent->expectkey = 0;
+
+  parser->stack[parser->depth].context   = context;
+  parser->stack[parser->depth].isobject  = (isobject) ? 1 : 0;
+  parser->stack[parser->depth].expectkey = (isobject) ? 1 : 0;
+  parser->stack[parser->depth].key[0]    = '\0';
+  parser->depth++;
+
+  return 0;
+} /* End of container_start() */
+
+/***************************************************************************
+ * token_value:
+ *
+ * Process a completed string or scalar token, either as an object key
+ * or a value for a recognized key in the current context.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+token_value (SLinventory *inv, const SLlog *log, int isstring)
+{
+  struct SLinvparser *parser = inv->parser;
+  InvLevel *level;
+  SLinvstation *station;
+  SLinvstream *stream;
+  const char *key;
+  char *value;
+  char *tail = NULL;
+
+  if (parser->depth == 0)
+    return -1;
+
+  level = &parser->stack[parser->depth - 1];
+  parser->token[parser->tokenlength] = '\0';
+  value = parser->token;
+
+  /* Object key */
+  if (level->isobject && level->expectkey)
+  {
+    if (!isstring)
+    {
+      sl_log_rl (log, 2, 0, "%s(): JSON object key is not a string\n", __func__);
+      return -1;
+    }
+
+    strncpy (level->key, value, sizeof (level->key) - 1);
+    level->key[sizeof (level->key) - 1] = '\0';
+    level->expectkey = 0;
+
+    return 0;
+  }
+
+  if (!level->isobject)
+    return 0;
+
+  key = level->key;
+
+  if (level->context == CTX_ROOT)
+  {
+    if (strcmp (key, "software") == 0)
+      strncpy (inv->software, value, sizeof (inv->software) - 1);
+    else if (strcmp (key, "organization") == 0)
+      strncpy (inv->organization, value, sizeof (inv->organization) - 1);
+  }
+  else if (level->context == CTX_STATION)
+  {
+    station = (SLinvstation *)(inv->arena + parser->station * sizeof (SLinvstation));
+
+    if (strcmp (key, "id") == 0)
+    {
+      strncpy (station->stationid, value, sizeof (station->stationid) - 1);
+    }
+    else if (strcmp (key, "start_seq") == 0)
+    {
+      station->start_seq = strtoull (value, &tail, 10);
+
+      if (*tail)
+        station->start_seq = SL_UNSETSEQUENCE;
+    }
+    else if (strcmp (key, "end_seq") == 0)
+    {
+      station->end_seq = strtoull (value, &tail, 10);
+
+      if (*tail)
+        station->end_seq = SL_UNSETSEQUENCE;
+    }
+  }
+  else if (level->context == CTX_STREAM)
+  {
+    stream = (SLinvstream *)(inv->arena + inv->arenasize - parser->streamsused);
+
+    if (strcmp (key, "id") == 0)
+      strncpy (stream->streamid, value, sizeof (stream->streamid) - 1);
+    else if (strcmp (key, "format") == 0)
+      stream->format = value[0];
+    else if (strcmp (key, "subformat") == 0)
+      stream->subformat = value[0];
+    else if (strcmp (key, "start_time") == 0)
+      stream->start_time = parse_isotime (value);
+    else if (strcmp (key, "end_time") == 0)
+      stream->end_time = parse_isotime (value);
+  }
+
+  return 0;
+} /* End of token_value() */
+
+/***************************************************************************
+ * inventory_finish:
+ *
+ * Sort the station and stream tables of a completed response and
+ * link stations to their streams.
+ ***************************************************************************/
+static void
+inventory_finish (SLinventory *inv)
+{
+  struct SLinvparser *parser = inv->parser;
+  SLinvstation *stations;
+  SLinvstream *streams;
+  uint32_t stationidx;
+  uint32_t streamidx;
+
+  if (!parser->stationsreset)
+  {
+    memset (parser, 0, sizeof (struct SLinvparser));
+    return;
+  }
+
+  stations = (SLinvstation *)inv->arena;
+  streams  = (SLinvstream *)(inv->arena + inv->arenasize - parser->streamsused);
+
+  /* Sort streams by parsed station order and stream ID, station ranges are contiguous */
+  qsort (streams, inv->streamcount, sizeof (SLinvstream), compare_streams);
+
+  for (stationidx = 0, streamidx = 0; stationidx < inv->stationcount; stationidx++)
+  {
+    stations[stationidx].streams     = &streams[streamidx];
+    stations[stationidx].streamcount = 0;
+
+    while (streamidx < inv->streamcount && streams[streamidx].stationindex == stationidx)
+    {
+      stations[stationidx].streamcount++;
+      streamidx++;
+    }
+  }
+
+  /* Sort stations by ID, then update station index of streams */
+  qsort (stations, inv->stationcount, sizeof (SLinvstation), compare_stations);
+
+  for (stationidx = 0; stationidx < inv->stationcount; stationidx++)
+  {
+    for (streamidx = 0; streamidx < stations[stationidx].streamcount; streamidx++)
+      stations[stationidx].streams[streamidx].stationindex = stationidx;
+  }
+
+  inv->stations = stations;
+
+  memset (parser, 0, sizeof (struct SLinvparser));
+} /* End of inventory_finish() */
+
+/***************************************************************************
+ * parse_isotime:
+ *
+ * Parse an ISO 8601 time string of the form YYYY-MM-DDThh:mm:ss[.f]Z
+ * into a nanosecond epoch time.
+ *
+ * Returns the time on success and SLTERROR on error.
+ ***************************************************************************/
+static int64_t
+parse_isotime (const char *isotime)
+{
+  static const int cumdays[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+  int year, month, mday, hour, min, sec;
+  int yday;
+  uint32_t nsec = 0;
+  uint32_t scale = 100000000;
+  const char *cp;
+
+  if (sscanf (isotime, "%4d-%2d-%2dT%2d:%2d:%2d", &year, &month, &mday, &hour, &min, &sec) != 6)
+    return SLTERROR;
+
+  if (year < 1900 || year > 2100 || month < 1 || month > 12 || mday < 1 || mday > 31 ||
+      hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 60)
+    return SLTERROR;
+
+  /* Fractional seconds */
+  if ((cp = strchr (isotime, '.')))
+  {
+    for (cp++; *cp >= '0' && *cp <= '9' && scale > 0; cp++)
+    {
+      nsec += (uint32_t)(*cp - '0') * scale;
+      scale /= 10;
+    }
+  }
+
+  yday = cumdays[month - 1] + mday;
+
+  if (month > 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+    yday++;
+
+  return sl_time2nstime (year, yday, hour, min, sec, nsec);
+} /* End of parse_isotime() */
+
+/***************************************************************************
+ * compare_stations:
+ *
+ * Compare stations by station ID for qsort() and bsearch().
+ ***************************************************************************/
+static int
+compare_stations (const void *a, const void *b)
+{
+  return strcmp (((const SLinvstation *)a)->stationid,
+                 ((const SLinvstation *)b)->stationid);
+} /* End of compare_stations() */
+
+/***************************************************************************
+ * compare_streams:
+ *
+ * Compare streams by station index, stream ID and format for qsort().
+ ***************************************************************************/
+static int
+compare_streams (const void *a, const void *b)
+{
+  const SLinvstream *streama = (const SLinvstream *)a;
+  const SLinvstream *streamb = (const SLinvstream *)b;
+  int cmp;
+
+  if (streama->stationindex != streamb->stationindex)
+    return (streama->stationindex < streamb->stationindex) ? -1 : 1;
+
+  if ((cmp = strcmp (streama->streamid, streamb->streamid)))
+    return cmp;
+
+  return (streama->format - streamb->format);
+} /* End of compare_streams() */
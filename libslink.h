@@ -28,10 +28,10 @@
 extern "C" {
 #endif
 
-#define LIBSLINK_RELEASE "2024.350"    /**< libslink release date */
+#define LIBSLINK_RELEASE "2026.290"    /**< libslink release date */
 #define LIBSLINK_VERSION_MAJOR  4      /**< libslink major version */
-#define LIBSLINK_VERSION_MINOR  1      /**< libslink minor version */
-#define LIBSLINK_VERSION_PATCH  3      /**< libslink patch version */
+#define LIBSLINK_VERSION_MINOR  2      /**< libslink minor version */
+#define LIBSLINK_VERSION_PATCH  0      /**< libslink patch version */
 #define LIBSLINK_STRINGIFY(a)   LIBSLINK_XSTRINGIFY(a)
 #define LIBSLINK_XSTRINGIFY(a)  #a
 /** @def LIBSLINK_VERSION
@@ -43,7 +43,19 @@ extern "C" {
 
 /** @defgroup seedlink-connection SeedLink Connection */
 /** @defgroup connection-state Connection State */
+/** @defgroup connection-group Connection Groups */
+/** @defgroup connection-merge Time-ordered Merge */
+/** @defgroup connection-dispatch Priority Dispatch */
+/** @defgroup inventory Station Inventory */
+/** @defgroup lpcache Last Packet Cache */
+/** @defgroup sample-rings Sample Rings */
+/** @defgroup continuity Continuity Index */
+/** @defgroup archive miniSEED Archive */
+/** @defgroup relay SeedLink Relay */
+/** @defgroup columns Columnar Metadata */
+/** @defgroup traffic Traffic Accounting */
 /** @defgroup logging Central Logging */
+/** @defgroup memory Memory Allocation */
 /** @defgroup utility-functions General Utility Functions */
 
 /* C99 standard headers */
@@ -235,6 +247,7 @@ typedef enum
 
 #define SLPAYLOAD_JSON_INFO     'I' //!< JSON payload, subformat SeedLink INFO
 #define SLPAYLOAD_JSON_ERROR    'E' //!< JSON payload, subformat SeedLink ERROR
+#define SLPAYLOAD_XML_INFO      'I' //!< XML payload, subformat SeedLink INFO (v3 reassembled)
 /** @} */
 
 /** @defgroup collect-status Collect Status
@@ -244,6 +257,7 @@ typedef enum
 #define SLTERMINATE              0  //!< Error or connection termination
 #define SLNOPACKET              -1  //!< No packet available for non-blocking
 #define SLTOOLARGE              -2  //!< Received packet is too large for buffer
+#define SLCHUNK                  2  //!< Segment of payload returned, see sl_set_chunkmode()
 /** @} */
 
 /** @def SL_UNSETSEQUENCE
@@ -298,6 +312,14 @@ typedef struct SLstream
   struct   SLstream *next;      //!< The next station in the chain
 } SLstream;
 
+/** @brief Token bucket limiting the rate of received bytes */
+typedef struct SLratelimit
+{
+  uint32_t rate;                //!< Bytes per second, 0 = unlimited
+  int64_t  tokens;              //!< Bytes that may be read
+  int64_t  updated;             //!< Time stamp of last refill
+} SLratelimit;
+
 /** @brief Connection state information */
 typedef struct SLstat
 {
@@ -315,7 +337,7 @@ typedef struct SLstat
   /** Stream state */
   enum
   {
-    HEADER, STATIONID, PAYLOAD
+    HEADER, STATIONID, PAYLOAD, SKIPPAYLOAD, RESYNC
   } stream_state;
 
   /** INFO query state */
@@ -324,6 +346,13 @@ typedef struct SLstat
     NoQuery, InfoQuery, KeepAliveQuery
   } query_state;
 
+  /* Fields added after 4.1 are appended to preserve binary compatibility */
+  int64_t ratelimit_time;       //!< Rate limit wait time stamp, reading resumes after
+  uint64_t resync_bytes;        //!< Bytes skipped to resynchronize after unparseable data
+  uint32_t resync_count;        //!< Number of resynchronizations after unparseable data
+  uint32_t chunkoffset;         //!< Payload offset of returned segment, chunked mode
+  uint32_t chunklength;         //!< Length of returned segment, chunked mode
+  uint8_t  chunkfinal;          //!< Flag indicating final segment, chunked mode
 } SLstat;
 
 /** @brief SeedLink Connection Description
@@ -370,6 +399,40 @@ typedef struct SLCD
 
   uint8_t     recvbuffer[SL_RECV_BUFFER_SIZE]; // Network receive buffer
   uint32_t    recvdatalen;      // Length of data in receive buffer
+
+  // Fields added after 4.1 are appended to preserve binary compatibility
+  void      (*gap_handler)(struct SLCD *slconn, const char *stationid,
+                           uint64_t firstseq, uint64_t lastseq, void *gap_data); // Sequence gap callback
+  void       *gap_data;         // Sequence gap callback data
+  void      (*info_handler)(struct SLCD *slconn, const char *xml, uint32_t length,
+                            int final, void *info_data); // v3 INFO fragment callback
+  void       *info_data;        // v3 INFO fragment callback data
+  struct SLlpcache *lpcache;    // Last packet cache updated by collection
+  struct SLcontinuity *continuity; // Continuity index updated by collection
+  struct SLarchive *archive;    // Archive writer updated by collection
+  struct SLrelay *relay;        // Relay updated by collection
+  struct SLtraffic *traffic;    // Traffic accounting updated by collection
+  int8_t      chunkmode;        // Boolean flag to enable chunked payload delivery
+  int8_t      splicemode;       // Boolean flag to enable splicing payloads to archive
+  int8_t      resync;           // Boolean flag to enable resynchronization on unparseable data
+  int8_t      inforeassembly;   // Boolean flag to enable v3 INFO reassembly
+  SLratelimit ratelimit;        // Receive rate limit for this connection
+  char       *arena;            // Arena for negotiation temporaries, NULL if disabled
+  uint32_t    arenasize;        // Size of negotiation arena
+  uint32_t    arenaused;        // Bytes used in negotiation arena
+  char       *transcodebuffer;  // Buffer for miniSEED 2 records being transcoded, NULL if disabled
+  uint32_t    transcodesize;    // Size of transcode buffer
+  char       *filter;           // Client-side filter patterns
+  SLstream   *removed;          // Streams removed since negotiation, filtered client-side
+  SLratelimit *sharedlimit;     // Shared group rate limit, NULL if not engaged
+  char       *infobuffer;       // v3 INFO reassembly buffer
+  uint32_t    infolength;       // Length of data in INFO buffer
+  uint32_t    infosize;         // Size of INFO buffer
+  int8_t      infoready;        // Flag indicating INFO response is complete
+  uint64_t    resyncmark;       // Skipped bytes at start of current resynchronization
+  uint8_t    *extdata;          // Received data provided by a connection group, processed in place
+  uint32_t    extdatalen;       // Length of data at extdata
+  int8_t      extrecv;          // Socket is read by a connection group with io_uring, not by sl_collect()
   /// @endcond
 } SLCD;
 
@@ -391,10 +454,34 @@ extern int sl_set_reconnectdelay (SLCD *slconn, int reconnectdelay);
 extern int sl_set_blockingmode (SLCD *slconn, int nonblock);
 extern int sl_set_dialupmode (SLCD *slconn, int dialup);
 extern int sl_set_batchmode (SLCD *slconn, int batchmode);
+extern int sl_set_chunkmode (SLCD *slconn, int chunkmode);
+extern int sl_set_resync (SLCD *slconn, int resync);
+extern int sl_set_ratelimit (SLCD *slconn, uint32_t rate);
+extern int sl_set_inforeassembly (SLCD *slconn, int reassemble);
+extern int sl_set_info_handler (SLCD *slconn,
+                                void (*info_handler) (SLCD *slconn, const char *xml,
+                                                      uint32_t length, int final,
+                                                      void *info_data),
+                                void *info_data);
 extern int sl_set_tlsmode (SLCD *slconn, int tlsmode);
+extern int sl_set_filter (SLCD *slconn, const char *patterns);
+extern int sl_set_lpcache (SLCD *slconn, struct SLlpcache *cache);
+extern int sl_set_continuity (SLCD *slconn, struct SLcontinuity *cont);
+extern int sl_set_archive (SLCD *slconn, struct SLarchive *archive);
+extern int sl_set_relay (SLCD *slconn, struct SLrelay *relay);
+extern int sl_set_traffic (SLCD *slconn, struct SLtraffic *traffic);
+extern int sl_set_splicemode (SLCD *slconn, int splicemode);
+extern int sl_set_arena (SLCD *slconn, uint32_t size);
+extern int sl_set_transcode (SLCD *slconn, uint32_t maxrecordlength);
+extern int sl_set_gap_handler (SLCD *slconn,
+                               void (*gap_handler) (SLCD *slconn, const char *stationid,
+                                                    uint64_t firstseq, uint64_t lastseq,
+                                                    void *gap_data),
+                               void *gap_data);
 extern int sl_add_stream (SLCD *slconn, const char *stationid,
                           const char *selectors, uint64_t seqnum,
                           const char *timestamp);
+extern int sl_remove_stream (SLCD *slconn, const char *stationid);
 extern int sl_set_allstation_params (SLCD *slconn, const char *selectors,
                                      uint64_t seqnum, const char *timestamp);
 extern int sl_request_info (SLCD *slconn, const char *infostr);
@@ -423,6 +510,525 @@ extern int sl_recvresp (SLCD *slconn, void *buffer, size_t maxbytes,
 extern int sl_poll (SLCD *slconn, int readability, int writability, int timeout_ms);
 /** @} */
 
+/** @addtogroup connection-group
+    @brief Collect packets from multiple connections as a single feed
+
+    A SeedLink Connection Group (::SLCG) combines any number of ::SLCD
+    connections into a single feed, collected with sl_group_collect().
+    The member connections are collected in non-blocking mode in a
+    round-robin fashion, and the group will wait for data on all
+    members when none have packets available.
+
+    A common use is redundant ingestion of the same data from multiple
+    servers.  When deduplication is enabled with sl_group_set_dedup(),
+    the first copy of each miniSEED record received from any member is
+    returned and later copies are discarded.  Records are identified
+    by station ID, record start time and source identifier, and a
+    sliding window of recently seen records is tracked per station.
+
+    Missing sequence ranges can be fetched by temporary dial-up
+    connections with sl_group_backfill(), or automatically for all
+    gaps detected on member connections when enabled with
+    sl_group_set_backfill().  Backfilled packets are returned by
+    sl_group_collect() along with the live packets.
+
+    Streams can be added to and removed from a member at runtime with
+    sl_group_add_stream() and sl_group_remove_stream() without
+    renegotiating the streams already flowing.  Additions are
+    negotiated on an auxiliary connection and merged into the member
+    when it next reconnects, removals are filtered client-side.
+
+    Backfilling members can be limited to a combined receive rate with
+    sl_group_set_ratelimit(), optionally only while live members lag.
+
+    On Linux, sockets of streaming members can be received with
+    io_uring using sl_group_set_iouring(), falling back to epoll when
+    io_uring is not available.
+
+    The member ::SLCD connections remain owned by the caller and
+    must be freed separately after the group is freed.  Connections
+    created for backfilling and additions are managed by the group.
+
+    @{ */
+
+/** @brief SeedLink Connection Group, an opaque structure */
+typedef struct SLCG SLCG;
+
+extern SLCG *sl_initslcg (void);
+extern void sl_freeslcg (SLCG *group);
+extern int sl_group_add (SLCG *group, SLCD *slconn);
+extern int sl_group_set_blockingmode (SLCG *group, int nonblock);
+extern int sl_group_set_dedup (SLCG *group, uint32_t window);
+extern int sl_group_set_backfill (SLCG *group, int maxconnections);
+extern int sl_group_set_ratelimit (SLCG *group, uint32_t rate, int maxlag);
+extern int sl_group_set_iouring (SLCG *group, uint32_t buffers, uint32_t buffersize);
+extern int sl_group_backfill (SLCG *group, const SLCD *primary, const char *stationid,
+                              uint64_t firstseq, uint64_t lastseq);
+extern int sl_group_add_stream (SLCG *group, SLCD *primary, const char *stationid,
+                                const char *selectors, uint64_t seqnum,
+                                const char *timestamp);
+extern int sl_group_remove_stream (SLCG *group, SLCD *primary, const char *stationid);
+extern int sl_group_collect (SLCG *group, SLCD **slconn,
+                             const SLpacketinfo **packetinfo,
+                             char *plbuffer, uint32_t plbuffersize);
+extern int sl_group_poll (SLCG *group, int timeout_ms);
+extern void sl_group_terminate (SLCG *group);
+/** @} */
+
+/** @addtogroup connection-merge
+    @brief Merge packets from a connection group in time order
+
+    Packets are returned by sl_collect() and sl_group_collect() in the
+    order they arrive from each connection.  A time-ordered merge
+    (::SLmerge) buffers packets collected from a connection group and
+    returns them with sl_merge_collect() in order of record start time,
+    within a configured latency bound.
+
+    Each packet is buffered until it has waited for the latency bound
+    or the buffer is full, at which point the earliest buffered packet
+    is returned.  Packets arriving with a start time earlier than a
+    packet already returned are late, and are either returned
+    immediately or discarded depending on the late packet policy.
+
+    Payloads that are not miniSEED are returned immediately.
+
+    @{ */
+
+/** @brief Time-ordered merge, an opaque structure */
+typedef struct SLmerge SLmerge;
+
+#define SLMERGE_LATE_DELIVER 0  //!< Return late packets immediately, out of order
+#define SLMERGE_LATE_DROP    1  //!< Discard late packets
+
+extern SLmerge *sl_initslmerge (SLCG *group, uint32_t maxpackets, uint32_t latency_ms,
+                                int latepolicy);
+extern void sl_freeslmerge (SLmerge *merge);
+extern int sl_merge_set_blockingmode (SLmerge *merge, int nonblock);
+extern int sl_merge_collect (SLmerge *merge, SLCD **slconn,
+                             const SLpacketinfo **packetinfo, const char **payload);
+/** @} */
+
+/** @addtogroup connection-dispatch
+    @brief Dispatch packets from a connection group by priority
+
+    Packets are returned by sl_group_collect() in the order they
+    arrive, so latency-critical channels wait behind bulk traffic such
+    as backfill sharing the same connections.  A priority dispatch
+    (::SLdispatch) queues all packets available from a connection
+    group by priority class and returns them with
+    sl_dispatch_collect() highest priority first.
+
+    Priority classes are assigned by source ID glob patterns with
+    sl_dispatch_add_class().  When the queues are full packets of the
+    lowest priority are shed, either dropped or passed to a handler set
+    with sl_dispatch_set_spill().  Queue delay and shedding are
+    measured per class and reported by sl_dispatch_stats().
+
+    @{ */
+
+/** @brief Priority dispatch, an opaque structure */
+typedef struct SLdispatch SLdispatch;
+
+#define SLDISPATCH_MAXCLASSES 16 //!< Maximum number of priority classes
+
+/** @brief Statistics of a priority class */
+typedef struct SLdispatchstat
+{
+  uint64_t packets;             //!< Packets returned
+  uint64_t shed;                //!< Packets dropped or spilled due to overload
+  uint32_t queued;              //!< Packets currently queued
+  int64_t  delay_total;         //!< Sum of queue delays of returned packets, nanoseconds
+  int64_t  delay_max;           //!< Maximum queue delay of returned packets, nanoseconds
+} SLdispatchstat;
+
+extern SLdispatch *sl_initsldispatch (SLCG *group, uint32_t maxpackets, int classes);
+extern void sl_freesldispatch (SLdispatch *dispatch);
+extern int sl_dispatch_set_blockingmode (SLdispatch *dispatch, int nonblock);
+extern int sl_dispatch_add_class (SLdispatch *dispatch, const char *pattern, int priority);
+extern int sl_dispatch_set_spill (SLdispatch *dispatch,
+                                  void (*spill) (SLCD *slconn, const SLpacketinfo *packetinfo,
+                                                 const char *payload, int priority,
+                                                 void *spill_data),
+                                  void *spill_data);
+extern int sl_dispatch_collect (SLdispatch *dispatch, SLCD **slconn,
+                                const SLpacketinfo **packetinfo, const char **payload,
+                                int *priority);
+extern int sl_dispatch_stats (SLdispatch *dispatch, int priority, SLdispatchstat *stat,
+                              int reset);
+/** @} */
+
+/** @addtogroup inventory
+    @brief Station and stream inventory from v4 JSON INFO responses
+
+    An inventory (::SLinventory) is populated by parsing the JSON
+    responses to INFO STATIONS or INFO STREAMS requests with
+    sl_inventory_parse().  Responses may be parsed as they are
+    received, in any number of segments.  When a response is complete
+    the station table is sorted by station ID and the streams of each
+    station by stream ID, for lookup with sl_inventory_station() and
+    sl_inventory_stream() or wildcard selection with
+    sl_inventory_select().
+
+    An inventory of the server may be used by sl_compact_streams() to
+    replace long stream lists with equivalent wildcard entries.
+
+    @{ */
+
+/** @brief Stream entry of an inventory */
+typedef struct SLinvstream
+{
+  char     streamid[32];       //!< Stream ID, e.g. "00_B_H_Z"
+  char     format;             //!< Payload format, e.g. '2' for miniSEED 2
+  char     subformat;          //!< Payload subformat, e.g. 'D' for data
+  uint32_t stationindex;       //!< Index of station in SLinventory.stations
+  int64_t  start_time;         //!< Start of available data, SLTERROR if unknown
+  int64_t  end_time;           //!< End of available data, SLTERROR if unknown
+} SLinvstream;
+
+/** @brief Station entry of an inventory */
+typedef struct SLinvstation
+{
+  char     stationid[SL_MAX_STATIONID]; //!< Station ID, e.g. "NET_STA"
+  uint64_t start_seq;          //!< First available sequence, SL_UNSETSEQUENCE if unknown
+  uint64_t end_seq;            //!< Next sequence, SL_UNSETSEQUENCE if unknown
+  SLinvstream *streams;        //!< Streams of station, sorted by stream ID
+  uint32_t streamcount;        //!< Number of streams of station
+} SLinvstation;
+
+/** @brief Station and stream inventory */
+typedef struct SLinventory
+{
+  char     software[128];      //!< Server software from last response
+  char     organization[128];  //!< Server organization from last response
+  SLinvstation *stations;      //!< Stations, sorted by station ID
+  uint32_t stationcount;       //!< Number of stations
+  uint32_t streamcount;        //!< Number of streams of all stations
+
+  /// @cond HIDDEN_FIELDS
+  char    *arena;              // Storage for station and stream entries
+  size_t   arenasize;          // Size of arena in bytes
+  struct SLinvparser *parser;  // Parser state between segments
+  /// @endcond
+} SLinventory;
+
+extern SLinventory *sl_initslinventory (size_t arenasize);
+extern void sl_freeslinventory (SLinventory *inv);
+extern int sl_inventory_parse (SLinventory *inv, const SLlog *log,
+                               const char *json, uint32_t length);
+extern void sl_inventory_reset (SLinventory *inv);
+extern const SLinvstation *sl_inventory_station (const SLinventory *inv,
+                                                 const char *stationid);
+extern const SLinvstream *sl_inventory_stream (const SLinvstation *station,
+                                               const char *streamid, char format);
+extern uint32_t sl_inventory_select (const SLinventory *inv,
+                                     const char *stationpattern, const char *streampattern,
+                                     const SLinvstream **streams, uint32_t maxstreams);
+extern int sl_compact_streams (SLCD *slconn, const SLinventory *inv);
+/** @} */
+
+/** @addtogroup lpcache
+    @brief Cache of the most recent packet of each data source
+
+    A last packet cache (::SLlpcache) retains the most recent miniSEED
+    packet, or only its fixed header, for each FDSN source identifier.
+    The cache is updated by connections configured with
+    sl_set_lpcache() and may be read from other threads with
+    sl_lpcache_get() and sl_lpcache_next() without blocking collection.
+
+    The cache is a fixed size hash table allocated by sl_initlpcache(),
+    it does not allocate memory or take locks when updated or read.
+
+    @{ */
+
+/** @brief Last packet cache, an opaque structure */
+typedef struct SLlpcache SLlpcache;
+
+/** @brief Snapshot of a cached packet */
+typedef struct SLlpentry
+{
+  char     sourceid[64];       //!< FDSN source identifier
+  char     stationid[SL_MAX_STATIONID]; //!< Station ID
+  uint64_t seqnum;             //!< Packet sequence number
+  int64_t  starttime;          //!< Record start time, SLTERROR if unknown
+  int64_t  received;           //!< Time the packet was cached
+  uint64_t updates;            //!< Number of packets received for source
+  char     payloadformat;      //!< Payload format
+  char     payloadsubformat;   //!< Payload subformat
+  uint32_t payloadlength;      //!< Length of packet payload
+  uint32_t datalength;         //!< Length of payload retained in cache
+} SLlpentry;
+
+extern SLlpcache *sl_initlpcache (uint32_t maxsources, uint32_t retainlength);
+extern void sl_freelpcache (SLlpcache *cache);
+extern int sl_lpcache_update (SLlpcache *cache, const SLlog *log,
+                              const SLpacketinfo *packetinfo, const char *payload);
+extern int sl_lpcache_get (SLlpcache *cache, const char *sourceid, SLlpentry *entry,
+                           char *buffer, uint32_t buffersize);
+extern int sl_lpcache_next (SLlpcache *cache, uint32_t *cursor, SLlpentry *entry,
+                            char *buffer, uint32_t buffersize);
+/** @} */
+
+/** @addtogroup sample-rings
+    @brief Rings of decoded samples per data source
+
+    Sample rings (::SLrings) keep the most recent decoded samples of
+    each data source, identified by FDSN source identifier, in fixed
+    capacity rings of 32-bit integers or floats.  Records are added
+    with sl_rings_add(), which detects gaps and overlaps from the
+    record start time and sample rate.
+
+    Windows of recent samples are returned by sl_rings_window() as
+    references into the ring without copying, and may be read from
+    any number of threads while records are added from one thread.
+    Readers confirm the samples were not overwritten while in use
+    with sl_rings_window_valid().
+
+    @{ */
+
+/** @brief Set of sample rings, an opaque structure */
+typedef struct SLrings SLrings;
+
+/** @brief Window of contiguous samples in a ring */
+typedef struct SLwindow
+{
+  char        sourceid[64];    //!< Source identifier, without "FDSN:" prefix
+  char        sampletype;      //!< Sample type, 'i' (int32_t) or 'f' (float)
+  double      samplerate;      //!< Sample rate in Hz
+  int64_t     starttime;       //!< Time of first sample
+  uint32_t    samplecount;     //!< Number of samples in window
+  const void *samples;         //!< Samples, contiguous and 4 bytes each
+  uint64_t    position;        //!< Ring position of first sample
+} SLwindow;
+
+extern SLrings *sl_initslrings (uint32_t maxsources, uint32_t capacity);
+extern void sl_freeslrings (SLrings *rings);
+extern int sl_rings_set_tolerance (SLrings *rings, double tolerance);
+extern int64_t sl_rings_add (SLrings *rings, const SLlog *log,
+                             const SLpacketinfo *packetinfo, const char *payload);
+extern int sl_rings_window (const SLrings *rings, const char *sourceid,
+                            double duration, SLwindow *window);
+extern int sl_rings_window_valid (const SLrings *rings, const SLwindow *window);
+extern int sl_rings_stats (const SLrings *rings, const char *sourceid,
+                           uint64_t *gaps, uint64_t *overlaps);
+/** @} */
+
+/** @addtogroup continuity
+    @brief Index of contiguous segments, gaps and overlaps per data source
+
+    A continuity index (::SLcontinuity) tracks the time coverage of
+    miniSEED records per data source as a list of contiguous segments,
+    with statistics of gaps and overlaps.  Records are added by
+    connections configured with sl_set_continuity(), or directly with
+    sl_continuity_add().  Records are coalesced into segments when they
+    start within a tolerance of the end of a segment, by default half
+    a sample period.
+
+    Memory is bounded by a maximum number of segments per source, the
+    oldest segments are compacted into summary totals when exceeded or
+    when requested with sl_continuity_compact().
+
+    @{ */
+
+/** @brief Continuity index, an opaque structure */
+typedef struct SLcontinuity SLcontinuity;
+
+/** @brief Contiguous time segment */
+typedef struct SLsegment
+{
+  int64_t  starttime;          //!< Time of first sample
+  int64_t  endtime;            //!< End of coverage, one sample period after last sample
+} SLsegment;
+
+/** @brief Continuity statistics of a data source */
+typedef struct SLcontinuitystats
+{
+  int64_t  earliest;           //!< Earliest time covered
+  int64_t  latest;             //!< Latest time covered
+  int64_t  coverage;           //!< Total time covered in nanoseconds
+  uint64_t gaps;               //!< Number of gaps between segments
+  int64_t  gaptime;            //!< Total time of gaps in nanoseconds
+  uint64_t overlaps;           //!< Number of records overlapping existing coverage
+  int64_t  overlaptime;        //!< Total time of overlaps in nanoseconds
+  uint64_t compacted;          //!< Number of segments compacted
+  uint32_t segmentcount;       //!< Number of segments retained
+} SLcontinuitystats;
+
+extern SLcontinuity *sl_initslcontinuity (uint32_t maxsegments);
+extern void sl_freeslcontinuity (SLcontinuity *cont);
+extern int sl_continuity_set_tolerance (SLcontinuity *cont, double tolerance);
+extern int sl_continuity_add (SLcontinuity *cont, const SLlog *log,
+                              const SLpacketinfo *packetinfo, const char *payload);
+extern int64_t sl_continuity_segments (const SLcontinuity *cont, const char *sourceid,
+                                       SLsegment *segments, uint32_t maxsegments);
+extern int sl_continuity_stats (const SLcontinuity *cont, const char *sourceid,
+                                SLcontinuitystats *stats);
+extern const char *sl_continuity_next (const SLcontinuity *cont, void **cursor);
+extern int64_t sl_continuity_compact (SLcontinuity *cont, int64_t before);
+extern int sl_continuity_save (const SLcontinuity *cont, const SLlog *log,
+                               const char *filename);
+/** @} */
+
+/** @addtogroup archive
+    @brief Writing of miniSEED records to day files in SDS or BUD layout
+
+    An archive writer (::SLarchive) appends received miniSEED records
+    to day files in a SeisComP Data Structure (SDS) or Buffer of Uniform
+    Data (BUD) directory layout.  Records are written by connections
+    configured with sl_set_archive(), or directly with
+    sl_archive_write().
+
+    A bounded number of files are kept open with the least recently
+    used file closed when a new file is needed.  Data is buffered per
+    file and, optionally, files are synchronized to storage in batches
+    at an interval set with sl_archive_set_sync().
+
+    @{ */
+
+#define SLARCHIVE_SDS  1       //!< SDS layout: ROOT/YEAR/NET/STA/CHAN.D/NET.STA.LOC.CHAN.D.YEAR.DOY
+#define SLARCHIVE_BUD  2       //!< BUD layout: ROOT/NET/STA/STA.NET.LOC.CHAN.YEAR.DOY
+
+/** @brief miniSEED archive writer, an opaque structure */
+typedef struct SLarchive SLarchive;
+
+extern SLarchive *sl_initslarchive (const char *rootdir, int layout,
+                                    uint32_t maxopen, uint32_t buffersize);
+extern int sl_freeslarchive (SLarchive *archive, const SLlog *log);
+extern int sl_archive_set_sync (SLarchive *archive, uint32_t interval_ms);
+extern int sl_archive_write (SLarchive *archive, const SLlog *log,
+                             const SLpacketinfo *packetinfo, const char *payload);
+extern int sl_archive_splice (SLarchive *archive, const SLlog *log,
+                              const SLpacketinfo *packetinfo, const char *header,
+                              uint32_t headerlength, int sockfd);
+extern int sl_archive_flush (SLarchive *archive, const SLlog *log);
+extern int sl_archive_stats (const SLarchive *archive, uint64_t *records,
+                             uint64_t *bytes, uint32_t *openfiles);
+/** @} */
+
+/** @addtogroup relay
+    @brief Re-serving of received packets to local SeedLink clients
+
+    A relay (::SLrelay) listens for SeedLink v3 and v4 clients and
+    serves them packets from a ring of recent packets.  Packets are
+    added by connections configured with sl_set_relay(), or directly
+    with sl_relay_add(), and are numbered with relay sequence numbers.
+
+    Clients are accepted and served by sl_relay_service(), which must
+    be called regularly from the thread adding packets.  Each packet is
+    stored once and sent to all clients from the ring, clients that
+    fall behind the ring skip the replaced packets.
+
+    Clients using protocol v3 are only sent 512-byte miniSEED 2
+    records.  Authentication requests are accepted without
+    verification.
+
+    @{ */
+
+/** @brief SeedLink relay, an opaque structure */
+typedef struct SLrelay SLrelay;
+
+extern SLrelay *sl_initslrelay (const char *listenaddress, const char *organization,
+                                uint32_t ringsize, uint32_t maxclients);
+extern void sl_freeslrelay (SLrelay *relay);
+extern int sl_relay_add (SLrelay *relay, const SLlog *log,
+                         const SLpacketinfo *packetinfo, const char *payload);
+extern int sl_relay_service (SLrelay *relay, const SLlog *log, int timeout_ms);
+extern int sl_relay_stats (const SLrelay *relay, uint64_t *packets,
+                           uint64_t *dropped, uint32_t *clients);
+/** @} */
+
+/** @addtogroup columns
+    @brief Collection of packet metadata into columnar arrays
+
+    Packets are collected with sl_collect_columns() and the metadata of
+    each packet is written as a row of caller-provided column arrays
+    (::SLcolumns) suitable for loading into columnar stores, e.g. as
+    Arrow arrays.  Source identifiers are dictionary encoded with the
+    dictionary in the Arrow string layout: identifier \c i is
+    \c dictdata[dictoffsets[i]] to \c dictdata[dictoffsets[i+1]].
+
+    @{ */
+
+/** @brief Column arrays for packet metadata, any column may be NULL */
+typedef struct SLcolumns
+{
+  uint32_t  capacity;          //!< Number of rows in each column array
+  uint32_t  length;            //!< Number of rows written
+  int32_t  *sourceid;          //!< Source ID dictionary index, -1 if none
+  int64_t  *starttime;         //!< Record start time, SLTERROR if unknown
+  double   *samplerate;        //!< Sample rate in Hz, 0.0 if unknown
+  uint32_t *samplecount;       //!< Number of samples
+  uint64_t *seqnum;            //!< Packet sequence number
+  int64_t  *arrivaltime;       //!< Time packet was collected
+  uint32_t *payloadlength;     //!< Payload length in bytes
+  char     *format;            //!< Payload format, see @ref payload-formats
+  int32_t  *dictoffsets;       //!< Dictionary offsets, dictcapacity + 1 entries
+  char     *dictdata;          //!< Dictionary string data
+  uint32_t  dictcapacity;      //!< Maximum number of dictionary entries
+  uint32_t  dictdatasize;      //!< Size of dictionary string data
+  uint32_t  dictlength;        //!< Number of dictionary entries, 0 to reset
+  uint32_t *dictslots;         //!< Optional zeroed hash slots for dictionary lookup, or NULL
+  uint32_t  dictslotcount;     //!< Number of hash slots, a power of 2
+} SLcolumns;
+
+extern int sl_collect_columns (SLCD *slconn, SLcolumns *columns,
+                               char *plbuffer, uint32_t plbuffersize, int *status);
+/** @} */
+
+/** @addtogroup traffic
+    @brief Accounting of received traffic per station and channel
+
+    Traffic accounting (::SLtraffic) counts the bytes and packets
+    received per station, and optionally per channel, to identify the
+    sources responsible for load.  Packets are counted by connections
+    configured with sl_set_traffic(), or directly with
+    sl_traffic_add().
+
+    Memory is fixed when allocated by sl_initsltraffic(), regardless
+    of the number of stations and channels.  The heaviest stations and
+    channels are tracked individually with the Space-Saving algorithm
+    and returned, with rates over a recent interval, by
+    sl_traffic_snapshot().  The traffic of any other station or channel
+    is estimated from a count-min sketch with sl_traffic_estimate().
+
+    Snapshots and estimates may be read from other threads without
+    blocking collection.
+
+    @{ */
+
+/** @brief Traffic accounting, an opaque structure */
+typedef struct SLtraffic SLtraffic;
+
+#define SLTRAFFIC_STATION      0  //!< Snapshot of stations
+#define SLTRAFFIC_CHANNEL      1  //!< Snapshot of channels
+#define SLTRAFFIC_ORDER_BYTES  0  //!< Order snapshot by total bytes
+#define SLTRAFFIC_ORDER_RATE   1  //!< Order snapshot by rate in last interval
+
+/** @brief Snapshot of the traffic of a station or channel */
+typedef struct SLtrafficentry
+{
+  char     key[64];            //!< Station ID or FDSN source identifier
+  uint64_t bytes;              //!< Bytes received, upper bound
+  uint64_t packets;            //!< Packets received, upper bound
+  uint64_t error;              //!< Maximum overestimate of bytes
+  uint64_t packeterror;        //!< Maximum overestimate of packets
+  double   rate;               //!< Bytes per second in last complete interval
+  double   packetrate;         //!< Packets per second in last complete interval
+  int64_t  lastseen;           //!< Time of last packet
+} SLtrafficentry;
+
+extern SLtraffic *sl_initsltraffic (uint32_t topk, uint32_t sketchwidth,
+                                    uint32_t interval, int channels);
+extern void sl_freesltraffic (SLtraffic *traffic);
+extern int sl_traffic_add (SLtraffic *traffic, const char *stationid,
+                           const char *sourceid, uint32_t length);
+extern int sl_traffic_snapshot (SLtraffic *traffic, int level, SLtrafficentry *entries,
+                                uint32_t maxentries, int order);
+extern int sl_traffic_estimate (SLtraffic *traffic, const char *key,
+                                uint64_t *bytes, uint64_t *packets);
+extern int sl_traffic_totals (SLtraffic *traffic, uint64_t *bytes, uint64_t *packets);
+extern void sl_traffic_reset (SLtraffic *traffic);
+/** @} */
+
 /** @addtogroup logging
     @{ */
 
@@ -472,6 +1078,25 @@ extern int sl_recoverstate (SLCD *slconn, const char *statefile);
 extern int sl_savestate (SLCD *slconn, const char *statefile);
 /** @} */
 
+/** @addtogroup memory
+    @brief Control of memory allocation by the library
+
+    All memory allocated by the library, including by the TLS
+    implementation, uses the allocator set with sl_set_allocator(),
+    by default the system malloc(), realloc() and free().
+
+    @{ */
+extern int sl_set_allocator (void *(*malloc_fn) (size_t size, void *data),
+                             void *(*realloc_fn) (void *ptr, size_t size, void *data),
+                             void (*free_fn) (void *ptr, void *data),
+                             void *data);
+extern void *sl_malloc (size_t size);
+extern void *sl_calloc (size_t count, size_t size);
+extern void *sl_realloc (void *ptr, size_t size);
+extern char *sl_strdup (const char *string);
+extern void sl_free (void *ptr);
+/** @} */
+
 /** @addtogroup utility-functions
     @brief General utilities
 
@@ -486,8 +1111,19 @@ extern int sl_payload_info (const SLlog *log, const SLpacketinfo *packetinfo,
                  char *sourceid, size_t sourceid_size,
                  char *starttimestr, size_t starttimestr_size,
                  double *samplerate,  uint32_t *samplecount);
+extern int64_t sl_payload_starttime (const SLlog *log, const SLpacketinfo *packetinfo,
+                                     const char *plbuffer, uint32_t plbuffer_size);
+extern int64_t sl_payload_decode (const SLlog *log, const SLpacketinfo *packetinfo,
+                                  const char *plbuffer, uint32_t plbuffer_size,
+                                  void *samples, uint32_t maxsamples, char *sampletype);
+extern int sl_payload_ms2to3 (const SLlog *log, const char *ms2, uint32_t ms2length,
+                              char *ms3, uint32_t ms3size);
 extern uint8_t sl_littleendianhost (void);
 extern int sl_doy2md (int year, int jday, int *month, int *mday);
+extern int64_t sl_time2nstime (int year, int yday, int hour, int min, int sec, uint32_t nsec);
+extern int sl_nstime2time (int64_t nstime, int *year, int *yday, int *hour,
+                           int *min, int *sec, uint32_t *nsec);
+extern char *sl_nstime2isotime (int64_t nstime, char *isotime, size_t isotimesize);
 extern char *sl_protocol_details (LIBPROTOCOL protocol, uint8_t *major, uint8_t *minor);
 extern const char *sl_formatstr (char format, char subformat);
 extern const char *sl_strerror(void);
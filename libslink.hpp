@@ -0,0 +1,731 @@
+/***************************************************************************
+ * libslink.hpp:
+ *
+ * Optional header-only C++20 interface for the SeedLink library (libslink).
+ *
+ * Provides RAII ownership of SeedLink connections, move-only packets
+ * exposed as std::span views of pooled payload buffers, coroutine
+ * awaitables for packet collection driven by the non-blocking
+ * sl_collect() interface, and compile-time dispatch of packets to
+ * handlers by payload format.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#ifndef LIBSLINK_HPP
+#define LIBSLINK_HPP 1
+
+#if !defined(__cplusplus) || __cplusplus < 202002L
+#error "libslink.hpp requires C++20 or later"
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "libslink.h"
+
+/** @defgroup cxx-interface C++ interface
+    @brief Header-only C++20 interface in libslink.hpp
+
+    A thin layer over the C interface for C++20 applications:
+
+    - slink::Connection owns an ::SLCD and frees it on destruction.
+
+    - slink::Packet is a move-only packet whose payload is exposed as a
+    \c std::span<const std::byte> view of a pooled buffer.  The buffer
+    is filled directly by sl_collect() and returned to the pool when
+    the packet is destroyed, no payload copies are made.
+
+    - slink::Loop and slink::Task allow packet collection with
+    \c co_await using the non-blocking mode of sl_collect().
+
+    - slink::dispatch() calls the handler overload selected at compile
+    time by payload format, see slink::format.
+
+    @code
+    slink::Task
+    reader (slink::Loop &loop, slink::Connection &conn)
+    {
+      while (auto packet = co_await loop.collect (conn))
+      {
+        slink::dispatch (*packet, slink::overloaded{
+          [] (slink::format::MSeed3, const slink::Packet &p) { ... },
+          [] (slink::format::JSON, const slink::Packet &p) { ... },
+          [] (auto, const slink::Packet &) { } });
+      }
+    }
+    @endcode
+
+    @{ */
+
+namespace slink
+{
+
+/** @brief Exception thrown for errors reported by the C interface */
+class Error : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+namespace detail
+{
+
+/** @cond UNDOCUMENTED */
+/* Pool of fixed-size payload buffers shared by a connection and its
+ * packets.  Buffers larger than the pool size are never pooled. */
+struct PoolState
+{
+  std::mutex lock;
+  std::vector<std::unique_ptr<std::byte[]>> free;
+  std::size_t buffersize;
+  std::size_t maxfree;
+
+  PoolState (std::size_t size, std::size_t max) : buffersize (size), maxfree (max) {}
+
+  std::unique_ptr<std::byte[]>
+  acquire (std::size_t size)
+  {
+    if (size <= buffersize)
+    {
+      std::lock_guard<std::mutex> guard (lock);
+
+      if (!free.empty ())
+      {
+        auto buffer = std::move (free.back ());
+        free.pop_back ();
+        return buffer;
+      }
+
+      size = buffersize;
+    }
+
+    return std::unique_ptr<std::byte[]> (new std::byte[size]);
+  }
+
+  void
+  release (std::unique_ptr<std::byte[]> buffer, std::size_t size)
+  {
+    if (!buffer || size != buffersize)
+      return;
+
+    std::lock_guard<std::mutex> guard (lock);
+
+    if (free.size () < maxfree)
+      free.push_back (std::move (buffer));
+  }
+};
+/** @endcond */
+
+} /* namespace detail */
+
+/** @brief Compile-time tags for payload formats, see @ref payload-formats */
+namespace format
+{
+template <char F>
+struct Tag
+{
+  static constexpr char value = F; //!< Payload format character
+};
+
+using Unknown  = Tag<SLPAYLOAD_UNKNOWN>;        //!< Unknown payload
+using Info     = Tag<SLPAYLOAD_MSEED2INFO>;     //!< miniSEED 2 INFO payload
+using InfoTerm = Tag<SLPAYLOAD_MSEED2INFOTERM>; //!< miniSEED 2 INFO payload, terminated
+using MSeed2   = Tag<SLPAYLOAD_MSEED2>;         //!< miniSEED 2 payload
+using MSeed3   = Tag<SLPAYLOAD_MSEED3>;         //!< miniSEED 3 payload
+using JSON     = Tag<SLPAYLOAD_JSON>;           //!< JSON payload
+using XML      = Tag<SLPAYLOAD_XML>;            //!< XML payload
+} /* namespace format */
+
+/***********************************************************************
+ * @brief A collected packet owning a pooled payload buffer
+ *
+ * Packets are move-only.  The payload is a view of the buffer that
+ * sl_collect() wrote into and remains valid for the lifetime of the
+ * packet, the buffer returns to its pool on destruction.
+ *
+ * For segments returned in chunked mode, see sl_set_chunkmode(), the
+ * payload is the segment at chunkoffset() of the complete payload and
+ * chunkfinal() is true for the last segment.
+ ***********************************************************************/
+class Packet
+{
+public:
+  Packet () = default;
+  Packet (const Packet &) = delete;
+  Packet &operator= (const Packet &) = delete;
+  Packet (Packet &&) noexcept = default;
+
+  Packet &
+  operator= (Packet &&other) noexcept
+  {
+    if (this != &other)
+    {
+      release ();
+      info_       = other.info_;
+      buffer_     = std::move (other.buffer_);
+      buffersize_ = other.buffersize_;
+      length_     = other.length_;
+      chunkoffset_ = other.chunkoffset_;
+      chunkfinal_ = other.chunkfinal_;
+      pool_       = std::move (other.pool_);
+    }
+
+    return *this;
+  }
+
+  ~Packet () { release (); }
+
+  /** @brief Packet details as reported by sl_collect() */
+  const SLpacketinfo &info () const noexcept { return info_; }
+
+  /** @brief View of the payload (or payload segment in chunked mode) */
+  std::span<const std::byte>
+  payload () const noexcept
+  {
+    return {buffer_.get (), length_};
+  }
+
+  /** @brief Payload as a character view, e.g. for JSON and XML payloads */
+  std::string_view
+  text () const noexcept
+  {
+    return {reinterpret_cast<const char *> (buffer_.get ()), length_};
+  }
+
+  /** @brief Offset of a segment in the complete payload, chunked mode */
+  std::size_t chunkoffset () const noexcept { return chunkoffset_; }
+
+  /** @brief True for complete payloads and the final segment in chunked mode */
+  bool chunkfinal () const noexcept { return chunkfinal_; }
+
+  char format () const noexcept { return info_.payloadformat; }
+  uint64_t seqnum () const noexcept { return info_.seqnum; }
+  std::string_view stationid () const noexcept { return info_.stationid; }
+
+  /** @brief Source identifier of a miniSEED payload, empty if not available */
+  std::string
+  sourceid () const
+  {
+    char sid[64] = {0};
+
+    if (sl_payload_info (nullptr, &info_, data (), length_,
+                         sid, sizeof (sid), nullptr, 0, nullptr, nullptr) < 0)
+      return {};
+
+    return sid;
+  }
+
+  /** @brief Start time of a miniSEED payload as nanoseconds since the epoch */
+  std::optional<int64_t>
+  starttime () const
+  {
+    int64_t nstime = sl_payload_starttime (nullptr, &info_, data (), length_);
+
+    if (nstime == SLTERROR)
+      return std::nullopt;
+
+    return nstime;
+  }
+
+private:
+  friend class Connection;
+
+  Packet (const SLpacketinfo &info, std::unique_ptr<std::byte[]> buffer,
+          std::size_t buffersize, std::size_t length,
+          std::shared_ptr<detail::PoolState> pool)
+      : info_ (info), buffer_ (std::move (buffer)), buffersize_ (buffersize),
+        length_ (length), pool_ (std::move (pool))
+  {
+  }
+
+  const char *
+  data () const noexcept
+  {
+    return reinterpret_cast<const char *> (buffer_.get ());
+  }
+
+  void
+  release () noexcept
+  {
+    if (pool_ && buffer_)
+      pool_->release (std::move (buffer_), buffersize_);
+
+    buffer_.reset ();
+    pool_.reset ();
+    length_ = 0;
+  }
+
+  SLpacketinfo info_ {};
+  std::unique_ptr<std::byte[]> buffer_;
+  std::size_t buffersize_ = 0;
+  std::size_t length_     = 0;
+  std::size_t chunkoffset_ = 0;
+  bool chunkfinal_ = true;
+  std::shared_ptr<detail::PoolState> pool_;
+};
+
+/***********************************************************************
+ * @brief RAII owner of an ::SLCD connection description
+ *
+ * The connection is configured in non-blocking mode so that
+ * try_collect() never blocks, making it suitable for use with ::Loop.
+ * The ::SLCD is disconnected and freed on destruction.
+ *
+ * The underlying ::SLCD is available with get() for any configuration
+ * not wrapped here.
+ ***********************************************************************/
+class Connection
+{
+public:
+  /** @brief Default pooled payload buffer size */
+  static constexpr std::size_t default_buffersize = 16384;
+
+  explicit Connection (const char *clientname, const char *clientversion = nullptr,
+                       std::size_t buffersize = default_buffersize,
+                       std::size_t maxpooled = 64)
+      : slconn_ (sl_initslcd (clientname, clientversion)),
+        pool_ (std::make_shared<detail::PoolState> (buffersize, maxpooled))
+  {
+    if (!slconn_)
+      throw Error ("sl_initslcd() failed");
+
+    if (sl_set_blockingmode (slconn_, 1))
+    {
+      sl_freeslcd (slconn_);
+      throw Error ("sl_set_blockingmode() failed");
+    }
+  }
+
+  Connection (const Connection &) = delete;
+  Connection &operator= (const Connection &) = delete;
+
+  Connection (Connection &&other) noexcept
+      : slconn_ (std::exchange (other.slconn_, nullptr)),
+        pool_ (std::move (other.pool_)),
+        pending_ (std::move (other.pending_)),
+        pendingsize_ (std::exchange (other.pendingsize_, 0)),
+        done_ (other.done_)
+  {
+  }
+
+  Connection &
+  operator= (Connection &&other) noexcept
+  {
+    if (this != &other)
+    {
+      close ();
+      slconn_      = std::exchange (other.slconn_, nullptr);
+      pool_        = std::move (other.pool_);
+      pending_     = std::move (other.pending_);
+      pendingsize_ = std::exchange (other.pendingsize_, 0);
+      done_        = other.done_;
+    }
+
+    return *this;
+  }
+
+  ~Connection () { close (); }
+
+  /** @brief The underlying ::SLCD */
+  SLCD *get () const noexcept { return slconn_; }
+
+  void
+  set_server (const char *address)
+  {
+    if (sl_set_serveraddress (slconn_, address))
+      throw Error ("sl_set_serveraddress() failed");
+  }
+
+  void
+  add_stream (const char *stationid, const char *selectors = nullptr,
+              uint64_t seqnum = SL_UNSETSEQUENCE, const char *timestamp = nullptr)
+  {
+    if (sl_add_stream (slconn_, stationid, selectors, seqnum, timestamp))
+      throw Error ("sl_add_stream() failed");
+  }
+
+  void
+  set_allstation_params (const char *selectors, uint64_t seqnum = SL_UNSETSEQUENCE,
+                         const char *timestamp = nullptr)
+  {
+    if (sl_set_allstation_params (slconn_, selectors, seqnum, timestamp))
+      throw Error ("sl_set_allstation_params() failed");
+  }
+
+  void
+  request_info (const char *infostr)
+  {
+    if (sl_request_info (slconn_, infostr))
+      throw Error ("sl_request_info() failed");
+  }
+
+  /** @brief Request termination of the connection, see sl_terminate() */
+  void terminate () noexcept { sl_terminate (slconn_); }
+
+  /** @brief True when the connection has terminated and will return no more packets */
+  bool terminated () const noexcept { return !slconn_ || done_; }
+
+  /***********************************************************************
+   * @brief Collect a packet without blocking
+   *
+   * Payloads are collected directly into pooled buffers, buffers are
+   * grown as needed when sl_collect() reports SLTOOLARGE.
+   *
+   * @returns A packet, or no value if none is available or the
+   * connection has terminated, check terminated() to distinguish.
+   ***********************************************************************/
+  std::optional<Packet>
+  try_collect ()
+  {
+    const SLpacketinfo *packetinfo = nullptr;
+
+    if (terminated ())
+      return std::nullopt;
+
+    if (!pending_)
+    {
+      pending_     = pool_->acquire (0);
+      pendingsize_ = pool_->buffersize;
+    }
+
+    for (;;)
+    {
+      int status = sl_collect (slconn_, &packetinfo,
+                               reinterpret_cast<char *> (pending_.get ()),
+                               static_cast<uint32_t> (pendingsize_));
+
+      if (status == SLPACKET || status == SLCHUNK)
+      {
+        std::size_t length = (status == SLCHUNK) ? slconn_->stat->chunklength
+                                                 : packetinfo->payloadcollected;
+
+        Packet packet (*packetinfo, std::move (pending_), pendingsize_, length, pool_);
+        pendingsize_ = 0;
+
+        if (status == SLCHUNK)
+        {
+          packet.chunkoffset_ = slconn_->stat->chunkoffset;
+          packet.chunkfinal_  = slconn_->stat->chunkfinal;
+        }
+        return packet;
+      }
+      else if (status == SLTOOLARGE)
+      {
+        /* Grow the buffer, preserving the partial payload already collected */
+        auto larger = pool_->acquire (packetinfo->payloadlength);
+        std::memcpy (larger.get (), pending_.get (), packetinfo->payloadcollected);
+        pool_->release (std::move (pending_), pendingsize_);
+        pending_     = std::move (larger);
+        pendingsize_ = packetinfo->payloadlength;
+        continue;
+      }
+      else if (status == SLTERMINATE)
+      {
+        done_ = true;
+      }
+
+      return std::nullopt;
+    }
+  }
+
+  /***********************************************************************
+   * @brief Wait for the connection to become readable
+   *
+   * When not connected the wait is a sleep, as the connection is
+   * (re)established by try_collect().
+   *
+   * @returns True if the socket is readable
+   ***********************************************************************/
+  bool
+  wait (std::chrono::milliseconds timeout) const
+  {
+    if (terminated ())
+      return false;
+
+    if (slconn_->link == -1)
+    {
+      std::this_thread::sleep_for (timeout);
+      return false;
+    }
+
+    return sl_poll (slconn_, 1, 0, static_cast<int> (timeout.count ())) > 0;
+  }
+
+private:
+  void
+  close () noexcept
+  {
+    if (slconn_)
+    {
+      if (slconn_->link != -1)
+        sl_disconnect (slconn_);
+
+      sl_freeslcd (slconn_);
+      slconn_ = nullptr;
+    }
+
+    if (pool_ && pending_)
+      pool_->release (std::move (pending_), pendingsize_);
+  }
+
+  SLCD *slconn_ = nullptr;
+  std::shared_ptr<detail::PoolState> pool_;
+  std::unique_ptr<std::byte[]> pending_;
+  std::size_t pendingsize_ = 0;
+  bool done_               = false;
+};
+
+/***********************************************************************
+ * @brief Coroutine type for packet handling tasks
+ *
+ * Tasks start immediately and run until the first suspension, usually
+ * a \c co_await of Loop::collect().  An exception escaping the
+ * coroutine is rethrown by get().
+ ***********************************************************************/
+class Task
+{
+public:
+  struct promise_type
+  {
+    std::exception_ptr exception;
+
+    Task get_return_object () { return Task (handle::from_promise (*this)); }
+    std::suspend_never initial_suspend () noexcept { return {}; }
+    std::suspend_always final_suspend () noexcept { return {}; }
+    void return_void () noexcept {}
+    void unhandled_exception () noexcept { exception = std::current_exception (); }
+  };
+
+  using handle = std::coroutine_handle<promise_type>;
+
+  Task (Task &&other) noexcept : coro_ (std::exchange (other.coro_, nullptr)) {}
+  Task (const Task &) = delete;
+  Task &operator= (const Task &) = delete;
+  Task &operator= (Task &&) = delete;
+
+  ~Task ()
+  {
+    if (coro_)
+      coro_.destroy ();
+  }
+
+  /** @brief True when the coroutine has run to completion */
+  bool done () const noexcept { return !coro_ || coro_.done (); }
+
+  /** @brief Rethrow any exception that escaped the completed coroutine */
+  void
+  get () const
+  {
+    if (coro_ && coro_.done () && coro_.promise ().exception)
+      std::rethrow_exception (coro_.promise ().exception);
+  }
+
+private:
+  explicit Task (handle coro) : coro_ (coro) {}
+
+  handle coro_;
+};
+
+/***********************************************************************
+ * @brief Single-threaded event loop resuming coroutines with packets
+ *
+ * Coroutines suspend in \c co_await collect(conn) and are resumed by
+ * run() or run_once() when a packet is collected for their connection
+ * or the connection terminates, in which case the awaited value is
+ * empty.  Each connection should have at most one waiting coroutine.
+ ***********************************************************************/
+class Loop
+{
+  struct Waiter
+  {
+    Connection *conn;
+    std::optional<Packet> *result;
+    std::coroutine_handle<> coro;
+  };
+
+public:
+  /** @brief Awaitable returned by collect() */
+  class Awaitable
+  {
+  public:
+    Awaitable (Loop &loop, Connection &conn) : loop_ (loop), conn_ (conn) {}
+
+    bool
+    await_ready ()
+    {
+      result_ = conn_.try_collect ();
+      return result_.has_value () || conn_.terminated ();
+    }
+
+    void
+    await_suspend (std::coroutine_handle<> coro)
+    {
+      loop_.waiters_.push_back ({&conn_, &result_, coro});
+    }
+
+    std::optional<Packet> await_resume () { return std::move (result_); }
+
+  private:
+    Loop &loop_;
+    Connection &conn_;
+    std::optional<Packet> result_;
+  };
+
+  /** @brief Collect the next packet from @p conn, empty on termination */
+  Awaitable collect (Connection &conn) { return Awaitable (*this, conn); }
+
+  /** @brief True if any coroutine is waiting for a packet */
+  bool pending () const noexcept { return !waiters_.empty (); }
+
+  /***********************************************************************
+   * @brief Collect for each waiting coroutine once, resuming as needed
+   *
+   * If no waiter progressed, wait up to @p timeout for the next
+   * connection in turn to become readable.
+   *
+   * @returns Number of coroutines resumed
+   ***********************************************************************/
+  std::size_t
+  run_once (std::chrono::milliseconds timeout = std::chrono::milliseconds (100))
+  {
+    std::size_t resumed = 0;
+    std::size_t count   = waiters_.size ();
+
+    for (std::size_t idx = 0; idx < count; idx++)
+    {
+      Waiter waiter = waiters_.front ();
+      waiters_.pop_front ();
+
+      *waiter.result = waiter.conn->try_collect ();
+
+      if (waiter.result->has_value () || waiter.conn->terminated ())
+      {
+        resumed++;
+        waiter.coro.resume ();
+      }
+      else
+      {
+        waiters_.push_back (waiter);
+      }
+    }
+
+    if (resumed == 0 && !waiters_.empty ())
+    {
+      waiters_.front ().conn->wait (timeout);
+      waiters_.push_back (waiters_.front ());
+      waiters_.pop_front ();
+    }
+
+    return resumed;
+  }
+
+  /** @brief Run until no coroutines are waiting */
+  void
+  run ()
+  {
+    while (pending ())
+      run_once ();
+  }
+
+private:
+  std::deque<Waiter> waiters_;
+};
+
+/** @brief Combine lambdas into a single overloaded handler for dispatch() */
+template <class... Ts>
+struct overloaded : Ts...
+{
+  using Ts::operator()...;
+};
+
+template <class... Ts>
+overloaded (Ts...) -> overloaded<Ts...>;
+
+/** @cond UNDOCUMENTED */
+namespace detail
+{
+template <class Tag, class Handler>
+inline bool
+dispatch_as (const Packet &packet, Handler &&handler)
+{
+  if constexpr (std::is_invocable_v<Handler, Tag, const Packet &>)
+  {
+    if (packet.format () == Tag::value)
+    {
+      std::forward<Handler> (handler) (Tag {}, packet);
+      return true;
+    }
+  }
+
+  return false;
+}
+} /* namespace detail */
+/** @endcond */
+
+/***********************************************************************
+ * @brief Call the handler overload for the payload format of a packet
+ *
+ * The handler is invoked as \c handler(Tag{}, packet) where \c Tag is
+ * the slink::format tag for the payload format.  Only formats with a
+ * matching overload are tested, selected at compile time, a generic
+ * \c auto overload handles any remaining formats.
+ *
+ * @returns True if a handler was called
+ ***********************************************************************/
+template <class Handler>
+inline bool
+dispatch (const Packet &packet, Handler &&handler)
+{
+  if (detail::dispatch_as<format::MSeed2> (packet, handler) ||
+      detail::dispatch_as<format::MSeed3> (packet, handler) ||
+      detail::dispatch_as<format::JSON> (packet, handler) ||
+      detail::dispatch_as<format::XML> (packet, handler) ||
+      detail::dispatch_as<format::Info> (packet, handler) ||
+      detail::dispatch_as<format::InfoTerm> (packet, handler))
+    return true;
+
+  if constexpr (std::is_invocable_v<Handler, format::Unknown, const Packet &>)
+  {
+    std::forward<Handler> (handler) (format::Unknown {}, packet);
+    return true;
+  }
+
+  return false;
+}
+
+} /* namespace slink */
+
+/** @} */
+
+#endif /* LIBSLINK_HPP */
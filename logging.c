@@ -81,7 +81,7 @@ sl_loginit_r (SLCD *slconn, int verbosity,
 
   if (slconn->log == NULL)
   {
-    slconn->log = (SLlog *)malloc (sizeof (SLlog));
+    slconn->log = (SLlog *)sl_malloc (sizeof (SLlog));
 
     slconn->log->log_print  = NULL;
     slconn->log->logprefix  = NULL;
@@ -119,7 +119,7 @@ sl_loginit_rl (SLlog *log, int verbosity,
 
   if (log == NULL)
   {
-    logp = (SLlog *)malloc (sizeof (SLlog));
+    logp = (SLlog *)sl_malloc (sizeof (SLlog));
 
     logp->log_print  = NULL;
     logp->logprefix  = NULL;
@@ -0,0 +1,448 @@
+/***************************************************************************
+ * lpcache.c
+ *
+ * Routines for caching the most recent packet of each data source.
+ *
+ * The cache is a fixed size, open addressing hash table keyed on FDSN
+ * source identifier.  Slots are claimed with compare-and-swap and
+ * never removed, and each slot is protected by a sequence lock so that
+ * other threads may read consistent snapshots without blocking the
+ * thread(s) updating the cache.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+#include "mseedformat.h"
+#include "slatomic.h"
+
+/* Bytes retained in header-only mode, the largest miniSEED 3 fixed
+ * header with source identifier, rounded up */
+#define LPCACHE_HEADERSIZE 296
+
+/* Slot states */
+#define SLOT_EMPTY   0
+#define SLOT_CLAIMED 1
+#define SLOT_READY   2
+
+/* Cache slot, followed by retained payload data */
+typedef struct LPSlot
+{
+  volatile uint32_t state;     /* Slot state, SLOT_* */
+  volatile uint32_t sequence;  /* Sequence lock, odd while writing */
+  uint64_t hash;               /* Hash of source ID, set before ready */
+  SLlpentry entry;             /* Packet details */
+} LPSlot;
+
+struct SLlpcache
+{
+  char *slots;                 /* Slot storage */
+  size_t slotsize;             /* Size of each slot including data */
+  uint32_t mask;               /* Table size - 1, size is a power of 2 */
+  uint32_t maxsources;         /* Maximum number of sources */
+  uint32_t capacity;           /* Maximum payload bytes retained per slot */
+  int8_t headeronly;           /* Retain only miniSEED fixed headers */
+  volatile uint32_t count;     /* Number of claimed and reserved slots */
+};
+
+#define SLOT(cache, idx) ((LPSlot *)((cache)->slots + (size_t)(idx) * (cache)->slotsize))
+#define SLOTDATA(slot)   ((char *)(slot) + sizeof (LPSlot))
+
+static LPSlot *find_slot (SLlpcache *cache, const char *sourceid, uint64_t hash, int claim);
+static void read_slot (LPSlot *slot, SLlpentry *entry, char *buffer, uint32_t buffersize);
+static uint64_t hash_sourceid (const char *sourceid);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new last packet cache
+ *
+ * Allocate a cache for the most recent packet of up to \a maxsources
+ * data sources, identified by FDSN source identifier.  All memory is
+ * allocated here, the cache is never resized.
+ *
+ * If \a retainlength is 0 only the fixed header of each miniSEED
+ * record is retained, otherwise up to \a retainlength bytes of each
+ * payload are retained.
+ *
+ * The cache may be fed from one or more connections with
+ * sl_set_lpcache(), or by calling sl_lpcache_update() directly.
+ *
+ * @param[in] maxsources    Maximum number of data sources to cache
+ * @param[in] retainlength  Payload bytes to retain, 0 for header only
+ *
+ * @returns An initialized ::SLlpcache on success, NULL on error.
+ ***************************************************************************/
+SLlpcache *
+sl_initlpcache (uint32_t maxsources, uint32_t retainlength)
+{
+  SLlpcache *cache;
+  uint32_t tablesize = 16;
+
+  if (maxsources == 0 || maxsources > (1U << 30))
+  {
+    sl_log_r (NULL, 2, 0, "%s(): invalid maximum sources: %u\n", __func__, maxsources);
+    return NULL;
+  }
+
+  /* Table size is a power of 2 at least twice the maximum sources */
+  while (tablesize < maxsources * 2)
+    tablesize <<= 1;
+
+  if ((cache = (SLlpcache *)sl_malloc (sizeof (SLlpcache))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (cache, 0, sizeof (SLlpcache));
+
+  cache->headeronly = (retainlength == 0) ? 1 : 0;
+  cache->capacity   = (retainlength == 0) ? LPCACHE_HEADERSIZE : retainlength;
+  cache->slotsize   = (sizeof (LPSlot) + cache->capacity + 7) & ~((size_t)7);
+  cache->mask       = tablesize - 1;
+  cache->maxsources = maxsources;
+
+  if ((cache->slots = (char *)sl_calloc (tablesize, cache->slotsize)) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_free (cache);
+    return NULL;
+  }
+
+  return cache;
+} /* End of sl_initlpcache() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a last packet cache
+ *
+ * Any connections feeding the cache must be detached, see
+ * sl_set_lpcache(), and no other threads may be reading it.
+ *
+ * @param[in] cache  Cache to free
+ ***************************************************************************/
+void
+sl_freelpcache (SLlpcache *cache)
+{
+  if (!cache)
+    return;
+
+  sl_free (cache->slots);
+  sl_free (cache);
+} /* End of sl_freelpcache() */
+
+/**********************************************************************/ /**
+ * @brief Update a last packet cache with a packet
+ *
+ * Cache the details and retained payload of a miniSEED packet as the
+ * most recent for its source identifier, unless a packet with a later
+ * start time is already cached.  Other payload types are ignored.
+ *
+ * Multiple threads may update the cache concurrently.
+ *
+ * @param[in] cache       Cache to update
+ * @param[in] log         Logging parameters, or NULL
+ * @param[in] packetinfo  Packet details as returned by sl_collect()
+ * @param[in] payload     Packet payload
+ *
+ * @retval  1 : packet cached
+ * @retval  0 : packet ignored, not miniSEED or older than cached packet
+ * @retval -1 : error, e.g. the maximum number of sources is reached
+ ***************************************************************************/
+int
+sl_lpcache_update (SLlpcache *cache, const SLlog *log,
+                   const SLpacketinfo *packetinfo, const char *payload)
+{
+  LPSlot *slot;
+  char sourceid[64] = {0};
+  uint32_t sequence;
+  uint32_t length;
+  int64_t starttime;
+  int updated = 0;
+
+  if (!cache || !packetinfo || !payload)
+    return -1;
+
+  if (packetinfo->payloadformat != SLPAYLOAD_MSEED2 &&
+      packetinfo->payloadformat != SLPAYLOAD_MSEED3)
+    return 0;
+
+  if (sl_payload_info (log, packetinfo, payload, packetinfo->payloadlength,
+                       sourceid, sizeof (sourceid), NULL, 0, NULL, NULL) == -1)
+    return -1;
+
+  starttime = sl_payload_starttime (log, packetinfo, payload, packetinfo->payloadlength);
+
+  if ((slot = find_slot (cache, sourceid, hash_sourceid (sourceid), 1)) == NULL)
+  {
+    sl_log_rl (log, 1, 1, "%s(): cache full, cannot add %s\n", __func__, sourceid);
+    return -1;
+  }
+
+  /* Determine length of payload to retain */
+  if (cache->headeronly)
+  {
+    if (packetinfo->payloadformat == SLPAYLOAD_MSEED3 &&
+        packetinfo->payloadlength >= MS3FSDH_LENGTH)
+      length = MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH (payload);
+    else
+      length = 64;
+  }
+  else
+  {
+    length = cache->capacity;
+  }
+
+  if (length > packetinfo->payloadlength)
+    length = packetinfo->payloadlength;
+  if (length > cache->capacity)
+    length = cache->capacity;
+
+  /* Acquire sequence lock by moving from even to odd */
+  for (;;)
+  {
+    sequence = ATOMIC_LOAD (&slot->sequence);
+
+    if ((sequence & 1) == 0 && ATOMIC_CAS (&slot->sequence, sequence, sequence + 1))
+      break;
+  }
+
+  slot->entry.updates++;
+
+  if (slot->entry.updates == 1 ||
+      starttime == SLTERROR ||
+      slot->entry.starttime == SLTERROR ||
+      starttime >= slot->entry.starttime)
+  {
+    memcpy (slot->entry.stationid, packetinfo->stationid, sizeof (slot->entry.stationid));
+    slot->entry.seqnum           = packetinfo->seqnum;
+    slot->entry.starttime        = starttime;
+    slot->entry.received         = sl_nstime ();
+    slot->entry.payloadformat    = packetinfo->payloadformat;
+    slot->entry.payloadsubformat = packetinfo->payloadsubformat;
+    slot->entry.payloadlength    = packetinfo->payloadlength;
+    slot->entry.datalength       = length;
+    memcpy (SLOTDATA (slot), payload, length);
+
+    updated = 1;
+  }
+
+  /* Release sequence lock */
+  ATOMIC_STORE (&slot->sequence, sequence + 2);
+
+  return updated;
+} /* End of sl_lpcache_update() */
+
+/**********************************************************************/ /**
+ * @brief Get the most recent packet of a source from a last packet cache
+ *
+ * Copy a consistent snapshot of the most recent packet cached for
+ * \a sourceid.  The details are returned in \a entry and up to
+ * \a buffersize bytes of the retained payload are copied to \a buffer,
+ * the number of retained bytes is SLlpentry.datalength.
+ *
+ * This routine may be called from any thread while the cache is being
+ * updated, it does not block updates.
+ *
+ * @param[in]  cache       Cache to read
+ * @param[in]  sourceid    FDSN source identifier, e.g. "FDSN:IU_COLA_00_B_H_Z"
+ * @param[out] entry       Packet details
+ * @param[out] buffer      Buffer for retained payload, or NULL
+ * @param[in]  buffersize  Size of \a buffer
+ *
+ * @retval  1 : packet found
+ * @retval  0 : no packet cached for source
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_lpcache_get (SLlpcache *cache, const char *sourceid, SLlpentry *entry,
+                char *buffer, uint32_t buffersize)
+{
+  LPSlot *slot;
+
+  if (!cache || !sourceid || !entry)
+    return -1;
+
+  if ((slot = find_slot (cache, sourceid, hash_sourceid (sourceid), 0)) == NULL)
+    return 0;
+
+  read_slot (slot, entry, buffer, buffersize);
+
+  return 1;
+} /* End of sl_lpcache_get() */
+
+/**********************************************************************/ /**
+ * @brief Iterate over the sources of a last packet cache
+ *
+ * Return a snapshot of the next cached source, in no particular order,
+ * as described for sl_lpcache_get().  The \a cursor must be set to 0
+ * before the first call and is updated for subsequent calls.
+ *
+ * @param[in]     cache       Cache to read
+ * @param[in,out] cursor      Iteration position, initialize to 0
+ * @param[out]    entry       Packet details
+ * @param[out]    buffer      Buffer for retained payload, or NULL
+ * @param[in]     buffersize  Size of \a buffer
+ *
+ * @retval  1 : packet returned
+ * @retval  0 : no more sources
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_lpcache_next (SLlpcache *cache, uint32_t *cursor, SLlpentry *entry,
+                 char *buffer, uint32_t buffersize)
+{
+  LPSlot *slot;
+
+  if (!cache || !cursor || !entry)
+    return -1;
+
+  while (*cursor <= cache->mask)
+  {
+    slot = SLOT (cache, *cursor);
+    (*cursor)++;
+
+    if (ATOMIC_LOAD (&slot->state) == SLOT_READY)
+    {
+      read_slot (slot, entry, buffer, buffersize);
+      return 1;
+    }
+  }
+
+  return 0;
+} /* End of sl_lpcache_next() */
+
+/***************************************************************************
+ * find_slot:
+ *
+ * Find the slot for a source ID using linear probing, optionally
+ * claiming an empty slot if the source is not present.
+ *
+ * Returns a pointer to the slot on success, NULL if not found or the
+ * cache is full.
+ ***************************************************************************/
+static LPSlot *
+find_slot (SLlpcache *cache, const char *sourceid, uint64_t hash, int claim)
+{
+  LPSlot *slot;
+  uint32_t idx;
+  uint32_t probes;
+  uint32_t state;
+  uint32_t count;
+
+  idx = (uint32_t)hash & cache->mask;
+
+  for (probes = 0; probes <= cache->mask; probes++, idx = (idx + 1) & cache->mask)
+  {
+    slot = SLOT (cache, idx);
+
+    state = ATOMIC_LOAD (&slot->state);
+
+    if (state == SLOT_EMPTY)
+    {
+      if (!claim)
+        return NULL;
+
+      /* Reserve a source before claiming, a full cache never claims a slot */
+      do
+      {
+        count = ATOMIC_LOAD (&cache->count);
+
+        if (count >= cache->maxsources)
+          return NULL;
+      } while (!ATOMIC_CAS (&cache->count, count, count + 1));
+
+      if (ATOMIC_CAS (&slot->state, SLOT_EMPTY, SLOT_CLAIMED))
+      {
+        slot->hash = hash;
+        strncpy (slot->entry.sourceid, sourceid, sizeof (slot->entry.sourceid) - 1);
+        slot->entry.starttime = SLTERROR;
+
+        ATOMIC_STORE (&slot->state, SLOT_READY);
+
+        return slot;
+      }
+
+      /* Lost race for slot, release reservation, wait for claimant to finish and check it */
+      ATOMIC_ADD (&cache->count, -1);
+      state = ATOMIC_LOAD (&slot->state);
+    }
+
+    /* Wait for a slot being claimed to become ready */
+    while (state == SLOT_CLAIMED)
+      state = ATOMIC_LOAD (&slot->state);
+
+    if (state == SLOT_READY && slot->hash == hash &&
+        strcmp (slot->entry.sourceid, sourceid) == 0)
+      return slot;
+  }
+
+  return NULL;
+} /* End of find_slot() */
+
+/***************************************************************************
+ * read_slot:
+ *
+ * Copy a consistent snapshot of a slot, retrying while the slot is
+ * being written.
+ ***************************************************************************/
+static void
+read_slot (LPSlot *slot, SLlpentry *entry, char *buffer, uint32_t buffersize)
+{
+  uint32_t before;
+  uint32_t after;
+  uint32_t length;
+
+  do
+  {
+    while ((before = ATOMIC_LOAD (&slot->sequence)) & 1)
+      ;
+
+    memcpy (entry, &slot->entry, sizeof (SLlpentry));
+
+    if (buffer && buffersize > 0)
+    {
+      length = (entry->datalength < buffersize) ? entry->datalength : buffersize;
+      memcpy (buffer, SLOTDATA (slot), length);
+    }
+
+    ACQUIRE_FENCE ();
+    after = ATOMIC_LOAD (&slot->sequence);
+  } while (before != after);
+} /* End of read_slot() */
+
+/***************************************************************************
+ * hash_sourceid:
+ *
+ * Compute the 64-bit FNV-1a hash of a source ID.
+ ***************************************************************************/
+static uint64_t
+hash_sourceid (const char *sourceid)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  while (*sourceid)
+  {
+    hash ^= (uint8_t)*sourceid++;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+} /* End of hash_sourceid() */
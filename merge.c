@@ -0,0 +1,573 @@
+/***************************************************************************
+ * merge.c
+ *
+ * Routines for merging packets from a connection group in time order
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+
+/* Initial payload buffer size for each slot, grown as needed */
+#define MERGE_PAYLOAD_SIZE 512
+
+/* Marker for no slot */
+#define NOSLOT UINT32_MAX
+
+/* Buffered packet */
+typedef struct MergeSlot
+{
+  SLCD *slconn;                /* Connection that returned the packet */
+  SLpacketinfo packetinfo;     /* Copy of packet details */
+  char *payload;               /* Payload buffer */
+  uint32_t payloadsize;        /* Size of payload buffer */
+  int64_t starttime;           /* Record start time, ordering key */
+  int64_t arrivaltime;         /* Time packet was received */
+  uint64_t arrivalseq;         /* Arrival counter, ordering for equal start times */
+  uint32_t older;              /* Previous slot in arrival order */
+  uint32_t newer;              /* Next slot in arrival order */
+} MergeSlot;
+
+/* Time-ordered merge of a connection group */
+struct SLmerge
+{
+  SLCG *group;                 /* Connection group to collect from */
+  MergeSlot *slots;            /* Pool of packet slots */
+  uint32_t slotcount;          /* Number of slots in pool */
+  uint32_t *heap;              /* Min-heap of buffered slot indexes */
+  uint32_t heapcount;          /* Number of slots in heap */
+  uint32_t *freeslots;         /* Stack of free slot indexes, top slot is receiving */
+  uint32_t freecount;          /* Number of free slots */
+  uint32_t oldest;             /* Oldest buffered slot by arrival */
+  uint32_t newest;             /* Newest buffered slot by arrival */
+  uint32_t returned;           /* Slot returned to caller, released on next call */
+  int64_t latency;             /* Maximum time to buffer packets, nanoseconds */
+  int64_t lastemitted;         /* Start time of last packet returned in order */
+  uint64_t arrivalseq;         /* Arrival counter */
+  uint64_t latecount;          /* Count of late packets */
+  int latepolicy;              /* Late packet policy */
+  int8_t noblock;              /* Control blocking on collection */
+  int8_t draining;             /* Group has terminated, return remaining */
+};
+
+static int slot_before (const SLmerge *merge, uint32_t a, uint32_t b);
+static void heap_push (SLmerge *merge, uint32_t slot);
+static uint32_t heap_pop (SLmerge *merge);
+static void arrival_append (SLmerge *merge, uint32_t slot);
+static void arrival_remove (SLmerge *merge, uint32_t slot);
+static int return_slot (SLmerge *merge, uint32_t slot, SLCD **slconn,
+                        const SLpacketinfo **packetinfo, const char **payload);
+static void release_slot (SLmerge *merge, uint32_t slot);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new ::SLmerge for a connection group
+ *
+ * Allocate a new time-ordered merge of packets collected from the
+ * specified connection group.  Packets are buffered for up to
+ * \a latency_ms milliseconds after they are received and returned
+ * by sl_merge_collect() in order of record start time.
+ *
+ * At most \a maxpackets packets are buffered, when this limit is
+ * reached the earliest buffered packet is returned regardless of
+ * latency.  The buffer should be large enough to hold all packets
+ * received during the latency period.
+ *
+ * Packets with a start time earlier than a packet already returned
+ * are late, and are handled according to \a latepolicy:
+ * - ::SLMERGE_LATE_DELIVER, return the packet immediately, out of order
+ * - ::SLMERGE_LATE_DROP, discard the packet
+ *
+ * The group is collected in non-blocking mode, the blocking behavior
+ * of sl_merge_collect() is controlled by sl_merge_set_blockingmode().
+ * The group remains owned by the caller and must not be collected
+ * from directly while the merge is in use.
+ *
+ * @param[in] group       Connection group to collect from
+ * @param[in] maxpackets  Maximum number of packets to buffer
+ * @param[in] latency_ms  Maximum time to buffer packets, milliseconds
+ * @param[in] latepolicy  Policy for late packets
+ *
+ * @returns An initialized ::SLmerge on success, NULL on error.
+ ***************************************************************************/
+SLmerge *
+sl_initslmerge (SLCG *group, uint32_t maxpackets, uint32_t latency_ms,
+                int latepolicy)
+{
+  SLmerge *merge;
+  uint32_t idx;
+
+  if (!group || maxpackets == 0 || maxpackets == NOSLOT)
+    return NULL;
+
+  if (latepolicy != SLMERGE_LATE_DELIVER && latepolicy != SLMERGE_LATE_DROP)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): unrecognized late packet policy: %d\n", __func__, latepolicy);
+    return NULL;
+  }
+
+  merge = (SLmerge *)sl_malloc (sizeof (SLmerge));
+
+  if (merge == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (merge, 0, sizeof (SLmerge));
+
+  merge->slots     = (MergeSlot *)sl_calloc (maxpackets, sizeof (MergeSlot));
+  merge->heap      = (uint32_t *)sl_malloc (maxpackets * sizeof (uint32_t));
+  merge->freeslots = (uint32_t *)sl_malloc (maxpackets * sizeof (uint32_t));
+
+  if (merge->slots == NULL || merge->heap == NULL || merge->freeslots == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_freeslmerge (merge);
+    return NULL;
+  }
+
+  merge->group       = group;
+  merge->slotcount   = maxpackets;
+  merge->heapcount   = 0;
+  merge->oldest      = NOSLOT;
+  merge->newest      = NOSLOT;
+  merge->returned    = NOSLOT;
+  merge->latency     = (int64_t)latency_ms * (SLTMODULUS / 1000);
+  merge->lastemitted = SLTERROR;
+  merge->arrivalseq  = 0;
+  merge->latecount   = 0;
+  merge->latepolicy  = latepolicy;
+  merge->noblock     = 0;
+  merge->draining    = 0;
+
+  /* All slots are initially free, stacked so that slot 0 is used first */
+  for (idx = 0; idx < maxpackets; idx++)
+  {
+    merge->freeslots[idx] = maxpackets - idx - 1;
+
+    if ((merge->slots[idx].payload = (char *)sl_malloc (MERGE_PAYLOAD_SIZE)) == NULL)
+    {
+      sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+      sl_freeslmerge (merge);
+      return NULL;
+    }
+
+    merge->slots[idx].payloadsize = MERGE_PAYLOAD_SIZE;
+  }
+
+  merge->freecount = maxpackets;
+
+  sl_group_set_blockingmode (group, 1);
+
+  return merge;
+} /* End of sl_initslmerge() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a ::SLmerge
+ *
+ * Any packets remaining in the buffer are discarded.  The connection
+ * group is not freed, it remains owned by the caller.
+ *
+ * @param[in] merge  Time-ordered merge to free
+ ***************************************************************************/
+void
+sl_freeslmerge (SLmerge *merge)
+{
+  uint32_t idx;
+
+  if (!merge)
+    return;
+
+  if (merge->latecount > 0)
+    sl_log_r (NULL, 1, 1, "Merge received %" PRIu64 " late packet(s)\n", merge->latecount);
+
+  if (merge->slots)
+  {
+    for (idx = 0; idx < merge->slotcount; idx++)
+      sl_free (merge->slots[idx].payload);
+  }
+
+  sl_free (merge->slots);
+  sl_free (merge->heap);
+  sl_free (merge->freeslots);
+  sl_free (merge);
+} /* End of sl_freeslmerge() */
+
+/**********************************************************************/ /**
+ * @brief Set or unset the ::SLmerge blocking mode
+ *
+ * In blocking mode sl_merge_collect() will wait until a packet is
+ * ready to be returned or all group members have terminated.  In
+ * non-blocking mode sl_merge_collect() will return quickly.
+ *
+ * By default, the merge is set to blocking mode.
+ *
+ * @param merge     Time-ordered merge
+ * @param nonblock  Boolean flag, if non-zero set to non-blocking mode
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_merge_set_blockingmode (SLmerge *merge, int nonblock)
+{
+  if (!merge)
+    return -1;
+
+  merge->noblock = (nonblock) ? 1 : 0;
+
+  return 0;
+} /* End of sl_merge_set_blockingmode() */
+
+/**********************************************************************/ /**
+ * @brief Collect packets from a ::SLmerge in time order
+ *
+ * Designed to run in a loop of a client program in the same way as
+ * sl_collect().  Packets collected from the group are buffered and
+ * returned in order of record start time once they have been
+ * buffered for the configured latency, or when the buffer is full.
+ *
+ * Payloads that are not miniSEED, or for which a start time cannot
+ * be determined, are returned immediately.  Segments of payloads
+ * from members in chunked mode are returned immediately with
+ * \a SLCHUNK, see sl_set_chunkmode().
+ *
+ * The returned \a packetinfo and \a payload are owned by the merge
+ * and valid until the next call to sl_merge_collect().
+ *
+ * When all group members have terminated, the packets remaining in
+ * the buffer are returned in order before ::SLTERMINATE.
+ *
+ * @param[in]  merge       Time-ordered merge
+ * @param[out] slconn      Pointer to the member ::SLCD that returned the packet
+ * @param[out] packetinfo  Pointer to pointer to ::SLpacketinfo describing payload
+ * @param[out] payload     Pointer to packet payload
+ *
+ * @returns @ref collect-status
+ * @retval SLPACKET Complete packet returned
+ * @retval SLTERMINATE All members have terminated and buffer is empty, or error
+ * @retval SLNOPACKET  No packet ready, call again
+ * @retval SLCHUNK  Segment of payload returned, chunked mode only
+ *
+ * @sa sl_group_collect()
+ ***************************************************************************/
+int
+sl_merge_collect (SLmerge *merge, SLCD **slconn,
+                  const SLpacketinfo **packetinfo, const char **payload)
+{
+  const SLpacketinfo *grouppacketinfo = NULL;
+  SLCD *groupslconn = NULL;
+  MergeSlot *slot;
+  uint32_t slotidx;
+  int64_t current_time;
+  int64_t wait;
+  char *newpayload;
+  int status;
+
+  if (!merge || !slconn || !packetinfo || !payload)
+    return SLTERMINATE;
+
+  *slconn     = NULL;
+  *packetinfo = NULL;
+  *payload    = NULL;
+
+  /* Release slot returned by previous call */
+  if (merge->returned != NOSLOT)
+  {
+    release_slot (merge, merge->returned);
+    merge->returned = NOSLOT;
+  }
+
+  while (1)
+  {
+    current_time = sl_nstime ();
+
+    /* Return earliest packet if buffer is full, oldest has waited long enough, or draining */
+    if (merge->heapcount > 0 &&
+        (merge->freecount == 0 || merge->draining ||
+         merge->slots[merge->oldest].arrivaltime + merge->latency <= current_time))
+    {
+      slotidx = heap_pop (merge);
+      arrival_remove (merge, slotidx);
+
+      merge->lastemitted = merge->slots[slotidx].starttime;
+
+      return return_slot (merge, slotidx, slconn, packetinfo, payload);
+    }
+
+    if (merge->draining)
+      return SLTERMINATE;
+
+    /* Collect next packet from the group into the receiving slot, the top
+     * free slot remains receiving until a packet or segment is complete */
+    slotidx = merge->freeslots[merge->freecount - 1];
+    slot    = &merge->slots[slotidx];
+
+    status = sl_group_collect (merge->group, &groupslconn, &grouppacketinfo,
+                               slot->payload, slot->payloadsize);
+
+    if (status == SLTOOLARGE)
+    {
+      newpayload = (char *)sl_realloc (slot->payload, grouppacketinfo->payloadlength);
+
+      if (newpayload == NULL)
+      {
+        sl_log_r (groupslconn, 2, 0, "%s(): error allocating memory\n", __func__);
+        return SLTERMINATE;
+      }
+
+      slot->payload     = newpayload;
+      slot->payloadsize = grouppacketinfo->payloadlength;
+      continue;
+    }
+    else if (status == SLTERMINATE)
+    {
+      merge->draining = 1;
+      continue;
+    }
+    else if (status == SLNOPACKET)
+    {
+      if (merge->noblock)
+        return SLNOPACKET;
+
+      /* Wait for data up to 1/10 second or until the oldest packet is due */
+      wait = 100;
+      if (merge->heapcount > 0)
+      {
+        wait = (merge->slots[merge->oldest].arrivaltime + merge->latency - current_time) /
+               (SLTMODULUS / 1000);
+
+        if (wait > 100)
+          wait = 100;
+        else if (wait < 0)
+          wait = 0;
+      }
+
+      sl_group_poll (merge->group, (int)wait);
+      continue;
+    }
+
+    /* Packet received, populate slot */
+    merge->freecount--;
+
+    slot->slconn      = groupslconn;
+    slot->packetinfo  = *grouppacketinfo;
+    slot->arrivaltime = current_time;
+    slot->arrivalseq  = merge->arrivalseq++;
+    slot->starttime   = SLTERROR;
+
+    if (grouppacketinfo->payloadformat == SLPAYLOAD_MSEED2 ||
+        grouppacketinfo->payloadformat == SLPAYLOAD_MSEED3)
+    {
+      slot->starttime = sl_payload_starttime (groupslconn->log, grouppacketinfo,
+                                              slot->payload, grouppacketinfo->payloadlength);
+    }
+
+    /* Return packets without a start time, and payload segments, immediately */
+    if (slot->starttime == SLTERROR || status == SLCHUNK)
+    {
+      return_slot (merge, slotidx, slconn, packetinfo, payload);
+      return status;
+    }
+
+    /* Handle late packets according to policy */
+    if (merge->lastemitted != SLTERROR && slot->starttime < merge->lastemitted)
+    {
+      merge->latecount++;
+
+      if (merge->latepolicy == SLMERGE_LATE_DROP)
+      {
+        sl_log_r (groupslconn, 1, 2, "[%s] Dropping late packet for %s, seq %" PRIu64 "\n",
+                  groupslconn->sladdr, slot->packetinfo.stationid, slot->packetinfo.seqnum);
+
+        merge->freecount++;
+        continue;
+      }
+
+      return return_slot (merge, slotidx, slconn, packetinfo, payload);
+    }
+
+    heap_push (merge, slotidx);
+    arrival_append (merge, slotidx);
+  }
+} /* End of sl_merge_collect() */
+
+/***************************************************************************
+ * return_slot:
+ *
+ * Set the return values to the contents of a slot, the slot is
+ * released on the next call to sl_merge_collect().
+ *
+ * Returns SLPACKET.
+ ***************************************************************************/
+static int
+return_slot (SLmerge *merge, uint32_t slotidx, SLCD **slconn,
+             const SLpacketinfo **packetinfo, const char **payload)
+{
+  merge->returned = slotidx;
+
+  *slconn     = merge->slots[slotidx].slconn;
+  *packetinfo = &merge->slots[slotidx].packetinfo;
+  *payload    = merge->slots[slotidx].payload;
+
+  return SLPACKET;
+} /* End of return_slot() */
+
+/***************************************************************************
+ * release_slot:
+ *
+ * Return a slot to the free stack below the top slot.  The top slot is
+ * the receiving slot and may hold a partially collected payload, e.g.
+ * after the slot was reallocated for SLTOOLARGE, so it must remain at
+ * the top until its packet is complete.
+ ***************************************************************************/
+static void
+release_slot (SLmerge *merge, uint32_t slotidx)
+{
+  if (merge->freecount == 0)
+  {
+    merge->freeslots[merge->freecount++] = slotidx;
+    return;
+  }
+
+  merge->freeslots[merge->freecount] = merge->freeslots[merge->freecount - 1];
+  merge->freeslots[merge->freecount - 1] = slotidx;
+  merge->freecount++;
+} /* End of release_slot() */
+
+/***************************************************************************
+ * slot_before:
+ *
+ * Determine if slot a should be returned before slot b, ordering by
+ * start time and arrival for equal start times.
+ *
+ * Returns 1 if a is before b, otherwise 0.
+ ***************************************************************************/
+static int
+slot_before (const SLmerge *merge, uint32_t a, uint32_t b)
+{
+  const MergeSlot *slota = &merge->slots[a];
+  const MergeSlot *slotb = &merge->slots[b];
+
+  if (slota->starttime != slotb->starttime)
+    return (slota->starttime < slotb->starttime);
+
+  return (slota->arrivalseq < slotb->arrivalseq);
+} /* End of slot_before() */
+
+/***************************************************************************
+ * heap_push:
+ *
+ * Add a slot to the min-heap.
+ ***************************************************************************/
+static void
+heap_push (SLmerge *merge, uint32_t slotidx)
+{
+  uint32_t pos = merge->heapcount++;
+  uint32_t parent;
+
+  while (pos > 0)
+  {
+    parent = (pos - 1) / 2;
+
+    if (!slot_before (merge, slotidx, merge->heap[parent]))
+      break;
+
+    merge->heap[pos] = merge->heap[parent];
+    pos              = parent;
+  }
+
+  merge->heap[pos] = slotidx;
+} /* End of heap_push() */
+
+/***************************************************************************
+ * heap_pop:
+ *
+ * Remove and return the earliest slot from the min-heap, which must
+ * not be empty.
+ ***************************************************************************/
+static uint32_t
+heap_pop (SLmerge *merge)
+{
+  uint32_t top  = merge->heap[0];
+  uint32_t last = merge->heap[--merge->heapcount];
+  uint32_t pos  = 0;
+  uint32_t child;
+
+  while ((child = pos * 2 + 1) < merge->heapcount)
+  {
+    if (child + 1 < merge->heapcount &&
+        slot_before (merge, merge->heap[child + 1], merge->heap[child]))
+      child++;
+
+    if (!slot_before (merge, merge->heap[child], last))
+      break;
+
+    merge->heap[pos] = merge->heap[child];
+    pos              = child;
+  }
+
+  if (merge->heapcount > 0)
+    merge->heap[pos] = last;
+
+  return top;
+} /* End of heap_pop() */
+
+/***************************************************************************
+ * arrival_append:
+ *
+ * Add a slot to the end of the arrival order list.
+ ***************************************************************************/
+static void
+arrival_append (SLmerge *merge, uint32_t slotidx)
+{
+  merge->slots[slotidx].older = merge->newest;
+  merge->slots[slotidx].newer = NOSLOT;
+
+  if (merge->newest != NOSLOT)
+    merge->slots[merge->newest].newer = slotidx;
+  else
+    merge->oldest = slotidx;
+
+  merge->newest = slotidx;
+} /* End of arrival_append() */
+
+/***************************************************************************
+ * arrival_remove:
+ *
+ * Remove a slot from the arrival order list.
+ ***************************************************************************/
+static void
+arrival_remove (SLmerge *merge, uint32_t slotidx)
+{
+  MergeSlot *slot = &merge->slots[slotidx];
+
+  if (slot->older != NOSLOT)
+    merge->slots[slot->older].newer = slot->newer;
+  else
+    merge->oldest = slot->newer;
+
+  if (slot->newer != NOSLOT)
+    merge->slots[slot->newer].older = slot->older;
+  else
+    merge->newest = slot->older;
+} /* End of arrival_remove() */
@@ -56,6 +56,8 @@ static int batchmode_int (SLCD *slconn);
 static int negotiate_uni_v3 (SLCD *slconn);
 static int negotiate_multi_v3 (SLCD *slconn);
 static int negotiate_v4 (SLCD *slconn);
+static void *arena_alloc (SLCD *slconn, size_t size);
+static void arena_free (SLCD *slconn, void *ptr);
 static int sockstartup_int (void);
 static int sockconnect_int (SOCKET sock, struct sockaddr *inetaddr, int addrlen);
 static int socknoblock_int (SOCKET sock);
@@ -100,7 +102,7 @@ tls_configure (SLCD *slconn, const char *nodename)
   sl_log_r (slconn, 1, 1, "[%s] Configuring TLS\n", slconn->sladdr);
 
   /* Allocate TLS data structure context */
-  if ((slconn->tlsctx = (TLSCTX *)malloc (sizeof (TLSCTX))) == NULL)
+  if ((slconn->tlsctx = (TLSCTX *)sl_malloc (sizeof (TLSCTX))) == NULL)
   {
     sl_log_r (slconn, 2, 0, "cannot allocate memory for TLS context\n");
     return -1;
@@ -505,8 +507,22 @@ sl_send_info (SLCD *slconn, const char *infostr, int verbose)
 int
 sl_disconnect (SLCD *slconn)
 {
+  /* Data provided by a connection group is discarded with the connection */
+  slconn->extdata    = NULL;
+  slconn->extdatalen = 0;
+
   if (slconn->link != -1)
   {
+#if defined(__linux__)
+    /* Sockets read by a connection group with io_uring remain referenced by
+     * the pending receive, shut down to close the connection immediately */
+    if (slconn->extrecv)
+    {
+      shutdown (slconn->link, SHUT_RDWR);
+      slconn->extrecv = 0;
+    }
+#endif
+
 #if defined(SLP_WIN)
     return closesocket (slconn->link);
 #else
@@ -529,7 +545,7 @@ sl_disconnect (SLCD *slconn)
     mbedtls_entropy_free (&tlsctx->entropy);
     mbedtls_psa_crypto_free();
 
-    free (slconn->tlsctx);
+    sl_free (slconn->tlsctx);
     slconn->tlsctx = NULL;
   }
 
@@ -1035,11 +1051,11 @@ sayhello_int (SLCD *slconn)
       capptr++;
 
     if (slconn->capabilities)
-      free (slconn->capabilities);
+      sl_free (slconn->capabilities);
     if (slconn->caparray)
-      free (slconn->caparray);
+      sl_free (slconn->caparray);
 
-    slconn->capabilities = strdup(capptr);
+    slconn->capabilities = sl_strdup(capptr);
     slconn->caparray = NULL;
   }
 
@@ -2050,6 +2066,8 @@ negotiate_v4 (SLCD *slconn)
   if (!slconn)
     return -1;
 
+  slconn->arenaused = 0;
+
   /* Generate V4, ISO compatible date-time strings */
   if (slconn->start_time)
   {
@@ -2076,13 +2094,13 @@ negotiate_v4 (SLCD *slconn)
   while (curstream != NULL)
   {
     /* Allocate new command in list */
-    if ((cmdptr = (struct cmd_s *)malloc(sizeof(struct cmd_s))) == NULL)
+    if ((cmdptr = (struct cmd_s *)arena_alloc (slconn, sizeof (struct cmd_s))) == NULL)
     {
       sl_log_r (slconn, 2, 0, "%s() Cannot allocate memory\n", __func__);
       while (cmdlist)
       {
         cmdptr = cmdlist->next;
-        free (cmdlist);
+        arena_free (slconn, cmdlist);
         cmdlist = cmdptr;
       }
 
@@ -2148,13 +2166,13 @@ negotiate_v4 (SLCD *slconn)
           }
 
           /* Allocate new command in list */
-          if ((cmdptr = (struct cmd_s *)malloc (sizeof (struct cmd_s))) == NULL)
+          if ((cmdptr = (struct cmd_s *)arena_alloc (slconn, sizeof (struct cmd_s))) == NULL)
           {
             sl_log_r (slconn, 2, 0, "%s() Cannot allocate memory\n", __func__);
             while (cmdlist)
             {
               cmdptr = cmdlist->next;
-              free (cmdlist);
+              arena_free (slconn, cmdlist);
               cmdlist = cmdptr;
             }
 
@@ -2175,13 +2193,13 @@ negotiate_v4 (SLCD *slconn)
     } /* End of selector processing */
 
     /* Allocate new command in list */
-    if ((cmdptr = (struct cmd_s *)malloc(sizeof(struct cmd_s))) == NULL)
+    if ((cmdptr = (struct cmd_s *)arena_alloc (slconn, sizeof (struct cmd_s))) == NULL)
     {
       sl_log_r (slconn, 2, 0, "%s() Cannot allocate memory\n", __func__);
       while (cmdlist)
       {
         cmdptr = cmdlist->next;
-        free (cmdlist);
+        arena_free (slconn, cmdlist);
         cmdlist = cmdptr;
       }
 
@@ -2253,7 +2271,7 @@ negotiate_v4 (SLCD *slconn)
       while (cmdlist)
       {
         cmdptr = cmdlist->next;
-        free (cmdlist);
+        arena_free (slconn, cmdlist);
         cmdlist = cmdptr;
       }
 
@@ -2275,7 +2293,7 @@ negotiate_v4 (SLCD *slconn)
       while (cmdlist)
       {
         cmdptr = cmdlist->next;
-        free (cmdlist);
+        arena_free (slconn, cmdlist);
         cmdlist = cmdptr;
       }
 
@@ -2332,13 +2350,60 @@ negotiate_v4 (SLCD *slconn)
   while (cmdlist)
   {
     cmdptr = cmdlist->next;
-    free (cmdlist);
+    arena_free (slconn, cmdlist);
     cmdlist = cmdptr;
   }
 
+  /* Reset negotiation arena */
+  slconn->arenaused = 0;
+
   return (errorcnt) ? -1 : slconn->link;
 } /* End of negotiate_v4() */
 
+/***************************************************************************
+ * arena_alloc:
+ *
+ * Allocate memory for negotiation temporaries from the connection
+ * arena, if configured and space remains, otherwise with sl_malloc().
+ * The arena is reset after each negotiation.
+ *
+ * Returns a pointer to the allocated memory or NULL on error.
+ ***************************************************************************/
+static void *
+arena_alloc (SLCD *slconn, size_t size)
+{
+  void *ptr;
+
+  /* Keep allocations aligned to 16 bytes */
+  size = (size + 15) & ~(size_t)15;
+
+  if (slconn->arena && size <= slconn->arenasize - slconn->arenaused)
+  {
+    ptr = slconn->arena + slconn->arenaused;
+    slconn->arenaused += (uint32_t)size;
+    return ptr;
+  }
+
+  return sl_malloc (size);
+} /* End of arena_alloc() */
+
+/***************************************************************************
+ * arena_free:
+ *
+ * Release memory from arena_alloc(), memory in the arena is released
+ * when the arena is reset.
+ ***************************************************************************/
+static void
+arena_free (SLCD *slconn, void *ptr)
+{
+  if (slconn->arena &&
+      (char *)ptr >= slconn->arena &&
+      (char *)ptr < slconn->arena + slconn->arenasize)
+    return;
+
+  sl_free (ptr);
+} /* End of arena_free() */
+
 /***************************************************************************
  * Startup the network socket layer.  At the moment this is only meaningful
  * for the WIN platform.
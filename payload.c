@@ -29,6 +29,9 @@
 #include "libslink.h"
 #include "mseedformat.h"
 
+static int64_t decode_steim (const SLlog *log, const char *input, uint32_t inputlength,
+                             int32_t *output, uint32_t samplecount,
+                             int steimlevel, int swapflag);
 
 /**********************************************************************/ /**
  * @brief Generate a summary string for a specified packet
@@ -39,7 +42,7 @@
  * @param[in] log Use the logging parameters specified in ::SLlog
  * @param[in] packetinfo The packet information structure
  * @param[in] plbuffer A buffer containing the packet payload
- * @param[in] plbuffer_size The size of the payload buffer in bytes
+ * @param[in] plbuffer_size The length of payload in the buffer, at least the fixed header of a miniSEED record
  * @param[out] summary A buffer to hold the summary string
  * @param[out] summary_size The size of the summary buffer in bytes
  *
@@ -91,7 +94,7 @@ sl_payload_summary (const SLlog *log, const SLpacketinfo *packetinfo,
  * @param[in] log Use the logging parameters specified in ::SLlog
  * @param[in] packetinfo The packet information structure
  * @param[in] plbuffer A buffer containing the packet payload
- * @param[in] plbuffer_size The size of the payload buffer in bytes
+ * @param[in] plbuffer_size The length of payload in the buffer, at least the fixed header of a miniSEED record
  * @param[out] sourceid A buffer to hold the source identifier string
  * @param[out] sourceid_size The size of the source identifier buffer in bytes
  * @param[out] starttimestr A buffer to hold the start time string
@@ -119,7 +122,7 @@ sl_payload_info (const SLlog *log, const SLpacketinfo *packetinfo,
   /* Parse requested details from miniSEED v2 */
   if (packetinfo->payloadformat == SLPAYLOAD_MSEED2)
   {
-    if (packetinfo->payloadlength < 48)
+    if (packetinfo->payloadlength < 48 || plbuffer_size < 48)
     {
       sl_log_rl (log, 2, 1, "%s(): payload too short for miniSEEDv2\n", __func__);
       return -1;
@@ -182,11 +185,11 @@ sl_payload_info (const SLlog *log, const SLpacketinfo *packetinfo,
 
     if (samplerate)
     {
-      uint16_t samprate_fact;
-      uint16_t samprate_mult;
+      int16_t samprate_fact;
+      int16_t samprate_mult;
 
-      samprate_fact = HO2u(*pMS2FSDH_SAMPLERATEFACT (plbuffer), swapflag);
-      samprate_mult = HO2u(*pMS2FSDH_SAMPLERATEMULT (plbuffer), swapflag);
+      samprate_fact = HO2d(*pMS2FSDH_SAMPLERATEFACT (plbuffer), swapflag);
+      samprate_mult = HO2d(*pMS2FSDH_SAMPLERATEMULT (plbuffer), swapflag);
 
       if (samprate_fact > 0)
         *samplerate = (double)samprate_fact;
@@ -207,7 +210,9 @@ sl_payload_info (const SLlog *log, const SLpacketinfo *packetinfo,
   /* Parse requested details from miniSEED v3 */
   else if (packetinfo->payloadformat == SLPAYLOAD_MSEED3)
   {
-    if (packetinfo->payloadlength < MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH(plbuffer))
+    if (plbuffer_size < MS3FSDH_LENGTH ||
+        packetinfo->payloadlength < MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH(plbuffer) ||
+        plbuffer_size < (uint32_t)MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH(plbuffer))
     {
       sl_log_rl (log, 2, 1, "%s(): payload too short for miniSEEDv3\n", __func__);
       return -1;
@@ -253,6 +258,10 @@ sl_payload_info (const SLlog *log, const SLpacketinfo *packetinfo,
     if (samplerate)
     {
       *samplerate = HO8f(*pMS3FSDH_SAMPLERATE (plbuffer), swapflag);
+
+      /* Negative values are sample periods in seconds */
+      if (*samplerate < 0.0)
+        *samplerate = -1.0 / *samplerate;
     }
 
     if (samplecount)
@@ -269,3 +278,451 @@ sl_payload_info (const SLlog *log, const SLpacketinfo *packetinfo,
 
   return 0;
 } /* End of sl_payload_info() */
+
+/**********************************************************************/ /**
+ * @brief Return the record start time of a miniSEED payload
+ *
+ * Parses the start time from the fixed header of a miniSEED 2 or 3
+ * payload and returns it as a nanosecond epoch time.  Only the fixed
+ * header is inspected, so \a plbuffer needs to contain at least the
+ * first 48 bytes of a miniSEED 2 record or the first 40 bytes of a
+ * miniSEED 3 record.
+ *
+ * @param[in] log Use the logging parameters specified in ::SLlog
+ * @param[in] packetinfo The packet information structure
+ * @param[in] plbuffer A buffer containing the packet payload
+ * @param[in] plbuffer_size The length of payload in the buffer, at least the fixed header of a miniSEED record
+ *
+ * @returns The record start time on success, ::SLTERROR on error or
+ * for payloads that are not miniSEED.
+ ***************************************************************************/
+int64_t
+sl_payload_starttime (const SLlog *log, const SLpacketinfo *packetinfo,
+                      const char *plbuffer, uint32_t plbuffer_size)
+{
+  uint8_t swapflag = 0; /* byte swapping flag */
+  int64_t nstime;
+
+  if (!packetinfo || !plbuffer)
+  {
+    sl_log_rl (log, 2, 1, "%s(): invalid input parameters\n", __func__);
+    return SLTERROR;
+  }
+
+  if (packetinfo->payloadformat == SLPAYLOAD_MSEED2)
+  {
+    if (plbuffer_size < 48)
+    {
+      sl_log_rl (log, 2, 1, "%s(): payload too short for miniSEEDv2\n", __func__);
+      return SLTERROR;
+    }
+
+    /* Check to see if byte swapping is needed by checking for sane year and day */
+    if (!MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (plbuffer), *pMS2FSDH_DAY (plbuffer)))
+      swapflag = 1;
+
+    nstime = sl_time2nstime (HO2u (*pMS2FSDH_YEAR (plbuffer), swapflag),
+                             HO2u (*pMS2FSDH_DAY (plbuffer), swapflag),
+                             *pMS2FSDH_HOUR (plbuffer),
+                             *pMS2FSDH_MIN (plbuffer),
+                             *pMS2FSDH_SEC (plbuffer),
+                             (uint32_t)HO2u (*pMS2FSDH_FSEC (plbuffer), swapflag) * 100000);
+  }
+  else if (packetinfo->payloadformat == SLPAYLOAD_MSEED3)
+  {
+    if (plbuffer_size < MS3FSDH_LENGTH)
+    {
+      sl_log_rl (log, 2, 1, "%s(): payload too short for miniSEEDv3\n", __func__);
+      return SLTERROR;
+    }
+
+    swapflag = (sl_littleendianhost ()) ? 0 : 1;
+
+    nstime = sl_time2nstime (HO2u (*pMS3FSDH_YEAR (plbuffer), swapflag),
+                             HO2u (*pMS3FSDH_DAY (plbuffer), swapflag),
+                             *pMS3FSDH_HOUR (plbuffer),
+                             *pMS3FSDH_MIN (plbuffer),
+                             *pMS3FSDH_SEC (plbuffer),
+                             HO4u (*pMS3FSDH_NSEC (plbuffer), swapflag));
+  }
+  else
+  {
+    return SLTERROR;
+  }
+
+  return nstime;
+} /* End of sl_payload_starttime() */
+
+/**********************************************************************/ /**
+ * @brief Decode the data samples of a miniSEED payload
+ *
+ * Decode the samples of a miniSEED 2 or 3 record encoded as 16 or
+ * 32-bit integers, 32 or 64-bit floats, or Steim-1 or Steim-2
+ * compressed integers.  Integer encodings are decoded to 32-bit
+ * integers (sample type 'i') and float encodings to 32-bit floats
+ * (sample type 'f'), so each sample occupies 4 bytes in \a samples.
+ *
+ * For miniSEED 2 the encoding and byte order are determined from
+ * blockette 1000, records without blockette 1000 cannot be decoded.
+ *
+ * @param[in] log Use the logging parameters specified in ::SLlog
+ * @param[in] packetinfo The packet information structure
+ * @param[in] plbuffer A buffer containing the packet payload
+ * @param[in] plbuffer_size The length of payload in the buffer, at least the fixed header of a miniSEED record
+ * @param[out] samples Buffer for decoded samples, 4 bytes per sample
+ * @param[in] maxsamples Maximum number of samples in \a samples
+ * @param[out] sampletype Type of decoded samples, 'i' or 'f'
+ *
+ * @returns The number of samples decoded on success, -1 on error.
+ *
+ * @sa sl_payload_info()
+ ***************************************************************************/
+int64_t
+sl_payload_decode (const SLlog *log, const SLpacketinfo *packetinfo,
+                   const char *plbuffer, uint32_t plbuffer_size,
+                   void *samples, uint32_t maxsamples, char *sampletype)
+{
+  const char *data;
+  uint32_t datalength;
+  uint32_t samplecount;
+  uint32_t idx;
+  uint8_t encoding  = 0;
+  int hdrswapflag   = 0;
+  int dataswapflag  = 0;
+  int bigendianhost = (sl_littleendianhost ()) ? 0 : 1;
+
+  if (!packetinfo || !plbuffer || !samples || !sampletype)
+  {
+    sl_log_rl (log, 2, 1, "%s(): invalid input parameters\n", __func__);
+    return -1;
+  }
+
+  if (packetinfo->payloadformat == SLPAYLOAD_MSEED2)
+  {
+    uint16_t dataoffset;
+    uint16_t blkt_offset;
+    uint16_t blkt_type;
+    int blkt_count = 0;
+    int found = 0;
+
+    if (plbuffer_size < 48)
+    {
+      sl_log_rl (log, 2, 1, "%s(): payload too short for miniSEEDv2\n", __func__);
+      return -1;
+    }
+
+    if (!MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (plbuffer), *pMS2FSDH_DAY (plbuffer)))
+      hdrswapflag = 1;
+
+    samplecount = HO2u (*pMS2FSDH_NUMSAMPLES (plbuffer), hdrswapflag);
+    dataoffset  = HO2u (*pMS2FSDH_DATAOFFSET (plbuffer), hdrswapflag);
+    blkt_offset = HO2u (*pMS2FSDH_BLOCKETTEOFFSET (plbuffer), hdrswapflag);
+
+    /* Search blockette chain for blockette 1000 */
+    while (blkt_offset >= 48 && (uint32_t)blkt_offset + 8 <= plbuffer_size &&
+           blkt_count++ < 64)
+    {
+      blkt_type = HO2u (*pMS2B1000_TYPE (plbuffer + blkt_offset), hdrswapflag);
+
+      if (blkt_type == 1000)
+      {
+        encoding = *pMS2B1000_ENCODING (plbuffer + blkt_offset);
+
+        /* Byte order flag: 0 = little endian, 1 = big endian */
+        dataswapflag = (*pMS2B1000_BYTEORDER (plbuffer + blkt_offset) != bigendianhost);
+        found = 1;
+        break;
+      }
+
+      blkt_offset = HO2u (*pMS2B1000_NEXT (plbuffer + blkt_offset), hdrswapflag);
+    }
+
+    if (!found)
+    {
+      sl_log_rl (log, 2, 1, "%s(): miniSEEDv2 record without blockette 1000\n", __func__);
+      return -1;
+    }
+
+    if (dataoffset < 48 || dataoffset > plbuffer_size)
+    {
+      sl_log_rl (log, 2, 1, "%s(): invalid miniSEEDv2 data offset: %u\n", __func__, dataoffset);
+      return -1;
+    }
+
+    data       = plbuffer + dataoffset;
+    datalength = plbuffer_size - dataoffset;
+
+    if (datalength > packetinfo->payloadlength - dataoffset)
+      datalength = packetinfo->payloadlength - dataoffset;
+  }
+  else if (packetinfo->payloadformat == SLPAYLOAD_MSEED3)
+  {
+    uint32_t dataoffset;
+
+    if (plbuffer_size < MS3FSDH_LENGTH)
+    {
+      sl_log_rl (log, 2, 1, "%s(): payload too short for miniSEEDv3\n", __func__);
+      return -1;
+    }
+
+    hdrswapflag = bigendianhost;
+
+    samplecount = HO4u (*pMS3FSDH_NUMSAMPLES (plbuffer), hdrswapflag);
+    encoding    = *pMS3FSDH_ENCODING (plbuffer);
+    dataoffset  = MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH (plbuffer) +
+                  HO2u (*pMS3FSDH_EXTRALENGTH (plbuffer), hdrswapflag);
+    datalength  = HO4u (*pMS3FSDH_DATALENGTH (plbuffer), hdrswapflag);
+
+    /* Compare lengths without overflow, the data length is not trusted */
+    if (dataoffset > plbuffer_size || datalength > plbuffer_size - dataoffset)
+    {
+      sl_log_rl (log, 2, 1, "%s(): payload too short for miniSEEDv3 data\n", __func__);
+      return -1;
+    }
+
+    data = plbuffer + dataoffset;
+
+    /* Steim encodings are big endian, all others little endian */
+    if (encoding == 10 || encoding == 11)
+      dataswapflag = (bigendianhost) ? 0 : 1;
+    else
+      dataswapflag = bigendianhost;
+  }
+  else
+  {
+    sl_log_rl (log, 2, 1, "%s(): unsupported payload format: %c\n",
+               __func__, packetinfo->payloadformat);
+    return -1;
+  }
+
+  if (samplecount > maxsamples)
+  {
+    sl_log_rl (log, 2, 1, "%s(): sample buffer too small, need %u samples\n",
+               __func__, samplecount);
+    return -1;
+  }
+
+  switch (encoding)
+  {
+  case 1: /* INT16 */
+    if ((uint64_t)samplecount * 2 > datalength)
+      goto short_data;
+
+    for (idx = 0; idx < samplecount; idx++)
+    {
+      int16_t sample;
+      memcpy (&sample, data + idx * 2, 2);
+      ((int32_t *)samples)[idx] = HO2d (sample, dataswapflag);
+    }
+
+    *sampletype = 'i';
+    break;
+
+  case 3: /* INT32 */
+    if ((uint64_t)samplecount * 4 > datalength)
+      goto short_data;
+
+    for (idx = 0; idx < samplecount; idx++)
+    {
+      int32_t sample;
+      memcpy (&sample, data + idx * 4, 4);
+      ((int32_t *)samples)[idx] = HO4d (sample, dataswapflag);
+    }
+
+    *sampletype = 'i';
+    break;
+
+  case 4: /* FLOAT32 */
+    if ((uint64_t)samplecount * 4 > datalength)
+      goto short_data;
+
+    for (idx = 0; idx < samplecount; idx++)
+    {
+      float sample;
+      memcpy (&sample, data + idx * 4, 4);
+      ((float *)samples)[idx] = HO4f (sample, dataswapflag);
+    }
+
+    *sampletype = 'f';
+    break;
+
+  case 5: /* FLOAT64 */
+    if ((uint64_t)samplecount * 8 > datalength)
+      goto short_data;
+
+    for (idx = 0; idx < samplecount; idx++)
+    {
+      double sample;
+      memcpy (&sample, data + idx * 8, 8);
+      ((float *)samples)[idx] = (float)HO8f (sample, dataswapflag);
+    }
+
+    *sampletype = 'f';
+    break;
+
+  case 10: /* STEIM1 */
+  case 11: /* STEIM2 */
+    if (decode_steim (log, data, datalength, (int32_t *)samples, samplecount,
+                      (encoding == 10) ? 1 : 2, dataswapflag) < 0)
+      return -1;
+
+    *sampletype = 'i';
+    break;
+
+  default:
+    sl_log_rl (log, 2, 1, "%s(): unsupported data encoding: %u\n", __func__, encoding);
+    return -1;
+  }
+
+  return samplecount;
+
+short_data:
+  sl_log_rl (log, 2, 1, "%s(): data length %u too short for %u samples\n",
+             __func__, datalength, samplecount);
+  return -1;
+} /* End of sl_payload_decode() */
+
+/***************************************************************************
+ * extend_sign:
+ *
+ * Sign extend the lowest bits of a value to a 32-bit integer.
+ ***************************************************************************/
+static inline int32_t
+extend_sign (uint32_t value, int bits)
+{
+  uint32_t signbit = (uint32_t)1 << (bits - 1);
+
+  value &= ((uint32_t)1 << bits) - 1;
+
+  return (int32_t)((value ^ signbit) - signbit);
+} /* End of extend_sign() */
+
+/***************************************************************************
+ * decode_steim:
+ *
+ * Decode Steim-1 or Steim-2 compressed 64-byte frames to 32-bit
+ * integers.  Differences are unpacked into the output buffer and then
+ * integrated from the forward integration constant in the first frame.
+ * The reverse integration constant is checked against the last sample.
+ *
+ * Returns the number of samples decoded on success and -1 on error.
+ ***************************************************************************/
+static int64_t
+decode_steim (const SLlog *log, const char *input, uint32_t inputlength,
+              int32_t *output, uint32_t samplecount,
+              int steimlevel, int swapflag)
+{
+  uint32_t frame[16];
+  uint32_t frames = inputlength / 64;
+  uint32_t frameidx;
+  uint32_t outidx = 0;
+  uint32_t nibbles;
+  uint32_t word;
+  int32_t x0 = 0;
+  int32_t xn = 0;
+  int widx;
+  int nibble;
+  int dnib;
+  int count;
+  int bits;
+  int idx;
+
+  if (samplecount == 0)
+    return 0;
+
+  for (frameidx = 0; frameidx < frames && outidx < samplecount; frameidx++)
+  {
+    memcpy (frame, input + frameidx * 64, 64);
+
+    if (swapflag)
+    {
+      for (widx = 0; widx < 16; widx++)
+        sl_gswap4 (&frame[widx]);
+    }
+
+    nibbles = frame[0];
+    widx    = 1;
+
+    /* First frame contains integration constants */
+    if (frameidx == 0)
+    {
+      x0   = (int32_t)frame[1];
+      xn   = (int32_t)frame[2];
+      widx = 3;
+    }
+
+    for (; widx < 16 && outidx < samplecount; widx++)
+    {
+      word   = frame[widx];
+      nibble = (nibbles >> (30 - 2 * widx)) & 0x3;
+      count  = 0;
+      bits   = 0;
+
+      if (nibble == 0)
+        continue;
+
+      if (nibble == 1)
+      {
+        count = 4;
+        bits  = 8;
+      }
+      else if (steimlevel == 1)
+      {
+        count = (nibble == 2) ? 2 : 1;
+        bits  = (nibble == 2) ? 16 : 32;
+      }
+      else
+      {
+        dnib = (word >> 30) & 0x3;
+
+        if (nibble == 2)
+        {
+          if (dnib == 1)      { count = 1; bits = 30; }
+          else if (dnib == 2) { count = 2; bits = 15; }
+          else if (dnib == 3) { count = 3; bits = 10; }
+        }
+        else
+        {
+          if (dnib == 0)      { count = 5; bits = 6; }
+          else if (dnib == 1) { count = 6; bits = 5; }
+          else if (dnib == 2) { count = 7; bits = 4; }
+        }
+
+        if (count == 0)
+        {
+          sl_log_rl (log, 2, 1, "%s(): invalid Steim-2 decode nibble in frame %u\n",
+                     __func__, frameidx);
+          return -1;
+        }
+      }
+
+      for (idx = count - 1; idx >= 0 && outidx < samplecount; idx--)
+      {
+        if (bits == 32)
+          output[outidx++] = (int32_t)word;
+        else
+          output[outidx++] = extend_sign (word >> (idx * bits), bits);
+      }
+    }
+  }
+
+  if (outidx < samplecount)
+  {
+    sl_log_rl (log, 2, 1, "%s(): Steim frames contain %u of %u samples\n",
+               __func__, outidx, samplecount);
+    return -1;
+  }
+
+  /* Integrate differences, the first difference is relative to the prior record */
+  output[0] = x0;
+  for (outidx = 1; outidx < samplecount; outidx++)
+    output[outidx] = (int32_t)((uint32_t)output[outidx - 1] + (uint32_t)output[outidx]);
+
+  if (output[samplecount - 1] != xn)
+  {
+    sl_log_rl (log, 1, 1, "%s(): Steim last sample %d does not match reverse integration constant %d\n",
+               __func__, output[samplecount - 1], xn);
+  }
+
+  return samplecount;
+} /* End of decode_steim() */
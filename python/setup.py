@@ -0,0 +1,34 @@
+#!/usr/bin/env python3
+#
+# Build the slink CPython extension module.
+#
+# The library must be built first, the extension links with the shared
+# library in the parent directory unless LIBSLINK_INCLUDE and
+# LIBSLINK_LIBDIR specify an installed libslink, e.g.:
+#
+#   make -C .. shared
+#   python3 setup.py build_ext --inplace
+
+import os
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+include_dir = os.environ.get("LIBSLINK_INCLUDE", os.path.join(here, ".."))
+library_dir = os.environ.get("LIBSLINK_LIBDIR", os.path.join(here, ".."))
+
+setup(
+    name="slink",
+    version="0.1.0",
+    description="SeedLink client interface using libslink",
+    license="Apache-2.0",
+    ext_modules=[
+        Extension(
+            "slink",
+            sources=["slinkmodule.c"],
+            include_dirs=[include_dir],
+            library_dirs=[library_dir],
+            libraries=["slink"],
+        )
+    ],
+)
@@ -0,0 +1,822 @@
+/***************************************************************************
+ * slinkmodule.c
+ *
+ * CPython extension module providing batched SeedLink packet collection
+ * with libslink.
+ *
+ * Packets are collected with sl_collect() into pooled buffers owned by
+ * the connection, without holding the GIL while waiting on the
+ * network.  Each batch exports its payloads and a packed array of
+ * per-packet header fields through the buffer protocol so they can be
+ * used with memoryview, bytes-like consumers and numpy.frombuffer()
+ * without creating Python objects per packet.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libslink.h>
+
+#define DEFAULT_BUFFERSIZE  1048576
+#define DEFAULT_MAXPACKETS  1024
+#define MAX_POOLED          4
+#define POLL_SLICE_MS       100
+
+#define STRINGIFY_(X) #X
+#define STRINGIFY(X) STRINGIFY_ (X)
+
+/* Packed header fields per packet, described by HEADER_DTYPE.
+ * The layout is fixed at 128 bytes with natural alignment. */
+typedef struct PacketHeader
+{
+  uint64_t seqnum;         /* Packet sequence number */
+  int64_t  starttime;      /* miniSEED start time, nanoseconds since epoch */
+  double   samplerate;     /* miniSEED sample rate */
+  uint32_t offset;         /* Offset of payload in batch payload buffer */
+  uint32_t length;         /* Payload length */
+  uint32_t samplecount;    /* miniSEED sample count */
+  char     format;         /* Payload format */
+  char     subformat;      /* Payload subformat */
+  char     stationid[SL_MAX_STATIONID];
+  char     sourceid[68];
+} PacketHeader;
+
+typedef char PacketHeaderSizeCheck[(sizeof (PacketHeader) == 128) ? 1 : -1];
+
+/* Pooled memory for a batch: payload buffer and header array */
+typedef struct PoolBuffer
+{
+  char *payload;
+  size_t payloadsize;
+  PacketHeader *headers;
+  size_t maxheaders;
+} PoolBuffer;
+
+typedef struct ConnectionObject
+{
+  PyObject_HEAD
+  SLCD *slconn;
+  size_t buffersize;
+  size_t maxpackets;
+  PoolBuffer pool[MAX_POOLED];
+  int pooled;
+  char *carry;           /* Partial payload carried to the next batch */
+  size_t carrysize;
+  uint32_t carrylength;
+  int terminated;
+} ConnectionObject;
+
+typedef struct BatchObject
+{
+  PyObject_HEAD
+  ConnectionObject *conn;
+  PoolBuffer buffer;
+  uint32_t count;
+  uint32_t used;
+} BatchObject;
+
+typedef struct HeadersObject
+{
+  PyObject_HEAD
+  BatchObject *batch;
+} HeadersObject;
+
+static PyTypeObject ConnectionType;
+static PyTypeObject BatchType;
+static PyTypeObject HeadersType;
+
+/*****
+ * pool_acquire:
+ *
+ * Take a batch buffer from the connection pool or allocate a new one.
+ *
+ * Returns 0 on success and -1 on allocation error.
+ ****/
+static int
+pool_acquire (ConnectionObject *conn, PoolBuffer *buffer)
+{
+  if (conn->pooled > 0)
+  {
+    *buffer = conn->pool[--conn->pooled];
+    return 0;
+  }
+
+  buffer->payloadsize = conn->buffersize;
+  buffer->maxheaders  = conn->maxpackets;
+  buffer->payload     = PyMem_RawMalloc (buffer->payloadsize);
+  buffer->headers     = PyMem_RawMalloc (buffer->maxheaders * sizeof (PacketHeader));
+
+  if (!buffer->payload || !buffer->headers)
+  {
+    PyMem_RawFree (buffer->payload);
+    PyMem_RawFree (buffer->headers);
+    buffer->payload = NULL;
+    buffer->headers = NULL;
+    return -1;
+  }
+
+  return 0;
+} /* End of pool_acquire() */
+
+/*****
+ * pool_release:
+ *
+ * Return a batch buffer to the connection pool, buffers that were
+ * grown for large payloads or that do not fit in the pool are freed.
+ ****/
+static void
+pool_release (ConnectionObject *conn, PoolBuffer *buffer)
+{
+  if (!buffer->payload)
+    return;
+
+  if (conn && conn->pooled < MAX_POOLED &&
+      buffer->payloadsize == conn->buffersize &&
+      buffer->maxheaders == conn->maxpackets)
+  {
+    conn->pool[conn->pooled++] = *buffer;
+  }
+  else
+  {
+    PyMem_RawFree (buffer->payload);
+    PyMem_RawFree (buffer->headers);
+  }
+
+  buffer->payload = NULL;
+  buffer->headers = NULL;
+} /* End of pool_release() */
+
+/*****
+ * fill_header:
+ *
+ * Populate the header entry for a collected packet, parsing the
+ * miniSEED header when present.  Called without the GIL.
+ ****/
+static void
+fill_header (PacketHeader *header, const SLpacketinfo *packetinfo,
+             const char *payload, uint32_t offset)
+{
+  memset (header, 0, sizeof (PacketHeader));
+
+  header->seqnum    = packetinfo->seqnum;
+  header->starttime = SLTERROR;
+  header->offset    = offset;
+  header->length    = packetinfo->payloadcollected;
+  header->format    = packetinfo->payloadformat;
+  header->subformat = packetinfo->payloadsubformat;
+  strncpy (header->stationid, packetinfo->stationid, sizeof (header->stationid) - 1);
+
+  if (packetinfo->payloadformat == SLPAYLOAD_MSEED2 ||
+      packetinfo->payloadformat == SLPAYLOAD_MSEED3)
+  {
+    sl_payload_info (NULL, packetinfo, payload, packetinfo->payloadcollected,
+                     header->sourceid, sizeof (header->sourceid), NULL, 0,
+                     &header->samplerate, &header->samplecount);
+    header->starttime = sl_payload_starttime (NULL, packetinfo, payload,
+                                              packetinfo->payloadcollected);
+  }
+} /* End of fill_header() */
+
+/*****
+ * Connection methods
+ ****/
+
+static int
+Connection_init (ConnectionObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"server", "clientname", "clientversion",
+                           "buffersize", "maxpackets", NULL};
+  const char *server        = NULL;
+  const char *clientname    = "pyslink";
+  const char *clientversion = NULL;
+  Py_ssize_t buffersize     = DEFAULT_BUFFERSIZE;
+  Py_ssize_t maxpackets     = DEFAULT_MAXPACKETS;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "s|sznn:Connection", kwlist,
+                                    &server, &clientname, &clientversion,
+                                    &buffersize, &maxpackets))
+    return -1;
+
+  if (buffersize < 512 || buffersize > UINT32_MAX || maxpackets < 1)
+  {
+    PyErr_SetString (PyExc_ValueError, "buffersize or maxpackets out of range");
+    return -1;
+  }
+
+  if (self->slconn)
+  {
+    PyErr_SetString (PyExc_RuntimeError, "Connection already initialized");
+    return -1;
+  }
+
+  self->buffersize = (size_t)buffersize;
+  self->maxpackets = (size_t)maxpackets;
+
+  if (!(self->slconn = sl_initslcd (clientname, clientversion)))
+  {
+    PyErr_SetString (PyExc_MemoryError, "sl_initslcd() failed");
+    return -1;
+  }
+
+  if (sl_set_serveraddress (self->slconn, server) ||
+      sl_set_blockingmode (self->slconn, 1))
+  {
+    PyErr_SetString (PyExc_ValueError, "Cannot configure connection");
+    return -1;
+  }
+
+  return 0;
+}
+
+static void
+Connection_close_slcd (ConnectionObject *self)
+{
+  if (self->slconn)
+  {
+    if (self->slconn->link != -1)
+      sl_disconnect (self->slconn);
+
+    sl_freeslcd (self->slconn);
+    self->slconn = NULL;
+  }
+}
+
+static void
+Connection_dealloc (ConnectionObject *self)
+{
+  Connection_close_slcd (self);
+
+  while (self->pooled > 0)
+  {
+    self->pooled--;
+    PyMem_RawFree (self->pool[self->pooled].payload);
+    PyMem_RawFree (self->pool[self->pooled].headers);
+  }
+
+  PyMem_RawFree (self->carry);
+  Py_TYPE (self)->tp_free ((PyObject *)self);
+}
+
+static int
+Connection_check (ConnectionObject *self)
+{
+  if (!self->slconn)
+  {
+    PyErr_SetString (PyExc_ValueError, "Connection is closed");
+    return -1;
+  }
+
+  return 0;
+}
+
+static PyObject *
+Connection_add_stream (ConnectionObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"stationid", "selectors", "seqnum", "timestamp", NULL};
+  const char *stationid = NULL;
+  const char *selectors = NULL;
+  const char *timestamp = NULL;
+  long long seqnum      = -1;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "s|zLz:add_stream", kwlist,
+                                    &stationid, &selectors, &seqnum, &timestamp))
+    return NULL;
+
+  if (Connection_check (self))
+    return NULL;
+
+  if (sl_add_stream (self->slconn, stationid, selectors,
+                     (seqnum < 0) ? SL_UNSETSEQUENCE : (uint64_t)seqnum, timestamp))
+  {
+    PyErr_SetString (PyExc_ValueError, "sl_add_stream() failed");
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+Connection_set_allstation_params (ConnectionObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"selectors", "seqnum", "timestamp", NULL};
+  const char *selectors = NULL;
+  const char *timestamp = NULL;
+  long long seqnum      = -1;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "z|Lz:set_allstation_params", kwlist,
+                                    &selectors, &seqnum, &timestamp))
+    return NULL;
+
+  if (Connection_check (self))
+    return NULL;
+
+  if (sl_set_allstation_params (self->slconn, selectors,
+                                (seqnum < 0) ? SL_UNSETSEQUENCE : (uint64_t)seqnum,
+                                timestamp))
+  {
+    PyErr_SetString (PyExc_ValueError, "sl_set_allstation_params() failed");
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+Connection_request_info (ConnectionObject *self, PyObject *args)
+{
+  const char *infostr = NULL;
+
+  if (!PyArg_ParseTuple (args, "s:request_info", &infostr))
+    return NULL;
+
+  if (Connection_check (self))
+    return NULL;
+
+  if (sl_request_info (self->slconn, infostr))
+  {
+    PyErr_SetString (PyExc_ValueError, "sl_request_info() failed");
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+Connection_terminate (ConnectionObject *self, PyObject *Py_UNUSED (ignored))
+{
+  if (self->slconn)
+    sl_terminate (self->slconn);
+
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+Connection_close (ConnectionObject *self, PyObject *Py_UNUSED (ignored))
+{
+  Connection_close_slcd (self);
+  self->terminated = 1;
+
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+Connection_enter (ConnectionObject *self, PyObject *Py_UNUSED (ignored))
+{
+  Py_INCREF (self);
+  return (PyObject *)self;
+}
+
+static PyObject *
+Connection_exit (ConnectionObject *self, PyObject *args)
+{
+  (void)args;
+  Connection_close_slcd (self);
+  self->terminated = 1;
+
+  Py_RETURN_FALSE;
+}
+
+/*****
+ * Connection_collect:
+ *
+ * Collect up to maxpackets packets into a new batch.  Waits up to
+ * timeout seconds for the first packet without holding the GIL, then
+ * returns as soon as no further packets are immediately available.
+ *
+ * Returns a Batch, possibly empty if the timeout expired, or None when
+ * the connection has terminated.
+ ****/
+static PyObject *
+Connection_collect (ConnectionObject *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[] = {"timeout", NULL};
+  const SLpacketinfo *packetinfo = NULL;
+  BatchObject *batch;
+  double timeout = -1.0;
+  int64_t deadline;
+  int64_t remaining;
+  int interrupted = 0;
+  int status;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "|d:collect", kwlist, &timeout))
+    return NULL;
+
+  if (self->terminated)
+    Py_RETURN_NONE;
+
+  if (Connection_check (self))
+    return NULL;
+
+  if (!(batch = PyObject_New (BatchObject, &BatchType)))
+    return NULL;
+
+  Py_INCREF (self);
+  batch->conn    = self;
+  batch->count   = 0;
+  batch->used    = 0;
+  batch->buffer.payload = NULL;
+
+  if (pool_acquire (self, &batch->buffer))
+  {
+    Py_DECREF (batch);
+    return PyErr_NoMemory ();
+  }
+
+  /* Restore partial payload carried over from the previous batch */
+  if (self->carrylength > 0)
+  {
+    if (self->carrylength > batch->buffer.payloadsize)
+    {
+      char *payload = PyMem_RawRealloc (batch->buffer.payload, self->carrylength);
+
+      if (!payload)
+      {
+        Py_DECREF (batch);
+        return PyErr_NoMemory ();
+      }
+
+      batch->buffer.payload     = payload;
+      batch->buffer.payloadsize = self->carrylength;
+    }
+
+    memcpy (batch->buffer.payload, self->carry, self->carrylength);
+    self->carrylength = 0;
+  }
+
+  deadline = (timeout < 0) ? -1 : sl_nstime () + (int64_t)(timeout * 1e9);
+
+  while (batch->count < batch->buffer.maxheaders)
+  {
+    Py_BEGIN_ALLOW_THREADS
+    status = sl_collect (self->slconn, &packetinfo,
+                         batch->buffer.payload + batch->used,
+                         (uint32_t)(batch->buffer.payloadsize - batch->used));
+
+    if (status == SLPACKET)
+    {
+      fill_header (&batch->buffer.headers[batch->count], packetinfo,
+                   batch->buffer.payload + batch->used, batch->used);
+      batch->used += packetinfo->payloadcollected;
+      batch->count++;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (status == SLPACKET)
+    {
+      continue;
+    }
+    else if (status == SLTOOLARGE)
+    {
+      /* Leave payload for the next batch */
+      if (batch->count > 0)
+        break;
+
+      /* Grow a batch buffer for a single payload larger than the pool size */
+      char *payload = PyMem_RawRealloc (batch->buffer.payload, packetinfo->payloadlength);
+
+      if (!payload)
+      {
+        Py_DECREF (batch);
+        return PyErr_NoMemory ();
+      }
+
+      batch->buffer.payload     = payload;
+      batch->buffer.payloadsize = packetinfo->payloadlength;
+      continue;
+    }
+    else if (status == SLTERMINATE)
+    {
+      self->terminated = 1;
+      break;
+    }
+
+    /* SLNOPACKET: return what is available, otherwise wait for data */
+    if (batch->count > 0)
+      break;
+
+    remaining = POLL_SLICE_MS;
+    if (deadline >= 0)
+    {
+      remaining = (deadline - sl_nstime ()) / 1000000;
+
+      if (remaining <= 0)
+        break;
+      if (remaining > POLL_SLICE_MS)
+        remaining = POLL_SLICE_MS;
+    }
+
+    /* Wait for data, or while not connected for the next attempt */
+    Py_BEGIN_ALLOW_THREADS
+    if (self->slconn->link != -1)
+      sl_poll (self->slconn, 1, 0, (int)remaining);
+    else
+      sl_usleep ((unsigned long int)remaining * 1000);
+    Py_END_ALLOW_THREADS
+
+    if ((interrupted = PyErr_CheckSignals ()))
+      break;
+  }
+
+  /* Carry partial payload collected into this batch to the next batch */
+  if (!self->terminated && self->slconn->stat->stream_state == PAYLOAD &&
+      self->slconn->stat->packetinfo.payloadcollected > 0)
+  {
+    uint32_t collected = self->slconn->stat->packetinfo.payloadcollected;
+
+    if (collected > self->carrysize)
+    {
+      char *carry = PyMem_RawRealloc (self->carry, collected);
+
+      if (!carry)
+      {
+        Py_DECREF (batch);
+        return PyErr_NoMemory ();
+      }
+
+      self->carry     = carry;
+      self->carrysize = collected;
+    }
+
+    memcpy (self->carry, batch->buffer.payload + batch->used, collected);
+    self->carrylength = collected;
+  }
+
+  if (interrupted)
+  {
+    Py_DECREF (batch);
+    return NULL;
+  }
+
+  if (batch->count == 0 && self->terminated)
+  {
+    Py_DECREF (batch);
+    Py_RETURN_NONE;
+  }
+
+  return (PyObject *)batch;
+}
+
+static PyObject *
+Connection_get_terminated (ConnectionObject *self, void *closure)
+{
+  (void)closure;
+  return PyBool_FromLong (self->terminated);
+}
+
+static PyMethodDef Connection_methods[] = {
+    {"add_stream", (PyCFunction)(void (*) (void))Connection_add_stream, METH_VARARGS | METH_KEYWORDS,
+     "add_stream(stationid, selectors=None, seqnum=-1, timestamp=None)\n\n"
+     "Add a stream to the connection, see sl_add_stream()."},
+    {"set_allstation_params", (PyCFunction)(void (*) (void))Connection_set_allstation_params,
+     METH_VARARGS | METH_KEYWORDS,
+     "set_allstation_params(selectors, seqnum=-1, timestamp=None)\n\n"
+     "Set parameters for all-station mode, see sl_set_allstation_params()."},
+    {"request_info", (PyCFunction)Connection_request_info, METH_VARARGS,
+     "request_info(infostr)\n\nRequest INFO, see sl_request_info()."},
+    {"collect", (PyCFunction)(void (*) (void))Connection_collect, METH_VARARGS | METH_KEYWORDS,
+     "collect(timeout=None) -> Batch or None\n\n"
+     "Collect a batch of packets, waiting up to timeout seconds (forever\n"
+     "if None) for the first packet with the GIL released.  Returns None\n"
+     "when the connection has terminated."},
+    {"terminate", (PyCFunction)Connection_terminate, METH_NOARGS,
+     "terminate()\n\nRequest connection termination, see sl_terminate()."},
+    {"close", (PyCFunction)Connection_close, METH_NOARGS,
+     "close()\n\nDisconnect and free the connection."},
+    {"__enter__", (PyCFunction)Connection_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)Connection_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}};
+
+static PyGetSetDef Connection_getset[] = {
+    {"terminated", (getter)Connection_get_terminated, NULL,
+     "True when the connection has terminated", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyTypeObject ConnectionType = {
+    PyVarObject_HEAD_INIT (NULL, 0)
+    .tp_name      = "slink.Connection",
+    .tp_basicsize = sizeof (ConnectionObject),
+    .tp_dealloc   = (destructor)Connection_dealloc,
+    .tp_flags     = Py_TPFLAGS_DEFAULT,
+    .tp_doc       = "Connection(server, clientname='pyslink', clientversion=None,\n"
+                    "           buffersize=1048576, maxpackets=1024)\n\n"
+                    "SeedLink connection collecting packets in batches.",
+    .tp_methods   = Connection_methods,
+    .tp_getset    = Connection_getset,
+    .tp_init      = (initproc)Connection_init,
+    .tp_new       = PyType_GenericNew,
+};
+
+/*****
+ * Batch methods
+ ****/
+
+static void
+Batch_dealloc (BatchObject *self)
+{
+  pool_release (self->conn, &self->buffer);
+  Py_XDECREF (self->conn);
+  PyObject_Free (self);
+}
+
+static int
+Batch_getbuffer (BatchObject *self, Py_buffer *view, int flags)
+{
+  return PyBuffer_FillInfo (view, (PyObject *)self, self->buffer.payload,
+                            self->used, 1, flags);
+}
+
+static Py_ssize_t
+Batch_length (BatchObject *self)
+{
+  return self->count;
+}
+
+/* Return a memoryview of a single payload, sharing the batch buffer */
+static PyObject *
+Batch_item (BatchObject *self, Py_ssize_t idx)
+{
+  PacketHeader *header;
+  PyObject *view;
+  PyObject *slice;
+
+  if (idx < 0 || idx >= (Py_ssize_t)self->count)
+  {
+    PyErr_SetString (PyExc_IndexError, "Batch index out of range");
+    return NULL;
+  }
+
+  header = &self->buffer.headers[idx];
+
+  if (!(view = PyMemoryView_FromObject ((PyObject *)self)))
+    return NULL;
+
+  slice = PySequence_GetSlice (view, header->offset, header->offset + header->length);
+  Py_DECREF (view);
+
+  return slice;
+}
+
+static PyObject *
+Batch_get_headers (BatchObject *self, void *closure)
+{
+  HeadersObject *headers;
+  PyObject *view;
+
+  (void)closure;
+
+  if (!(headers = PyObject_New (HeadersObject, &HeadersType)))
+    return NULL;
+
+  Py_INCREF (self);
+  headers->batch = self;
+
+  view = PyMemoryView_FromObject ((PyObject *)headers);
+  Py_DECREF (headers);
+
+  return view;
+}
+
+static PyGetSetDef Batch_getset[] = {
+    {"headers", (getter)Batch_get_headers, NULL,
+     "memoryview of packed per-packet header fields, see HEADER_DTYPE", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyBufferProcs Batch_as_buffer = {
+    (getbufferproc)Batch_getbuffer,
+    NULL,
+};
+
+static PySequenceMethods Batch_as_sequence = {
+    .sq_length = (lenfunc)Batch_length,
+    .sq_item   = (ssizeargfunc)Batch_item,
+};
+
+static PyTypeObject BatchType = {
+    PyVarObject_HEAD_INIT (NULL, 0)
+    .tp_name        = "slink.Batch",
+    .tp_basicsize   = sizeof (BatchObject),
+    .tp_dealloc     = (destructor)Batch_dealloc,
+    .tp_flags       = Py_TPFLAGS_DEFAULT,
+    .tp_doc         = "Batch of collected packets.\n\n"
+                      "Exports the concatenated payloads through the buffer protocol,\n"
+                      "batch[i] is a memoryview of payload i and batch.headers the\n"
+                      "packed header fields.  Memory returns to the connection pool\n"
+                      "when the batch and all views of it are released.",
+    .tp_getset      = Batch_getset,
+    .tp_as_buffer   = &Batch_as_buffer,
+    .tp_as_sequence = &Batch_as_sequence,
+};
+
+/*****
+ * Headers methods, exporter of the header array of a batch
+ ****/
+
+static void
+Headers_dealloc (HeadersObject *self)
+{
+  Py_XDECREF (self->batch);
+  PyObject_Free (self);
+}
+
+static int
+Headers_getbuffer (HeadersObject *self, Py_buffer *view, int flags)
+{
+  return PyBuffer_FillInfo (view, (PyObject *)self, self->batch->buffer.headers,
+                            self->batch->count * sizeof (PacketHeader), 1, flags);
+}
+
+static PyBufferProcs Headers_as_buffer = {
+    (getbufferproc)Headers_getbuffer,
+    NULL,
+};
+
+static PyTypeObject HeadersType = {
+    PyVarObject_HEAD_INIT (NULL, 0)
+    .tp_name      = "slink._Headers",
+    .tp_basicsize = sizeof (HeadersObject),
+    .tp_dealloc   = (destructor)Headers_dealloc,
+    .tp_flags     = Py_TPFLAGS_DEFAULT,
+    .tp_as_buffer = &Headers_as_buffer,
+};
+
+/*****
+ * Module definition
+ ****/
+
+/* Build HEADER_DTYPE, a numpy compatible dtype description of PacketHeader */
+static PyObject *
+header_dtype (void)
+{
+  return Py_BuildValue ("[(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)(ss)]",
+                        "seqnum", "=u8",
+                        "starttime", "=i8",
+                        "samplerate", "=f8",
+                        "offset", "=u4",
+                        "length", "=u4",
+                        "samplecount", "=u4",
+                        "format", "S1",
+                        "subformat", "S1",
+                        "stationid", "S" STRINGIFY (SL_MAX_STATIONID),
+                        "sourceid", "S68");
+}
+
+static struct PyModuleDef slinkmodule = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "slink",
+    .m_doc  = "SeedLink client interface using libslink.\n\n"
+              "Packet headers of a batch can be viewed as a structured array with:\n"
+              "  numpy.frombuffer(batch.headers, dtype=numpy.dtype(slink.HEADER_DTYPE))",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC
+PyInit_slink (void)
+{
+  PyObject *module;
+  PyObject *dtype;
+
+  if (PyType_Ready (&ConnectionType) < 0 ||
+      PyType_Ready (&BatchType) < 0 ||
+      PyType_Ready (&HeadersType) < 0)
+    return NULL;
+
+  if (!(module = PyModule_Create (&slinkmodule)))
+    return NULL;
+
+  Py_INCREF (&ConnectionType);
+  Py_INCREF (&BatchType);
+
+  if (PyModule_AddObject (module, "Connection", (PyObject *)&ConnectionType) < 0 ||
+      PyModule_AddObject (module, "Batch", (PyObject *)&BatchType) < 0 ||
+      !(dtype = header_dtype ()) ||
+      PyModule_AddObject (module, "HEADER_DTYPE", dtype) < 0 ||
+      PyModule_AddIntConstant (module, "HEADER_SIZE", sizeof (PacketHeader)) < 0 ||
+      PyModule_AddStringConstant (module, "LIBSLINK_VERSION", LIBSLINK_VERSION) < 0)
+  {
+    Py_DECREF (module);
+    return NULL;
+  }
+
+  return module;
+}
@@ -0,0 +1,2017 @@
+/***************************************************************************
+ * relay.c
+ *
+ * Routines for re-serving received packets to local SeedLink clients.
+ *
+ * A relay keeps a ring of recent packets indexed by a relay sequence
+ * number and accepts SeedLink v3 and v4 clients on a listening socket.
+ * Client commands (HELLO, STATION, SELECT, DATA, FETCH, TIME, INFO,
+ * END, etc.) are answered from the ring and packets are sent to each
+ * client directly from the ring, a packet is stored once regardless of
+ * the number of clients.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+#include "globmatch.h"
+#include "mseedformat.h"
+
+#if defined(SLP_WIN)
+  #define POLL(fds, nfds, timeout) WSAPoll (fds, nfds, timeout)
+  #define CLOSESOCKET(sock) closesocket (sock)
+  #define INVALIDSOCKET INVALID_SOCKET
+  #define IS_EWOULDBLOCK() (WSAGetLastError () == WSAEWOULDBLOCK)
+  #define IS_EINTR() (WSAGetLastError () == WSAEINTR)
+  #define SENDFLAGS 0
+#else
+  #include <poll.h>
+  #include <sys/uio.h>
+  #define POLL(fds, nfds, timeout) poll (fds, nfds, timeout)
+  #define CLOSESOCKET(sock) close (sock)
+  #define INVALIDSOCKET -1
+  #define IS_EWOULDBLOCK() (errno == EWOULDBLOCK || errno == EAGAIN)
+  #define IS_EINTR() (errno == EINTR)
+  #if defined(MSG_NOSIGNAL)
+    #define SENDFLAGS MSG_NOSIGNAL
+  #else
+    #define SENDFLAGS 0
+  #endif
+#endif
+
+/* Maximum length of a client command line */
+#define RELAY_MAXCMD 256
+
+/* Maximum bytes sent to a client per service pass, for fairness */
+#define RELAY_SENDBUDGET (256 * 1024)
+
+/* Length of v3 miniSEED records and the XML data in v3 INFO records */
+#define RELAY_V3RECLEN 512
+#define RELAY_V3INFODATA (RELAY_V3RECLEN - 64)
+
+/* Packet in the ring */
+typedef struct RelayPacket
+{
+  uint64_t seqnum;             /* Relay sequence number */
+  int64_t starttime;           /* miniSEED start time, SLTERROR if unknown */
+  char stationid[SL_MAX_STATIONID]; /* Station ID, NET_STA */
+  char streamid[32];           /* Stream ID, LOC_B_S_SS, empty if unknown */
+  char format;                 /* Payload format */
+  char subformat;              /* Payload subformat */
+  char *payload;               /* Payload buffer */
+  uint32_t length;             /* Payload length */
+  uint32_t size;               /* Payload buffer size */
+} RelayPacket;
+
+/* Station requested by a client */
+typedef struct RelayStation
+{
+  char pattern[SL_MAX_STATIONID]; /* Station ID pattern, NET_STA */
+  char *selectors;             /* NUL-separated +/- prefixed stream ID patterns */
+  size_t selectorslength;      /* Length of selector list */
+  uint64_t startseq;           /* Requested start sequence or SL_UNSETSEQUENCE */
+  int64_t starttime;           /* Time window start, SLTERROR if unset */
+  int64_t endtime;             /* Time window end, SLTERROR if unset */
+  struct RelayStation *next;
+} RelayStation;
+
+/* Connected client */
+typedef struct RelayClient
+{
+  SOCKET sock;                 /* Client socket, INVALIDSOCKET when closed */
+  char address[64];            /* Client address for logging */
+  int8_t protocol;             /* Protocol major version, 3 or 4 */
+  int8_t streaming;            /* Streaming packets */
+  int8_t fetch;                /* Close when all buffered packets are sent */
+  int8_t batch;                /* v3 batch mode, no command responses */
+  int8_t closing;              /* Close when output is sent */
+  char command[RELAY_MAXCMD];  /* Partial command line */
+  uint32_t commandlength;
+  char *output;                /* Pending command responses */
+  uint32_t outputlength;
+  uint32_t outputoffset;
+  uint32_t outputsize;
+  RelayStation *stations;      /* Requested stations */
+  RelayStation *current;       /* Station being configured */
+  uint64_t cursor;             /* Sequence of next packet to send */
+  uint32_t sent;               /* Bytes of packet at cursor sent */
+  uint8_t header[SLHEADSIZE_V4 + SL_MAX_STATIONID]; /* Header of packet at cursor */
+  uint32_t headerlength;
+  uint64_t packets;            /* Packets sent */
+} RelayClient;
+
+struct SLrelay
+{
+  SOCKET listener;             /* Listening socket */
+  char organization[100];      /* Organization reported to clients */
+  RelayPacket *ring;           /* Ring of packets */
+  uint32_t ringsize;           /* Number of packets in ring */
+  uint64_t nextseq;            /* Sequence of next packet added */
+  RelayClient **clients;       /* Connected clients */
+  uint32_t clientcount;
+  uint32_t maxclients;
+  struct pollfd *pollfds;      /* Poll descriptors, listener then clients */
+  int64_t started;             /* Time relay was started */
+  uint64_t packets;            /* Packets added */
+  uint64_t dropped;            /* Packets not sent to clients too far behind */
+};
+
+static int relay_listen (SLrelay *relay, const char *listenaddress);
+static void accept_clients (SLrelay *relay, const SLlog *log);
+static void close_client (RelayClient *client, const SLlog *log, const char *reason);
+static void free_client (RelayClient *client);
+static int read_client (SLrelay *relay, const SLlog *log, RelayClient *client);
+static int handle_command (SLrelay *relay, const SLlog *log, RelayClient *client, char *command);
+static int send_client (SLrelay *relay, const SLlog *log, RelayClient *client);
+static int respond (RelayClient *client, const char *response, size_t length);
+static int respond_ok (RelayClient *client);
+static int respond_error (RelayClient *client, const char *code, const char *message);
+static int add_station (RelayClient *client, const char *pattern);
+static int add_selector (RelayClient *client, const char *selector);
+static int start_request (SLrelay *relay, RelayClient *client, char *args, int istime);
+static void start_streaming (SLrelay *relay, RelayClient *client);
+static int match_packet (const RelayClient *client, const RelayPacket *packet);
+static int match_selectors (const RelayStation *station, const RelayPacket *packet);
+static uint32_t build_header (const RelayClient *client, const RelayPacket *packet,
+                              uint8_t *header);
+static int info_response (SLrelay *relay, RelayClient *client, const char *level);
+static int info_json (SLrelay *relay, RelayClient *client, int level, char **text, size_t *length);
+static int info_xml (SLrelay *relay, RelayClient *client, int level, char **text, size_t *length);
+static int info_records (RelayClient *client, const char *xml, size_t length);
+static int append_text (char **text, size_t *length, size_t *size, const char *format, ...);
+static int64_t parse_time (const char *timestr);
+static uint64_t oldest_seq (const SLrelay *relay);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new relay and start listening for clients
+ *
+ * The relay listens on \a listenaddress, in the form `[host:]port`,
+ * where an omitted host listens on all interfaces.  Up to \a ringsize
+ * recent packets are kept for clients, and up to \a maxclients clients
+ * are accepted.
+ *
+ * Packets are added by connections configured with sl_set_relay(), or
+ * directly with sl_relay_add(), and clients are served by calling
+ * sl_relay_service() regularly.
+ *
+ * Packets are numbered with relay sequence numbers, independent of the
+ * sequence numbers of the upstream server(s), so that a relay may be
+ * fed by multiple connections.
+ *
+ * The relay is not thread-safe, all calls must be made from the same
+ * thread or otherwise serialized.
+ *
+ * @param[in] listenaddress  Address to listen on, `[host:]port`
+ * @param[in] organization   Organization reported to clients, or NULL
+ * @param[in] ringsize       Number of packets in the ring, 0 for a default of 10000
+ * @param[in] maxclients     Maximum number of clients, 0 for a default of 512
+ *
+ * @returns An initialized ::SLrelay on success, NULL on error.
+ *
+ * @sa sl_set_relay(), sl_relay_service()
+ ***************************************************************************/
+SLrelay *
+sl_initslrelay (const char *listenaddress, const char *organization,
+                uint32_t ringsize, uint32_t maxclients)
+{
+  SLrelay *relay;
+
+  if (!listenaddress)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): listen address is required\n", __func__);
+    return NULL;
+  }
+
+  if ((relay = (SLrelay *)sl_malloc (sizeof (SLrelay))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (relay, 0, sizeof (SLrelay));
+
+  relay->listener   = INVALIDSOCKET;
+  relay->ringsize   = (ringsize) ? ringsize : 10000;
+  relay->maxclients = (maxclients) ? maxclients : 512;
+  relay->started    = sl_nstime ();
+
+  snprintf (relay->organization, sizeof (relay->organization), "%s",
+            (organization) ? organization : "libslink relay");
+
+  relay->ring    = (RelayPacket *)sl_calloc (relay->ringsize, sizeof (RelayPacket));
+  relay->clients = (RelayClient **)sl_calloc (relay->maxclients, sizeof (RelayClient *));
+  relay->pollfds = (struct pollfd *)sl_calloc (relay->maxclients + 1, sizeof (struct pollfd));
+
+  if (!relay->ring || !relay->clients || !relay->pollfds)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_freeslrelay (relay);
+    return NULL;
+  }
+
+  if (relay_listen (relay, listenaddress))
+  {
+    sl_freeslrelay (relay);
+    return NULL;
+  }
+
+  return relay;
+} /* End of sl_initslrelay() */
+
+/**********************************************************************/ /**
+ * @brief Disconnect all clients and free all resources of a relay
+ *
+ * @param[in] relay  Relay to free
+ ***************************************************************************/
+void
+sl_freeslrelay (SLrelay *relay)
+{
+  uint32_t idx;
+
+  if (!relay)
+    return;
+
+  if (relay->clients)
+  {
+    for (idx = 0; idx < relay->clientcount; idx++)
+    {
+      close_client (relay->clients[idx], NULL, NULL);
+      free_client (relay->clients[idx]);
+    }
+
+    sl_free (relay->clients);
+  }
+
+  if (relay->ring)
+  {
+    for (idx = 0; idx < relay->ringsize; idx++)
+      sl_free (relay->ring[idx].payload);
+
+    sl_free (relay->ring);
+  }
+
+  if (relay->listener != INVALIDSOCKET)
+    CLOSESOCKET (relay->listener);
+
+  sl_free (relay->pollfds);
+  sl_free (relay);
+} /* End of sl_freeslrelay() */
+
+/**********************************************************************/ /**
+ * @brief Add a packet to a relay
+ *
+ * The payload is copied into the ring and the packet is assigned the
+ * next relay sequence number.  INFO responses are not added.
+ *
+ * When the ring is full the oldest packet is replaced.  Clients that
+ * have not yet sent this packet skip it, a client in the middle of
+ * sending it is disconnected as too slow.
+ *
+ * @param[in] relay       Relay to add packet to
+ * @param[in] log         Logging parameters, or NULL
+ * @param[in] packetinfo  Packet information from sl_collect()
+ * @param[in] payload     Packet payload
+ *
+ * @retval  1 : packet added
+ * @retval  0 : packet not added, INFO response or empty
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_relay_add (SLrelay *relay, const SLlog *log,
+              const SLpacketinfo *packetinfo, const char *payload)
+{
+  RelayPacket *packet;
+  RelayClient *client;
+  char sourceid[64] = {0};
+  char *newpayload;
+  char *cp;
+  uint32_t length;
+  uint32_t idx;
+  int underscores;
+
+  if (!relay || !packetinfo || !payload)
+    return -1;
+
+  length = packetinfo->payloadcollected;
+
+  if (length == 0 ||
+      packetinfo->payloadformat == SLPAYLOAD_MSEED2INFO ||
+      packetinfo->payloadformat == SLPAYLOAD_MSEED2INFOTERM ||
+      (packetinfo->payloadformat == SLPAYLOAD_JSON &&
+       (packetinfo->payloadsubformat == SLPAYLOAD_JSON_INFO ||
+        packetinfo->payloadsubformat == SLPAYLOAD_JSON_ERROR)) ||
+      (packetinfo->payloadformat == SLPAYLOAD_XML &&
+       packetinfo->payloadsubformat == SLPAYLOAD_XML_INFO))
+    return 0;
+
+  packet = &relay->ring[relay->nextseq % relay->ringsize];
+
+  /* Clients sending the packet being replaced cannot complete it */
+  if (relay->nextseq >= relay->ringsize)
+  {
+    for (idx = 0; idx < relay->clientcount; idx++)
+    {
+      client = relay->clients[idx];
+
+      if (client->cursor == packet->seqnum && client->sent > 0)
+        close_client (client, log, "too slow, packet replaced while sending");
+    }
+  }
+
+  if (length > packet->size)
+  {
+    if ((newpayload = (char *)sl_realloc (packet->payload, length)) == NULL)
+    {
+      sl_log_rl (log, 2, 0, "%s(): error allocating memory\n", __func__);
+      return -1;
+    }
+
+    packet->payload = newpayload;
+    packet->size    = length;
+  }
+
+  memcpy (packet->payload, payload, length);
+  packet->length       = length;
+  packet->seqnum       = relay->nextseq;
+  packet->format       = packetinfo->payloadformat;
+  packet->subformat    = packetinfo->payloadsubformat;
+  packet->starttime    = SLTERROR;
+  packet->streamid[0]  = '\0';
+
+  snprintf (packet->stationid, sizeof (packet->stationid), "%s", packetinfo->stationid);
+
+  /* Station and stream IDs from miniSEED source identifier, FDSN:NET_STA_LOC_B_S_SS */
+  if ((packet->format == SLPAYLOAD_MSEED2 || packet->format == SLPAYLOAD_MSEED3) &&
+      sl_payload_info (log, packetinfo, payload, length,
+                       sourceid, sizeof (sourceid), NULL, 0, NULL, NULL) == 0)
+  {
+    packet->starttime = sl_payload_starttime (log, packetinfo, payload, length);
+
+    cp = (strncmp (sourceid, "FDSN:", 5) == 0) ? sourceid + 5 : sourceid;
+
+    for (idx = 0, underscores = 0; cp[idx]; idx++)
+    {
+      if (cp[idx] == '_' && ++underscores == 2)
+      {
+        snprintf (packet->stationid, sizeof (packet->stationid), "%.*s", (int)idx, cp);
+        snprintf (packet->streamid, sizeof (packet->streamid), "%s", cp + idx + 1);
+        break;
+      }
+    }
+
+    if (packet->subformat == 0)
+      packet->subformat = 'D';
+  }
+
+  relay->nextseq++;
+  relay->packets++;
+
+  return 1;
+} /* End of sl_relay_add() */
+
+/**********************************************************************/ /**
+ * @brief Accept clients, process commands and send packets
+ *
+ * Waits up to \a timeout_ms milliseconds for client activity, accepts
+ * new clients, processes received commands and sends pending responses
+ * and packets.  Sockets are non-blocking, a slow client does not delay
+ * others.
+ *
+ * This function must be called regularly, e.g. after each call to
+ * sl_collect() with a timeout of 0, or in a loop with a non-blocking
+ * connection.
+ *
+ * @param[in] relay       Relay to service
+ * @param[in] log         Logging parameters, or NULL
+ * @param[in] timeout_ms  Maximum time to wait for activity in milliseconds
+ *
+ * @returns The number of connected clients on success, -1 on error.
+ ***************************************************************************/
+int
+sl_relay_service (SLrelay *relay, const SLlog *log, int timeout_ms)
+{
+  RelayClient *client;
+  uint32_t idx;
+  uint32_t count;
+  int ready;
+
+  if (!relay)
+    return -1;
+
+  /* Poll listener and clients, for writability if output is pending */
+  relay->pollfds[0].fd      = relay->listener;
+  relay->pollfds[0].events  = POLLIN;
+  relay->pollfds[0].revents = 0;
+
+  for (idx = 0; idx < relay->clientcount; idx++)
+  {
+    client = relay->clients[idx];
+
+    relay->pollfds[idx + 1].fd      = client->sock;
+    relay->pollfds[idx + 1].events  = POLLIN;
+    relay->pollfds[idx + 1].revents = 0;
+
+    if (client->outputlength > client->outputoffset ||
+        (client->streaming && (client->cursor < relay->nextseq || client->fetch)))
+    {
+      relay->pollfds[idx + 1].events |= POLLOUT;
+    }
+  }
+
+  ready = POLL (relay->pollfds, relay->clientcount + 1, (timeout_ms < 0) ? 0 : timeout_ms);
+
+  if (ready < 0)
+  {
+    if (IS_EINTR ())
+      return relay->clientcount;
+
+    sl_log_rl (log, 2, 0, "%s(): error polling sockets: %s\n", __func__, sl_strerror ());
+    return -1;
+  }
+
+  if (ready > 0)
+  {
+    for (idx = 0; idx < relay->clientcount; idx++)
+    {
+      client = relay->clients[idx];
+
+      if (client->sock == INVALIDSOCKET)
+        continue;
+
+      if (relay->pollfds[idx + 1].revents & (POLLIN | POLLHUP | POLLERR))
+      {
+        if (read_client (relay, log, client))
+          continue;
+      }
+
+      if (relay->pollfds[idx + 1].revents & POLLOUT)
+        send_client (relay, log, client);
+    }
+
+    if (relay->pollfds[0].revents & POLLIN)
+      accept_clients (relay, log);
+  }
+
+  /* Remove closed clients */
+  for (idx = 0, count = 0; idx < relay->clientcount; idx++)
+  {
+    client = relay->clients[idx];
+
+    if (client->sock == INVALIDSOCKET)
+      free_client (client);
+    else
+      relay->clients[count++] = client;
+  }
+
+  relay->clientcount = count;
+
+  return relay->clientcount;
+} /* End of sl_relay_service() */
+
+/**********************************************************************/ /**
+ * @brief Return relay statistics
+ *
+ * @param[in]  relay    Relay to report
+ * @param[out] packets  Number of packets added, or NULL
+ * @param[out] dropped  Number of packets skipped by clients too far behind, or NULL
+ * @param[out] clients  Number of connected clients, or NULL
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_relay_stats (const SLrelay *relay, uint64_t *packets, uint64_t *dropped,
+                uint32_t *clients)
+{
+  if (!relay)
+    return -1;
+
+  if (packets)
+    *packets = relay->packets;
+  if (dropped)
+    *dropped = relay->dropped;
+  if (clients)
+    *clients = relay->clientcount;
+
+  return 0;
+} /* End of sl_relay_stats() */
+
+/***************************************************************************
+ * relay_listen:
+ *
+ * Create a non-blocking listening socket for an address in the form
+ * [host:]port.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+relay_listen (SLrelay *relay, const char *listenaddress)
+{
+  struct addrinfo hints;
+  struct addrinfo *addr0 = NULL;
+  struct addrinfo *addr;
+  char host[256] = {0};
+  const char *port;
+  const char *colon;
+  int optval = 1;
+
+  /* Split [host:]port, host may be a bracketed IPv6 address */
+  if ((colon = strrchr (listenaddress, ':')))
+  {
+    if (listenaddress[0] == '[' && colon > listenaddress && *(colon - 1) == ']')
+      snprintf (host, sizeof (host), "%.*s", (int)(colon - listenaddress - 2), listenaddress + 1);
+    else
+      snprintf (host, sizeof (host), "%.*s", (int)(colon - listenaddress), listenaddress);
+
+    port = colon + 1;
+  }
+  else
+  {
+    port = listenaddress;
+  }
+
+#if defined(SLP_WIN)
+  WSADATA wsaData;
+
+  if (WSAStartup (MAKEWORD (2, 2), &wsaData))
+  {
+    sl_log_r (NULL, 2, 0, "%s(): cannot initialize sockets\n", __func__);
+    return -1;
+  }
+#endif
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family   = PF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags    = AI_PASSIVE;
+
+  if (getaddrinfo ((host[0]) ? host : NULL, port, &hints, &addr0))
+  {
+    sl_log_r (NULL, 2, 0, "%s(): cannot resolve listen address %s\n", __func__, listenaddress);
+    return -1;
+  }
+
+  for (addr = addr0; addr != NULL; addr = addr->ai_next)
+  {
+    if ((relay->listener = socket (addr->ai_family, addr->ai_socktype, addr->ai_protocol)) == INVALIDSOCKET)
+      continue;
+
+    setsockopt (relay->listener, SOL_SOCKET, SO_REUSEADDR, (void *)&optval, sizeof (optval));
+
+    if (bind (relay->listener, addr->ai_addr, addr->ai_addrlen) == 0 &&
+        listen (relay->listener, 64) == 0)
+      break;
+
+    CLOSESOCKET (relay->listener);
+    relay->listener = INVALIDSOCKET;
+  }
+
+  freeaddrinfo (addr0);
+
+  if (relay->listener == INVALIDSOCKET)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): cannot listen on %s: %s\n", __func__, listenaddress, sl_strerror ());
+    return -1;
+  }
+
+#if defined(SLP_WIN)
+  u_long flag = 1;
+  ioctlsocket (relay->listener, FIONBIO, &flag);
+#else
+  fcntl (relay->listener, F_SETFL, fcntl (relay->listener, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+  return 0;
+} /* End of relay_listen() */
+
+/***************************************************************************
+ * accept_clients:
+ *
+ * Accept pending client connections, connections beyond the maximum
+ * number of clients are closed.
+ ***************************************************************************/
+static void
+accept_clients (SLrelay *relay, const SLlog *log)
+{
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+  RelayClient *client;
+  SOCKET sock;
+  char host[48];
+  char port[8];
+
+  for (;;)
+  {
+    addrlen = sizeof (addr);
+
+    if ((sock = accept (relay->listener, (struct sockaddr *)&addr, &addrlen)) == INVALIDSOCKET)
+    {
+      if (!IS_EWOULDBLOCK () && !IS_EINTR ())
+        sl_log_rl (log, 2, 0, "%s(): error accepting client: %s\n", __func__, sl_strerror ());
+      return;
+    }
+
+    if (getnameinfo ((struct sockaddr *)&addr, addrlen, host, sizeof (host),
+                     port, sizeof (port), NI_NUMERICHOST | NI_NUMERICSERV))
+    {
+      strcpy (host, "unknown");
+      port[0] = '\0';
+    }
+
+    if (relay->clientcount >= relay->maxclients)
+    {
+      sl_log_rl (log, 1, 0, "Relay client %s:%s rejected, maximum clients connected\n", host, port);
+      CLOSESOCKET (sock);
+      continue;
+    }
+
+    if ((client = (RelayClient *)sl_malloc (sizeof (RelayClient))) == NULL)
+    {
+      sl_log_rl (log, 2, 0, "%s(): error allocating memory\n", __func__);
+      CLOSESOCKET (sock);
+      return;
+    }
+
+    memset (client, 0, sizeof (RelayClient));
+    client->sock     = sock;
+    client->protocol = 3;
+    snprintf (client->address, sizeof (client->address), "%s:%s", host, port);
+
+#if defined(SLP_WIN)
+    u_long flag = 1;
+    ioctlsocket (sock, FIONBIO, &flag);
+#else
+    fcntl (sock, F_SETFL, fcntl (sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    relay->clients[relay->clientcount++] = client;
+
+    sl_log_rl (log, 1, 1, "Relay client %s connected\n", client->address);
+  }
+} /* End of accept_clients() */
+
+/***************************************************************************
+ * close_client:
+ *
+ * Close the socket of a client, the client is removed at the end of
+ * the service pass.
+ ***************************************************************************/
+static void
+close_client (RelayClient *client, const SLlog *log, const char *reason)
+{
+  if (client->sock == INVALIDSOCKET)
+    return;
+
+  CLOSESOCKET (client->sock);
+  client->sock      = INVALIDSOCKET;
+  client->streaming = 0;
+
+  if (reason)
+    sl_log_rl (log, 1, 1, "Relay client %s disconnected, %s, %" PRIu64 " packets sent\n",
+               client->address, reason, client->packets);
+} /* End of close_client() */
+
+/***************************************************************************
+ * free_client:
+ *
+ * Free all resources of a client.
+ ***************************************************************************/
+static void
+free_client (RelayClient *client)
+{
+  RelayStation *station;
+
+  while (client->stations)
+  {
+    station = client->stations->next;
+    sl_free (client->stations->selectors);
+    sl_free (client->stations);
+    client->stations = station;
+  }
+
+  sl_free (client->output);
+  sl_free (client);
+} /* End of free_client() */
+
+/***************************************************************************
+ * read_client:
+ *
+ * Receive data from a client and process complete command lines,
+ * terminated by CR and/or LF.
+ *
+ * Returns 0 on success and -1 if the client was closed.
+ ***************************************************************************/
+static int
+read_client (SLrelay *relay, const SLlog *log, RelayClient *client)
+{
+  char buffer[1024];
+  char *cp;
+  int received;
+  int idx;
+
+  received = recv (client->sock, buffer, sizeof (buffer), 0);
+
+  if (received == 0)
+  {
+    close_client (client, log, "closed by client");
+    return -1;
+  }
+  else if (received < 0)
+  {
+    if (IS_EWOULDBLOCK () || IS_EINTR ())
+      return 0;
+
+    close_client (client, log, sl_strerror ());
+    return -1;
+  }
+
+  for (idx = 0; idx < received; idx++)
+  {
+    if (buffer[idx] == '\r' || buffer[idx] == '\n')
+    {
+      if (client->commandlength == 0)
+        continue;
+
+      client->command[client->commandlength] = '\0';
+      client->commandlength = 0;
+
+      /* Trim trailing spaces */
+      cp = client->command + strlen (client->command);
+      while (cp > client->command && *(cp - 1) == ' ')
+        *--cp = '\0';
+
+      if (handle_command (relay, log, client, client->command))
+      {
+        close_client (client, log, "command processing failed");
+        return -1;
+      }
+
+      if (client->sock == INVALIDSOCKET)
+        return -1;
+    }
+    else if (client->commandlength < RELAY_MAXCMD - 1)
+    {
+      client->command[client->commandlength++] = buffer[idx];
+    }
+    else
+    {
+      close_client (client, log, "command too long");
+      return -1;
+    }
+  }
+
+  /* Send responses without waiting for the next pass */
+  if (client->outputlength > client->outputoffset)
+    send_client (relay, log, client);
+
+  return 0;
+} /* End of read_client() */
+
+/***************************************************************************
+ * handle_command:
+ *
+ * Process a single command from a client.  Responses are appended to
+ * the client output.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+handle_command (SLrelay *relay, const SLlog *log, RelayClient *client, char *command)
+{
+  char response[400];
+  char pattern[SL_MAX_STATIONID];
+  char *args;
+  char *arg2;
+  size_t length;
+  int rv;
+
+  /* Split command and arguments */
+  length = strcspn (command, " ");
+  args   = command + length;
+  if (*args)
+    *args++ = '\0';
+  args += strspn (args, " ");
+
+  for (char *cp = command; *cp; cp++)
+    *cp = toupper ((int)*cp);
+
+  sl_log_rl (log, 1, 3, "Relay client %s command: %s %s\n", client->address, command, args);
+
+  /* Commands accepted while streaming */
+  if (strcmp (command, "INFO") == 0)
+  {
+    return info_response (relay, client, args);
+  }
+  else if (strcmp (command, "BYE") == 0)
+  {
+    close_client (client, log, "BYE");
+    return 0;
+  }
+
+  if (client->streaming)
+    return 0;
+
+  if (strcmp (command, "HELLO") == 0)
+  {
+    length = snprintf (response, sizeof (response),
+                       "SeedLink v4.0 (libslink/%s relay) :: "
+                       "SLPROTO:4.0 SLPROTO:3.1 CAP EXTREPLY NSWILDCARD BATCH\r\n%s\r\n",
+                       LIBSLINK_VERSION, relay->organization);
+    return respond (client, response, length);
+  }
+  else if (strcmp (command, "SLPROTO") == 0)
+  {
+    if (strncmp (args, "4.", 2) == 0)
+    {
+      client->protocol = 4;
+      return respond_ok (client);
+    }
+    else if (strncmp (args, "3.", 2) == 0)
+    {
+      client->protocol = 3;
+      return respond_ok (client);
+    }
+
+    return respond_error (client, "UNSUPPORTED", "unsupported protocol version");
+  }
+  else if (strcmp (command, "CAPABILITIES") == 0 ||
+           strcmp (command, "USERAGENT") == 0 ||
+           strcmp (command, "AUTH") == 0)
+  {
+    /* Authentication is not verified by the relay */
+    return respond_ok (client);
+  }
+  else if (strcmp (command, "GETCAPABILITIES") == 0)
+  {
+    length = snprintf (response, sizeof (response),
+                       "SLPROTO:4.0 SLPROTO:3.1 CAP EXTREPLY NSWILDCARD BATCH\r\n");
+    return respond (client, response, length);
+  }
+  else if (strcmp (command, "BATCH") == 0 && client->protocol == 3)
+  {
+    rv = respond_ok (client);
+    client->batch = 1;
+    return rv;
+  }
+  else if (strcmp (command, "STATION") == 0)
+  {
+    /* v3: STATION sta [net], v4: STATION NET_STA */
+    if (client->protocol == 3)
+    {
+      arg2 = args + strcspn (args, " ");
+      if (*arg2)
+        *arg2++ = '\0';
+      arg2 += strspn (arg2, " ");
+
+      snprintf (pattern, sizeof (pattern), "%s_%s", (*arg2) ? arg2 : "*", args);
+    }
+    else
+    {
+      snprintf (pattern, sizeof (pattern), "%s", args);
+    }
+
+    if (*args == '\0' || add_station (client, pattern))
+      return respond_error (client, "ARGUMENTS", "invalid station");
+
+    return respond_ok (client);
+  }
+  else if (strcmp (command, "SELECT") == 0)
+  {
+    if (add_selector (client, args))
+      return respond_error (client, "ARGUMENTS", "invalid selector");
+
+    return respond_ok (client);
+  }
+  else if (strcmp (command, "DATA") == 0 ||
+           strcmp (command, "FETCH") == 0 ||
+           strcmp (command, "TIME") == 0)
+  {
+    /* v3 uni-station mode when no station was requested, streaming starts without response */
+    if (client->protocol == 3 && client->stations == NULL)
+    {
+      if (add_station (client, "*") ||
+          start_request (relay, client, args, (command[0] == 'T')))
+        return respond_error (client, "ARGUMENTS", "invalid request");
+
+      client->fetch = (command[0] == 'F');
+      start_streaming (relay, client);
+      return 0;
+    }
+
+    if (!client->current)
+      return respond_error (client, "UNEXPECTED", "no station requested");
+
+    if (start_request (relay, client, args, (command[0] == 'T')))
+      return respond_error (client, "ARGUMENTS", "invalid request");
+
+    if (command[0] == 'F')
+      client->fetch = 1;
+
+    return respond_ok (client);
+  }
+  else if (strcmp (command, "END") == 0 || strcmp (command, "ENDFETCH") == 0)
+  {
+    if (!client->stations)
+      return respond_error (client, "UNEXPECTED", "no station requested");
+
+    if (strcmp (command, "ENDFETCH") == 0)
+      client->fetch = 1;
+
+    start_streaming (relay, client);
+    return 0;
+  }
+
+  return respond_error (client, "UNSUPPORTED", "unsupported command");
+} /* End of handle_command() */
+
+/***************************************************************************
+ * add_station:
+ *
+ * Add a requested station pattern to a client, becoming the station
+ * for subsequent SELECT and DATA commands.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+add_station (RelayClient *client, const char *pattern)
+{
+  RelayStation *station;
+
+  if (strlen (pattern) >= SL_MAX_STATIONID)
+    return -1;
+
+  if ((station = (RelayStation *)sl_malloc (sizeof (RelayStation))) == NULL)
+    return -1;
+
+  memset (station, 0, sizeof (RelayStation));
+  strcpy (station->pattern, pattern);
+  station->startseq  = SL_UNSETSEQUENCE;
+  station->starttime = SLTERROR;
+  station->endtime   = SLTERROR;
+
+  /* Selectors given before any station (v3 uni-station mode) apply to this station */
+  if (client->current && client->current->pattern[0] == '\0')
+  {
+    station->selectors       = client->current->selectors;
+    station->selectorslength = client->current->selectorslength;
+    sl_free (client->stations);
+    client->stations = NULL;
+  }
+
+  station->next    = client->stations;
+  client->stations = station;
+  client->current  = station;
+
+  return 0;
+} /* End of add_station() */
+
+/***************************************************************************
+ * add_selector:
+ *
+ * Add a selector to the current station of a client.  v3 selectors,
+ * [LL]CCC[.T], are converted to v4 stream ID patterns, LOC_B_S_SS[.T].
+ * Selectors prefixed with '!' exclude matching streams.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+add_selector (RelayClient *client, const char *selector)
+{
+  RelayStation *station;
+  char converted[64];
+  const char *pattern;
+  char *newselectors;
+  size_t length;
+  int exclude;
+
+  if (*selector == '\0')
+    return -1;
+
+  exclude = (*selector == '!') ? 1 : 0;
+  pattern = selector + exclude;
+
+  /* Convert v3 selectors, other patterns are used as given */
+  if (strchr (pattern, '_') == NULL &&
+      sl_v3to4selector (converted, sizeof (converted), pattern))
+    pattern = converted;
+
+  if (*pattern == '\0' || strlen (pattern) >= sizeof (converted))
+    return -1;
+
+  /* Selectors before any station, v3 uni-station mode, use a placeholder station */
+  if (!client->current)
+  {
+    if ((station = (RelayStation *)sl_malloc (sizeof (RelayStation))) == NULL)
+      return -1;
+
+    memset (station, 0, sizeof (RelayStation));
+    client->stations = station;
+    client->current  = station;
+  }
+
+  station = client->current;
+  length  = strlen (pattern) + 2;
+
+  if ((newselectors = (char *)sl_realloc (station->selectors,
+                                          station->selectorslength + length + 1)) == NULL)
+    return -1;
+
+  station->selectors = newselectors;
+  station->selectors[station->selectorslength] = (exclude) ? '-' : '+';
+  strcpy (station->selectors + station->selectorslength + 1, pattern);
+  station->selectorslength += length;
+  station->selectors[station->selectorslength] = '\0';
+
+  return 0;
+} /* End of add_selector() */
+
+/***************************************************************************
+ * start_request:
+ *
+ * Parse the arguments of a DATA, FETCH or TIME command for the current
+ * station of a client:
+ *
+ *   v3: DATA|FETCH [seq [start]], TIME start [end]
+ *   v4: DATA [seq|ALL [start [end]]]
+ *
+ * v3 sequence numbers are hexadecimal, v4 are decimal.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+start_request (SLrelay *relay, RelayClient *client, char *args, int istime)
+{
+  RelayStation *station = client->current;
+  char *fields[3] = {NULL, NULL, NULL};
+  char *tail = NULL;
+  uint64_t seqnum;
+  uint64_t seq;
+  int count = 0;
+
+  while (*args && count < 3)
+  {
+    fields[count++] = args;
+    args += strcspn (args, " ");
+    if (*args)
+      *args++ = '\0';
+    args += strspn (args, " ");
+  }
+
+  if (istime)
+  {
+    if (!fields[0])
+      return -1;
+
+    station->startseq = SL_ALLDATASEQUENCE;
+    fields[2]         = fields[1];
+    fields[1]         = fields[0];
+  }
+  else if (fields[0])
+  {
+    if (strcmp (fields[0], "ALL") == 0)
+    {
+      station->startseq = SL_ALLDATASEQUENCE;
+    }
+    else
+    {
+      seqnum = strtoull (fields[0], &tail, (client->protocol == 3) ? 16 : 10);
+
+      if (*tail)
+        return -1;
+
+      if (client->protocol == 3)
+      {
+        /* Find the packet in the ring with matching 24-bit sequence */
+        station->startseq = SL_ALLDATASEQUENCE;
+
+        for (seq = oldest_seq (relay); seq < relay->nextseq; seq++)
+        {
+          if ((seq & 0xFFFFFF) == (seqnum & 0xFFFFFF))
+          {
+            station->startseq = seq;
+            break;
+          }
+        }
+      }
+      else
+      {
+        station->startseq = seqnum;
+      }
+    }
+  }
+
+  if (fields[1] && (station->starttime = parse_time (fields[1])) == SLTERROR)
+    return -1;
+
+  if (fields[2] && (station->endtime = parse_time (fields[2])) == SLTERROR)
+    return -1;
+
+  return 0;
+} /* End of start_request() */
+
+/***************************************************************************
+ * start_streaming:
+ *
+ * Start streaming to a client from the earliest position requested by
+ * any station: the requested sequence number, the oldest packet for
+ * ALL or time windows, otherwise the next packet added.
+ ***************************************************************************/
+static void
+start_streaming (SLrelay *relay, RelayClient *client)
+{
+  RelayStation *station;
+  uint64_t oldest = oldest_seq (relay);
+  uint64_t start  = relay->nextseq;
+  uint64_t seq;
+
+  for (station = client->stations; station; station = station->next)
+  {
+    if (station->startseq == SL_ALLDATASEQUENCE || station->starttime != SLTERROR)
+      seq = oldest;
+    else if (station->startseq == SL_UNSETSEQUENCE)
+      seq = relay->nextseq;
+    else if (station->startseq < oldest)
+      seq = oldest;
+    else if (station->startseq > relay->nextseq)
+      seq = relay->nextseq;
+    else
+      seq = station->startseq;
+
+    if (seq < start)
+      start = seq;
+  }
+
+  client->cursor    = start;
+  client->sent      = 0;
+  client->streaming = 1;
+} /* End of start_streaming() */
+
+/***************************************************************************
+ * send_client:
+ *
+ * Send pending command responses and packets to a client until the
+ * socket would block or the send budget is used.  Responses are only
+ * sent between packets.  Packets are sent directly from the ring with
+ * the header built for the client protocol.
+ *
+ * Returns 0 on success and -1 if the client was closed.
+ ***************************************************************************/
+static int
+send_client (SLrelay *relay, const SLlog *log, RelayClient *client)
+{
+  RelayPacket *packet;
+  uint64_t oldest;
+  uint32_t total;
+  size_t budget = RELAY_SENDBUDGET;
+  int sent;
+
+  while (budget > 0 && client->sock != INVALIDSOCKET)
+  {
+    /* Send pending responses between packets */
+    if (client->sent == 0 && client->outputlength > client->outputoffset)
+    {
+      sent = send (client->sock, client->output + client->outputoffset,
+                   client->outputlength - client->outputoffset, SENDFLAGS);
+
+      if (sent < 0)
+      {
+        if (IS_EWOULDBLOCK () || IS_EINTR ())
+          return 0;
+
+        close_client (client, log, sl_strerror ());
+        return -1;
+      }
+
+      client->outputoffset += sent;
+      budget = (budget > (size_t)sent) ? budget - sent : 0;
+
+      if (client->outputoffset < client->outputlength)
+        return 0;
+
+      client->outputoffset = 0;
+      client->outputlength = 0;
+      continue;
+    }
+
+    if (client->closing)
+    {
+      close_client (client, log, "end of fetch");
+      return -1;
+    }
+
+    if (!client->streaming)
+      return 0;
+
+    /* Skip packets replaced in the ring */
+    oldest = oldest_seq (relay);
+    if (client->cursor < oldest)
+    {
+      sl_log_rl (log, 1, 1, "Relay client %s too slow, skipped %" PRIu64 " packets\n",
+                 client->address, oldest - client->cursor);
+
+      relay->dropped += oldest - client->cursor;
+      client->cursor  = oldest;
+      client->sent    = 0;
+    }
+
+    /* All available packets sent */
+    if (client->cursor >= relay->nextseq)
+    {
+      if (client->fetch)
+      {
+        client->closing = 1;
+        if (respond (client, "END", 3))
+          return -1;
+        continue;
+      }
+
+      return 0;
+    }
+
+    packet = &relay->ring[client->cursor % relay->ringsize];
+
+    if (client->sent == 0)
+    {
+      if (!match_packet (client, packet))
+      {
+        client->cursor++;
+        continue;
+      }
+
+      client->headerlength = build_header (client, packet, client->header);
+    }
+
+    total = client->headerlength + packet->length;
+
+#if defined(SLP_WIN)
+    if (client->sent < client->headerlength)
+      sent = send (client->sock, (const char *)client->header + client->sent,
+                   client->headerlength - client->sent, SENDFLAGS);
+    else
+      sent = send (client->sock, packet->payload + (client->sent - client->headerlength),
+                   total - client->sent, SENDFLAGS);
+#else
+    {
+      struct msghdr msg;
+      struct iovec iov[2];
+      int iovcnt = 0;
+
+      if (client->sent < client->headerlength)
+      {
+        iov[iovcnt].iov_base = client->header + client->sent;
+        iov[iovcnt].iov_len  = client->headerlength - client->sent;
+        iovcnt++;
+        iov[iovcnt].iov_base = packet->payload;
+        iov[iovcnt].iov_len  = packet->length;
+        iovcnt++;
+      }
+      else
+      {
+        iov[iovcnt].iov_base = packet->payload + (client->sent - client->headerlength);
+        iov[iovcnt].iov_len  = total - client->sent;
+        iovcnt++;
+      }
+
+      memset (&msg, 0, sizeof (msg));
+      msg.msg_iov    = iov;
+      msg.msg_iovlen = iovcnt;
+
+      sent = sendmsg (client->sock, &msg, SENDFLAGS);
+    }
+#endif
+
+    if (sent < 0)
+    {
+      if (IS_EWOULDBLOCK () || IS_EINTR ())
+        return 0;
+
+      close_client (client, log, sl_strerror ());
+      return -1;
+    }
+
+    client->sent += sent;
+    budget = (budget > (size_t)sent) ? budget - sent : 0;
+
+    if (client->sent < total)
+      return 0;
+
+    client->sent = 0;
+    client->cursor++;
+    client->packets++;
+  }
+
+  return 0;
+} /* End of send_client() */
+
+/***************************************************************************
+ * match_packet:
+ *
+ * Determine if a packet is selected by any station requested by a
+ * client.  v3 clients are only sent 512-byte miniSEED 2 records.
+ *
+ * Returns 1 if selected, otherwise 0.
+ ***************************************************************************/
+static int
+match_packet (const RelayClient *client, const RelayPacket *packet)
+{
+  const RelayStation *station;
+
+  if (client->protocol == 3 &&
+      (packet->format != SLPAYLOAD_MSEED2 || packet->length != RELAY_V3RECLEN))
+    return 0;
+
+  for (station = client->stations; station; station = station->next)
+  {
+    if (!sl_globmatch ((char *)packet->stationid, (char *)station->pattern))
+      continue;
+
+    if (station->startseq != SL_UNSETSEQUENCE &&
+        station->startseq != SL_ALLDATASEQUENCE &&
+        packet->seqnum < station->startseq)
+      continue;
+
+    if (station->starttime != SLTERROR &&
+        (packet->starttime == SLTERROR || packet->starttime < station->starttime))
+      continue;
+
+    if (station->endtime != SLTERROR &&
+        (packet->starttime == SLTERROR || packet->starttime > station->endtime))
+      continue;
+
+    if (match_selectors (station, packet))
+      return 1;
+  }
+
+  return 0;
+} /* End of match_packet() */
+
+/***************************************************************************
+ * match_selectors:
+ *
+ * Match the stream ID of a packet against the selectors of a station.
+ * A packet matches when any include selector, or there are none,
+ * matches and no exclude selector matches.  A selector with a type
+ * suffix, e.g. ".D", only matches packets with that subformat.
+ *
+ * Returns 1 if selected, otherwise 0.
+ ***************************************************************************/
+static int
+match_selectors (const RelayStation *station, const RelayPacket *packet)
+{
+  const char *selector;
+  char pattern[64];
+  char *type;
+  int accept = -1;
+  int match;
+
+  if (!station->selectors)
+    return 1;
+
+  for (selector = station->selectors; *selector; selector += strlen (selector) + 1)
+  {
+    snprintf (pattern, sizeof (pattern), "%s", selector + 1);
+
+    if ((type = strchr (pattern, '.')))
+      *type++ = '\0';
+
+    match = (packet->streamid[0] &&
+             sl_globmatch ((char *)packet->streamid, pattern) &&
+             (!type || *type == packet->subformat)) ? 1 : 0;
+
+    if (*selector == '-')
+    {
+      if (match)
+        return 0;
+    }
+    else if (accept != 1)
+    {
+      accept = match;
+    }
+  }
+
+  return (accept == 0) ? 0 : 1;
+} /* End of match_selectors() */
+
+/***************************************************************************
+ * build_header:
+ *
+ * Build the SeedLink header of a packet for the protocol of a client.
+ *
+ * Returns the length of the header.
+ ***************************************************************************/
+static uint32_t
+build_header (const RelayClient *client, const RelayPacket *packet, uint8_t *header)
+{
+  uint64_t seqnum = packet->seqnum;
+  uint32_t length = packet->length;
+  uint8_t stationidlength;
+
+  if (client->protocol == 3)
+  {
+    char v3header[SLHEADSIZE_V3 + 1];
+
+    snprintf (v3header, sizeof (v3header), "SL%06" PRIX64, seqnum & 0xFFFFFF);
+    memcpy (header, v3header, SLHEADSIZE_V3);
+
+    return SLHEADSIZE_V3;
+  }
+
+  stationidlength = (uint8_t)strlen (packet->stationid);
+
+  if (!sl_littleendianhost ())
+  {
+    sl_gswap8 (&seqnum);
+    sl_gswap4 (&length);
+  }
+
+  memcpy (header, SIGNATURE_V4, 2);
+  header[2] = packet->format;
+  header[3] = packet->subformat;
+  memcpy (header + 4, &length, 4);
+  memcpy (header + 8, &seqnum, 8);
+  header[16] = stationidlength;
+  memcpy (header + SLHEADSIZE_V4, packet->stationid, stationidlength);
+
+  return SLHEADSIZE_V4 + stationidlength;
+} /* End of build_header() */
+
+/***************************************************************************
+ * respond:
+ *
+ * Append a response to the pending output of a client.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+respond (RelayClient *client, const char *response, size_t length)
+{
+  char *newoutput;
+  uint32_t newsize;
+
+  if (client->outputlength + length > client->outputsize)
+  {
+    newsize = (client->outputsize) ? client->outputsize : 1024;
+
+    while (newsize < client->outputlength + length)
+      newsize *= 2;
+
+    if ((newoutput = (char *)sl_realloc (client->output, newsize)) == NULL)
+      return -1;
+
+    client->output     = newoutput;
+    client->outputsize = newsize;
+  }
+
+  memcpy (client->output + client->outputlength, response, length);
+  client->outputlength += length;
+
+  return 0;
+} /* End of respond() */
+
+/***************************************************************************
+ * respond_ok:
+ *
+ * Respond with OK, unless in v3 batch mode.
+ ***************************************************************************/
+static int
+respond_ok (RelayClient *client)
+{
+  if (client->batch)
+    return 0;
+
+  return respond (client, "OK\r\n", 4);
+} /* End of respond_ok() */
+
+/***************************************************************************
+ * respond_error:
+ *
+ * Respond with an error, including code and message for v4 clients.
+ ***************************************************************************/
+static int
+respond_error (RelayClient *client, const char *code, const char *message)
+{
+  char response[200];
+  int length;
+
+  if (client->protocol == 3)
+  {
+    if (client->batch)
+      return 0;
+
+    return respond (client, "ERROR\r\n", 7);
+  }
+
+  length = snprintf (response, sizeof (response), "ERROR %s %s\r\n", code, message);
+
+  return respond (client, response, length);
+} /* End of respond_error() */
+
+/***************************************************************************
+ * info_response:
+ *
+ * Respond to an INFO request: a JSON packet for v4 clients and XML in
+ * miniSEED INFO records for v3 clients.  Supported levels are ID,
+ * STATIONS and STREAMS, describing the packets in the ring.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+info_response (SLrelay *relay, RelayClient *client, const char *level)
+{
+  uint8_t header[SLHEADSIZE_V4];
+  uint32_t length32;
+  uint64_t seqnum = 0;
+  char *text      = NULL;
+  size_t length   = 0;
+  int infolevel;
+  int rv;
+
+  if (strcasecmp (level, "ID") == 0)
+    infolevel = 0;
+  else if (strcasecmp (level, "STATIONS") == 0)
+    infolevel = 1;
+  else if (strcasecmp (level, "STREAMS") == 0)
+    infolevel = 2;
+  else
+    return respond_error (client, "UNSUPPORTED", "unsupported INFO level");
+
+  if (client->protocol == 3)
+  {
+    if (info_xml (relay, client, infolevel, &text, &length))
+      return -1;
+
+    rv = info_records (client, text, length);
+    sl_free (text);
+
+    return rv;
+  }
+
+  if (info_json (relay, client, infolevel, &text, &length))
+    return -1;
+
+  /* JSON INFO packet, no station ID */
+  length32 = (uint32_t)length;
+
+  if (!sl_littleendianhost ())
+  {
+    sl_gswap4 (&length32);
+    sl_gswap8 (&seqnum);
+  }
+
+  memcpy (header, SIGNATURE_V4, 2);
+  header[2] = SLPAYLOAD_JSON;
+  header[3] = SLPAYLOAD_JSON_INFO;
+  memcpy (header + 4, &length32, 4);
+  memcpy (header + 8, &seqnum, 8);
+  header[16] = 0;
+
+  rv = (respond (client, (char *)header, sizeof (header)) ||
+        respond (client, text, length)) ? -1 : 0;
+
+  sl_free (text);
+
+  return rv;
+} /* End of info_response() */
+
+/***************************************************************************
+ * info_json:
+ *
+ * Generate a v4 JSON INFO response for a level: 0 = ID, 1 = STATIONS,
+ * 2 = STREAMS.  Stations and streams are those of packets in the ring.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+info_json (SLrelay *relay, RelayClient *client, int level, char **text, size_t *length)
+{
+  RelayPacket *packet;
+  RelayPacket *other;
+  RelayPacket *prior;
+  char starttime[32];
+  char endtime[32];
+  uint64_t oldest = oldest_seq (relay);
+  uint64_t seq;
+  uint64_t seq2;
+  uint64_t seq3;
+  uint64_t lastseq;
+  int64_t start;
+  int64_t end;
+  size_t size     = 0;
+  int stations    = 0;
+  int streams;
+  int seen;
+
+  (void)client;
+
+  if (append_text (text, length, &size,
+                   "{\"software\":\"libslink/%s relay\",\"organization\":\"%s\"",
+                   LIBSLINK_VERSION, relay->organization))
+    return -1;
+
+  if (level > 0)
+  {
+    if (append_text (text, length, &size, ",\"station\":["))
+      return -1;
+
+    /* First packet of each station starts a station entry */
+    for (seq = oldest; seq < relay->nextseq; seq++)
+    {
+      packet = &relay->ring[seq % relay->ringsize];
+
+      for (seen = 0, seq2 = oldest; seq2 < seq && !seen; seq2++)
+        seen = (strcmp (relay->ring[seq2 % relay->ringsize].stationid, packet->stationid) == 0);
+
+      if (seen)
+        continue;
+
+      for (lastseq = seq, seq2 = seq + 1; seq2 < relay->nextseq; seq2++)
+      {
+        if (strcmp (relay->ring[seq2 % relay->ringsize].stationid, packet->stationid) == 0)
+          lastseq = seq2;
+      }
+
+      if (append_text (text, length, &size,
+                       "%s{\"id\":\"%s\",\"description\":\"\",\"start_seq\":%" PRIu64
+                       ",\"end_seq\":%" PRIu64,
+                       (stations++) ? "," : "", packet->stationid, seq, lastseq))
+        return -1;
+
+      if (level > 1)
+      {
+        if (append_text (text, length, &size, ",\"stream\":["))
+          return -1;
+
+        /* First packet of each stream of the station starts a stream entry */
+        for (streams = 0, seq2 = seq; seq2 <= lastseq; seq2++)
+        {
+          other = &relay->ring[seq2 % relay->ringsize];
+
+          if (strcmp (other->stationid, packet->stationid) || other->streamid[0] == '\0')
+            continue;
+
+          start = end = SLTERROR;
+          seen  = 0;
+
+          for (seq3 = seq; seq3 <= lastseq; seq3++)
+          {
+            prior = &relay->ring[seq3 % relay->ringsize];
+
+            if (strcmp (prior->stationid, other->stationid) ||
+                strcmp (prior->streamid, other->streamid) ||
+                prior->format != other->format)
+              continue;
+
+            if (seq3 < seq2)
+            {
+              seen = 1;
+              break;
+            }
+
+            if (prior->starttime != SLTERROR)
+            {
+              if (start == SLTERROR || prior->starttime < start)
+                start = prior->starttime;
+              if (end == SLTERROR || prior->starttime > end)
+                end = prior->starttime;
+            }
+          }
+
+          if (seen)
+            continue;
+
+          if (start == SLTERROR || !sl_nstime2isotime (start, starttime, sizeof (starttime)))
+            starttime[0] = '\0';
+          if (end == SLTERROR || !sl_nstime2isotime (end, endtime, sizeof (endtime)))
+            endtime[0] = '\0';
+
+          if (append_text (text, length, &size,
+                           "%s{\"id\":\"%s\",\"format\":\"%c\",\"subformat\":\"%c\","
+                           "\"start_time\":\"%s\",\"end_time\":\"%s\"}",
+                           (streams++) ? "," : "", other->streamid,
+                           other->format, (other->subformat) ? other->subformat : 'D',
+                           starttime, endtime))
+            return -1;
+        }
+
+        if (append_text (text, length, &size, "]"))
+          return -1;
+      }
+
+      if (append_text (text, length, &size, "}"))
+        return -1;
+    }
+
+    if (append_text (text, length, &size, "]"))
+      return -1;
+  }
+
+  return append_text (text, length, &size, "}");
+} /* End of info_json() */
+
+/***************************************************************************
+ * info_xml:
+ *
+ * Generate a v3 XML INFO response for a level: 0 = ID, 1 = STATIONS,
+ * 2 = STREAMS.  Only stations and streams of miniSEED 2 packets in the
+ * ring, as served to v3 clients, are included.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+info_xml (SLrelay *relay, RelayClient *client, int level, char **text, size_t *length)
+{
+  RelayPacket *packet;
+  RelayPacket *other;
+  RelayPacket *prior;
+  char started[32];
+  char net[SL_MAX_STATIONID];
+  char *sta;
+  char *cp;
+  char loc[4];
+  char chan[4];
+  uint64_t oldest = oldest_seq (relay);
+  uint64_t seq;
+  uint64_t seq2;
+  uint64_t seq3;
+  uint64_t lastseq;
+  size_t size = 0;
+  int seen;
+
+  if (!sl_nstime2isotime (relay->started, started, sizeof (started)))
+    started[0] = '\0';
+
+  if (append_text (text, length, &size,
+                   "<?xml version=\"1.0\"?>\n<seedlink software=\"libslink/%s relay\" "
+                   "organization=\"%s\" started=\"%s\">\n",
+                   LIBSLINK_VERSION, relay->organization, started))
+    return -1;
+
+  for (seq = oldest; level > 0 && seq < relay->nextseq; seq++)
+  {
+    packet = &relay->ring[seq % relay->ringsize];
+
+    if (packet->format != SLPAYLOAD_MSEED2 || packet->length != RELAY_V3RECLEN)
+      continue;
+
+    for (seen = 0, seq2 = oldest; seq2 < seq && !seen; seq2++)
+    {
+      other = &relay->ring[seq2 % relay->ringsize];
+      seen  = (other->format == SLPAYLOAD_MSEED2 &&
+               strcmp (other->stationid, packet->stationid) == 0);
+    }
+
+    if (seen)
+      continue;
+
+    for (lastseq = seq, seq2 = seq + 1; seq2 < relay->nextseq; seq2++)
+    {
+      other = &relay->ring[seq2 % relay->ringsize];
+      if (other->format == SLPAYLOAD_MSEED2 && strcmp (other->stationid, packet->stationid) == 0)
+        lastseq = seq2;
+    }
+
+    snprintf (net, sizeof (net), "%s", packet->stationid);
+    if ((sta = strchr (net, '_')))
+      *sta++ = '\0';
+
+    if (append_text (text, length, &size,
+                     "<station name=\"%s\" network=\"%s\" description=\"\" "
+                     "begin_seq=\"%06" PRIX64 "\" end_seq=\"%06" PRIX64 "\" stream_check=\"enabled\"%s>\n",
+                     (sta) ? sta : "", net, seq & 0xFFFFFF, (lastseq + 1) & 0xFFFFFF,
+                     (level > 1) ? "" : "/"))
+      return -1;
+
+    if (level < 2)
+      continue;
+
+    for (seq2 = seq; seq2 <= lastseq; seq2++)
+    {
+      other = &relay->ring[seq2 % relay->ringsize];
+
+      if (other->format != SLPAYLOAD_MSEED2 || strcmp (other->stationid, packet->stationid))
+        continue;
+
+      for (seen = 0, seq3 = seq; seq3 < seq2 && !seen; seq3++)
+      {
+        prior = &relay->ring[seq3 % relay->ringsize];
+        seen  = (prior->format == SLPAYLOAD_MSEED2 &&
+                 strcmp (prior->stationid, other->stationid) == 0 &&
+                 strcmp (prior->streamid, other->streamid) == 0);
+      }
+
+      if (seen)
+        continue;
+
+      /* Stream ID LOC_B_S_SS to location and SEED channel */
+      if (sscanf (other->streamid, "%2[^_]", loc) != 1)
+        loc[0] = '\0';
+
+      if ((cp = strchr (other->streamid, '_')) == NULL ||
+          sscanf (cp, "_%c_%c_%c", &chan[0], &chan[1], &chan[2]) != 3)
+        continue;
+
+      chan[3] = '\0';
+
+      if (append_text (text, length, &size,
+                       "<stream location=\"%s\" seedname=\"%.3s\" type=\"D\"/>\n", loc, chan))
+        return -1;
+    }
+
+    if (append_text (text, length, &size, "</station>\n"))
+      return -1;
+  }
+
+  (void)client;
+
+  return append_text (text, length, &size, "</seedlink>\n");
+} /* End of info_xml() */
+
+/***************************************************************************
+ * info_records:
+ *
+ * Append XML text to a v3 client output as a sequence of 512-byte
+ * miniSEED INFO records, each preceded by an SLINFO header, '*' marks
+ * records followed by more records of the same response.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+info_records (RelayClient *client, const char *xml, size_t length)
+{
+  char record[SLHEADSIZE_V3 + RELAY_V3RECLEN];
+  char *msr = record + SLHEADSIZE_V3;
+  int year, yday, hour, min, sec;
+  uint32_t nsec;
+  size_t offset = 0;
+  size_t chunk;
+
+  sl_nstime2time (sl_nstime (), &year, &yday, &hour, &min, &sec, &nsec);
+
+  do
+  {
+    chunk = length - offset;
+    if (chunk > RELAY_V3INFODATA)
+      chunk = RELAY_V3INFODATA;
+
+    memset (record, 0, sizeof (record));
+    memcpy (record, INFOSIGNATURE, 6);
+    record[6] = ' ';
+    record[7] = (offset + chunk < length) ? '*' : ' ';
+
+    /* Fixed header in host byte order with blockette 1000, ASCII encoding */
+    memcpy (msr, "000000D ", 8);
+    memcpy (pMS2FSDH_STATION (msr), "INFO ", 5);
+    memcpy (pMS2FSDH_LOCATION (msr), "  ", 2);
+    memcpy (pMS2FSDH_CHANNEL (msr), "LOG", 3);
+    memcpy (pMS2FSDH_NETWORK (msr), "SL", 2);
+    *pMS2FSDH_YEAR (msr)            = (uint16_t)year;
+    *pMS2FSDH_DAY (msr)             = (uint16_t)yday;
+    *pMS2FSDH_HOUR (msr)            = (uint8_t)hour;
+    *pMS2FSDH_MIN (msr)             = (uint8_t)min;
+    *pMS2FSDH_SEC (msr)             = (uint8_t)sec;
+    *pMS2FSDH_NUMSAMPLES (msr)      = (uint16_t)chunk;
+    *pMS2FSDH_NUMBLOCKETTES (msr)   = 1;
+    *pMS2FSDH_DATAOFFSET (msr)      = 64;
+    *pMS2FSDH_BLOCKETTEOFFSET (msr) = 48;
+
+    *(uint16_t *)(msr + 48) = 1000;   /* Blockette type */
+    *(uint16_t *)(msr + 50) = 0;      /* Next blockette */
+    msr[52] = 0;                      /* Encoding, ASCII */
+    msr[53] = (sl_littleendianhost ()) ? 0 : 1; /* Word order */
+    msr[54] = 9;                      /* Record length, 2^9 */
+
+    memcpy (msr + 64, xml + offset, chunk);
+
+    if (respond (client, record, sizeof (record)))
+      return -1;
+
+    offset += chunk;
+  } while (offset < length);
+
+  return 0;
+} /* End of info_records() */
+
+/***************************************************************************
+ * append_text:
+ *
+ * Append formatted text to a growing buffer.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+append_text (char **text, size_t *length, size_t *size, const char *format, ...)
+{
+  va_list args;
+  char *newtext;
+  size_t newsize;
+  int printed;
+
+  for (;;)
+  {
+    va_start (args, format);
+    printed = vsnprintf ((*text) ? *text + *length : NULL,
+                         (*text) ? *size - *length : 0, format, args);
+    va_end (args);
+
+    if (printed < 0)
+      return -1;
+
+    if (*text && *length + printed < *size)
+    {
+      *length += printed;
+      return 0;
+    }
+
+    newsize = (*size) ? *size * 2 : 4096;
+    while (newsize <= *length + printed)
+      newsize *= 2;
+
+    if ((newtext = (char *)sl_realloc (*text, newsize)) == NULL)
+    {
+      sl_free (*text);
+      *text = NULL;
+      return -1;
+    }
+
+    *text = newtext;
+    *size = newsize;
+  }
+} /* End of append_text() */
+
+/***************************************************************************
+ * parse_time:
+ *
+ * Parse a time string in v3 comma-separated, YYYY,MM,DD,hh,mm,ss, or
+ * ISO 8601, YYYY-MM-DDThh:mm:ss[.ffffff][Z], form.
+ *
+ * Returns nanosecond epoch time on success and SLTERROR on error.
+ ***************************************************************************/
+static int64_t
+parse_time (const char *timestr)
+{
+  static const int days[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+  int year, month, mday;
+  int hour = 0;
+  int min  = 0;
+  int sec  = 0;
+  int yday;
+  uint32_t nsec = 0;
+  const char *fraction;
+  int digits;
+
+  if (sscanf (timestr, "%d%*[-,]%d%*[-,]%d%*[T ,]%d%*[:,]%d%*[:,]%d",
+              &year, &month, &mday, &hour, &min, &sec) < 3)
+    return SLTERROR;
+
+  if (month < 1 || month > 12 || mday < 1 || mday > 31)
+    return SLTERROR;
+
+  yday = days[month - 1] + mday;
+  if (month > 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+    yday++;
+
+  if ((fraction = strchr (timestr, '.')))
+  {
+    for (fraction++, digits = 0; *fraction >= '0' && *fraction <= '9' && digits < 9; fraction++, digits++)
+      nsec = nsec * 10 + (*fraction - '0');
+
+    for (; digits < 9; digits++)
+      nsec *= 10;
+  }
+
+  return sl_time2nstime (year, yday, hour, min, sec, nsec);
+} /* End of parse_time() */
+
+/***************************************************************************
+ * oldest_seq:
+ *
+ * Return the sequence number of the oldest packet in the ring.
+ ***************************************************************************/
+static uint64_t
+oldest_seq (const SLrelay *relay)
+{
+  return (relay->nextseq > relay->ringsize) ? relay->nextseq - relay->ringsize : 0;
+} /* End of oldest_seq() */
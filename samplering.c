@@ -0,0 +1,641 @@
+/***************************************************************************
+ * samplering.c
+ *
+ * Routines for maintaining rings of decoded samples per data source.
+ *
+ * Each source has a fixed capacity ring of 4-byte samples, either
+ * 32-bit integers or floats, in a cache-aligned buffer that is
+ * mirrored: every sample is written at its position and again one
+ * capacity later, so that any window up to the capacity is contiguous
+ * in memory and can be returned to readers without copying.
+ *
+ * A single thread adds records while any number of threads read
+ * windows.  Ring metadata is protected by a sequence lock and readers
+ * may verify after use that a window was not overwritten.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+#include "slatomic.h"
+
+/* Alignment of sample buffers, a common cache line size */
+#define RING_ALIGNMENT 64
+
+/* Maximum samples decoded from a single record */
+#define RING_MAXRECORDSAMPLES 65536
+
+/* Sample ring for a single source */
+typedef struct SLring
+{
+  char sourceid[64];           /* FDSN source identifier without prefix */
+  uint64_t hash;               /* Hash of source ID */
+  volatile uint32_t sequence;  /* Sequence lock for metadata, odd while writing */
+  char sampletype;             /* Sample type of current segment, 'i' or 'f' */
+  double samplerate;           /* Sample rate of current segment */
+  uint64_t written;            /* Total samples written, position of next sample */
+  volatile uint64_t writing;   /* Position through which samples may be changing */
+  uint64_t segmentpos;         /* Position of first sample of current segment */
+  int64_t segmentstart;        /* Time of first sample of current segment */
+  uint64_t gaps;               /* Number of gaps detected */
+  uint64_t overlaps;           /* Number of overlaps detected */
+  void *raw;                   /* Allocated buffer */
+  uint32_t *samples;           /* Aligned, mirrored sample buffer */
+} SLring;
+
+struct SLrings
+{
+  SLring *volatile *table;     /* Hash table of rings, published atomically */
+  uint32_t mask;               /* Table size - 1, size is a power of 2 */
+  uint32_t maxsources;         /* Maximum number of sources */
+  uint32_t count;              /* Number of sources */
+  uint32_t capacity;           /* Capacity of each ring in samples */
+  int64_t tolerance;           /* Time tolerance in nanoseconds, -1 for half a sample period */
+  int32_t *decoded;            /* Buffer for decoded record samples */
+};
+
+static SLring *find_ring (const SLrings *rings, const char *sourceid, uint64_t hash);
+static SLring *add_ring (SLrings *rings, const SLlog *log, const char *sourceid, uint64_t hash);
+static uint64_t hash_sourceid (const char *sourceid);
+static void normalize_sourceid (const char *sourceid, char *key, size_t keysize);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new set of sample rings
+ *
+ * Allocate a set of sample rings for up to \a maxsources data sources,
+ * identified by FDSN source identifier, each with \a capacity samples.
+ * The buffer for each source is allocated when the first record for
+ * the source is added.
+ *
+ * @param[in] maxsources  Maximum number of data sources
+ * @param[in] capacity    Capacity of each ring in samples
+ *
+ * @returns An initialized ::SLrings on success, NULL on error.
+ ***************************************************************************/
+SLrings *
+sl_initslrings (uint32_t maxsources, uint32_t capacity)
+{
+  SLrings *rings;
+  uint32_t tablesize = 16;
+
+  if (maxsources == 0 || maxsources > (1U << 30) || capacity == 0 || capacity > (1U << 30))
+  {
+    sl_log_r (NULL, 2, 0, "%s(): invalid maximum sources (%u) or capacity (%u)\n",
+              __func__, maxsources, capacity);
+    return NULL;
+  }
+
+  /* Table size is a power of 2 at least twice the maximum sources */
+  while (tablesize < maxsources * 2)
+    tablesize <<= 1;
+
+  if ((rings = (SLrings *)sl_malloc (sizeof (SLrings))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (rings, 0, sizeof (SLrings));
+
+  rings->table   = (SLring *volatile *)sl_calloc (tablesize, sizeof (SLring *));
+  rings->decoded = (int32_t *)sl_malloc (RING_MAXRECORDSAMPLES * sizeof (int32_t));
+
+  if (rings->table == NULL || rings->decoded == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_freeslrings (rings);
+    return NULL;
+  }
+
+  rings->mask       = tablesize - 1;
+  rings->maxsources = maxsources;
+  rings->capacity   = capacity;
+  rings->tolerance  = -1;
+
+  return rings;
+} /* End of sl_initslrings() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a set of sample rings
+ *
+ * No other threads may be reading the rings.
+ *
+ * @param[in] rings  Sample rings to free
+ ***************************************************************************/
+void
+sl_freeslrings (SLrings *rings)
+{
+  uint32_t idx;
+
+  if (!rings)
+    return;
+
+  if (rings->table)
+  {
+    for (idx = 0; idx <= rings->mask; idx++)
+    {
+      if (rings->table[idx])
+      {
+        sl_free (rings->table[idx]->raw);
+        sl_free (rings->table[idx]);
+      }
+    }
+
+    sl_free ((void *)rings->table);
+  }
+
+  sl_free (rings->decoded);
+  sl_free (rings);
+} /* End of sl_freeslrings() */
+
+/**********************************************************************/ /**
+ * @brief Set the time tolerance for gap and overlap detection
+ *
+ * A record is considered contiguous with the previous record of the
+ * same source if its start time is within \a tolerance seconds of the
+ * expected time.  The default tolerance is half a sample period.
+ *
+ * @param[in] rings      Sample rings
+ * @param[in] tolerance  Tolerance in seconds, negative for half a sample period
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_rings_set_tolerance (SLrings *rings, double tolerance)
+{
+  if (!rings)
+    return -1;
+
+  rings->tolerance = (tolerance < 0.0) ? -1 : (int64_t)(tolerance * 1e9 + 0.5);
+
+  return 0;
+} /* End of sl_rings_set_tolerance() */
+
+/**********************************************************************/ /**
+ * @brief Decode a miniSEED record and add its samples to a ring
+ *
+ * Decode the samples of a miniSEED record with sl_payload_decode()
+ * and append them to the ring for its source identifier, which is
+ * created if needed.
+ *
+ * The record start time is compared with the time expected from the
+ * end of the previous record.  A gap, or a change of sample rate or
+ * sample type, starts a new contiguous segment; windows are only
+ * returned from the current segment.  Samples overlapping data
+ * already in the ring are discarded.
+ *
+ * Only a single thread may add records to a set of rings.
+ *
+ * @param[in] rings       Sample rings
+ * @param[in] log         Logging parameters, or NULL
+ * @param[in] packetinfo  Packet details as returned by sl_collect()
+ * @param[in] payload     Packet payload
+ *
+ * @returns The number of samples added, 0 for non-miniSEED payloads
+ * or fully overlapping records, or -1 on error.
+ ***************************************************************************/
+int64_t
+sl_rings_add (SLrings *rings, const SLlog *log,
+              const SLpacketinfo *packetinfo, const char *payload)
+{
+  SLring *ring;
+  char sourceid[64] = {0};
+  char key[64];
+  char sampletype = 0;
+  double samplerate = 0.0;
+  int64_t starttime;
+  int64_t expected;
+  int64_t tolerance;
+  int64_t offset;
+  int64_t count;
+  uint64_t skip = 0;
+  uint64_t position;
+  uint32_t index;
+  uint32_t sequence;
+  int newsegment = 0;
+
+  if (!rings || !packetinfo || !payload)
+    return -1;
+
+  if (packetinfo->payloadformat != SLPAYLOAD_MSEED2 &&
+      packetinfo->payloadformat != SLPAYLOAD_MSEED3)
+    return 0;
+
+  if (sl_payload_info (log, packetinfo, payload, packetinfo->payloadlength,
+                       sourceid, sizeof (sourceid), NULL, 0, &samplerate, NULL) == -1)
+    return -1;
+
+  if ((starttime = sl_payload_starttime (log, packetinfo, payload,
+                                         packetinfo->payloadlength)) == SLTERROR)
+    return -1;
+
+  if ((count = sl_payload_decode (log, packetinfo, payload, packetinfo->payloadlength,
+                                  rings->decoded, RING_MAXRECORDSAMPLES, &sampletype)) < 0)
+    return -1;
+
+  if (count == 0 || samplerate <= 0.0)
+    return 0;
+
+  normalize_sourceid (sourceid, key, sizeof (key));
+
+  if ((ring = find_ring (rings, key, hash_sourceid (key))) == NULL &&
+      (ring = add_ring (rings, log, key, hash_sourceid (key))) == NULL)
+    return -1;
+
+  /* Compare start time with expected time of next sample */
+  if (ring->written == 0 || ring->sampletype != sampletype ||
+      ring->samplerate - samplerate > 1e-4 * samplerate ||
+      samplerate - ring->samplerate > 1e-4 * samplerate)
+  {
+    newsegment = 1;
+  }
+  else
+  {
+    tolerance = (rings->tolerance >= 0) ? rings->tolerance : (int64_t)(0.5e9 / samplerate);
+    expected  = ring->segmentstart +
+                (int64_t)((double)(ring->written - ring->segmentpos) * 1e9 / samplerate + 0.5);
+    offset    = starttime - expected;
+
+    if (offset > tolerance)
+    {
+      sl_log_rl (log, 1, 2, "%s: gap of %.6f seconds\n", sourceid, (double)offset / 1e9);
+      ring->gaps++;
+      newsegment = 1;
+    }
+    else if (offset < -tolerance)
+    {
+      sl_log_rl (log, 1, 2, "%s: overlap of %.6f seconds\n", sourceid, (double)-offset / 1e9);
+      ring->overlaps++;
+
+      /* Skip overlapping samples, rounding to nearest sample */
+      skip = (uint64_t)((double)-offset * samplerate / 1e9 + 0.5);
+
+      if (skip >= (uint64_t)count)
+        return 0;
+    }
+  }
+
+  count -= skip;
+
+  /* Announce positions being overwritten before writing samples */
+  ATOMIC_STORE64 (&ring->writing, ring->written + count);
+  FULL_FENCE ();
+
+  for (position = ring->written; position < ring->written + count; position++)
+  {
+    index = (uint32_t)(position % rings->capacity);
+
+    ring->samples[index]                   = (uint32_t)rings->decoded[skip + position - ring->written];
+    ring->samples[index + rings->capacity] = ring->samples[index];
+  }
+
+  /* Update metadata under sequence lock */
+  sequence = ring->sequence;
+  ATOMIC_STORE (&ring->sequence, sequence + 1);
+  FULL_FENCE ();
+
+  if (newsegment)
+  {
+    ring->sampletype   = sampletype;
+    ring->samplerate   = samplerate;
+    ring->segmentpos   = ring->written;
+    ring->segmentstart = starttime;
+  }
+
+  ring->written += count;
+
+  ATOMIC_STORE (&ring->sequence, sequence + 2);
+
+  return count;
+} /* End of sl_rings_add() */
+
+/**********************************************************************/ /**
+ * @brief Get the most recent window of samples for a source
+ *
+ * Find the most recent \a duration seconds of contiguous samples for
+ * \a sourceid, limited to the current segment and the ring capacity.
+ * The window references samples in the ring directly, no samples are
+ * copied.  The samples may be overwritten by subsequent records, after
+ * using the samples call sl_rings_window_valid() to verify that they
+ * were not changed while in use.
+ *
+ * The source identifier may be given with or without the "FDSN:" prefix,
+ * or as SEED codes separated by periods, e.g. "IU.ANMO.00.BHZ".
+ *
+ * This routine may be called from any thread while records are added.
+ *
+ * @param[in]  rings     Sample rings
+ * @param[in]  sourceid  FDSN source identifier, e.g. "FDSN:IU_ANMO_00_B_H_Z"
+ * @param[in]  duration  Window duration in seconds, 0 for all available
+ * @param[out] window    Window description
+ *
+ * @retval  1 : window returned, may contain 0 samples
+ * @retval  0 : source not found
+ * @retval -1 : error, including a source whose first samples are
+ *              still being added
+ ***************************************************************************/
+int
+sl_rings_window (const SLrings *rings, const char *sourceid, double duration,
+                 SLwindow *window)
+{
+  char key[64];
+  SLring *ring;
+  uint64_t written;
+  uint64_t segmentpos;
+  uint64_t available;
+  uint64_t count;
+  uint64_t limit;
+  uint64_t position;
+  int64_t segmentstart;
+  double samplerate;
+  char sampletype;
+  uint32_t before;
+  uint32_t after;
+
+  if (!rings || !sourceid || !window)
+    return -1;
+
+  normalize_sourceid (sourceid, key, sizeof (key));
+
+  if ((ring = find_ring (rings, key, hash_sourceid (key))) == NULL)
+    return 0;
+
+  /* Read consistent metadata */
+  do
+  {
+    while ((before = ATOMIC_LOAD (&ring->sequence)) & 1)
+      ;
+
+    sampletype   = ring->sampletype;
+    samplerate   = ring->samplerate;
+    written      = ring->written;
+    segmentpos   = ring->segmentpos;
+    segmentstart = ring->segmentstart;
+
+    ACQUIRE_FENCE ();
+    after = ATOMIC_LOAD (&ring->sequence);
+  } while (before != after);
+
+  /* A new ring is visible before its first samples are written */
+  if (samplerate == 0.0)
+    return -1;
+
+  available = written - segmentpos;
+
+  if (available > rings->capacity)
+    available = rings->capacity;
+
+  count = available;
+
+  /* Limit to duration, rounding up to whole samples */
+  if (duration > 0.0)
+  {
+    limit = (uint64_t)(duration * samplerate);
+
+    if ((double)limit < duration * samplerate)
+      limit++;
+
+    if (count > limit)
+      count = limit;
+  }
+
+  position = written - count;
+
+  memset (window, 0, sizeof (SLwindow));
+  strncpy (window->sourceid, ring->sourceid, sizeof (window->sourceid) - 1);
+  window->sampletype = sampletype;
+  window->samplerate = samplerate;
+  window->samplecount = (uint32_t)count;
+  window->position   = position;
+  window->starttime  = segmentstart +
+                       (int64_t)((double)(position - segmentpos) * 1e9 / samplerate + 0.5);
+  window->samples    = (const void *)&ring->samples[position % rings->capacity];
+
+  return 1;
+} /* End of sl_rings_window() */
+
+/**********************************************************************/ /**
+ * @brief Verify that the samples of a window were not overwritten
+ *
+ * Check that none of the samples referenced by a window returned by
+ * sl_rings_window() have been, or are being, overwritten by newer
+ * samples.  Call after using the samples to confirm they were
+ * consistent.
+ *
+ * @param[in] rings   Sample rings
+ * @param[in] window  Window returned by sl_rings_window()
+ *
+ * @retval  1 : window samples are intact
+ * @retval  0 : window samples were overwritten
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_rings_window_valid (const SLrings *rings, const SLwindow *window)
+{
+  const SLring *ring;
+  char key[64];
+  uint64_t writing;
+
+  if (!rings || !window)
+    return -1;
+
+  normalize_sourceid (window->sourceid, key, sizeof (key));
+
+  if ((ring = find_ring (rings, key, hash_sourceid (key))) == NULL)
+    return -1;
+
+  ACQUIRE_FENCE ();
+  writing = ATOMIC_LOAD64 (&ring->writing);
+
+  return (writing <= window->position + rings->capacity) ? 1 : 0;
+} /* End of sl_rings_window_valid() */
+
+/**********************************************************************/ /**
+ * @brief Get gap and overlap counts for a source
+ *
+ * @param[in]  rings     Sample rings
+ * @param[in]  sourceid  Source identifier, as for sl_rings_window()
+ * @param[out] gaps      Number of gaps detected, or NULL
+ * @param[out] overlaps  Number of overlaps detected, or NULL
+ *
+ * @retval  1 : counts returned
+ * @retval  0 : source not found
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_rings_stats (const SLrings *rings, const char *sourceid,
+                uint64_t *gaps, uint64_t *overlaps)
+{
+  const SLring *ring;
+  char key[64];
+
+  if (!rings || !sourceid)
+    return -1;
+
+  normalize_sourceid (sourceid, key, sizeof (key));
+
+  if ((ring = find_ring (rings, key, hash_sourceid (key))) == NULL)
+    return 0;
+
+  if (gaps)
+    *gaps = ring->gaps;
+  if (overlaps)
+    *overlaps = ring->overlaps;
+
+  return 1;
+} /* End of sl_rings_stats() */
+
+/***************************************************************************
+ * find_ring:
+ *
+ * Find the ring for a source ID using linear probing.
+ *
+ * Returns a pointer to the ring if found, otherwise NULL.
+ ***************************************************************************/
+static SLring *
+find_ring (const SLrings *rings, const char *sourceid, uint64_t hash)
+{
+  SLring *ring;
+  uint32_t idx;
+  uint32_t probes;
+
+  idx = (uint32_t)hash & rings->mask;
+
+  for (probes = 0; probes <= rings->mask; probes++, idx = (idx + 1) & rings->mask)
+  {
+    ring = (SLring *)ATOMIC_LOADPTR (&rings->table[idx]);
+
+    if (ring == NULL)
+      return NULL;
+
+    if (ring->hash == hash && strcmp (ring->sourceid, sourceid) == 0)
+      return ring;
+  }
+
+  return NULL;
+} /* End of find_ring() */
+
+/***************************************************************************
+ * add_ring:
+ *
+ * Allocate a new ring for a source ID and publish it in the table.
+ *
+ * Returns a pointer to the new ring on success, NULL on error.
+ ***************************************************************************/
+static SLring *
+add_ring (SLrings *rings, const SLlog *log, const char *sourceid, uint64_t hash)
+{
+  SLring *ring;
+  uint32_t idx;
+  uintptr_t aligned;
+
+  if (rings->count >= rings->maxsources)
+  {
+    sl_log_rl (log, 1, 1, "%s(): maximum sources reached, cannot add %s\n", __func__, sourceid);
+    return NULL;
+  }
+
+  if ((ring = (SLring *)sl_calloc (1, sizeof (SLring))) == NULL ||
+      (ring->raw = sl_malloc ((size_t)rings->capacity * 2 * sizeof (uint32_t) + RING_ALIGNMENT)) == NULL)
+  {
+    sl_log_rl (log, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_free (ring);
+    return NULL;
+  }
+
+  aligned = ((uintptr_t)ring->raw + RING_ALIGNMENT - 1) & ~((uintptr_t)RING_ALIGNMENT - 1);
+  ring->samples = (uint32_t *)aligned;
+  ring->hash    = hash;
+  strncpy (ring->sourceid, sourceid, sizeof (ring->sourceid) - 1);
+
+  idx = (uint32_t)hash & rings->mask;
+
+  while (rings->table[idx] != NULL)
+    idx = (idx + 1) & rings->mask;
+
+  ATOMIC_STOREPTR (&rings->table[idx], ring);
+  rings->count++;
+
+  return ring;
+} /* End of add_ring() */
+
+/***************************************************************************
+ * normalize_sourceid:
+ *
+ * Convert a source ID to the key used for lookup: an FDSN source ID
+ * without the "FDSN:" prefix.  SEED codes separated by periods, e.g.
+ * "IU.ANMO.00.BHZ", are converted to "IU_ANMO_00_B_H_Z".  The location
+ * code may be empty or "--", e.g. "IU.ANMO..BHZ".
+ ***************************************************************************/
+static void
+normalize_sourceid (const char *sourceid, char *key, size_t keysize)
+{
+  const char *sta;
+  const char *loc;
+  const char *chan;
+  int loclength;
+
+  if (strncmp (sourceid, "FDSN:", 5) == 0)
+    sourceid += 5;
+
+  /* Split NET.STA.LOC.CHAN at periods, only the location may be empty */
+  if (!strchr (sourceid, '_') &&
+      (sta = strchr (sourceid, '.')) != NULL && sta > sourceid &&
+      (loc = strchr (sta + 1, '.')) != NULL && loc > sta + 1 &&
+      (chan = strchr (loc + 1, '.')) != NULL &&
+      strlen (chan + 1) == 3 && !strchr (chan + 1, '.'))
+  {
+    loclength = (int)(chan - loc - 1);
+
+    if (loclength == 2 && strncmp (loc + 1, "--", 2) == 0)
+      loclength = 0;
+
+    snprintf (key, keysize, "%.*s_%.*s_%.*s_%c_%c_%c",
+              (int)(sta - sourceid), sourceid,
+              (int)(loc - sta - 1), sta + 1,
+              loclength, loc + 1,
+              chan[1], chan[2], chan[3]);
+    return;
+  }
+
+  snprintf (key, keysize, "%s", sourceid);
+} /* End of normalize_sourceid() */
+
+/***************************************************************************
+ * hash_sourceid:
+ *
+ * Compute the 64-bit FNV-1a hash of a source ID.
+ ***************************************************************************/
+static uint64_t
+hash_sourceid (const char *sourceid)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  while (*sourceid)
+  {
+    hash ^= (uint8_t)*sourceid++;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+} /* End of hash_sourceid() */
@@ -0,0 +1,74 @@
+/***************************************************************************
+ * slatomic.h
+ *
+ * Internal atomic operations on 32 and 64-bit values with acquire and
+ * release ordering, using the GCC/Clang __atomic builtins or the MSVC
+ * Interlocked intrinsics.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#ifndef SLATOMIC_H
+#define SLATOMIC_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+  #include <windows.h>
+  #include <intrin.h>
+  #define ATOMIC_LOAD(ptr)      ((uint32_t)_InterlockedCompareExchange ((volatile long *)(ptr), 0, 0))
+  #define ATOMIC_STORE(ptr, v)  _InterlockedExchange ((volatile long *)(ptr), (long)(v))
+  #define ATOMIC_CAS(ptr, e, d) (_InterlockedCompareExchange ((volatile long *)(ptr), (long)(d), (long)(e)) == (long)(e))
+  #define ATOMIC_ADD(ptr, v)    ((uint32_t)_InterlockedExchangeAdd ((volatile long *)(ptr), (long)(v)) + (v))
+  #define ATOMIC_LOAD64(ptr)    ((uint64_t)_InterlockedCompareExchange64 ((volatile __int64 *)(ptr), 0, 0))
+  #define ATOMIC_STORE64(ptr, v) _InterlockedExchange64 ((volatile __int64 *)(ptr), (__int64)(v))
+  #define ATOMIC_LOADPTR(ptr)   _InterlockedCompareExchangePointer ((void *volatile *)(ptr), NULL, NULL)
+  #define ATOMIC_STOREPTR(ptr, v) _InterlockedExchangePointer ((void *volatile *)(ptr), (void *)(v))
+  #define ACQUIRE_FENCE()       _ReadWriteBarrier ()
+  #define RELEASE_FENCE()       _ReadWriteBarrier ()
+  #define FULL_FENCE()          MemoryBarrier ()
+#else
+  #define ATOMIC_LOAD(ptr)      __atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+  #define ATOMIC_STORE(ptr, v)  __atomic_store_n ((ptr), (v), __ATOMIC_RELEASE)
+  #define ATOMIC_CAS(ptr, e, d) sl_atomic_cas ((ptr), (e), (d))
+  #define ATOMIC_ADD(ptr, v)    __atomic_add_fetch ((ptr), (v), __ATOMIC_ACQ_REL)
+  #define ATOMIC_LOAD64(ptr)    __atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+  #define ATOMIC_STORE64(ptr, v) __atomic_store_n ((ptr), (v), __ATOMIC_RELEASE)
+  #define ATOMIC_LOADPTR(ptr)   __atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+  #define ATOMIC_STOREPTR(ptr, v) __atomic_store_n ((ptr), (v), __ATOMIC_RELEASE)
+  #define ACQUIRE_FENCE()       __atomic_thread_fence (__ATOMIC_ACQUIRE)
+  #define RELEASE_FENCE()       __atomic_thread_fence (__ATOMIC_RELEASE)
+  #define FULL_FENCE()          __atomic_thread_fence (__ATOMIC_SEQ_CST)
+
+static inline int
+sl_atomic_cas (volatile uint32_t *ptr, uint32_t expected, uint32_t desired)
+{
+  return __atomic_compare_exchange_n (ptr, &expected, desired, 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,17 +26,46 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <ctype.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+  #include <emmintrin.h>
+#endif
 
 #include "globmatch.h"
 #include "libslink.h"
 #include "mseedformat.h"
 
+/* Maximum data copied from a buffer provided by a connection group to complete
+ * data remaining in the internal buffer, more than any header and station ID */
+#define EXTERNAL_COPY 1024
+
 /* Function(s) only used in this source file */
 static int receive_header (SLCD *slconn, uint8_t *buffer, uint32_t bytesavailable);
+static int valid_header (const SLCD *slconn, const uint8_t *buffer, uint32_t bytesavailable);
+static void resync_start (SLCD *slconn);
+static uint32_t resync_scan (SLCD *slconn, const uint8_t *buffer, uint32_t bytesavailable);
+static uint32_t find_signature (const uint8_t *buffer, uint32_t length, uint8_t second);
 static int64_t receive_payload (SLCD *slconn, char *plbuffer, uint32_t plbuffersize,
                                 uint8_t *buffer, uint32_t bytesavailable);
-static int update_stream (SLCD *slconn, const char *payload);
+static uint32_t receive_chunk (SLCD *slconn, char *plbuffer, uint32_t plbuffersize,
+                               uint8_t *buffer, uint32_t bytesavailable);
+static int update_stream (SLCD *slconn, const char *payload, uint32_t length);
+static int filter_payload (SLCD *slconn, const char *payload, uint32_t length);
+static int removed_station (SLCD *slconn, const char *sourceid);
+static void free_streams (SLstream *stream);
+static uint32_t rate_allowance (SLCD *slconn, uint32_t maxbytes, int64_t current_time);
+static int64_t rate_refill (SLratelimit *limit, int64_t current_time);
+static int transcode_payload (SLCD *slconn, char *plbuffer, uint32_t plbuffersize);
+#if defined(__linux__)
+static int splice_packet (SLCD *slconn);
+#endif
+static int info_append (SLCD *slconn, const char *record, int final);
+static int info_return (SLCD *slconn, const SLpacketinfo **packetinfo,
+                        char *plbuffer, uint32_t plbuffersize);
 static int64_t detect (const char *record, uint64_t recbuflen, char *payloadformat);
+static void consume_data (SLCD *slconn, uint8_t **data, uint32_t *datalength,
+                          uint32_t bytesconsumed);
 
 /* Initialize the global termination handler */
 SLCD *global_termination_SLCD = NULL;
@@ -65,6 +94,20 @@ SLCD *global_termination_SLCD = NULL;
  * partial payload data and should be preserved if reallocated,
  * specifically the first \a packetinfo.payloadcollected bytes.
  *
+ * If chunked mode is enabled with sl_set_chunkmode(), payloads other
+ * than miniSEED that are larger than \a plbuffer are returned in
+ * segments as they arrive with \a SLCHUNK, instead of \a SLTOOLARGE.
+ * Each segment is placed at the start of \a plbuffer and described by
+ * \a slconn.stat.chunkoffset, \a slconn.stat.chunklength and
+ * \a slconn.stat.chunkfinal.
+ *
+ * If splice mode is enabled with sl_set_splicemode(), miniSEED
+ * payloads that are moved directly to the archive are not returned
+ * and only reach the archive, see sl_set_splicemode().
+ *
+ * If transcoding is enabled with sl_set_transcode(), miniSEED 2
+ * payloads are returned as miniSEED 3.
+ *
  * @param[in]  slconn   SeedLink connection description
  * @param[out] packetinfo  Pointer to pointer to ::SLpacketinfo describing payload
  * @param[out] plbuffer  Destination buffer for packet payload
@@ -75,6 +118,7 @@ SLCD *global_termination_SLCD = NULL;
  * @retval SLTERMINATE Connection termination or error
  * @retval SLNOPACKET  No packet available, call again
  * @retval SLTOOLARGE  Payload is larger than allowed maximum
+ * @retval SLCHUNK  Segment of payload returned, chunked mode only
  ***************************************************************************/
 int
 sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
@@ -84,14 +128,30 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
   int64_t current_time;
   uint32_t bytesconsumed;
   uint32_t bytesavailable;
+  uint8_t *data;
+  uint32_t datalength;
+  int stalled;
+  int validheader;
   int poll_state;
+  uint32_t allowance;
+  int64_t ratewait;
+#if defined(__linux__)
+  int spliced;
+#endif
 
   if (!slconn || !packetinfo || (plbuffersize > 0 && !plbuffer))
     return SLTERMINATE;
 
+  /* Return reassembled INFO response not yet returned, e.g. after SLTOOLARGE */
+  if (slconn->infoready)
+  {
+    return info_return (slconn, packetinfo, plbuffer, plbuffersize);
+  }
+
   while (slconn->terminate < 2)
   {
     current_time = sl_nstime();
+    stalled      = 0;
 
     if (slconn->link == -1)
     {
@@ -110,6 +170,9 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
     if (slconn->stat->conn_state == DOWN &&
         slconn->stat->netdly_time < current_time)
     {
+      /* Discard any partial INFO response from a previous connection */
+      slconn->infolength = 0;
+
       if (sl_connect (slconn, 1) != -1)
       {
         slconn->stat->conn_state = UP;
@@ -133,6 +196,10 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         }
       }
 
+      /* Removed streams were not requested, nothing remains to filter */
+      free_streams (slconn->removed);
+      slconn->removed = NULL;
+
       slconn->stat->conn_state = STREAMING;
     }
 
@@ -150,20 +217,75 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         slconn->stat->query_state = NoQuery;
       }
 
-      free (slconn->info);
+      sl_free (slconn->info);
       slconn->info = NULL;
     }
 
     /* Read incoming data stream */
     if (slconn->stat->conn_state == STREAMING)
     {
-      /* Receive data into internal buffer */
-      if (slconn->terminate == 0)
+#if defined(__linux__)
+      /* Move miniSEED payloads from the socket to the archive in splice mode,
+       * not used with rate limits as spliced bytes are not metered or with
+       * transcoding as archived records must be transcoded */
+      if (slconn->splicemode && slconn->archive && slconn->tlsctx == NULL &&
+          slconn->ratelimit.rate == 0 && slconn->sharedlimit == NULL &&
+          slconn->transcodebuffer == NULL &&
+          slconn->protocol & SLPROTO40 && slconn->terminate == 0 &&
+          slconn->stat->stream_state == HEADER && slconn->recvdatalen == 0 &&
+          slconn->extrecv == 0)
+      {
+        if ((spliced = splice_packet (slconn)) < 0)
+        {
+          break;
+        }
+        else if (spliced > 0)
+        {
+          /* Return to caller between packets when not blocking */
+          if (slconn->noblock)
+          {
+            *packetinfo = NULL;
+            return SLNOPACKET;
+          }
+
+          continue;
+        }
+      }
+#endif
+
+      /* Complete data remaining in the internal buffer, e.g. a header split between
+       * buffers received by a connection group, with the start of the next buffer */
+      if (slconn->extrecv && slconn->recvdatalen > 0 && slconn->extdatalen > 0)
+      {
+        bytesavailable = sizeof (slconn->recvbuffer) - slconn->recvdatalen;
+
+        if (bytesavailable > EXTERNAL_COPY)
+          bytesavailable = EXTERNAL_COPY;
+        if (bytesavailable > slconn->extdatalen)
+          bytesavailable = slconn->extdatalen;
+
+        memcpy (slconn->recvbuffer + slconn->recvdatalen, slconn->extdata, bytesavailable);
+        slconn->recvdatalen += bytesavailable;
+        slconn->extdata += bytesavailable;
+        slconn->extdatalen -= bytesavailable;
+      }
+
+      /* Receive data into internal buffer, no more than allowed by rate limits.
+       * When throttled the socket is not read and TCP flow control slows the server.
+       * Sockets read by a connection group are never read here. */
+      allowance = 0;
+      if (slconn->terminate == 0 && slconn->extrecv == 0)
+      {
+        allowance = rate_allowance (slconn,
+                                    sizeof (slconn->recvbuffer) - slconn->recvdatalen,
+                                    current_time);
+      }
+
+      if (allowance > 0)
       {
         bytesread = sl_recvdata (slconn,
                                  slconn->recvbuffer + slconn->recvdatalen,
-                                 sizeof (slconn->recvbuffer) - slconn->recvdatalen,
-                                 slconn->sladdr);
+                                 allowance, slconn->sladdr);
 
         if (bytesread < 0)
         {
@@ -172,6 +294,11 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         else if (bytesread > 0)
         {
           slconn->recvdatalen += bytesread;
+
+          if (slconn->ratelimit.rate)
+            slconn->ratelimit.tokens -= bytesread;
+          if (slconn->sharedlimit && slconn->sharedlimit->rate)
+            slconn->sharedlimit->tokens -= bytesread;
         }
         else if (slconn->recvdatalen == 0) /* bytesread == 0 */
         {
@@ -187,15 +314,26 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         }
       }
 
-      /* Process data in internal buffer */
+      /* Process data in internal buffer, or data provided by a connection group in place */
+      if (slconn->recvdatalen == 0 && slconn->extdatalen > 0)
+      {
+        data       = slconn->extdata;
+        datalength = slconn->extdatalen;
+      }
+      else
+      {
+        data       = slconn->recvbuffer;
+        datalength = slconn->recvdatalen;
+      }
+
       bytesconsumed = 0;
 
       /* Check for special cases of the server reporting end of streaming or errors
        * while awaiting a header (i.e. in between packets) */
       if (slconn->stat->stream_state == HEADER)
       {
-        if (slconn->recvdatalen - bytesconsumed >= 3 &&
-            memcmp (slconn->recvbuffer + bytesconsumed, "END", 3) == 0)
+        if (datalength - bytesconsumed >= 3 &&
+            memcmp (data + bytesconsumed, "END", 3) == 0)
         {
           sl_log_r (slconn, 1, 1, "[%s] End of selected time window or stream (FETCH/dial-up mode)\n",
                     slconn->sladdr);
@@ -204,8 +342,8 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
           break;
         }
 
-        if (slconn->recvdatalen - bytesconsumed >= 5 &&
-            memcmp (slconn->recvbuffer + bytesconsumed, "ERROR", 5) == 0)
+        if (datalength - bytesconsumed >= 5 &&
+            memcmp (data + bytesconsumed, "ERROR", 5) == 0)
         {
           sl_log_r (slconn, 2, 0, "[%s] Server reported an error with the last command\n",
                     slconn->sladdr);
@@ -215,16 +353,36 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         }
       }
 
+      /* Validate the next header before reading it in resync mode */
+      validheader = 1;
+      if (slconn->resync && slconn->stat->stream_state == HEADER)
+      {
+        bytesavailable = datalength - bytesconsumed;
+
+        if ((validheader = valid_header (slconn, data + bytesconsumed, bytesavailable)) == 0)
+          resync_start (slconn);
+      }
+
+      /* Skip unparseable data up to the next valid header */
+      if (slconn->stat->stream_state == RESYNC)
+      {
+        bytesconsumed += resync_scan (slconn, data + bytesconsumed,
+                                      datalength - bytesconsumed);
+
+        if (slconn->stat->stream_state == RESYNC)
+          validheader = -1;
+      }
+
       /* Read next header */
-      if (slconn->stat->stream_state == HEADER)
+      if (slconn->stat->stream_state == HEADER && validheader != -1)
       {
-        bytesavailable = slconn->recvdatalen - bytesconsumed;
+        bytesavailable = datalength - bytesconsumed;
 
         if ((slconn->protocol & SLPROTO3X && bytesavailable >= SLHEADSIZE_V3) ||
             (slconn->protocol & SLPROTO40 && bytesavailable >= SLHEADSIZE_V4))
         {
           bytesread = receive_header (slconn,
-                                      slconn->recvbuffer + bytesconsumed,
+                                      data + bytesconsumed,
                                       bytesavailable);
 
           if (bytesread < 0)
@@ -253,7 +411,7 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
       /* Read station ID */
       if (slconn->stat->stream_state == STATIONID &&
           slconn->stat->packetinfo.stationidlength > 0 &&
-          (slconn->recvdatalen - bytesconsumed) >= slconn->stat->packetinfo.stationidlength)
+          (datalength - bytesconsumed) >= slconn->stat->packetinfo.stationidlength)
       {
         if (slconn->stat->packetinfo.stationidlength > (sizeof (slconn->stat->packetinfo.stationid) - 1))
         {
@@ -268,7 +426,7 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         else
         {
           memcpy (slconn->stat->packetinfo.stationid,
-                  slconn->recvbuffer + bytesconsumed,
+                  data + bytesconsumed,
                   slconn->stat->packetinfo.stationidlength);
 
           slconn->stat->packetinfo.stationid[slconn->stat->packetinfo.stationidlength] = '\0';
@@ -281,24 +439,123 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         }
       } /* Done reading station ID */
 
+      /* Apply client-side filter before any payload is copied */
+      if (slconn->stat->stream_state == PAYLOAD &&
+          (slconn->filter || slconn->removed) &&
+          slconn->stat->packetinfo.payloadcollected == 0)
+      {
+        bytesavailable = datalength - bytesconsumed;
+
+        if (filter_payload (slconn, (char *)data + bytesconsumed, bytesavailable) == 0)
+        {
+          /* Update streaming tracking from the header in the internal buffer,
+           * only the part of the payload received so far is available */
+          if (bytesavailable > slconn->stat->packetinfo.payloadlength)
+            bytesavailable = slconn->stat->packetinfo.payloadlength;
+
+          if (update_stream (slconn, (char *)data + bytesconsumed, bytesavailable) == -1)
+          {
+            sl_log_r (slconn, 2, 0, "[%s] %s(): cannot update stream tracking\n",
+                      slconn->sladdr, __func__);
+            return -1;
+          }
+
+          slconn->stat->stream_state = SKIPPAYLOAD;
+        }
+      }
+
+      /* Skip payload rejected by filter */
+      if (slconn->stat->stream_state == SKIPPAYLOAD)
+      {
+        bytesavailable = datalength - bytesconsumed;
+        bytesread      = slconn->stat->packetinfo.payloadlength - slconn->stat->packetinfo.payloadcollected;
+
+        if (bytesread > bytesavailable)
+          bytesread = bytesavailable;
+
+        if (bytesread > 0)
+        {
+          slconn->stat->netto_time     = 0;
+          slconn->stat->keepalive_time = 0;
+
+          slconn->stat->packetinfo.payloadcollected += bytesread;
+          bytesconsumed += bytesread;
+        }
+
+        if (slconn->stat->packetinfo.payloadcollected == slconn->stat->packetinfo.payloadlength)
+        {
+          slconn->stat->stream_state = HEADER;
+        }
+      } /* Done skipping payload */
+
+      /* Read payload in segments in chunked mode when buffer is not sufficient */
+      if (slconn->stat->stream_state == PAYLOAD &&
+          slconn->chunkmode && plbuffersize > 0 &&
+          slconn->stat->packetinfo.payloadlength > plbuffersize &&
+          slconn->stat->packetinfo.payloadformat != SLPAYLOAD_MSEED2 &&
+          slconn->stat->packetinfo.payloadformat != SLPAYLOAD_MSEED3)
+      {
+        bytesavailable = datalength - bytesconsumed;
+
+        if (bytesavailable > 0)
+        {
+          bytesread = receive_chunk (slconn, plbuffer, plbuffersize,
+                                     data + bytesconsumed,
+                                     bytesavailable);
+
+          slconn->stat->netto_time     = 0;
+          slconn->stat->keepalive_time = 0;
+
+          bytesconsumed += bytesread;
+
+          /* Shift any remaining data in the buffer to the start */
+          consume_data (slconn, &data, &datalength, bytesconsumed);
+          bytesconsumed = 0;
+
+          if (slconn->stat->chunkfinal)
+          {
+            slconn->stat->stream_state = HEADER;
+          }
+
+          /* V4 Keepalive INFO responses are not returned to caller */
+          if (slconn->stat->query_state == KeepAliveQuery &&
+              slconn->stat->packetinfo.payloadformat == SLPAYLOAD_JSON &&
+              slconn->stat->packetinfo.payloadsubformat == SLPAYLOAD_JSON_INFO)
+          {
+            if (slconn->stat->chunkfinal)
+            {
+              sl_log_r (slconn, 1, 2, "[%s] Keepalive message received\n", slconn->sladdr);
+
+              slconn->stat->query_state = NoQuery;
+            }
+
+            continue;
+          }
+
+          /* Update streaming tracking when the payload is complete */
+          if (slconn->stat->chunkfinal &&
+              update_stream (slconn, plbuffer, slconn->stat->chunklength) == -1)
+          {
+            sl_log_r (slconn, 2, 0, "[%s] %s(): cannot update stream tracking\n",
+                      slconn->sladdr, __func__);
+            return -1;
+          }
+
+          *packetinfo = &slconn->stat->packetinfo;
+          return SLCHUNK;
+        }
+      } /* Done reading payload chunk */
       /* Read payload */
-      if (slconn->stat->stream_state == PAYLOAD)
+      else if (slconn->stat->stream_state == PAYLOAD)
       {
-        bytesavailable = slconn->recvdatalen - bytesconsumed;
+        bytesavailable = datalength - bytesconsumed;
 
         /* If payload length is known, return SLTOOLARGE if buffer is not sufficient */
         if (slconn->stat->packetinfo.payloadlength > 0 &&
             slconn->stat->packetinfo.payloadlength > plbuffersize)
         {
           /* Shift any remaining data in the buffer to the start */
-          if (bytesconsumed > 0 && bytesconsumed < slconn->recvdatalen)
-          {
-            memmove (slconn->recvbuffer,
-                     slconn->recvbuffer + bytesconsumed,
-                     slconn->recvdatalen - bytesconsumed);
-          }
-
-          slconn->recvdatalen -= bytesconsumed;
+          consume_data (slconn, &data, &datalength, bytesconsumed);
           bytesconsumed = 0;
 
           *packetinfo = &slconn->stat->packetinfo;
@@ -306,10 +563,17 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
         }
 
         bytesread = receive_payload (slconn, plbuffer, plbuffersize,
-                                     slconn->recvbuffer + bytesconsumed,
+                                     data + bytesconsumed,
                                      bytesavailable);
 
-        if (bytesread < 0)
+        /* Unrecognized v3 payload, the header was not followed by a record */
+        if (bytesread < 0 && slconn->resync &&
+            slconn->protocol & SLPROTO3X &&
+            slconn->stat->packetinfo.payloadlength == 0)
+        {
+          resync_start (slconn);
+        }
+        else if (bytesread < 0)
         {
           break;
         }
@@ -326,14 +590,7 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
             slconn->stat->packetinfo.payloadcollected == slconn->stat->packetinfo.payloadlength)
         {
           /* Shift any remaining data in the buffer to the start */
-          if (bytesconsumed > 0 && bytesconsumed < slconn->recvdatalen)
-          {
-            memmove (slconn->recvbuffer,
-                     slconn->recvbuffer + bytesconsumed,
-                     slconn->recvdatalen - bytesconsumed);
-          }
-
-          slconn->recvdatalen -= bytesconsumed;
+          consume_data (slconn, &data, &datalength, bytesconsumed);
           bytesconsumed = 0;
 
           /* Set state for header collection if payload is complete */
@@ -360,17 +617,82 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
 
             slconn->stat->query_state = NoQuery;
           }
+          /* V3 INFO responses are reassembled or passed to the handler */
+          else if ((slconn->inforeassembly || slconn->info_handler) &&
+                   (slconn->stat->packetinfo.payloadformat == SLPAYLOAD_MSEED2INFO ||
+                    slconn->stat->packetinfo.payloadformat == SLPAYLOAD_MSEED2INFOTERM))
+          {
+            if (info_append (slconn, plbuffer,
+                             (slconn->stat->packetinfo.payloadformat == SLPAYLOAD_MSEED2INFOTERM)) == -1)
+            {
+              break;
+            }
+
+            if (slconn->infoready)
+            {
+              return info_return (slconn, packetinfo, plbuffer, plbuffersize);
+            }
+
+            /* Continue with any data remaining in the buffer */
+            continue;
+          }
+          /* Payloads rejected by filter, when not determined before collection */
+          else if ((slconn->filter || slconn->removed) &&
+                   filter_payload (slconn, plbuffer, slconn->stat->packetinfo.payloadlength) == 0)
+          {
+            if (update_stream (slconn, plbuffer, slconn->stat->packetinfo.payloadlength) == -1)
+            {
+              sl_log_r (slconn, 2, 0, "[%s] %s(): cannot update stream tracking\n",
+                        slconn->sladdr, __func__);
+              return -1;
+            }
+
+            /* Continue with any data remaining in the buffer */
+            continue;
+          }
           /* All other payloads are returned to the caller */
           else
           {
             /* Update streaming tracking */
-            if (update_stream (slconn, plbuffer) == -1)
+            if (update_stream (slconn, plbuffer, slconn->stat->packetinfo.payloadlength) == -1)
             {
               sl_log_r (slconn, 2, 0, "[%s] %s(): cannot update stream tracking\n",
                         slconn->sladdr, __func__);
               return -1;
             }
 
+            /* Transcode miniSEED 2 to miniSEED 3, records that cannot be transcoded are returned unchanged */
+            if (slconn->transcodebuffer &&
+                slconn->stat->packetinfo.payloadformat == SLPAYLOAD_MSEED2)
+            {
+              transcode_payload (slconn, plbuffer, plbuffersize);
+            }
+
+            /* Update last packet cache, continuity index, archive and relay, failures are logged and not fatal */
+            if (slconn->lpcache)
+            {
+              sl_lpcache_update (slconn->lpcache, slconn->log,
+                                 &slconn->stat->packetinfo, plbuffer);
+            }
+
+            if (slconn->continuity)
+            {
+              sl_continuity_add (slconn->continuity, slconn->log,
+                                 &slconn->stat->packetinfo, plbuffer);
+            }
+
+            if (slconn->archive)
+            {
+              sl_archive_write (slconn->archive, slconn->log,
+                                &slconn->stat->packetinfo, plbuffer);
+            }
+
+            if (slconn->relay)
+            {
+              sl_relay_add (slconn->relay, slconn->log,
+                            &slconn->stat->packetinfo, plbuffer);
+            }
+
             *packetinfo = &slconn->stat->packetinfo;
             return SLPACKET;
           }
@@ -378,28 +700,43 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
       } /* Done reading payload */
 
       /* If a viable amount of data exists but has not been consumed something is wrong with the stream */
-      if (slconn->recvdatalen > SL_MIN_PAYLOAD && bytesconsumed == 0)
+      if (datalength > SL_MIN_PAYLOAD && bytesconsumed == 0 &&
+          slconn->resync && validheader != -1)
+      {
+        resync_start (slconn);
+      }
+      else if (datalength > SL_MIN_PAYLOAD && bytesconsumed == 0 &&
+               validheader != -1)
       {
         sl_log_r (slconn, 2, 0, "[%s] %s(): cannot process received data, terminating.\n",
                   slconn->sladdr, __func__);
         sl_log_r (slconn, 2, 0, "[%s]  recvdatalen: %u, stream_state: %d, bytesconsumed: %u\n",
-                  slconn->sladdr, slconn->recvdatalen, slconn->stat->stream_state, bytesconsumed);
+                  slconn->sladdr, datalength, slconn->stat->stream_state, bytesconsumed);
         break;
       }
 
-      /* Shift any remaining data in the buffer to the start */
-      if (bytesconsumed > 0 && bytesconsumed < slconn->recvdatalen)
+      /* No more data can be processed until provided by a connection group */
+      stalled = (slconn->extrecv && bytesconsumed == 0);
+
+      /* Data provided by a connection group that cannot be processed yet, e.g. a
+       * partial header at the end of a buffer, is kept in the internal buffer */
+      if (data != slconn->recvbuffer && bytesconsumed == 0 && datalength > 0)
       {
-        memmove (slconn->recvbuffer,
-                 slconn->recvbuffer + bytesconsumed,
-                 slconn->recvdatalen - bytesconsumed);
+        bytesconsumed = sizeof (slconn->recvbuffer) - slconn->recvdatalen;
+
+        if (bytesconsumed > datalength)
+          bytesconsumed = datalength;
+
+        memcpy (slconn->recvbuffer + slconn->recvdatalen, data, bytesconsumed);
+        slconn->recvdatalen += bytesconsumed;
       }
 
-      slconn->recvdatalen -= bytesconsumed;
+      /* Shift any remaining data in the buffer to the start */
+      consume_data (slconn, &data, &datalength, bytesconsumed);
       bytesconsumed = 0;
 
       /* Set termination flag to level 2 if less than viable number of bytes in buffer */
-      if (slconn->terminate == 1 && slconn->recvdatalen < SL_MIN_PAYLOAD)
+      if (slconn->terminate == 1 && slconn->recvdatalen + slconn->extdatalen < SL_MIN_PAYLOAD)
       {
         slconn->terminate = 2;
       }
@@ -457,8 +794,28 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
       slconn->stat->keepalive_time = current_time + SL_EPOCH2SLTIME (slconn->keepalive);
     }
 
-    /* Return if not waiting for data and no data in internal buffer */
-    if (slconn->noblock && slconn->recvdatalen == 0)
+    /* Wait for rate limit tokens, return if not blocking */
+    if (slconn->stat->conn_state == STREAMING && slconn->terminate == 0 &&
+        slconn->stat->ratelimit_time > current_time)
+    {
+      if (slconn->noblock)
+      {
+        *packetinfo = NULL;
+        return SLNOPACKET;
+      }
+
+      /* Sleep until tokens are available, at most 1/10 second */
+      ratewait = slconn->stat->ratelimit_time - current_time;
+      if (ratewait > SL_EPOCH2SLTIME (1) / 10)
+        ratewait = SL_EPOCH2SLTIME (1) / 10;
+
+      sl_usleep ((unsigned long int)(ratewait / 1000));
+    }
+
+    /* Return if not waiting for data and no data in internal buffer, or if
+     * the data remaining cannot be processed until more is provided */
+    if ((slconn->noblock || slconn->extrecv) && slconn->extdatalen == 0 &&
+        (slconn->recvdatalen == 0 || stalled))
     {
       *packetinfo = NULL;
       return SLNOPACKET;
@@ -479,6 +836,41 @@ sl_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
   return SLTERMINATE;
 } /* End of sl_collect() */
 
+/***************************************************************************
+ * consume_data:
+ *
+ * Remove consumed data from the data being processed.  Data remaining
+ * in the internal buffer is shifted to the start, data provided by a
+ * connection group is consumed in place.
+ ***************************************************************************/
+static void
+consume_data (SLCD *slconn, uint8_t **data, uint32_t *datalength,
+              uint32_t bytesconsumed)
+{
+  if (bytesconsumed == 0)
+    return;
+
+  if (*data == slconn->recvbuffer)
+  {
+    if (bytesconsumed < slconn->recvdatalen)
+    {
+      memmove (slconn->recvbuffer,
+               slconn->recvbuffer + bytesconsumed,
+               slconn->recvdatalen - bytesconsumed);
+    }
+
+    slconn->recvdatalen -= bytesconsumed;
+  }
+  else
+  {
+    slconn->extdata += bytesconsumed;
+    slconn->extdatalen -= bytesconsumed;
+    *data += bytesconsumed;
+  }
+
+  *datalength -= bytesconsumed;
+} /* End of consume_data() */
+
 /***************************************************************************
  * receive_header:
  *
@@ -572,82 +964,312 @@ receive_header (SLCD *slconn, uint8_t *buffer, uint32_t bytesavailable)
 } /* End of receive_header() */
 
 /***************************************************************************
- * receive_payload:
- *
- * Copy payload data to supplied buffer.
+ * valid_header:
  *
- * The supplied buffer must be large enough for payload detection,
- * defined as SL_MIN_PAYLOAD bytes.
+ * Determine if the buffer starts with a valid SeedLink header for the
+ * protocol in use, followed by a station ID (v4) and the start of a
+ * recognized payload.  For miniSEED payloads the fixed header is
+ * checked, and for miniSEED 3 the record length must match the
+ * payload length in the SeedLink header.
  *
- * Returns
- * bytes : Number of bytes consumed on success
- * -1 :  on error
+ * Returns:
+ * 1 : valid header
+ * 0 : invalid header
+ * -1 : not enough data to determine validity
  ***************************************************************************/
-int64_t
-receive_payload (SLCD *slconn, char *plbuffer, uint32_t plbuffersize,
-                 uint8_t *buffer, uint32_t bytesavailable)
+static int
+valid_header (const SLCD *slconn, const uint8_t *buffer, uint32_t bytesavailable)
 {
-  SLpacketinfo *packetinfo = NULL;
-  uint32_t bytestoconsume = 0;
-  int64_t detectedlength;
-  char payloadformat = SLPAYLOAD_UNKNOWN;
+  const char *payload;
+  uint32_t payloadlength;
+  uint32_t recordlength;
+  uint32_t needed;
+  uint16_t extralength;
+  uint8_t stationidlength;
+  int idx;
 
-  if (!slconn || !plbuffer)
+  if (slconn->protocol & SLPROTO3X)
+  {
+    if (bytesavailable < SLHEADSIZE_V3)
+      return -1;
+
+    if (memcmp (buffer, INFOSIGNATURE, 6) != 0)
+    {
+      if (memcmp (buffer, SIGNATURE_V3, 2) != 0)
+        return 0;
+
+      for (idx = 2; idx < SLHEADSIZE_V3; idx++)
+      {
+        if (!isxdigit ((int)buffer[idx]))
+          return 0;
+      }
+    }
+
+    if (bytesavailable < SLHEADSIZE_V3 + 48)
+      return -1;
+
+    return (MS2_ISVALIDHEADER ((const char *)buffer + SLHEADSIZE_V3)) ? 1 : 0;
+  }
+
+  if (bytesavailable < SLHEADSIZE_V4)
     return -1;
 
-  packetinfo = &slconn->stat->packetinfo;
+  if (memcmp (buffer, SIGNATURE_V4, 2) != 0)
+    return 0;
 
-  /* Return for more data if the minimum for detection is not available */
-  if (packetinfo->payloadlength == 0 && bytesavailable < SL_MIN_PAYLOAD)
-  {
+  memcpy (&payloadlength, buffer + 4, 4);
+  stationidlength = buffer[16];
+
+  if (!sl_littleendianhost ())
+    sl_gswap4 (&payloadlength);
+
+  if (stationidlength >= SL_MAX_STATIONID)
     return 0;
-  }
 
-  /* If payload length is unknown, consume up to 128 bytes */
-  if (packetinfo->payloadlength == 0)
-  {
-    bytestoconsume = (bytesavailable < 128) ? bytesavailable : 128;
-  }
-  /* If remaining payload is smaller than available, consume remaining */
-  else if ((packetinfo->payloadlength - packetinfo->payloadcollected) < bytesavailable)
-  {
-    bytestoconsume = packetinfo->payloadlength - packetinfo->payloadcollected;
-  }
-  /* Otherwise, all available data is payload */
-  else
+  /* Bytes of payload needed for validation */
+  switch (buffer[2])
   {
-    bytestoconsume = bytesavailable;
+  case SLPAYLOAD_MSEED2:
+    needed = 48;
+    break;
+  case SLPAYLOAD_MSEED3:
+    needed = MS3FSDH_LENGTH;
+    break;
+  case SLPAYLOAD_JSON:
+  case SLPAYLOAD_XML:
+    needed = 1;
+    break;
+  default:
+    return 0;
   }
 
-  if (bytestoconsume > plbuffersize - packetinfo->payloadcollected)
-  {
-    sl_log_r (slconn, 2, 0, "[%s] %s(): provided buffer size (%u) is insufficient for payload (%u)\n",
-              slconn->sladdr, __func__, plbuffersize,
-              (packetinfo->payloadlength == 0) ? bytestoconsume : packetinfo->payloadlength);
+  if (payloadlength < needed)
+    return 0;
+
+  if (bytesavailable < SLHEADSIZE_V4 + stationidlength + needed)
     return -1;
-  }
 
-  /* Copy payload data from internal buffer to payload buffer */
-  memcpy (plbuffer + packetinfo->payloadcollected, buffer, bytestoconsume);
-  packetinfo->payloadcollected += bytestoconsume;
+  payload = (const char *)buffer + SLHEADSIZE_V4 + stationidlength;
 
-  /* If payload length is not yet known for V3, try to detect from payload */
-  if (slconn->protocol & SLPROTO3X && packetinfo->payloadlength == 0)
+  switch (buffer[2])
   {
-    detectedlength = detect (plbuffer, packetinfo->payloadcollected, &payloadformat);
+  case SLPAYLOAD_MSEED2:
+    return (MS2_ISVALIDHEADER (payload)) ? 1 : 0;
+  case SLPAYLOAD_MSEED3:
+    if (!MS3_ISVALIDHEADER (payload))
+      return 0;
 
-    /* Return error if no recognized payload detected */
-    if (detectedlength < 0)
+    memcpy (&extralength, pMS3FSDH_EXTRALENGTH (payload), 2);
+    memcpy (&recordlength, pMS3FSDH_DATALENGTH (payload), 4);
+
+    if (!sl_littleendianhost ())
     {
-      sl_log_r (slconn, 2, 0,
-                "[%s] %s(): non-miniSEED packet received for v3 protocol! Terminating.\n",
-                slconn->sladdr, __func__);
-      return -1;
+      sl_gswap2 (&extralength);
+      sl_gswap4 (&recordlength);
     }
-    /* Update packet info if length detected */
-    else if (detectedlength > 0)
-    {
-      if (packetinfo->payloadformat == SLPAYLOAD_UNKNOWN)
+
+    recordlength += MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH (payload) + extralength;
+
+    return (recordlength == payloadlength) ? 1 : 0;
+  case SLPAYLOAD_JSON:
+    return (*payload == '{') ? 1 : 0;
+  default:
+    return (*payload == '<') ? 1 : 0;
+  }
+} /* End of valid_header() */
+
+/***************************************************************************
+ * resync_start:
+ *
+ * Start resynchronization after unparseable data, the stream is
+ * scanned for the next valid header by resync_scan().
+ ***************************************************************************/
+static void
+resync_start (SLCD *slconn)
+{
+  sl_log_r (slconn, 2, 0, "[%s] Unparseable data received, resynchronizing stream\n",
+            slconn->sladdr);
+
+  slconn->stat->resync_count++;
+  slconn->stat->stream_state = RESYNC;
+  slconn->resyncmark         = slconn->stat->resync_bytes;
+} /* End of resync_start() */
+
+/***************************************************************************
+ * resync_scan:
+ *
+ * Scan the buffer for the next valid header, skipping everything
+ * before it.  When found, the stream state is set to HEADER.  A
+ * candidate header that cannot be validated with the data available
+ * is kept for the next scan, as is a trailing byte that may be the
+ * start of a signature.
+ *
+ * Returns the number of bytes skipped.
+ ***************************************************************************/
+static uint32_t
+resync_scan (SLCD *slconn, const uint8_t *buffer, uint32_t bytesavailable)
+{
+  uint8_t second = (slconn->protocol & SLPROTO3X) ? SIGNATURE_V3[1] : SIGNATURE_V4[1];
+  uint32_t offset = 0;
+  int valid = 0;
+
+  while ((offset += find_signature (buffer + offset, bytesavailable - offset, second)) < bytesavailable)
+  {
+    if ((valid = valid_header (slconn, buffer + offset, bytesavailable - offset)) != 0)
+      break;
+
+    offset++;
+  }
+
+  /* Keep a trailing byte that may start a signature */
+  if (offset >= bytesavailable)
+  {
+    offset = bytesavailable;
+
+    if (offset > 0 && buffer[offset - 1] == 'S')
+      offset--;
+  }
+
+  slconn->stat->resync_bytes += offset;
+
+  if (valid == 1)
+  {
+    sl_log_r (slconn, 1, 0, "[%s] Stream resynchronized, skipped %" PRIu64 " bytes\n",
+              slconn->sladdr, slconn->stat->resync_bytes - slconn->resyncmark);
+
+    slconn->stat->stream_state = HEADER;
+  }
+
+  return offset;
+} /* End of resync_scan() */
+
+/***************************************************************************
+ * find_signature:
+ *
+ * Find the first occurrence of a two byte header signature, 'S'
+ * followed by the specified second byte, using SSE2 to test 16
+ * positions at a time when available, otherwise memchr().
+ *
+ * Returns the offset of the signature or length if not found.
+ ***************************************************************************/
+static uint32_t
+find_signature (const uint8_t *buffer, uint32_t length, uint8_t second)
+{
+  const uint8_t *found;
+  uint32_t offset = 0;
+
+#if defined(__SSE2__) && defined(__GNUC__)
+  const __m128i first = _mm_set1_epi8 ('S');
+  const __m128i next  = _mm_set1_epi8 ((char)second);
+  __m128i current;
+  __m128i following;
+  int mask;
+
+  /* Compare each position and the following position in 16 byte blocks */
+  for (; offset + 17 <= length; offset += 16)
+  {
+    current   = _mm_loadu_si128 ((const __m128i *)(buffer + offset));
+    following = _mm_loadu_si128 ((const __m128i *)(buffer + offset + 1));
+    mask      = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (current, first),
+                                                  _mm_cmpeq_epi8 (following, next)));
+
+    if (mask)
+      return offset + __builtin_ctz (mask);
+  }
+#endif
+
+  while (offset < length &&
+         (found = (const uint8_t *)memchr (buffer + offset, 'S', length - offset)) != NULL)
+  {
+    offset = found - buffer;
+
+    /* A trailing 'S' is reported for the caller to keep */
+    if (offset + 1 >= length || buffer[offset + 1] == second)
+      return (offset + 1 >= length) ? length : offset;
+
+    offset++;
+  }
+
+  return length;
+} /* End of find_signature() */
+
+/***************************************************************************
+ * receive_payload:
+ *
+ * Copy payload data to supplied buffer.
+ *
+ * The supplied buffer must be large enough for payload detection,
+ * defined as SL_MIN_PAYLOAD bytes.
+ *
+ * Returns
+ * bytes : Number of bytes consumed on success
+ * -1 :  on error
+ ***************************************************************************/
+int64_t
+receive_payload (SLCD *slconn, char *plbuffer, uint32_t plbuffersize,
+                 uint8_t *buffer, uint32_t bytesavailable)
+{
+  SLpacketinfo *packetinfo = NULL;
+  uint32_t bytestoconsume = 0;
+  int64_t detectedlength;
+  char payloadformat = SLPAYLOAD_UNKNOWN;
+
+  if (!slconn || !plbuffer)
+    return -1;
+
+  packetinfo = &slconn->stat->packetinfo;
+
+  /* Return for more data if the minimum for detection is not available */
+  if (packetinfo->payloadlength == 0 && bytesavailable < SL_MIN_PAYLOAD)
+  {
+    return 0;
+  }
+
+  /* If payload length is unknown, consume up to 128 bytes */
+  if (packetinfo->payloadlength == 0)
+  {
+    bytestoconsume = (bytesavailable < 128) ? bytesavailable : 128;
+  }
+  /* If remaining payload is smaller than available, consume remaining */
+  else if ((packetinfo->payloadlength - packetinfo->payloadcollected) < bytesavailable)
+  {
+    bytestoconsume = packetinfo->payloadlength - packetinfo->payloadcollected;
+  }
+  /* Otherwise, all available data is payload */
+  else
+  {
+    bytestoconsume = bytesavailable;
+  }
+
+  if (bytestoconsume > plbuffersize - packetinfo->payloadcollected)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): provided buffer size (%u) is insufficient for payload (%u)\n",
+              slconn->sladdr, __func__, plbuffersize,
+              (packetinfo->payloadlength == 0) ? bytestoconsume : packetinfo->payloadlength);
+    return -1;
+  }
+
+  /* Copy payload data from internal buffer to payload buffer */
+  memcpy (plbuffer + packetinfo->payloadcollected, buffer, bytestoconsume);
+  packetinfo->payloadcollected += bytestoconsume;
+
+  /* If payload length is not yet known for V3, try to detect from payload */
+  if (slconn->protocol & SLPROTO3X && packetinfo->payloadlength == 0)
+  {
+    detectedlength = detect (plbuffer, packetinfo->payloadcollected, &payloadformat);
+
+    /* Return error if no recognized payload detected */
+    if (detectedlength < 0)
+    {
+      sl_log_r (slconn, 2, 0,
+                "[%s] %s(): non-miniSEED packet received for v3 protocol! Terminating.\n",
+                slconn->sladdr, __func__);
+      return -1;
+    }
+    /* Update packet info if length detected */
+    else if (detectedlength > 0)
+    {
+      if (packetinfo->payloadformat == SLPAYLOAD_UNKNOWN)
       {
         packetinfo->payloadformat = payloadformat;
       }
@@ -659,11 +1281,161 @@ receive_payload (SLCD *slconn, char *plbuffer, uint32_t plbuffersize,
   return bytestoconsume;
 } /* End of receive_payload() */
 
+/***************************************************************************
+ * receive_chunk:
+ *
+ * Copy the next segment of payload data to the start of the supplied
+ * buffer, limited by the buffer size and the payload remaining.  The
+ * chunk offset, length and final flag in the packet info are set to
+ * describe the segment.
+ *
+ * Returns the number of bytes consumed.
+ ***************************************************************************/
+static uint32_t
+receive_chunk (SLCD *slconn, char *plbuffer, uint32_t plbuffersize,
+               uint8_t *buffer, uint32_t bytesavailable)
+{
+  SLpacketinfo *packetinfo = &slconn->stat->packetinfo;
+  uint32_t bytestoconsume;
+
+  bytestoconsume = packetinfo->payloadlength - packetinfo->payloadcollected;
+
+  if (bytestoconsume > bytesavailable)
+    bytestoconsume = bytesavailable;
+
+  if (bytestoconsume > plbuffersize)
+    bytestoconsume = plbuffersize;
+
+  memcpy (plbuffer, buffer, bytestoconsume);
+
+  slconn->stat->chunkoffset = packetinfo->payloadcollected;
+  slconn->stat->chunklength = bytestoconsume;
+  packetinfo->payloadcollected += bytestoconsume;
+  slconn->stat->chunkfinal = (packetinfo->payloadcollected == packetinfo->payloadlength) ? 1 : 0;
+
+  return bytestoconsume;
+} /* End of receive_chunk() */
+
+/***************************************************************************
+ * info_append:
+ *
+ * Extract the XML text from a v3 INFO record and either pass it to
+ * the INFO handler or append it to the reassembly buffer.  When the
+ * record is the final record of the response and reassembly is
+ * enabled, the document is marked ready to be returned.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+info_append (SLCD *slconn, const char *record, int final)
+{
+  uint32_t payloadlength = slconn->stat->packetinfo.payloadlength;
+  uint16_t dataoffset;
+  uint16_t datalength;
+  uint32_t newsize;
+  char *newbuffer;
+  int swapflag = 0;
+
+  if (payloadlength < 48)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): INFO record too short (%u)\n",
+              slconn->sladdr, __func__, payloadlength);
+    return -1;
+  }
+
+  /* Check to see if byte swapping is needed by checking for sane year and day */
+  if (!MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (record), *pMS2FSDH_DAY (record)))
+    swapflag = 1;
+
+  /* The XML text starts at the data offset with the sample count as length */
+  dataoffset = HO2u (*pMS2FSDH_DATAOFFSET (record), swapflag);
+  datalength = HO2u (*pMS2FSDH_NUMSAMPLES (record), swapflag);
+
+  if (dataoffset < 48 || (uint32_t)dataoffset + datalength > payloadlength)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): INFO record data beyond record (%u + %u > %u)\n",
+              slconn->sladdr, __func__, dataoffset, datalength, payloadlength);
+    return -1;
+  }
+
+  /* Stream fragments to handler */
+  if (slconn->info_handler)
+  {
+    slconn->info_handler (slconn, record + dataoffset, datalength, final, slconn->info_data);
+    return 0;
+  }
+
+  /* Grow reassembly buffer as needed, doubling to minimize reallocation */
+  if (slconn->infolength + datalength > slconn->infosize)
+  {
+    newsize = (slconn->infosize) ? slconn->infosize : 65536;
+
+    while (newsize < slconn->infolength + datalength)
+      newsize *= 2;
+
+    if ((newbuffer = (char *)sl_realloc (slconn->infobuffer, newsize)) == NULL)
+    {
+      sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+      return -1;
+    }
+
+    slconn->infobuffer = newbuffer;
+    slconn->infosize   = newsize;
+  }
+
+  memcpy (slconn->infobuffer + slconn->infolength, record + dataoffset, datalength);
+  slconn->infolength += datalength;
+
+  if (final)
+    slconn->infoready = 1;
+
+  return 0;
+} /* End of info_append() */
+
+/***************************************************************************
+ * info_return:
+ *
+ * Return a reassembled INFO response as a single XML payload.  If the
+ * payload buffer is not large enough SLTOOLARGE is returned and the
+ * response is kept to be returned on a subsequent call.
+ *
+ * Returns SLPACKET or SLTOOLARGE.
+ ***************************************************************************/
+static int
+info_return (SLCD *slconn, const SLpacketinfo **packetinfo,
+             char *plbuffer, uint32_t plbuffersize)
+{
+  SLpacketinfo *info = &slconn->stat->packetinfo;
+
+  memset (info, 0, sizeof (SLpacketinfo));
+  info->seqnum           = SL_UNSETSEQUENCE;
+  info->payloadformat    = SLPAYLOAD_XML;
+  info->payloadsubformat = SLPAYLOAD_XML_INFO;
+  info->payloadlength    = slconn->infolength;
+
+  *packetinfo = info;
+
+  if (slconn->infolength > plbuffersize)
+  {
+    return SLTOOLARGE;
+  }
+
+  memcpy (plbuffer, slconn->infobuffer, slconn->infolength);
+  info->payloadcollected = slconn->infolength;
+
+  slconn->infolength = 0;
+  slconn->infoready  = 0;
+
+  return SLPACKET;
+} /* End of info_return() */
+
 /***************************************************************************
  * update_stream:
  *
- * Update the appropriate stream list entries.  Length of the payload
- * must be at least enough to determine stream details.
+ * Update the appropriate stream list entries.  The \a length bytes of
+ * the payload available, which may be less than the payload length,
+ * must be at least enough to determine stream details, e.g. the fixed
+ * header of a miniSEED record.
  *
  * The slconn->stat->packetinfo.stationid value is also populated from
  * the payload if not already set.
@@ -671,7 +1443,7 @@ receive_payload (SLCD *slconn, char *plbuffer, uint32_t plbuffersize,
  * Returns 0 if successfully updated and -1 if not found or error.
  ***************************************************************************/
 static int
-update_stream (SLCD *slconn, const char *payload)
+update_stream (SLCD *slconn, const char *payload, uint32_t length)
 {
   SLpacketinfo *packetinfo = NULL;
   SLstream *curstream;
@@ -701,9 +1473,9 @@ update_stream (SLCD *slconn, const char *payload)
   if (packetinfo->payloadformat == SLPAYLOAD_MSEED2 ||
       packetinfo->payloadformat == SLPAYLOAD_MSEED3)
   {
-    if (sl_payload_info (slconn->log, packetinfo,
-                         payload, packetinfo->payloadlength,
-                         (packetinfo->stationidlength == 0) ? sourceid : NULL, sizeof (sourceid),
+    if (sl_payload_info (slconn->log, packetinfo, payload, length,
+                         (packetinfo->stationidlength == 0 || slconn->traffic) ? sourceid : NULL,
+                         sizeof (sourceid),
                          timestamp, sizeof (timestamp),
                          NULL, NULL) == -1)
     {
@@ -741,6 +1513,13 @@ update_stream (SLCD *slconn, const char *payload)
     }
   }
 
+  /* Count all received packets, including those rejected by the client-side filter */
+  if (slconn->traffic)
+  {
+    sl_traffic_add (slconn->traffic, packetinfo->stationid,
+                    (sourceid[0]) ? sourceid : NULL, packetinfo->payloadlength);
+  }
+
   curstream = slconn->streams;
 
   /* For all-station mode */
@@ -759,6 +1538,25 @@ update_stream (SLCD *slconn, const char *payload)
     /* Use glob matching to match wildcarded station ID codes */
     if (sl_globmatch (packetinfo->stationid, curstream->stationid))
     {
+      /* Check for skipped sequence numbers for single-station entries, only
+       * when requested as servers with a global sequence skip numbers per station */
+      if (slconn->gap_handler &&
+          curstream->seqnum != SL_UNSETSEQUENCE &&
+          curstream->seqnum != SL_ALLDATASEQUENCE &&
+          packetinfo->seqnum != SL_UNSETSEQUENCE &&
+          packetinfo->seqnum > curstream->seqnum + 1 &&
+          !strchr (curstream->stationid, '*') &&
+          !strchr (curstream->stationid, '?'))
+      {
+        sl_log_r (slconn, 1, 1, "[%s] %s: sequence gap, missing %" PRIu64 " to %" PRIu64 "\n",
+                  slconn->sladdr, packetinfo->stationid,
+                  curstream->seqnum + 1, packetinfo->seqnum - 1);
+
+        slconn->gap_handler (slconn, packetinfo->stationid,
+                             curstream->seqnum + 1, packetinfo->seqnum - 1,
+                             slconn->gap_data);
+      }
+
       curstream->seqnum = packetinfo->seqnum;
       strcpy (curstream->timestamp, timestamp);
 
@@ -768,6 +1566,13 @@ update_stream (SLCD *slconn, const char *payload)
     curstream = curstream->next;
   }
 
+  /* Packets for removed streams are expected until renegotiation */
+  for (curstream = slconn->removed; updates == 0 && curstream; curstream = curstream->next)
+  {
+    if (sl_globmatch (packetinfo->stationid, curstream->stationid))
+      updates++;
+  }
+
   /* If no updates then no match was found */
   if (updates == 0)
     sl_log_r (slconn, 2, 0, "[%s] unexpected data received: %s\n",
@@ -776,6 +1581,425 @@ update_stream (SLCD *slconn, const char *payload)
   return (updates == 0) ? -1 : 0;
   } /* End of update_stream() */
 
+/***************************************************************************
+ * filter_payload:
+ *
+ * Evaluate the client-side filter for a payload using the source
+ * identifier from the miniSEED fixed header.  Only the fixed header
+ * is needed, so this can be called on the internal receive buffer
+ * before the payload is copied.
+ *
+ * For v3 connections the payload length and format are detected and
+ * set in the packet info if not yet known.
+ *
+ * Payloads that are not miniSEED are always accepted.
+ *
+ * Returns:
+ * 1 : accepted
+ * 0 : rejected
+ * -1 : not enough data to determine source identifier and length
+ ***************************************************************************/
+static int
+filter_payload (SLCD *slconn, const char *payload, uint32_t length)
+{
+  SLpacketinfo *packetinfo = &slconn->stat->packetinfo;
+  char sourceid[64] = {0};
+  char payloadformat = SLPAYLOAD_UNKNOWN;
+  int64_t detectedlength;
+  int accept = -1;
+  char *pattern;
+
+  /* Detect v3 payload length and format */
+  if (slconn->protocol & SLPROTO3X && packetinfo->payloadlength == 0)
+  {
+    if (packetinfo->payloadformat != SLPAYLOAD_UNKNOWN)
+      return 1;
+
+    if ((detectedlength = detect (payload, length, &payloadformat)) <= 0)
+      return -1;
+
+    packetinfo->payloadformat = payloadformat;
+    packetinfo->payloadlength = detectedlength;
+  }
+
+  if (packetinfo->payloadformat == SLPAYLOAD_MSEED2)
+  {
+    if (length < 48)
+      return -1;
+  }
+  else if (packetinfo->payloadformat == SLPAYLOAD_MSEED3)
+  {
+    if (length < MS3FSDH_LENGTH || length < (uint32_t)MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH (payload))
+      return -1;
+  }
+  else
+  {
+    return 1;
+  }
+
+  if (sl_payload_info (slconn->log, packetinfo, payload, length,
+                       sourceid, sizeof (sourceid), NULL, 0, NULL, NULL) == -1)
+  {
+    return 1;
+  }
+
+  /* Patterns match NET_STA_LOC_B_S_SS, without the FDSN: prefix */
+  if (strncmp (sourceid, "FDSN:", 5) == 0)
+    memmove (sourceid, sourceid + 5, strlen (sourceid + 5) + 1);
+
+  /* Streams removed since negotiation are still sent by the server */
+  if (slconn->removed && removed_station (slconn, sourceid))
+    return 0;
+
+  if (slconn->filter == NULL)
+    return 1;
+
+  /* Accepted if any include pattern matches, or there are none, and no exclude pattern matches */
+  for (pattern = slconn->filter; *pattern; pattern += strlen (pattern) + 1)
+  {
+    if (*pattern == '-')
+    {
+      if (sl_globmatch (sourceid, pattern + 1))
+        return 0;
+    }
+    else
+    {
+      if (accept != 1)
+        accept = (sl_globmatch (sourceid, pattern + 1)) ? 1 : 0;
+    }
+  }
+
+  return (accept == 0) ? 0 : 1;
+} /* End of filter_payload() */
+
+/***************************************************************************
+ * removed_station:
+ *
+ * Determine if the station of a source identifier, in the form of
+ * NET_STA_LOC_B_S_SS, matches a stream removed with sl_remove_stream()
+ * and no stream remaining in the stream list.
+ *
+ * Returns 1 if the station was removed, otherwise 0.
+ ***************************************************************************/
+static int
+removed_station (SLCD *slconn, const char *sourceid)
+{
+  SLstream *stream;
+  char stationid[SL_MAX_STATIONID];
+  const char *cp;
+  size_t count;
+
+  /* Extract NET_STA from NET_STA_LOC_B_S_SS */
+  if ((cp = strchr (sourceid, '_')) == NULL || (cp = strchr (cp + 1, '_')) == NULL)
+    return 0;
+
+  if ((count = cp - sourceid) >= sizeof (stationid))
+    return 0;
+
+  memcpy (stationid, sourceid, count);
+  stationid[count] = '\0';
+
+  for (stream = slconn->removed; stream; stream = stream->next)
+  {
+    if (sl_globmatch (stationid, stream->stationid))
+      break;
+  }
+
+  if (stream == NULL)
+    return 0;
+
+  for (stream = slconn->streams; stream; stream = stream->next)
+  {
+    if (sl_globmatch (stationid, stream->stationid))
+      return 0;
+  }
+
+  return 1;
+} /* End of removed_station() */
+
+/***************************************************************************
+ * free_streams:
+ *
+ * Free a stream list.
+ ***************************************************************************/
+static void
+free_streams (SLstream *stream)
+{
+  SLstream *nextstream;
+
+  while (stream != NULL)
+  {
+    nextstream = stream->next;
+
+    if (stream->selectors != NULL)
+      sl_free (stream->selectors);
+    sl_free (stream);
+
+    stream = nextstream;
+  }
+} /* End of free_streams() */
+
+/***************************************************************************
+ * rate_allowance:
+ *
+ * Determine how many bytes may be read from the server given the
+ * connection rate limit and the shared group rate limit, if engaged.
+ * When either token bucket is empty the time when reading may resume
+ * is set in ratelimit_time of the connection state, waiting at least
+ * 10 milliseconds to avoid many small reads.
+ *
+ * Returns the number of bytes that may be read, at most maxbytes.
+ ***************************************************************************/
+static uint32_t
+rate_allowance (SLCD *slconn, uint32_t maxbytes, int64_t current_time)
+{
+  SLratelimit *limits[2];
+  int64_t tokens;
+  int64_t wait;
+  int idx;
+
+  limits[0] = &slconn->ratelimit;
+  limits[1] = slconn->sharedlimit;
+
+  slconn->stat->ratelimit_time = 0;
+
+  for (idx = 0; idx < 2; idx++)
+  {
+    if (limits[idx] == NULL || limits[idx]->rate == 0)
+      continue;
+
+    tokens = rate_refill (limits[idx], current_time);
+
+    if (tokens <= 0)
+    {
+      wait = (1 - tokens) * SLTMODULUS / limits[idx]->rate;
+
+      if (wait < SLTMODULUS / 100)
+        wait = SLTMODULUS / 100;
+
+      if (current_time + wait > slconn->stat->ratelimit_time)
+        slconn->stat->ratelimit_time = current_time + wait;
+
+      maxbytes = 0;
+    }
+    else if (tokens < maxbytes)
+    {
+      maxbytes = (uint32_t)tokens;
+    }
+  }
+
+  return maxbytes;
+} /* End of rate_allowance() */
+
+/***************************************************************************
+ * rate_refill:
+ *
+ * Add tokens to a bucket for the time elapsed since the last refill,
+ * up to a burst of one second at the configured rate.  The refill time
+ * is only advanced by whole tokens so that slow rates are not lost to
+ * rounding when called frequently.
+ *
+ * Returns the number of tokens available, which may be negative.
+ ***************************************************************************/
+static int64_t
+rate_refill (SLratelimit *limit, int64_t current_time)
+{
+  int64_t elapsed;
+  int64_t added;
+
+  elapsed = current_time - limit->updated;
+
+  if (limit->updated == 0 || elapsed >= SL_EPOCH2SLTIME (2))
+  {
+    limit->tokens  = limit->rate;
+    limit->updated = current_time;
+  }
+  else if (elapsed > 0)
+  {
+    added = (int64_t)limit->rate * elapsed / SLTMODULUS;
+
+    if (added > 0)
+    {
+      limit->tokens += added;
+      limit->updated += added * SLTMODULUS / limit->rate;
+    }
+  }
+
+  if (limit->tokens > (int64_t)limit->rate)
+    limit->tokens = limit->rate;
+
+  return limit->tokens;
+} /* End of rate_refill() */
+
+/***************************************************************************
+ * transcode_payload:
+ *
+ * Transcode a complete miniSEED 2 payload in the payload buffer to
+ * miniSEED 3 and update the packet info.  The record is copied to the
+ * preallocated transcode buffer and rewritten into the payload buffer
+ * with sl_payload_ms2to3(), no memory is allocated.
+ *
+ * Returns:
+ * 0 : payload transcoded
+ * -1 : payload not transcoded and unchanged
+ ***************************************************************************/
+static int
+transcode_payload (SLCD *slconn, char *plbuffer, uint32_t plbuffersize)
+{
+  SLpacketinfo *packetinfo = &slconn->stat->packetinfo;
+  int length;
+
+  if (packetinfo->payloadlength > slconn->transcodesize)
+  {
+    sl_log_r (slconn, 1, 2, "[%s] %s(): record length %u exceeds transcode buffer, not transcoded\n",
+              slconn->sladdr, __func__, packetinfo->payloadlength);
+    return -1;
+  }
+
+  memcpy (slconn->transcodebuffer, plbuffer, packetinfo->payloadlength);
+
+  length = sl_payload_ms2to3 (slconn->log, slconn->transcodebuffer,
+                              packetinfo->payloadlength, plbuffer, plbuffersize);
+
+  if (length < 0)
+  {
+    sl_log_r (slconn, 1, 2, "[%s] %s(): record cannot be transcoded, returned as miniSEED 2\n",
+              slconn->sladdr, __func__);
+    return -1;
+  }
+
+  packetinfo->payloadformat    = SLPAYLOAD_MSEED3;
+  packetinfo->payloadlength    = (uint32_t)length;
+  packetinfo->payloadcollected = (uint32_t)length;
+
+  return 0;
+} /* End of transcode_payload() */
+
+#if defined(__linux__)
+/***************************************************************************
+ * splice_packet:
+ *
+ * Move a v4 miniSEED packet from the socket to the archive.  The
+ * SeedLink header, station ID and fixed header of the record are read
+ * with MSG_PEEK, only the SeedLink header and station ID are consumed
+ * and the payload is moved to the archive by sl_archive_splice().
+ *
+ * Must only be called when the receive buffer is empty and a header is
+ * expected.  If the packet cannot be moved, e.g. it is not miniSEED, the
+ * header is not valid or it is not completely available, nothing is
+ * consumed and the data is collected as usual, including END and ERROR
+ * responses and resynchronization.  If the payload cannot be archived after the header is
+ * consumed the state is set for payload collection.
+ *
+ * Returns:
+ * 1 : packet read from the socket and moved to archive, unless an
+ *     archive write error was logged
+ * 0 : packet not moved, continue with normal collection
+ * -1 : error, the socket failed while reading the payload
+ ***************************************************************************/
+static int
+splice_packet (SLCD *slconn)
+{
+  SLpacketinfo *packetinfo = &slconn->stat->packetinfo;
+  char peek[SLHEADSIZE_V4 + 255 + MS3FSDH_LENGTH + 255];
+  uint32_t headerlength = 0;
+  uint32_t needed       = SLHEADSIZE_V4;
+  ssize_t peeked        = 0;
+  int available         = 0;
+  int rv;
+
+  /* Peek at the SeedLink header, station ID and record header */
+  while ((uint32_t)peeked < needed)
+  {
+    peeked = recv (slconn->link, peek, needed, MSG_PEEK);
+
+    if (peeked < (ssize_t)needed)
+      return 0;
+
+    /* END, ERROR and unparseable data are left to normal collection */
+    if (memcmp (peek, SIGNATURE_V4, 2) != 0 ||
+        receive_header (slconn, (uint8_t *)peek, (uint32_t)peeked) < 0)
+      return 0;
+
+    if (packetinfo->payloadformat != SLPAYLOAD_MSEED2 &&
+        packetinfo->payloadformat != SLPAYLOAD_MSEED3)
+      return 0;
+
+    if (packetinfo->stationidlength == 0 ||
+        packetinfo->stationidlength > (sizeof (packetinfo->stationid) - 1))
+      return 0;
+
+    headerlength = SLHEADSIZE_V4 + packetinfo->stationidlength;
+
+    if (packetinfo->payloadformat == SLPAYLOAD_MSEED2)
+      needed = headerlength + 64;
+    else if ((uint32_t)peeked >= headerlength + MS3FSDH_LENGTH)
+      needed = headerlength + MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH (peek + headerlength);
+    else
+      needed = headerlength + MS3FSDH_LENGTH;
+
+    if (needed - headerlength > packetinfo->payloadlength)
+      return 0;
+  }
+
+  if (valid_header (slconn, (uint8_t *)peek, needed) != 1)
+    return 0;
+
+  memcpy (packetinfo->stationid, peek + SLHEADSIZE_V4, packetinfo->stationidlength);
+  packetinfo->stationid[packetinfo->stationidlength] = '\0';
+  packetinfo->payloadcollected = 0;
+
+  /* Packets rejected by the filter are skipped by normal collection */
+  if ((slconn->filter || slconn->removed) &&
+      filter_payload (slconn, peek + headerlength, needed - headerlength) != 1)
+    return 0;
+
+  /* Only move packets completely received, never wait for the payload */
+  if (ioctl (slconn->link, FIONREAD, &available) || available < 0 ||
+      (uint32_t)available < headerlength + packetinfo->payloadlength)
+    return 0;
+
+  /* Consume the SeedLink header and station ID */
+  if (recv (slconn->link, slconn->recvbuffer, headerlength, 0) != (ssize_t)headerlength)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): error consuming packet header\n",
+              slconn->sladdr, __func__);
+    return -1;
+  }
+
+  rv = sl_archive_splice (slconn->archive, slconn->log, packetinfo,
+                          peek + headerlength, needed - headerlength, slconn->link);
+
+  if (rv < 0)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): error moving payload to archive\n",
+              slconn->sladdr, __func__);
+    return -1;
+  }
+
+  /* Collect payload as usual if it could not be archived */
+  if (rv == 0)
+  {
+    slconn->stat->stream_state = PAYLOAD;
+    return 0;
+  }
+
+  packetinfo->payloadcollected = packetinfo->payloadlength;
+
+  slconn->stat->netto_time     = 0;
+  slconn->stat->keepalive_time = 0;
+
+  if (update_stream (slconn, peek + headerlength, needed - headerlength) == -1)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): cannot update stream tracking\n",
+              slconn->sladdr, __func__);
+    return -1;
+  }
+
+  return 1;
+} /* End of splice_packet() */
+#endif
+
 /**********************************************************************/ /**
  * @brief Initialize a new ::SLCD
  *
@@ -796,7 +2020,7 @@ sl_initslcd (const char *clientname, const char *clientversion)
 {
   SLCD *slconn;
 
-  slconn = (SLCD *)malloc (sizeof (SLCD));
+  slconn = (SLCD *)sl_malloc (sizeof (SLCD));
 
   if (slconn == NULL)
   {
@@ -821,11 +2045,35 @@ sl_initslcd (const char *clientname, const char *clientversion)
   slconn->auth_value    = NULL;
   slconn->auth_finish   = NULL;
   slconn->auth_data     = NULL;
+  slconn->gap_handler   = NULL;
+  slconn->gap_data      = NULL;
+  slconn->info_handler  = NULL;
+  slconn->info_data     = NULL;
+  slconn->lpcache       = NULL;
+  slconn->continuity    = NULL;
+  slconn->archive       = NULL;
+  slconn->relay         = NULL;
+  slconn->traffic       = NULL;
   slconn->streams       = NULL;
   slconn->info          = NULL;
   slconn->noblock       = 0;
   slconn->dialup        = 0;
   slconn->batchmode     = 0;
+  slconn->chunkmode     = 0;
+  slconn->splicemode    = 0;
+  slconn->resync        = 0;
+  slconn->ratelimit.rate    = 0;
+  slconn->ratelimit.tokens  = 0;
+  slconn->ratelimit.updated = 0;
+  slconn->arena         = NULL;
+  slconn->arenasize     = 0;
+  slconn->arenaused     = 0;
+  slconn->transcodebuffer = NULL;
+  slconn->transcodesize = 0;
+  slconn->inforeassembly = 0;
+  slconn->extdata       = NULL;
+  slconn->extdatalen    = 0;
+  slconn->extrecv       = 0;
   slconn->lastpkttime   = 1;
   slconn->terminate     = 0;
   slconn->resume        = 1;
@@ -836,14 +2084,22 @@ sl_initslcd (const char *clientname, const char *clientversion)
   slconn->server_protocols = 0;
   slconn->capabilities     = NULL;
   slconn->caparray         = NULL;
+  slconn->filter           = NULL;
+  slconn->removed          = NULL;
+  slconn->sharedlimit      = NULL;
+  slconn->infobuffer       = NULL;
+  slconn->infolength       = 0;
+  slconn->infosize         = 0;
+  slconn->infoready        = 0;
+  slconn->resyncmark       = 0;
   slconn->tls              = 0;
   slconn->tlsctx           = NULL;
 
   /* Allocate the associated persistent state struct */
-  if ((slconn->stat = (SLstat *)malloc (sizeof (SLstat))) == NULL)
+  if ((slconn->stat = (SLstat *)sl_malloc (sizeof (SLstat))) == NULL)
   {
     sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
-    free (slconn);
+    sl_free (slconn);
     return NULL;
   }
 
@@ -877,45 +2133,35 @@ sl_initslcd (const char *clientname, const char *clientversion)
 } /* End of sl_newslcd() */
 
 /**********************************************************************/ /**
- * @brief Free all memory associated with a ::SLCD
- *
- * Free all memory associated with a SLCD struct including the
- * associated stream list and persistent connection state.
- *
- * @param[in] slconn     SeedLink connection description to free
- ***************************************************************************/
-void
-sl_freeslcd (SLCD *slconn)
-{
-  SLstream *curstream;
-  SLstream *nextstream;
-
-  curstream = slconn->streams;
-
-  /* Traverse the stream list and free memory */
-  while (curstream != NULL)
-  {
-    nextstream = curstream->next;
-
-    if (curstream->selectors != NULL)
-      free (curstream->selectors);
-    free (curstream);
-
-    curstream = nextstream;
-  }
-
-  free (slconn->sladdr);
-  free (slconn->slhost);
-  free (slconn->slport);
-  free (slconn->start_time);
-  free (slconn->end_time);
-  free (slconn->capabilities);
-  free (slconn->caparray);
-  free (slconn->clientname);
-  free (slconn->clientversion);
-  free (slconn->stat);
-  free (slconn->log);
-  free (slconn);
+ * @brief Free all memory associated with a ::SLCD
+ *
+ * Free all memory associated with a SLCD struct including the
+ * associated stream list and persistent connection state.
+ *
+ * @param[in] slconn     SeedLink connection description to free
+ ***************************************************************************/
+void
+sl_freeslcd (SLCD *slconn)
+{
+  free_streams (slconn->streams);
+  free_streams (slconn->removed);
+
+  sl_free (slconn->sladdr);
+  sl_free (slconn->slhost);
+  sl_free (slconn->slport);
+  sl_free (slconn->start_time);
+  sl_free (slconn->end_time);
+  sl_free (slconn->capabilities);
+  sl_free (slconn->caparray);
+  sl_free (slconn->filter);
+  sl_free (slconn->infobuffer);
+  sl_free (slconn->clientname);
+  sl_free (slconn->clientversion);
+  sl_free (slconn->arena);
+  sl_free (slconn->transcodebuffer);
+  sl_free (slconn->stat);
+  sl_free (slconn->log);
+  sl_free (slconn);
 } /* End of sl_freeslcd() */
 
 /**********************************************************************/ /**
@@ -939,10 +2185,10 @@ sl_set_clientname (SLCD *slconn, const char *name, const char *version)
   if (!slconn || !name)
     return -1;
 
-  free (slconn->clientname);
-  free (slconn->clientversion);
+  sl_free (slconn->clientname);
+  sl_free (slconn->clientversion);
 
-  slconn->clientname = strdup (name);
+  slconn->clientname = sl_strdup (name);
 
   if (slconn->clientname == NULL)
   {
@@ -952,7 +2198,7 @@ sl_set_clientname (SLCD *slconn, const char *name, const char *version)
 
   if (version)
   {
-    slconn->clientversion = strdup (version);
+    slconn->clientversion = sl_strdup (version);
 
     if (slconn->clientversion == NULL)
     {
@@ -1077,127 +2323,613 @@ sl_set_serveraddress (SLCD *slconn, const char *server_address)
   /* Store the user-supplied address if not set directly */
   if (server_address != slconn->sladdr)
   {
-    free (slconn->sladdr);
-    slconn->sladdr = strdup (server_address);
+    sl_free (slconn->sladdr);
+    slconn->sladdr = sl_strdup (server_address);
+  }
+
+  sl_free (slconn->slhost);
+  sl_free (slconn->slport);
+
+  slconn->slhost = sl_strdup (host);
+  slconn->slport = sl_strdup (port);
+
+  if (slconn->sladdr == NULL ||
+      slconn->slhost == NULL ||
+      slconn->slport == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return -1;
+  }
+
+  /* Set TLS flag if port is the TLS default */
+  if (strcmp(slconn->slport, SL_SECURE_PORT) == 0)
+  {
+    sl_set_tlsmode (slconn, 1);
   }
 
-  free (slconn->slhost);
-  free (slconn->slport);
+  return 0;
+} /* End of sl_set_serveraddress() */
+
+/**********************************************************************/ /**
+ * @brief Set SeedLink connection time window (begin and end times)
+ *
+ * Set the connection time window limits.  This will trigger the
+ * connection to be negotiated with the \c TIME command for v3 connections
+ * and a time range to be included with the \c DATA command of v4 connections.
+ *
+ * No validation of the time strings is done, so the user must ensure that
+ * the target SeedLink server supports time string format supplied.  A
+ * relatively safe format is <code>yyyy-mm-ddTHH:MM:SS</code>.
+ *
+ * @param slconn      SeedLink connection description
+ * @param start_time  Starting time string in <code>yyyy-mm-ddTHH:MM:SS</code> format
+ * @param end_time    Ending time string in <code>yyyy-mm-ddTHH:MM:SS</code> format
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_set_timewindow (SLCD *slconn, const char *start_time, const char *end_time)
+{
+    if (!slconn || (!start_time && !end_time))
+        return -1;
+
+    sl_free (slconn->start_time);
+    sl_free (slconn->end_time);
+    slconn->start_time = NULL;
+    slconn->end_time = NULL;
+
+    if (start_time && (slconn->start_time = sl_strdup (start_time)) == NULL)
+    {
+        sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+        return -1;
+    }
+
+    if (end_time && (slconn->end_time = sl_strdup (end_time)) == NULL)
+    {
+        sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+        return -1;
+    }
+
+    return 0;
+} /* End of sl_set_timewindow() */
+
+/**********************************************************************/ /**
+ * @brief Set SeedLink connection authentication parameters (v4 only)
+ *
+ * Set the callback functions and callback data used for authentication
+ * of SeedLink connections.  This is only relevant for the v4 protocol.
+ *
+ * The \a auth_value callback is executed to retrieve the authentication
+ * value to be sent to the server.  This value is transmitted with the
+ * \c AUTH command for v4 connections.  The following values are specified
+ * by the v4 protocol:
+ * ```
+ * USERPASS <username> <password>
+ * ```
+ * and
+ * ```
+ * JWT <token>
+ * ```
+ *
+ * The \a auth_finish callback is executed when authentication is complete.
+ * This can be used to free memory or perform other cleanup tasks.
+ *
+ * The \a auth_data parameter is a pointer to caller-supplied data that
+ * is passed to the callback functions.
+ *
+ * There is no requirement that servers must support authentication, so
+ * the user must ensure that the target server supports authentication.
+ *
+ * @param slconn        SeedLink connection description
+ * @param auth_value    Callback executed to retrieve the authentication value
+ * @param auth_finish   Callback executed when authentication is complete
+ * @param auth_data     Caller-supplied data passed to the callback functions
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_set_auth_params (SLCD *slconn,
+                    const char *(*auth_value) (const char *server, void *auth_data),
+                    void (*auth_finish) (const char *server, void *auth_data),
+                    void *auth_data)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->auth_value  = auth_value;
+    slconn->auth_finish = auth_finish;
+    slconn->auth_data   = auth_data;
+
+    return 0;
+} /* End of sl_set_auth_params() */
+
+/**********************************************************************/ /**
+ * @brief Set a callback for sequence gaps detected in received data
+ *
+ * Gap detection assumes that the server numbers packets per station,
+ * i.e. each packet received is expected to have a sequence number one
+ * greater than the previous packet for the same station, as done by
+ * SeisComP seedlink.  When one or more sequence numbers are skipped the
+ * \a gap_handler callback is executed with the range of missing
+ * sequence numbers, inclusive.
+ *
+ * Servers that use a single sequence for all stations, e.g. ringserver,
+ * skip sequence numbers between the packets of each station and a gap
+ * would be reported for nearly every packet.  A gap handler must not
+ * be set for connections to such servers.
+ *
+ * Gaps are only tracked for stream list entries with a station ID
+ * that does not contain wildcards, i.e. a single station.  A gap
+ * may legitimately occur when the server no longer has the requested
+ * data, for example when resuming a connection after a long outage.
+ *
+ * The \a gap_data parameter is a pointer to caller-supplied data that
+ * is passed to the callback function.
+ *
+ * Gaps are only detected while a callback is set, and are then also
+ * logged at verbosity 1.
+ *
+ * @param slconn       SeedLink connection description
+ * @param gap_handler  Callback executed when a sequence gap is detected, NULL to disable
+ * @param gap_data     Caller-supplied data passed to the callback function
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_group_backfill()
+ ***************************************************************************/
+int
+sl_set_gap_handler (SLCD *slconn,
+                    void (*gap_handler) (SLCD *slconn, const char *stationid,
+                                         uint64_t firstseq, uint64_t lastseq,
+                                         void *gap_data),
+                    void *gap_data)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->gap_handler = gap_handler;
+    slconn->gap_data    = gap_data;
+
+    return 0;
+} /* End of sl_set_gap_handler() */
+
+/**********************************************************************/ /**
+ * @brief Set a last packet cache to be updated by a connection
+ *
+ * Each miniSEED packet returned by sl_collect() is added to the
+ * \a cache with sl_lpcache_update().  A cache may be shared by multiple
+ * connections, including connections collected from other threads.
+ *
+ * The cache is not owned by the connection and must be freed by the
+ * caller with sl_freelpcache() after the connection is detached or freed.
+ *
+ * @param slconn  SeedLink connection description
+ * @param cache   Last packet cache to update, NULL to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_initlpcache()
+ ***************************************************************************/
+int
+sl_set_lpcache (SLCD *slconn, SLlpcache *cache)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->lpcache = cache;
+
+    return 0;
+} /* End of sl_set_lpcache() */
+
+/**********************************************************************/ /**
+ * @brief Set a continuity index to be updated by a connection
+ *
+ * Each miniSEED packet returned by sl_collect() is added to the
+ * continuity index with sl_continuity_add().  An index may be shared
+ * by multiple connections collected from the same thread.
+ *
+ * The index is not owned by the connection and must be freed by the
+ * caller with sl_freeslcontinuity() after the connection is detached
+ * or freed.
+ *
+ * @param slconn  SeedLink connection description
+ * @param cont    Continuity index to update, NULL to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_initslcontinuity()
+ ***************************************************************************/
+int
+sl_set_continuity (SLCD *slconn, SLcontinuity *cont)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->continuity = cont;
+
+    return 0;
+} /* End of sl_set_continuity() */
+
+/**********************************************************************/ /**
+ * @brief Set an archive writer to be updated by a connection
+ *
+ * Each miniSEED packet returned by sl_collect() is written to the
+ * archive with sl_archive_write().  An archive may be shared by
+ * multiple connections collected from the same thread.
+ *
+ * The archive is not owned by the connection and must be freed by the
+ * caller with sl_freeslarchive() after the connection is detached or
+ * freed.
+ *
+ * @param slconn   SeedLink connection description
+ * @param archive  Archive writer to update, NULL to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_initslarchive()
+ ***************************************************************************/
+int
+sl_set_archive (SLCD *slconn, SLarchive *archive)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->archive = archive;
+
+    return 0;
+} /* End of sl_set_archive() */
+
+/**********************************************************************/ /**
+ * @brief Set a relay to be updated by a connection
+ *
+ * Each packet returned by sl_collect(), except INFO responses, is
+ * added to the relay with sl_relay_add().  A relay may be shared by
+ * multiple connections collected from the same thread, clients are
+ * served by calling sl_relay_service() from that thread.
+ *
+ * The relay is not owned by the connection and must be freed by the
+ * caller with sl_freeslrelay() after the connection is detached or
+ * freed.
+ *
+ * @param slconn  SeedLink connection description
+ * @param relay   Relay to update, NULL to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_initslrelay()
+ ***************************************************************************/
+int
+sl_set_relay (SLCD *slconn, SLrelay *relay)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->relay = relay;
+
+    return 0;
+} /* End of sl_set_relay() */
+
+/**********************************************************************/ /**
+ * @brief Set traffic accounting to be updated by a connection
+ *
+ * Each packet received by the connection, except INFO responses, is
+ * counted in \a traffic with sl_traffic_add() by station ID and FDSN
+ * source identifier.  This includes packets rejected by client-side
+ * filtering and packets spliced to an archive.  Traffic accounting
+ * may be shared by multiple connections, including connections
+ * collected from different threads.
+ *
+ * The traffic accounting is not owned by the connection and must be
+ * freed by the caller with sl_freesltraffic() after the connection is
+ * detached or freed.
+ *
+ * @param slconn   SeedLink connection description
+ * @param traffic  Traffic accounting to update, NULL to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_initsltraffic()
+ ***************************************************************************/
+int
+sl_set_traffic (SLCD *slconn, SLtraffic *traffic)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->traffic = traffic;
+
+    return 0;
+} /* End of sl_set_traffic() */
+
+/**********************************************************************/ /**
+ * @brief Set or unset splice mode for archiving
+ *
+ * In splice mode, miniSEED payloads received on plain TCP connections
+ * using protocol v4 are moved from the socket to the archive set with
+ * sl_set_archive() using splice(), without copying the payload data
+ * to user space.  Only the SeedLink header, station ID and the fixed
+ * header of each record are read by the library to route the record.
+ *
+ * Payloads moved to the archive are only seen by the archive and the
+ * stream and traffic tracking, they are bypassed by every other
+ * consumer of collected packets:
+ *  - Not returned by sl_collect(), sl_group_collect() or
+ *    sl_dispatch_collect(), so callers never see the payload, e.g. to
+ *    add samples to rings with sl_rings_add().
+ *  - Not added to the last packet cache set with sl_set_lpcache().
+ *  - Not added to the continuity index set with sl_set_continuity().
+ *  - Not added to the relay set with sl_set_relay().
+ *
+ * Splice mode is not used while transcoding is enabled with
+ * sl_set_transcode(), records are then archived after transcoding.
+ * Other payloads, packets received while data remains in the receive
+ * buffer, packets not yet completely received and packets rejected by
+ * a filter are handled as usual, so collection never waits for a
+ * payload to be moved.
+ *
+ * Splice mode is only supported on Linux.  By default, splice mode is
+ * disabled.
+ *
+ * @param slconn      SeedLink connection description
+ * @param splicemode  Boolean flag, if non-zero enable splice mode
+ *
+ * @retval  0 : success
+ * @retval -1 : error or not supported on this platform
+ ***************************************************************************/
+int
+sl_set_splicemode (SLCD *slconn, int splicemode)
+{
+    if (!slconn)
+        return -1;
+
+#if !defined(__linux__)
+    if (splicemode)
+    {
+        sl_log_r (slconn, 2, 0, "%s(): splice mode is not supported on this platform\n", __func__);
+        return -1;
+    }
+#endif
+
+    slconn->splicemode = (splicemode) ? 1 : 0;
+
+    return 0;
+} /* End of sl_set_splicemode() */
+
+/**********************************************************************/ /**
+ * @brief Set the size of the negotiation arena of a connection
+ *
+ * Temporary memory used during protocol negotiation, e.g. the list of
+ * commands for each station, is allocated from a per-connection arena
+ * of \a size bytes that is reset after each negotiation instead of
+ * being allocated and released individually.  Allocations that do not
+ * fit in the arena use the library allocator.
+ *
+ * The arena itself is allocated with sl_malloc() and released by
+ * sl_freeslcd().  By default, no arena is used.
+ *
+ * @param slconn  SeedLink connection description
+ * @param size    Size of arena in bytes, 0 to disable
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_set_allocator()
+ ***************************************************************************/
+int
+sl_set_arena (SLCD *slconn, uint32_t size)
+{
+    char *arena = NULL;
+
+    if (!slconn)
+        return -1;
 
-  slconn->slhost = strdup (host);
-  slconn->slport = strdup (port);
+    if (size > 0 && (arena = (char *)sl_malloc (size)) == NULL)
+    {
+        sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+        return -1;
+    }
 
-  if (slconn->sladdr == NULL ||
-      slconn->slhost == NULL ||
-      slconn->slport == NULL)
-  {
-    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
-    return -1;
-  }
+    sl_free (slconn->arena);
 
-  /* Set TLS flag if port is the TLS default */
-  if (strcmp(slconn->slport, SL_SECURE_PORT) == 0)
-  {
-    sl_set_tlsmode (slconn, 1);
-  }
+    slconn->arena     = arena;
+    slconn->arenasize = size;
+    slconn->arenaused = 0;
 
-  return 0;
-} /* End of sl_set_serveraddress() */
+    return 0;
+} /* End of sl_set_arena() */
 
 /**********************************************************************/ /**
- * @brief Set SeedLink connection time window (begin and end times)
+ * @brief Set transcoding of miniSEED 2 payloads to miniSEED 3
  *
- * Set the connection time window limits.  This will trigger the
- * connection to be negotiated with the \c TIME command for v3 connections
- * and a time range to be included with the \c DATA command of v4 connections.
+ * When enabled, each complete miniSEED 2 payload is rewritten as
+ * miniSEED 3 with sl_payload_ms2to3() before it is returned by
+ * sl_collect() and before the last packet cache, continuity index,
+ * archive and relay are updated.  The packet info describes the
+ * transcoded payload.
  *
- * No validation of the time strings is done, so the user must ensure that
- * the target SeedLink server supports time string format supplied.  A
- * relatively safe format is <code>yyyy-mm-ddTHH:MM:SS</code>.
+ * A buffer of \a maxrecordlength bytes is allocated with sl_malloc()
+ * and used for all records, no memory is allocated per record.
+ * Records longer than \a maxrecordlength, records that cannot be
+ * transcoded, e.g. without blockette 1000, and records for which the
+ * payload buffer passed to sl_collect() is too small for the miniSEED 3
+ * record are returned unchanged as miniSEED 2.  The buffer is released
+ * by sl_freeslcd().  By default, payloads are not transcoded.
  *
- * @param slconn      SeedLink connection description
- * @param start_time  Starting time string in <code>yyyy-mm-ddTHH:MM:SS</code> format
- * @param end_time    Ending time string in <code>yyyy-mm-ddTHH:MM:SS</code> format
+ * @param slconn           SeedLink connection description
+ * @param maxrecordlength  Maximum miniSEED 2 record length to transcode, 0 to disable
  *
  * @retval  0 : success
  * @retval -1 : error
+ *
+ * @sa sl_payload_ms2to3()
  ***************************************************************************/
 int
-sl_set_timewindow (SLCD *slconn, const char *start_time, const char *end_time)
+sl_set_transcode (SLCD *slconn, uint32_t maxrecordlength)
 {
-    if (!slconn || (!start_time && !end_time))
-        return -1;
-
-    free (slconn->start_time);
-    free (slconn->end_time);
-    slconn->start_time = NULL;
-    slconn->end_time = NULL;
+    char *buffer = NULL;
 
-    if (start_time && (slconn->start_time = strdup (start_time)) == NULL)
-    {
-        sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    if (!slconn)
         return -1;
-    }
 
-    if (end_time && (slconn->end_time = strdup (end_time)) == NULL)
+    if (maxrecordlength > 0 && (buffer = (char *)sl_malloc (maxrecordlength)) == NULL)
     {
-        sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+        sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
         return -1;
     }
 
+    sl_free (slconn->transcodebuffer);
+
+    slconn->transcodebuffer = buffer;
+    slconn->transcodesize   = maxrecordlength;
+
     return 0;
-} /* End of sl_set_timewindow() */
+} /* End of sl_set_transcode() */
 
 /**********************************************************************/ /**
- * @brief Set SeedLink connection authentication parameters (v4 only)
+ * @brief Set a client-side filter for received miniSEED packets
  *
- * Set the callback functions and callback data used for authentication
- * of SeedLink connections.  This is only relevant for the v4 protocol.
+ * Packets are filtered by matching their FDSN Source Identifier
+ * against a list of glob patterns, separated by spaces or commas.
+ * The filter is evaluated on the fixed header as soon as it is
+ * received, and rejected packets are skipped in the receive buffer
+ * without being copied or returned.  Stream tracking, e.g. sequence
+ * numbers, is still updated for rejected packets.
  *
- * The \a auth_value callback is executed to retrieve the authentication
- * value to be sent to the server.  This value is transmitted with the
- * \c AUTH command for v4 connections.  The following values are specified
- * by the v4 protocol:
- * ```
- * USERPASS <username> <password>
- * ```
- * and
- * ```
- * JWT <token>
- * ```
+ * This is useful when servers do not fully support the requested
+ * selectors.
  *
- * The \a auth_finish callback is executed when authentication is complete.
- * This can be used to free memory or perform other cleanup tasks.
+ * Patterns may be any of the following forms:
+ * - `NET_STA_LOC_B_S_SS`, the source identifier without the
+ *   `FDSN:` prefix, which is also allowed
+ * - `LOC_B_S_SS`, a v4 stream ID matching any station
+ * - `[LL]CCC`, a v3 style selector matching any station, converted
+ *   with sl_v3to4selector()
  *
- * The \a auth_data parameter is a pointer to caller-supplied data that
- * is passed to the callback functions.
+ * Patterns prefixed with `!` exclude matching packets.  A packet is
+ * accepted when it matches any include pattern, or there are only
+ * exclude patterns, and does not match any exclude pattern.
  *
- * There is no requirement that servers must support authentication, so
- * the user must ensure that the target server supports authentication.
+ * For example, `"*_B_H_? !XX_*"` accepts all BH channels except for
+ * the XX network.
  *
- * @param slconn        SeedLink connection description
- * @param auth_value    Callback executed to retrieve the authentication value
- * @param auth_finish   Callback executed when authentication is complete
- * @param auth_data     Caller-supplied data passed to the callback functions
+ * Payloads that are not miniSEED are never filtered.
+ *
+ * @param slconn    SeedLink connection description
+ * @param patterns  List of patterns, NULL to remove filter
  *
  * @retval  0 : success
  * @retval -1 : error
  ***************************************************************************/
 int
-sl_set_auth_params (SLCD *slconn,
-                    const char *(*auth_value) (const char *server, void *auth_data),
-                    void (*auth_finish) (const char *server, void *auth_data),
-                    void *auth_data)
+sl_set_filter (SLCD *slconn, const char *patterns)
 {
-    if (!slconn)
-        return -1;
+  char pattern[64];
+  char converted[64];
+  char *filter = NULL;
+  char *newfilter;
+  const char *cp;
+  const char *normalized;
+  size_t filterlength = 0;
+  size_t length;
+  size_t underscores;
+  size_t idx;
+  int exclude;
 
-    slconn->auth_value  = auth_value;
-    slconn->auth_finish = auth_finish;
-    slconn->auth_data   = auth_data;
+  if (!slconn)
+    return -1;
 
+  sl_free (slconn->filter);
+  slconn->filter = NULL;
+
+  if (!patterns)
     return 0;
-} /* End of sl_set_auth_params() */
+
+  cp = patterns;
+  while (*cp)
+  {
+    /* Skip separators */
+    if (*cp == ' ' || *cp == ',' || *cp == '\t')
+    {
+      cp++;
+      continue;
+    }
+
+    length = strcspn (cp, " ,\t");
+
+    if (length >= sizeof (pattern))
+    {
+      sl_log_r (slconn, 2, 0, "[%s] %s(): filter pattern too long: '%.*s'\n",
+                slconn->sladdr, __func__, (int)length, cp);
+      sl_free (filter);
+      return -1;
+    }
+
+    memcpy (pattern, cp, length);
+    pattern[length] = '\0';
+    cp += length;
+
+    exclude    = (pattern[0] == '!') ? 1 : 0;
+    normalized = pattern + exclude;
+
+    if (strncmp (normalized, "FDSN:", 5) == 0)
+      normalized += 5;
+
+    for (idx = 0, underscores = 0; normalized[idx]; idx++)
+    {
+      if (normalized[idx] == '_')
+        underscores++;
+    }
+
+    /* v3 selector, convert to v4 stream ID */
+    if (underscores == 0 && strcmp (normalized, "*") != 0)
+    {
+      if (sl_v3to4selector (converted + 4, sizeof (converted) - 4, normalized) == NULL)
+      {
+        sl_log_r (slconn, 2, 0, "[%s] %s(): cannot convert filter pattern: '%s'\n",
+                  slconn->sladdr, __func__, pattern);
+        sl_free (filter);
+        return -1;
+      }
+
+      memcpy (converted, "*_*_", 4);
+      normalized = converted;
+    }
+    /* v4 stream ID, match any station */
+    else if (underscores == 3)
+    {
+      snprintf (converted, sizeof (converted), "*_*_%s", normalized);
+      normalized = converted;
+    }
+
+    /* Add pattern, prefixed with + or -, to NUL-separated list */
+    length = strlen (normalized) + 2;
+
+    if ((newfilter = (char *)sl_realloc (filter, filterlength + length + 1)) == NULL)
+    {
+      sl_log_r (slconn, 2, 0, "%s(): error allocating memory\n", __func__);
+      sl_free (filter);
+      return -1;
+    }
+
+    filter = newfilter;
+    filter[filterlength] = (exclude) ? '-' : '+';
+    strcpy (filter + filterlength + 1, normalized);
+    filterlength += length;
+    filter[filterlength] = '\0';
+  }
+
+  slconn->filter = filter;
+
+  return 0;
+} /* End of sl_set_filter() */
 
 /**********************************************************************/ /**
  * @brief Set SeedLink connection keep alive interval in seconds
@@ -1355,6 +3087,197 @@ sl_set_dialupmode (SLCD *slconn, int dialup)
     return 0;
 } /* End of sl_set_dialupmode() */
 
+/**********************************************************************/ /**
+ * @brief Set chunked delivery mode for large payloads
+ *
+ * In chunked mode, payloads other than miniSEED that are larger than
+ * the buffer provided to sl_collect() are returned in segments as
+ * they arrive, with a status of ::SLCHUNK, instead of returning
+ * ::SLTOOLARGE.  This allows large responses, e.g. JSON INFO responses,
+ * to be processed incrementally without a buffer sized for the
+ * largest response.
+ *
+ * Each segment is copied to the start of the payload buffer and
+ * described by the \a chunkoffset, \a chunklength and \a chunkfinal
+ * fields of the connection's ::SLstat.  Stream tracking is updated when the
+ * final segment is returned.
+ *
+ * miniSEED payloads are never returned in segments.
+ *
+ * By default, chunked mode is disabled.
+ *
+ * @param slconn     SeedLink connection description
+ * @param chunkmode  Boolean flag, if non-zero enable chunked mode
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_set_chunkmode (SLCD *slconn, int chunkmode)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->chunkmode = (chunkmode) ? 1 : 0;
+
+    return 0;
+} /* End of sl_set_chunkmode() */
+
+/**********************************************************************/ /**
+ * @brief Set resynchronization on unparseable data
+ *
+ * By default, unparseable data received from the server, e.g. an
+ * unexpected header signature or a v3 header not followed by a
+ * miniSEED record, terminates the connection.  Data is then fetched
+ * again after reconnecting.
+ *
+ * In resync mode, each header is validated, including the fixed
+ * header of miniSEED payloads, before it is read.  When unparseable
+ * data is found the stream is scanned forward for the next valid
+ * header and streaming continues from there.  The number of
+ * resynchronizations and bytes skipped are counted in the
+ * \a resync_count and \a resync_bytes fields of ::SLstat.
+ *
+ * Packets that were corrupted are lost, gaps are reported by the
+ * sequence gap handler if set with sl_set_gap_handler().
+ *
+ * By default, resync mode is disabled.
+ *
+ * @param slconn  SeedLink connection description
+ * @param resync  Boolean flag to enable resync mode
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_set_resync (SLCD *slconn, int resync)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->resync = (resync) ? 1 : 0;
+
+    return 0;
+} /* End of sl_set_resync() */
+
+/**********************************************************************/ /**
+ * @brief Set the receive rate limit of a connection
+ *
+ * Limit the rate at which data is read from the server to \a rate
+ * bytes per second, allowing bursts of up to one second of data.  The
+ * limit is applied with a token bucket in the read path of
+ * sl_collect(): when no tokens are available the socket is not read,
+ * the kernel receive buffer fills and TCP flow control slows the
+ * server.  This is useful to keep backfilling, e.g. with
+ * sl_set_timewindow() or ::SL_ALLDATASEQUENCE, from saturating a link
+ * shared with real-time connections.
+ *
+ * While throttled in non-blocking mode sl_collect() returns
+ * ::SLNOPACKET, in blocking mode it sleeps until data may be read.
+ * The limit may be changed at any time, including while collecting.
+ * Payloads are not spliced to an archive while a limit is set.
+ *
+ * By default, the rate is not limited.  A group-wide limit can be
+ * set with sl_group_set_ratelimit().
+ *
+ * @param slconn  SeedLink connection description
+ * @param rate    Maximum bytes per second, 0 to disable the limit
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_set_ratelimit (SLCD *slconn, uint32_t rate)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->ratelimit.rate = rate;
+
+    if (slconn->ratelimit.tokens > (int64_t)rate)
+        slconn->ratelimit.tokens = rate;
+
+    return 0;
+} /* End of sl_set_ratelimit() */
+
+/**********************************************************************/ /**
+ * @brief Set reassembly of v3 INFO responses
+ *
+ * SeedLink v3 INFO responses are sent as a series of miniSEED 2
+ * records containing XML text, by default each record is returned
+ * individually by sl_collect() as ::SLPAYLOAD_MSEED2INFO records
+ * followed by a final ::SLPAYLOAD_MSEED2INFOTERM record.
+ *
+ * When reassembly is enabled the XML text of each record is
+ * collected internally and the complete document is returned once
+ * as a ::SLPAYLOAD_XML payload with subformat ::SLPAYLOAD_XML_INFO.
+ * If the document is larger than the payload buffer ::SLTOOLARGE is
+ * returned, the caller may reallocate the buffer and the document is
+ * returned on the next call.
+ *
+ * The internal buffer grows as needed and is retained for subsequent
+ * responses.
+ *
+ * @param slconn      SeedLink connection description
+ * @param reassemble  Boolean flag, if non-zero enable reassembly
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_set_info_handler()
+ ***************************************************************************/
+int
+sl_set_inforeassembly (SLCD *slconn, int reassemble)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->inforeassembly = (reassemble) ? 1 : 0;
+
+    return 0;
+} /* End of sl_set_inforeassembly() */
+
+/**********************************************************************/ /**
+ * @brief Set a callback for incremental v3 INFO response processing
+ *
+ * When set, the XML text from each record of a v3 INFO response is
+ * passed to the \a info_handler callback as it is received, instead
+ * of the records being returned by sl_collect().  The \a final flag
+ * is set for the last fragment of the response.  This allows large
+ * responses to be processed incrementally, e.g. with a streaming XML
+ * parser, without holding the entire document.
+ *
+ * The \a xml fragment is not NUL terminated and is only valid during
+ * the callback.
+ *
+ * The \a info_data parameter is a pointer to caller-supplied data that
+ * is passed to the callback function.
+ *
+ * @param slconn        SeedLink connection description
+ * @param info_handler  Callback for INFO response fragments, NULL to disable
+ * @param info_data     Caller-supplied data passed to the callback function
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ *
+ * @sa sl_set_inforeassembly()
+ ***************************************************************************/
+int
+sl_set_info_handler (SLCD *slconn,
+                     void (*info_handler) (SLCD *slconn, const char *xml,
+                                           uint32_t length, int final,
+                                           void *info_data),
+                     void *info_data)
+{
+    if (!slconn)
+        return -1;
+
+    slconn->info_handler = info_handler;
+    slconn->info_data    = info_data;
+
+    return 0;
+} /* End of sl_set_info_handler() */
+
 /**********************************************************************/ /**
  * @brief Set or unset the SeedLink connection batch mode (v3 only)
  *
@@ -1460,7 +3383,7 @@ sl_add_stream (SLCD *slconn, const char *stationid,
     }
   }
 
-  newstream = (SLstream *)malloc (sizeof (SLstream));
+  newstream = (SLstream *)sl_malloc (sizeof (SLstream));
 
   if (newstream == NULL)
   {
@@ -1471,7 +3394,7 @@ sl_add_stream (SLCD *slconn, const char *stationid,
   strncpy (newstream->stationid, stationid, sizeof (newstream->stationid) - 1);
 
   if (selectors)
-    newstream->selectors = strdup (selectors);
+    newstream->selectors = sl_strdup (selectors);
   else
     newstream->selectors = NULL;
 
@@ -1545,6 +3468,91 @@ sl_add_stream (SLCD *slconn, const char *stationid,
   return 0;
 } /* End of sl_add_stream() */
 
+/**********************************************************************/ /**
+ * @brief Remove a stream from the stream list of a connection
+ *
+ * Remove all entries with the station ID \a stationid from the stream
+ * list, the match is exact and wildcards are not expanded.
+ *
+ * If the connection is active the server continues to send data for
+ * the removed stations until the connection is re-established, so
+ * packets for them are filtered client-side and skipped without being
+ * copied.  The remaining stations are not renegotiated and receive no
+ * interruption.  Packets matching both a removed and a remaining entry,
+ * e.g. a wildcard, are not filtered.  The removed streams are dropped
+ * from negotiation the next time the connection is configured.
+ *
+ * The last entry in the stream list, and the all-station mode entry,
+ * cannot be removed.
+ *
+ * @param[in] slconn     SeedLink connection description
+ * @param[in] stationid  Station ID of entries to remove
+ *
+ * @retval  0 : success
+ * @retval -1 : error or no matching entries
+ *
+ * @sa sl_add_stream(), sl_group_add_stream()
+ ***************************************************************************/
+int
+sl_remove_stream (SLCD *slconn, const char *stationid)
+{
+  SLstream **link;
+  SLstream *stream;
+  int remaining = 0;
+  int removed = 0;
+
+  if (!slconn || !stationid)
+    return -1;
+
+  for (stream = slconn->streams; stream; stream = stream->next)
+  {
+    if (strcmp (stream->stationid, stationid) == 0)
+      removed++;
+    else
+      remaining++;
+  }
+
+  if (removed == 0)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): no stream list entry for %s\n",
+              slconn->sladdr, __func__, stationid);
+    return -1;
+  }
+
+  if (remaining == 0 || slconn->multistation == 0)
+  {
+    sl_log_r (slconn, 2, 0, "[%s] %s(): cannot remove last stream list entry %s\n",
+              slconn->sladdr, __func__, stationid);
+    return -1;
+  }
+
+  link = &slconn->streams;
+  while ((stream = *link) != NULL)
+  {
+    if (strcmp (stream->stationid, stationid) != 0)
+    {
+      link = &stream->next;
+      continue;
+    }
+
+    *link = stream->next;
+
+    /* Filter until renegotiation if streaming, otherwise never requested */
+    if (slconn->link != -1 && slconn->stat->conn_state != DOWN)
+    {
+      stream->next    = slconn->removed;
+      slconn->removed = stream;
+    }
+    else
+    {
+      stream->next = NULL;
+      free_streams (stream);
+    }
+  }
+
+  return 0;
+} /* End of sl_remove_stream() */
+
 /**********************************************************************/ /**
  * @brief Set the parameters for an all-station mode connection
  *
@@ -1577,7 +3585,7 @@ sl_set_allstation_params (SLCD *slconn, const char *selectors,
 
   if (newstream == NULL)
   {
-    newstream = (SLstream *)malloc (sizeof (SLstream));
+    newstream = (SLstream *)sl_malloc (sizeof (SLstream));
 
     if (newstream == NULL)
     {
@@ -1596,7 +3604,7 @@ sl_set_allstation_params (SLCD *slconn, const char *selectors,
   strncpy (newstream->stationid, "*", sizeof (newstream->stationid));
 
   if (selectors)
-    newstream->selectors = strdup (selectors);
+    newstream->selectors = sl_strdup (selectors);
   else
     newstream->selectors = NULL;
 
@@ -1615,7 +3623,7 @@ sl_set_allstation_params (SLCD *slconn, const char *selectors,
     {
       sl_log_r (slconn, 2, 0, "%s(): could not convert timestamp for all-station mode: '%s'\n",
                 __func__, newstream->timestamp);
-      free (newstream);
+      sl_free (newstream);
       return -1;
     }
   }
@@ -1651,7 +3659,7 @@ sl_request_info (SLCD *slconn, const char *infostr)
   }
   else
   {
-    slconn->info = strdup(infostr);
+    slconn->info = sl_strdup(infostr);
     return 0;
   }
 } /* End of sl_request_info() */
@@ -1690,7 +3698,7 @@ sl_hascapability (SLCD *slconn, char *capability)
   if (slconn->caparray == NULL)
   {
     /* Copy and replace spaces with terminating NULLs */
-    slconn->caparray = strdup(slconn->capabilities);
+    slconn->caparray = sl_strdup(slconn->capabilities);
 
     for (idx = 0; idx < length; idx++)
     {
@@ -0,0 +1,136 @@
+/***************************************************************************
+ * test-continuity.c
+ *
+ * Tests of gap accounting of the continuity index, in particular for
+ * segments added after history has been compacted.
+ ***************************************************************************/
+
+#include "testutils.h"
+
+#define SOURCEID "FDSN:XX_TEST__B_H_Z"
+#define SECOND 1000000000LL
+
+/***************************************************************************
+ * add_record:
+ *
+ * Add a 1 sample per second record of \a samples starting at \a second
+ * of the test day to \a cont.
+ *
+ * Returns the result of sl_continuity_add().
+ ***************************************************************************/
+static int
+add_record (SLcontinuity *cont, int second, uint32_t samples)
+{
+  SLpacketinfo packetinfo;
+  char record[256];
+  double samplerate = 1.0;
+
+  memset (&packetinfo, 0, sizeof (packetinfo));
+  packetinfo.payloadformat = SLPAYLOAD_MSEED3;
+  packetinfo.payloadlength = test_ms3record (record, SOURCEID, 2026, 100);
+
+  record[12] = (char)(second / 3600);
+  record[13] = (char)(second / 60 % 60);
+  record[14] = (char)(second % 60);
+  memcpy (record + 16, &samplerate, 8);
+  memcpy (record + 24, &samples, 4);
+
+  return sl_continuity_add (cont, NULL, &packetinfo, record);
+} /* End of add_record() */
+
+/***************************************************************************
+ * compact_before:
+ *
+ * Compact history of \a cont before \a second of the test day.
+ *
+ * Returns the result of sl_continuity_compact().
+ ***************************************************************************/
+static int64_t
+compact_before (SLcontinuity *cont, int second)
+{
+  return sl_continuity_compact (cont, sl_time2nstime (2026, 100, 0, 0, 0, 0) +
+                                          second * SECOND);
+} /* End of compact_before() */
+
+/* A segment after a gap following completely compacted history is a gap */
+static void
+test_after_compacted (void)
+{
+  SLcontinuitystats stats;
+  SLcontinuity *cont;
+
+  CHECK ((cont = sl_initslcontinuity (100)) != NULL);
+  if (!cont)
+    return;
+
+  CHECK (add_record (cont, 0, 10) == 1);
+  CHECK (add_record (cont, 20, 10) == 1);
+  CHECK (compact_before (cont, 35) == 2);
+
+  CHECK (add_record (cont, 40, 10) == 1);
+  CHECK (sl_continuity_stats (cont, SOURCEID, &stats) == 1);
+  CHECK (stats.segmentcount == 1);
+  CHECK (stats.gaps == 2);
+  CHECK (stats.gaptime == 20 * SECOND);
+
+  /* Contiguous with compacted history is not a gap */
+  CHECK (compact_before (cont, 55) == 1);
+  CHECK (add_record (cont, 50, 10) == 1);
+  CHECK (sl_continuity_stats (cont, SOURCEID, &stats) == 1);
+  CHECK (stats.gaps == 2);
+  CHECK (stats.gaptime == 20 * SECOND);
+
+  sl_freeslcontinuity (cont);
+} /* End of test_after_compacted() */
+
+/* A segment between compacted history and retained segments splits the gap */
+static void
+test_before_retained (void)
+{
+  SLcontinuitystats stats;
+  SLcontinuity *cont;
+
+  CHECK ((cont = sl_initslcontinuity (100)) != NULL);
+  if (!cont)
+    return;
+
+  CHECK (add_record (cont, 0, 10) == 1);
+  CHECK (add_record (cont, 20, 10) == 1);
+  CHECK (add_record (cont, 60, 10) == 1);
+  CHECK (compact_before (cont, 35) == 2);
+
+  CHECK (add_record (cont, 40, 10) == 1);
+  CHECK (sl_continuity_stats (cont, SOURCEID, &stats) == 1);
+  CHECK (stats.segmentcount == 2);
+  CHECK (stats.gaps == 3);
+  CHECK (stats.gaptime == 30 * SECOND);
+
+  sl_freeslcontinuity (cont);
+
+  /* A segment contiguous with compacted history shortens the gap */
+  CHECK ((cont = sl_initslcontinuity (100)) != NULL);
+  if (!cont)
+    return;
+
+  CHECK (add_record (cont, 0, 10) == 1);
+  CHECK (add_record (cont, 20, 10) == 1);
+  CHECK (add_record (cont, 60, 10) == 1);
+  CHECK (compact_before (cont, 35) == 2);
+
+  CHECK (add_record (cont, 30, 10) == 1);
+  CHECK (sl_continuity_stats (cont, SOURCEID, &stats) == 1);
+  CHECK (stats.segmentcount == 2);
+  CHECK (stats.gaps == 2);
+  CHECK (stats.gaptime == 30 * SECOND);
+
+  sl_freeslcontinuity (cont);
+} /* End of test_before_retained() */
+
+int
+main (void)
+{
+  test_after_compacted ();
+  test_before_retained ();
+
+  return TEST_RESULT ("test-continuity");
+}
@@ -0,0 +1,140 @@
+/***************************************************************************
+ * test-samplering.c
+ *
+ * Tests of source identifier lookup of sample rings and of windows of
+ * rings while their first samples are added.
+ ***************************************************************************/
+
+#include <pthread.h>
+
+#include "testutils.h"
+#include "slatomic.h"
+
+#define SOURCES 2000
+#define SAMPLES 100
+
+static SLrings *rings;
+static volatile int added = -1;
+
+/***************************************************************************
+ * add_record:
+ *
+ * Add a 1 sample per second record of INT32 samples for \a sid to the
+ * rings.
+ *
+ * Returns the result of sl_rings_add().
+ ***************************************************************************/
+static int64_t
+add_record (const char *sid)
+{
+  SLpacketinfo packetinfo;
+  char record[512];
+  double samplerate    = 1.0;
+  uint32_t samplecount = SAMPLES;
+  uint32_t datalength  = SAMPLES * 4;
+  uint32_t length;
+
+  length = test_ms3record (record, sid, 2026, 100);
+
+  record[15] = 3;
+  memcpy (record + 16, &samplerate, 8);
+  memcpy (record + 24, &samplecount, 4);
+  memcpy (record + 36, &datalength, 4);
+  memset (record + length, 0, datalength);
+
+  memset (&packetinfo, 0, sizeof (packetinfo));
+  packetinfo.payloadformat = SLPAYLOAD_MSEED3;
+  packetinfo.payloadlength = length + datalength;
+
+  return sl_rings_add (rings, NULL, &packetinfo, record);
+} /* End of add_record() */
+
+/* Windows are found by FDSN source ID or SEED codes with an empty location */
+static void
+test_sourceid (void)
+{
+  SLwindow window;
+
+  CHECK (add_record ("FDSN:IU_ANMO__B_H_Z") == SAMPLES);
+
+  CHECK (sl_rings_window (rings, "FDSN:IU_ANMO__B_H_Z", 0, &window) == 1);
+  CHECK (sl_rings_window (rings, "IU_ANMO__B_H_Z", 0, &window) == 1);
+  CHECK (sl_rings_window (rings, "IU.ANMO..BHZ", 0, &window) == 1);
+  CHECK (sl_rings_window (rings, "IU.ANMO.--.BHZ", 0, &window) == 1);
+  CHECK (strcmp (window.sourceid, "IU_ANMO__B_H_Z") == 0);
+  CHECK (window.samplecount == SAMPLES);
+
+  CHECK (add_record ("FDSN:IU_ANMO_00_B_H_Z") == SAMPLES);
+  CHECK (sl_rings_window (rings, "IU.ANMO.00.BHZ", 0, &window) == 1);
+  CHECK (strcmp (window.sourceid, "IU_ANMO_00_B_H_Z") == 0);
+
+  CHECK (sl_rings_window (rings, "IU..00.BHZ", 0, &window) == 0);
+  CHECK (sl_rings_window (rings, "IU.ANMO.00.BHZX", 0, &window) == 0);
+} /* End of test_sourceid() */
+
+/* Add records for new sources, announcing each before it is added */
+static void *
+add_sources (void *arg)
+{
+  char sid[64];
+  int idx;
+
+  (void)arg;
+
+  for (idx = 0; idx < SOURCES; idx++)
+  {
+    snprintf (sid, sizeof (sid), "FDSN:XX_S%d__B_H_Z", idx);
+
+    ATOMIC_STORE (&added, idx);
+    add_record (sid);
+  }
+
+  return NULL;
+} /* End of add_sources() */
+
+/* A window is never returned without a sample rate */
+static void
+test_new_sources (void)
+{
+  pthread_t thread;
+  SLwindow window;
+  char sid[64];
+  int idx = -1;
+  int status;
+  int invalid = 0;
+
+  CHECK (pthread_create (&thread, NULL, add_sources, NULL) == 0);
+
+  while (idx < SOURCES - 1)
+  {
+    idx = ATOMIC_LOAD (&added);
+
+    if (idx < 0)
+      continue;
+
+    snprintf (sid, sizeof (sid), "XX_S%d__B_H_Z", idx);
+
+    status = sl_rings_window (rings, sid, 0, &window);
+
+    if (status == 1 && window.samplerate <= 0.0)
+      invalid++;
+  }
+
+  pthread_join (thread, NULL);
+
+  CHECK (invalid == 0);
+} /* End of test_new_sources() */
+
+int
+main (void)
+{
+  if ((rings = sl_initslrings (SOURCES + 2, 1024)) == NULL)
+    return 1;
+
+  test_sourceid ();
+  test_new_sources ();
+
+  sl_freeslrings (rings);
+
+  return TEST_RESULT ("test-samplering");
+}
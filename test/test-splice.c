@@ -0,0 +1,185 @@
+/***************************************************************************
+ * test-splice.c
+ *
+ * Tests of collection in splice mode, where miniSEED payloads are moved
+ * from the socket to an archive.
+ ***************************************************************************/
+
+#include "testutils.h"
+
+static char archivedir[] = "/tmp/test-splice-XXXXXX";
+
+/***************************************************************************
+ * splice_connection:
+ *
+ * Create a connection with splice mode enabled and a new archive.
+ *
+ * Returns new connection on success and NULL on error.
+ ***************************************************************************/
+static SLCD *
+splice_connection (int *peer, SLarchive **archive)
+{
+  SLCD *slconn;
+
+  if (!(slconn = test_connection (peer)))
+    return NULL;
+
+  if (!(*archive = sl_initslarchive (archivedir, SLARCHIVE_SDS, 10, 0)) ||
+      sl_set_archive (slconn, *archive) ||
+      sl_set_splicemode (slconn, 1))
+    return NULL;
+
+  return slconn;
+} /* End of splice_connection() */
+
+/* END from the server after a spliced packet terminates the connection */
+static void
+test_end (void)
+{
+  const SLpacketinfo *packetinfo = NULL;
+  SLarchive *archive = NULL;
+  SLCD *slconn;
+  char record[256];
+  char packet[512];
+  char plbuffer[512];
+  uint64_t records = 0;
+  uint32_t length;
+  int peer;
+
+  CHECK ((slconn = splice_connection (&peer, &archive)) != NULL);
+  if (!slconn)
+    return;
+
+  length = test_ms3record (record, "FDSN:XX_TEST__B_H_Z", 2026, 100);
+  length = test_packet (packet, SLPAYLOAD_MSEED3, 1, "XX_TEST", record, length);
+  CHECK (write (peer, packet, length) == (ssize_t)length);
+  CHECK (write (peer, "END", 3) == 3);
+
+  CHECK (test_collect (slconn, &packetinfo, plbuffer, sizeof (plbuffer)) == SLTERMINATE);
+  CHECK (slconn->stat->resync_count == 0);
+
+  sl_archive_stats (archive, &records, NULL, NULL);
+  CHECK (records == 1);
+
+  close (peer);
+  sl_freeslcd (slconn);
+  sl_freeslarchive (archive, NULL);
+} /* End of test_end() */
+
+/* A corrupt header is resynchronized by normal collection, not fatal */
+static void
+test_corrupt (void)
+{
+  const SLpacketinfo *packetinfo = NULL;
+  SLarchive *archive = NULL;
+  SLCD *slconn;
+  char record[256];
+  char packet[512];
+  char plbuffer[512];
+  uint64_t records = 0;
+  uint32_t length;
+  int peer;
+
+  CHECK ((slconn = splice_connection (&peer, &archive)) != NULL);
+  if (!slconn)
+    return;
+
+  sl_set_resync (slconn, 1);
+
+  length = test_ms3record (record, "FDSN:XX_TEST__B_H_Z", 2026, 100);
+  length = test_packet (packet, SLPAYLOAD_MSEED3, 1, "XX_TEST", record, length);
+  CHECK (write (peer, packet, length) == (ssize_t)length);
+  CHECK (write (peer, "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX", 32) == 32);
+
+  length = test_ms3record (record, "FDSN:XX_TEST__B_H_Z", 2026, 100);
+  length = test_packet (packet, SLPAYLOAD_MSEED3, 2, "XX_TEST", record, length);
+  CHECK (write (peer, packet, length) == (ssize_t)length);
+  CHECK (write (peer, "END", 3) == 3);
+
+  CHECK (test_collect (slconn, &packetinfo, plbuffer, sizeof (plbuffer)) == SLPACKET);
+  CHECK (packetinfo && packetinfo->seqnum == 2);
+  CHECK (slconn->stat->resync_count == 1);
+  CHECK (test_collect (slconn, &packetinfo, plbuffer, sizeof (plbuffer)) == SLTERMINATE);
+
+  sl_archive_stats (archive, &records, NULL, NULL);
+  CHECK (records == 2);
+
+  close (peer);
+  sl_freeslcd (slconn);
+  sl_freeslarchive (archive, NULL);
+} /* End of test_corrupt() */
+
+/* Records are transcoded before archiving, splice mode is not used */
+static void
+test_transcode (void)
+{
+  const SLpacketinfo *packetinfo = NULL;
+  SLarchive *archive = NULL;
+  SLCD *slconn;
+  FILE *file;
+  char path[256];
+  char record[512];
+  char packet[1024];
+  char plbuffer[1024];
+  uint32_t returned = 0;
+  uint32_t length;
+  long filesize = -1;
+  int peer;
+
+  CHECK ((slconn = splice_connection (&peer, &archive)) != NULL);
+  if (!slconn)
+    return;
+
+  CHECK (sl_set_transcode (slconn, 512) == 0);
+
+  length = test_ms2record (record, 2026, 101);
+  length = test_packet (packet, SLPAYLOAD_MSEED2, 1, "XX_TEST", record, length);
+  CHECK (write (peer, packet, length) == (ssize_t)length);
+  CHECK (write (peer, "END", 3) == 3);
+
+  CHECK (test_collect (slconn, &packetinfo, plbuffer, sizeof (plbuffer)) == SLPACKET);
+  if (packetinfo)
+  {
+    CHECK (packetinfo->payloadformat == SLPAYLOAD_MSEED3);
+    returned = packetinfo->payloadlength;
+  }
+  CHECK (test_collect (slconn, &packetinfo, plbuffer, sizeof (plbuffer)) == SLTERMINATE);
+
+  close (peer);
+  sl_freeslcd (slconn);
+  sl_freeslarchive (archive, NULL);
+
+  /* The archive contains only the transcoded record */
+  snprintf (path, sizeof (path), "%s/2026/XX/TEST/BHZ.D/XX.TEST..BHZ.D.2026.101", archivedir);
+  CHECK ((file = fopen (path, "rb")) != NULL);
+  if (!file)
+    return;
+
+  CHECK (fread (record, 1, 3, file) == 3 && memcmp (record, "MS\3", 3) == 0);
+  if (fseek (file, 0, SEEK_END) == 0)
+    filesize = ftell (file);
+  CHECK (returned > 0 && filesize == (long)returned);
+
+  fclose (file);
+} /* End of test_transcode() */
+
+int
+main (void)
+{
+  char command[64];
+
+  if (!mkdtemp (archivedir))
+    return 1;
+
+  sl_loginit (0, NULL, NULL, NULL, NULL);
+
+  test_end ();
+  test_corrupt ();
+  test_transcode ();
+
+  snprintf (command, sizeof (command), "rm -rf %s", archivedir);
+  if (system (command))
+    test_failures++;
+
+  return TEST_RESULT ("test-splice");
+}
@@ -0,0 +1,183 @@
+/***************************************************************************
+ * testutils.h
+ *
+ * Shared routines for the libslink tests: result checking, a connection
+ * fed by a local socket in place of a server and construction of v4
+ * packets with minimal miniSEED records.
+ ***************************************************************************/
+
+#ifndef TESTUTILS_H
+#define TESTUTILS_H 1
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <libslink.h>
+
+static int test_failures = 0;
+
+/* Report a failed check with location, continuing with the test */
+#define CHECK(X)                                                    \
+  do                                                                \
+  {                                                                 \
+    if (!(X))                                                       \
+    {                                                               \
+      fprintf (stderr, "%s:%d: check failed: %s\n",                 \
+               __FILE__, __LINE__, #X);                             \
+      test_failures++;                                              \
+    }                                                               \
+  } while (0)
+
+/* Report test results, returns exit status for main() */
+#define TEST_RESULT(NAME) \
+  (printf ("%s: %s\n", (NAME), (test_failures) ? "FAILED" : "passed"), (test_failures) ? 1 : 0)
+
+/***************************************************************************
+ * test_connection:
+ *
+ * Create a non-blocking connection in streaming state with the v4 protocol for
+ * station XX_TEST, reading from one end of a socket pair, the other end is returned in \a peer
+ * for the test to write server data to.
+ *
+ * Returns new connection on success and NULL on error.
+ ***************************************************************************/
+static SLCD *
+test_connection (int *peer)
+{
+  SLCD *slconn;
+  int sv[2];
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv))
+    return NULL;
+
+  if (!(slconn = sl_initslcd ("test", "1.0")) ||
+      sl_set_serveraddress (slconn, "localhost:18000") ||
+      sl_add_stream (slconn, "XX_TEST", NULL, SL_UNSETSEQUENCE, NULL))
+    return NULL;
+
+  fcntl (sv[0], F_SETFL, fcntl (sv[0], F_GETFL) | O_NONBLOCK);
+  sl_set_blockingmode (slconn, 1);
+
+  slconn->link             = sv[0];
+  slconn->protocol         = SLPROTO40;
+  slconn->stat->conn_state = STREAMING;
+
+  *peer = sv[1];
+
+  return slconn;
+} /* End of test_connection() */
+
+/***************************************************************************
+ * test_collect:
+ *
+ * Collect from a connection created by test_connection() until a
+ * packet is returned, the connection is terminated or no data remains.
+ * The connection is never re-established as there is no server.
+ *
+ * Returns the status of the last sl_collect().
+ ***************************************************************************/
+static int
+test_collect (SLCD *slconn, const SLpacketinfo **packetinfo,
+              char *plbuffer, uint32_t plbuffersize)
+{
+  int status = SLNOPACKET;
+  int tries;
+
+  for (tries = 0; tries < 1000 && status == SLNOPACKET && slconn->link != -1; tries++)
+    status = sl_collect (slconn, packetinfo, plbuffer, plbuffersize);
+
+  return status;
+} /* End of test_collect() */
+
+/***************************************************************************
+ * test_ms3record:
+ *
+ * Build a miniSEED 3 record without data samples for \a sid starting
+ * at the beginning of \a doy of \a year.
+ *
+ * Returns record length.
+ ***************************************************************************/
+static uint32_t
+test_ms3record (char *record, const char *sid, uint16_t year, uint16_t doy)
+{
+  uint8_t sidlength = (uint8_t)strlen (sid);
+
+  memset (record, 0, 40);
+  memcpy (record, "MS", 2);
+  record[2] = 3;
+  memcpy (record + 8, &year, 2);
+  memcpy (record + 10, &doy, 2);
+  record[15] = 11;
+  record[33] = sidlength;
+  memcpy (record + 40, sid, sidlength);
+
+  return 40 + sidlength;
+} /* End of test_ms3record() */
+
+/***************************************************************************
+ * test_ms2record:
+ *
+ * Build a 512-byte miniSEED 2 record with blockette 1000 and without
+ * data samples for station XX_TEST channel BHZ starting at the
+ * beginning of \a doy of \a year.
+ *
+ * Returns record length.
+ ***************************************************************************/
+static uint32_t
+test_ms2record (char *record, uint16_t year, uint16_t doy)
+{
+  uint16_t value;
+
+  memset (record, 0, 512);
+  memcpy (record, "000001D TEST   BHZXX", 20);
+  memcpy (record + 20, &year, 2);
+  memcpy (record + 22, &doy, 2);
+  value = 1;
+  memcpy (record + 32, &value, 2);
+  memcpy (record + 34, &value, 2);
+  record[39] = 1;
+  value = 64;
+  memcpy (record + 44, &value, 2);
+  value = 48;
+  memcpy (record + 46, &value, 2);
+
+  /* Blockette 1000: Steim-2, little endian, 512-byte record */
+  value = 1000;
+  memcpy (record + 48, &value, 2);
+  record[52] = 11;
+  record[53] = 0;
+  record[54] = 9;
+
+  return 512;
+} /* End of test_ms2record() */
+
+/***************************************************************************
+ * test_packet:
+ *
+ * Build a v4 packet with \a payload of \a length bytes in \a packet.
+ *
+ * Returns packet length.
+ ***************************************************************************/
+static uint32_t
+test_packet (char *packet, char format, uint64_t seqnum, const char *stationid,
+             const char *payload, uint32_t length)
+{
+  uint8_t stationidlength = (uint8_t)strlen (stationid);
+
+  memcpy (packet, "SE", 2);
+  packet[2] = format;
+  packet[3] = 'D';
+  memcpy (packet + 4, &length, 4);
+  memcpy (packet + 8, &seqnum, 8);
+  packet[16] = (char)stationidlength;
+  memcpy (packet + SLHEADSIZE_V4, stationid, stationidlength);
+  memcpy (packet + SLHEADSIZE_V4 + stationidlength, payload, length);
+
+  return SLHEADSIZE_V4 + stationidlength + length;
+} /* End of test_packet() */
+
+#endif /* TESTUTILS_H */
@@ -0,0 +1,848 @@
+/***************************************************************************
+ * traffic.c
+ *
+ * Routines for accounting received traffic per station and channel.
+ *
+ * The heaviest stations, and optionally channels, are tracked with the
+ * Space-Saving algorithm in fixed size tables of counters, a min-heap
+ * on bytes selects the counter replaced by a new key.  All keys are
+ * also counted in a count-min sketch so that the traffic of any
+ * station or channel in the long tail can be estimated.  Updates are
+ * protected by a sequence lock so that other threads may read
+ * consistent snapshots without blocking collection.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+#include "slatomic.h"
+
+/* Rows of the count-min sketch */
+#define SKETCH_DEPTH 4
+
+/* Marker for no counter */
+#define NOCOUNTER UINT32_MAX
+
+/* Space-Saving counter */
+typedef struct TrafficCounter
+{
+  char     key[64];            /* Station ID or source ID */
+  uint64_t hash;               /* Hash of key */
+  uint64_t bytes;              /* Bytes counted, including error */
+  uint64_t packets;            /* Packets counted, including error */
+  uint64_t error;              /* Maximum overestimate of bytes */
+  uint64_t packeterror;        /* Maximum overestimate of packets */
+  uint64_t interval;           /* Index of current rate interval */
+  uint64_t intervalbytes;      /* Bytes in current rate interval */
+  uint64_t intervalpackets;    /* Packets in current rate interval */
+  uint64_t previousbytes;      /* Bytes in previous rate interval */
+  uint64_t previouspackets;    /* Packets in previous rate interval */
+  int64_t  lastseen;           /* Time of last packet */
+  uint32_t heappos;            /* Position in min-heap */
+} TrafficCounter;
+
+/* Table of counters for the heaviest keys of one level */
+typedef struct TrafficTable
+{
+  TrafficCounter *counters;    /* Counters */
+  uint32_t  count;             /* Number of counters in use */
+  uint32_t  capacity;          /* Maximum number of counters */
+  uint32_t *heap;              /* Min-heap of counter indexes by bytes */
+  uint32_t *index;             /* Hash table of counter indexes, NOCOUNTER if empty */
+  uint32_t  mask;              /* Hash table size - 1, size is a power of 2 */
+} TrafficTable;
+
+struct SLtraffic
+{
+  volatile uint32_t sequence;  /* Sequence lock, odd while writing */
+  TrafficTable stations;       /* Heaviest stations */
+  TrafficTable channels;       /* Heaviest channels, capacity 0 if disabled */
+  uint64_t *sketch;            /* Count-min sketch, bytes and packets per cell */
+  uint32_t  sketchmask;        /* Sketch width - 1, width is a power of 2 */
+  int64_t   interval;          /* Rate interval, nanoseconds */
+  uint64_t  bytes;             /* Total bytes */
+  uint64_t  packets;           /* Total packets */
+};
+
+static int table_init (TrafficTable *table, uint32_t capacity);
+static void table_free (TrafficTable *table);
+static void table_add (TrafficTable *table, const char *key, uint64_t hash,
+                       uint32_t length, uint64_t interval, int64_t current_time);
+static uint32_t table_find (const TrafficTable *table, const char *key, uint64_t hash);
+static void table_unindex (TrafficTable *table, uint32_t counteridx);
+static void heap_up (TrafficTable *table, uint32_t pos);
+static void heap_down (TrafficTable *table, uint32_t pos);
+static void sketch_add (SLtraffic *traffic, uint64_t hash, uint32_t length);
+static void read_entry (const SLtraffic *traffic, const TrafficCounter *counter,
+                        uint64_t interval, SLtrafficentry *entry);
+static int compare_bytes (const void *a, const void *b);
+static int compare_rate (const void *a, const void *b);
+static uint64_t hash_key (const char *key);
+
+/**********************************************************************/ /**
+ * @brief Initialize a new traffic accounting structure
+ *
+ * Allocate counters for the \a topk heaviest stations, and the same
+ * number of channels if \a channels is non-zero, and a count-min
+ * sketch with \a sketchwidth cells per row for the remaining long tail.
+ * All memory is allocated here, the memory used does not grow with
+ * the number of stations or channels.
+ *
+ * Rates are computed over intervals of \a interval seconds.
+ *
+ * The structure may be fed from one or more connections with
+ * sl_set_traffic(), or by calling sl_traffic_add() directly.
+ *
+ * @param[in] topk         Number of heaviest stations and channels to track
+ * @param[in] sketchwidth  Cells per sketch row, rounded up to a power of 2
+ * @param[in] interval     Rate interval in seconds
+ * @param[in] channels     Boolean flag to also track channels
+ *
+ * @returns An initialized ::SLtraffic on success, NULL on error.
+ ***************************************************************************/
+SLtraffic *
+sl_initsltraffic (uint32_t topk, uint32_t sketchwidth, uint32_t interval, int channels)
+{
+  SLtraffic *traffic;
+  uint32_t width = 16;
+
+  if (topk == 0 || topk > (1U << 24) || sketchwidth > (1U << 24) || interval == 0)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): invalid parameters, topk: %u, sketchwidth: %u, interval: %u\n",
+              __func__, topk, sketchwidth, interval);
+    return NULL;
+  }
+
+  while (width < sketchwidth)
+    width <<= 1;
+
+  if ((traffic = (SLtraffic *)sl_malloc (sizeof (SLtraffic))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    return NULL;
+  }
+
+  memset (traffic, 0, sizeof (SLtraffic));
+
+  traffic->sketchmask = width - 1;
+  traffic->interval   = SL_EPOCH2SLTIME ((int64_t)interval);
+
+  if (table_init (&traffic->stations, topk) ||
+      (channels && table_init (&traffic->channels, topk)) ||
+      (traffic->sketch = (uint64_t *)sl_calloc ((size_t)SKETCH_DEPTH * width * 2,
+                                                 sizeof (uint64_t))) == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_freesltraffic (traffic);
+    return NULL;
+  }
+
+  return traffic;
+} /* End of sl_initsltraffic() */
+
+/**********************************************************************/ /**
+ * @brief Free all memory associated with a traffic accounting structure
+ *
+ * Any connections feeding the structure must be detached, see
+ * sl_set_traffic(), and no other threads may be reading it.
+ *
+ * @param[in] traffic  Traffic accounting to free
+ ***************************************************************************/
+void
+sl_freesltraffic (SLtraffic *traffic)
+{
+  if (!traffic)
+    return;
+
+  table_free (&traffic->stations);
+  table_free (&traffic->channels);
+  sl_free (traffic->sketch);
+  sl_free (traffic);
+} /* End of sl_freesltraffic() */
+
+/**********************************************************************/ /**
+ * @brief Add a packet to traffic accounting
+ *
+ * Count \a length bytes and one packet for the station and, if
+ * channels are tracked and \a sourceid is provided, for the channel.
+ * This is called for each packet received by connections configured
+ * with sl_set_traffic(), including packets rejected by client-side
+ * filtering, as they are received and parsed regardless.
+ *
+ * @param[in] traffic    Traffic accounting
+ * @param[in] stationid  Station ID, e.g. "NET_STA"
+ * @param[in] sourceid   FDSN source identifier of the channel, or NULL
+ * @param[in] length     Payload length in bytes
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_traffic_add (SLtraffic *traffic, const char *stationid, const char *sourceid,
+                uint32_t length)
+{
+  uint64_t stationhash;
+  uint64_t sourcehash = 0;
+  uint64_t interval;
+  int64_t current_time;
+  uint32_t sequence;
+
+  if (!traffic || !stationid)
+    return -1;
+
+  current_time = sl_nstime ();
+  interval     = (uint64_t)(current_time / traffic->interval);
+  stationhash  = hash_key (stationid);
+
+  if (sourceid && traffic->channels.capacity)
+    sourcehash = hash_key (sourceid);
+
+  /* Acquire sequence lock by moving from even to odd */
+  for (;;)
+  {
+    sequence = ATOMIC_LOAD (&traffic->sequence);
+
+    if ((sequence & 1) == 0 && ATOMIC_CAS (&traffic->sequence, sequence, sequence + 1))
+      break;
+  }
+
+  traffic->bytes += length;
+  traffic->packets++;
+
+  table_add (&traffic->stations, stationid, stationhash, length, interval, current_time);
+  sketch_add (traffic, stationhash, length);
+
+  if (sourceid && traffic->channels.capacity)
+  {
+    table_add (&traffic->channels, sourceid, sourcehash, length, interval, current_time);
+    sketch_add (traffic, sourcehash, length);
+  }
+
+  /* Release sequence lock */
+  ATOMIC_STORE (&traffic->sequence, sequence + 2);
+
+  return 0;
+} /* End of sl_traffic_add() */
+
+/**********************************************************************/ /**
+ * @brief Get a snapshot of the heaviest stations or channels
+ *
+ * Copy up to \a maxentries of the tracked stations, with
+ * ::SLTRAFFIC_STATION, or channels, with ::SLTRAFFIC_CHANNEL, to
+ * \a entries, ordered by descending total bytes with
+ * ::SLTRAFFIC_ORDER_BYTES or descending rate in the last complete
+ * interval with ::SLTRAFFIC_ORDER_RATE.
+ *
+ * Totals of entries are upper bounds: a key that replaced another
+ * counter inherits its count, the maximum overestimate is reported in
+ * the \a error fields.  Any key whose total exceeds the total of all
+ * traffic divided by the number of counters is guaranteed to be
+ * tracked.
+ *
+ * This may be called from any thread while the structure is updated.
+ *
+ * @param[in]  traffic     Traffic accounting
+ * @param[in]  level       ::SLTRAFFIC_STATION or ::SLTRAFFIC_CHANNEL
+ * @param[out] entries     Destination for entries
+ * @param[in]  maxentries  Maximum number of entries to return
+ * @param[in]  order       ::SLTRAFFIC_ORDER_BYTES or ::SLTRAFFIC_ORDER_RATE
+ *
+ * @returns Number of entries returned or -1 on error.
+ ***************************************************************************/
+int
+sl_traffic_snapshot (SLtraffic *traffic, int level, SLtrafficentry *entries,
+                     uint32_t maxentries, int order)
+{
+  const TrafficTable *table;
+  TrafficCounter *counters;
+  SLtrafficentry *all;
+  uint64_t interval;
+  uint32_t before;
+  uint32_t after;
+  uint32_t count;
+  uint32_t idx;
+
+  if (!traffic || (!entries && maxentries > 0) ||
+      (level != SLTRAFFIC_STATION && level != SLTRAFFIC_CHANNEL) ||
+      (order != SLTRAFFIC_ORDER_BYTES && order != SLTRAFFIC_ORDER_RATE))
+    return -1;
+
+  table = (level == SLTRAFFIC_STATION) ? &traffic->stations : &traffic->channels;
+
+  if (table->capacity == 0 || maxentries == 0)
+    return 0;
+
+  counters = (TrafficCounter *)sl_malloc (sizeof (TrafficCounter) * table->capacity);
+  all      = (SLtrafficentry *)sl_malloc (sizeof (SLtrafficentry) * table->capacity);
+
+  if (counters == NULL || all == NULL)
+  {
+    sl_log_r (NULL, 2, 0, "%s(): error allocating memory\n", __func__);
+    sl_free (counters);
+    sl_free (all);
+    return -1;
+  }
+
+  /* Copy a consistent snapshot of the counters, retrying while written */
+  do
+  {
+    while ((before = ATOMIC_LOAD (&traffic->sequence)) & 1)
+      ;
+
+    count = table->count;
+    if (count > table->capacity)
+      count = table->capacity;
+
+    memcpy (counters, table->counters, sizeof (TrafficCounter) * count);
+
+    ACQUIRE_FENCE ();
+    after = ATOMIC_LOAD (&traffic->sequence);
+  } while (before != after);
+
+  interval = (uint64_t)(sl_nstime () / traffic->interval);
+
+  for (idx = 0; idx < count; idx++)
+    read_entry (traffic, &counters[idx], interval, &all[idx]);
+
+  qsort (all, count, sizeof (SLtrafficentry),
+         (order == SLTRAFFIC_ORDER_RATE) ? compare_rate : compare_bytes);
+
+  if (count > maxentries)
+    count = maxentries;
+
+  memcpy (entries, all, sizeof (SLtrafficentry) * count);
+
+  sl_free (counters);
+  sl_free (all);
+
+  return (int)count;
+} /* End of sl_traffic_snapshot() */
+
+/**********************************************************************/ /**
+ * @brief Estimate the traffic of any station or channel
+ *
+ * Estimate the total bytes and packets of a station ID or FDSN source
+ * identifier from the count-min sketch, including keys not among the
+ * heaviest tracked.  Estimates are never below the true totals and
+ * exceed them by a fraction of all traffic that shrinks as the sketch
+ * width grows.
+ *
+ * This may be called from any thread while the structure is updated.
+ *
+ * @param[in]  traffic  Traffic accounting
+ * @param[in]  key      Station ID or FDSN source identifier
+ * @param[out] bytes    Estimated bytes, may be NULL
+ * @param[out] packets  Estimated packets, may be NULL
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_traffic_estimate (SLtraffic *traffic, const char *key, uint64_t *bytes, uint64_t *packets)
+{
+  uint64_t hash;
+  uint64_t minbytes;
+  uint64_t minpackets;
+  uint64_t cell;
+  uint32_t before;
+  uint32_t after;
+  int row;
+
+  if (!traffic || !key)
+    return -1;
+
+  hash = hash_key (key);
+
+  do
+  {
+    while ((before = ATOMIC_LOAD (&traffic->sequence)) & 1)
+      ;
+
+    minbytes   = UINT64_MAX;
+    minpackets = UINT64_MAX;
+
+    for (row = 0; row < SKETCH_DEPTH; row++)
+    {
+      cell = ((uint64_t)row * (traffic->sketchmask + 1) +
+              (((hash & 0xFFFFFFFF) + (uint64_t)row * (hash >> 32)) & traffic->sketchmask)) * 2;
+
+      if (traffic->sketch[cell] < minbytes)
+        minbytes = traffic->sketch[cell];
+      if (traffic->sketch[cell + 1] < minpackets)
+        minpackets = traffic->sketch[cell + 1];
+    }
+
+    ACQUIRE_FENCE ();
+    after = ATOMIC_LOAD (&traffic->sequence);
+  } while (before != after);
+
+  if (bytes)
+    *bytes = minbytes;
+  if (packets)
+    *packets = minpackets;
+
+  return 0;
+} /* End of sl_traffic_estimate() */
+
+/**********************************************************************/ /**
+ * @brief Get the total traffic counted
+ *
+ * This may be called from any thread while the structure is updated.
+ *
+ * @param[in]  traffic  Traffic accounting
+ * @param[out] bytes    Total bytes, may be NULL
+ * @param[out] packets  Total packets, may be NULL
+ *
+ * @retval  0 : success
+ * @retval -1 : error
+ ***************************************************************************/
+int
+sl_traffic_totals (SLtraffic *traffic, uint64_t *bytes, uint64_t *packets)
+{
+  uint64_t totalbytes;
+  uint64_t totalpackets;
+  uint32_t before;
+  uint32_t after;
+
+  if (!traffic)
+    return -1;
+
+  do
+  {
+    while ((before = ATOMIC_LOAD (&traffic->sequence)) & 1)
+      ;
+
+    totalbytes   = traffic->bytes;
+    totalpackets = traffic->packets;
+
+    ACQUIRE_FENCE ();
+    after = ATOMIC_LOAD (&traffic->sequence);
+  } while (before != after);
+
+  if (bytes)
+    *bytes = totalbytes;
+  if (packets)
+    *packets = totalpackets;
+
+  return 0;
+} /* End of sl_traffic_totals() */
+
+/**********************************************************************/ /**
+ * @brief Reset all counters of a traffic accounting structure
+ *
+ * Clear all tracked stations and channels, the sketch and the totals,
+ * e.g. to start a new accounting period so that keys that recently
+ * became heavy are not hidden by historical totals.
+ *
+ * @param[in] traffic  Traffic accounting
+ ***************************************************************************/
+void
+sl_traffic_reset (SLtraffic *traffic)
+{
+  uint32_t sequence;
+
+  if (!traffic)
+    return;
+
+  for (;;)
+  {
+    sequence = ATOMIC_LOAD (&traffic->sequence);
+
+    if ((sequence & 1) == 0 && ATOMIC_CAS (&traffic->sequence, sequence, sequence + 1))
+      break;
+  }
+
+  traffic->stations.count = 0;
+  traffic->channels.count = 0;
+  traffic->bytes          = 0;
+  traffic->packets        = 0;
+
+  memset (traffic->stations.index, 0xFF, sizeof (uint32_t) * (traffic->stations.mask + 1));
+
+  if (traffic->channels.capacity)
+    memset (traffic->channels.index, 0xFF, sizeof (uint32_t) * (traffic->channels.mask + 1));
+
+  memset (traffic->sketch, 0,
+          sizeof (uint64_t) * SKETCH_DEPTH * (traffic->sketchmask + 1) * 2);
+
+  ATOMIC_STORE (&traffic->sequence, sequence + 2);
+} /* End of sl_traffic_reset() */
+
+/***************************************************************************
+ * table_init:
+ *
+ * Allocate a table of counters with a hash index at least twice the
+ * capacity.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+table_init (TrafficTable *table, uint32_t capacity)
+{
+  uint32_t tablesize = 16;
+
+  while (tablesize < capacity * 2)
+    tablesize <<= 1;
+
+  table->counters = (TrafficCounter *)sl_calloc (capacity, sizeof (TrafficCounter));
+  table->heap     = (uint32_t *)sl_malloc (sizeof (uint32_t) * capacity);
+  table->index    = (uint32_t *)sl_malloc (sizeof (uint32_t) * tablesize);
+
+  if (table->counters == NULL || table->heap == NULL || table->index == NULL)
+    return -1;
+
+  memset (table->index, 0xFF, sizeof (uint32_t) * tablesize);
+
+  table->count    = 0;
+  table->capacity = capacity;
+  table->mask     = tablesize - 1;
+
+  return 0;
+} /* End of table_init() */
+
+/***************************************************************************
+ * table_free:
+ *
+ * Free the memory of a table of counters.
+ ***************************************************************************/
+static void
+table_free (TrafficTable *table)
+{
+  sl_free (table->counters);
+  sl_free (table->heap);
+  sl_free (table->index);
+} /* End of table_free() */
+
+/***************************************************************************
+ * table_add:
+ *
+ * Count a packet for a key with the Space-Saving algorithm: a tracked
+ * key is incremented, otherwise a free counter is used or the counter
+ * with the fewest bytes is replaced and its count inherited as error.
+ ***************************************************************************/
+static void
+table_add (TrafficTable *table, const char *key, uint64_t hash,
+           uint32_t length, uint64_t interval, int64_t current_time)
+{
+  TrafficCounter *counter;
+  uint32_t counteridx;
+  uint32_t slot;
+  int added = 0;
+
+  counteridx = table_find (table, key, hash);
+
+  if (counteridx == NOCOUNTER)
+  {
+    if (table->count < table->capacity)
+    {
+      added      = 1;
+      counteridx = table->count++;
+      counter    = &table->counters[counteridx];
+
+      memset (counter, 0, sizeof (TrafficCounter));
+      counter->heappos        = counteridx;
+      table->heap[counteridx] = counteridx;
+    }
+    else
+    {
+      /* Replace the counter with the fewest bytes, at the top of the heap */
+      counteridx = table->heap[0];
+      counter    = &table->counters[counteridx];
+
+      table_unindex (table, counteridx);
+
+      counter->error           = counter->bytes;
+      counter->packeterror     = counter->packets;
+      counter->intervalbytes   = 0;
+      counter->intervalpackets = 0;
+      counter->previousbytes   = 0;
+      counter->previouspackets = 0;
+    }
+
+    strncpy (counter->key, key, sizeof (counter->key) - 1);
+    counter->key[sizeof (counter->key) - 1] = '\0';
+    counter->hash     = hash;
+    counter->interval = interval;
+
+    for (slot = hash & table->mask; table->index[slot] != NOCOUNTER; slot = (slot + 1) & table->mask)
+      ;
+
+    table->index[slot] = counteridx;
+  }
+
+  counter = &table->counters[counteridx];
+
+  /* Roll over rate intervals */
+  if (counter->interval != interval)
+  {
+    counter->previousbytes   = (counter->interval + 1 == interval) ? counter->intervalbytes : 0;
+    counter->previouspackets = (counter->interval + 1 == interval) ? counter->intervalpackets : 0;
+    counter->intervalbytes   = 0;
+    counter->intervalpackets = 0;
+    counter->interval        = interval;
+  }
+
+  counter->bytes += length;
+  counter->packets++;
+  counter->intervalbytes += length;
+  counter->intervalpackets++;
+  counter->lastseen = current_time;
+
+  /* New counters are added at the end of the heap, existing counters grow */
+  if (added)
+    heap_up (table, counter->heappos);
+  else
+    heap_down (table, counter->heappos);
+} /* End of table_add() */
+
+/***************************************************************************
+ * table_find:
+ *
+ * Find the counter of a key in the hash index.
+ *
+ * Returns the counter index or NOCOUNTER if the key is not tracked.
+ ***************************************************************************/
+static uint32_t
+table_find (const TrafficTable *table, const char *key, uint64_t hash)
+{
+  const TrafficCounter *counter;
+  uint32_t slot;
+
+  for (slot = hash & table->mask; table->index[slot] != NOCOUNTER; slot = (slot + 1) & table->mask)
+  {
+    counter = &table->counters[table->index[slot]];
+
+    if (counter->hash == hash && strcmp (counter->key, key) == 0)
+      return table->index[slot];
+  }
+
+  return NOCOUNTER;
+} /* End of table_find() */
+
+/***************************************************************************
+ * table_unindex:
+ *
+ * Remove a counter from the hash index, shifting following entries of
+ * the probe sequence back so that no tombstones are needed.
+ ***************************************************************************/
+static void
+table_unindex (TrafficTable *table, uint32_t counteridx)
+{
+  uint32_t slot;
+  uint32_t next;
+  uint32_t home;
+
+  for (slot = table->counters[counteridx].hash & table->mask;
+       table->index[slot] != counteridx;
+       slot = (slot + 1) & table->mask)
+    ;
+
+  table->index[slot] = NOCOUNTER;
+
+  for (next = (slot + 1) & table->mask; table->index[next] != NOCOUNTER; next = (next + 1) & table->mask)
+  {
+    home = table->counters[table->index[next]].hash & table->mask;
+
+    /* Move the entry back if its home is not between the hole and its slot */
+    if (((next - home) & table->mask) >= ((next - slot) & table->mask))
+    {
+      table->index[slot] = table->index[next];
+      table->index[next] = NOCOUNTER;
+      slot               = next;
+    }
+  }
+} /* End of table_unindex() */
+
+/***************************************************************************
+ * heap_up:
+ *
+ * Restore the min-heap order after a counter was added at a heap
+ * position.
+ ***************************************************************************/
+static void
+heap_up (TrafficTable *table, uint32_t pos)
+{
+  uint32_t counteridx = table->heap[pos];
+  uint64_t bytes      = table->counters[counteridx].bytes;
+  uint32_t parent;
+
+  while (pos > 0)
+  {
+    parent = (pos - 1) / 2;
+
+    if (table->counters[table->heap[parent]].bytes <= bytes)
+      break;
+
+    table->heap[pos]                          = table->heap[parent];
+    table->counters[table->heap[pos]].heappos = pos;
+    pos                                       = parent;
+  }
+
+  table->heap[pos]                    = counteridx;
+  table->counters[counteridx].heappos = pos;
+} /* End of heap_up() */
+
+/***************************************************************************
+ * heap_down:
+ *
+ * Restore the min-heap order after the bytes of the counter at a heap
+ * position increased.
+ ***************************************************************************/
+static void
+heap_down (TrafficTable *table, uint32_t pos)
+{
+  uint32_t counteridx = table->heap[pos];
+  uint64_t bytes      = table->counters[counteridx].bytes;
+  uint32_t child;
+
+  while ((child = pos * 2 + 1) < table->count)
+  {
+    if (child + 1 < table->count &&
+        table->counters[table->heap[child + 1]].bytes < table->counters[table->heap[child]].bytes)
+      child++;
+
+    if (table->counters[table->heap[child]].bytes >= bytes)
+      break;
+
+    table->heap[pos]                          = table->heap[child];
+    table->counters[table->heap[pos]].heappos = pos;
+    pos                                       = child;
+  }
+
+  table->heap[pos]                    = counteridx;
+  table->counters[counteridx].heappos = pos;
+} /* End of heap_down() */
+
+/***************************************************************************
+ * sketch_add:
+ *
+ * Count a packet in the count-min sketch, the cell of each row is
+ * selected by double hashing from the two halves of the key hash.
+ ***************************************************************************/
+static void
+sketch_add (SLtraffic *traffic, uint64_t hash, uint32_t length)
+{
+  uint64_t cell;
+  int row;
+
+  for (row = 0; row < SKETCH_DEPTH; row++)
+  {
+    cell = ((uint64_t)row * (traffic->sketchmask + 1) +
+            (((hash & 0xFFFFFFFF) + (uint64_t)row * (hash >> 32)) & traffic->sketchmask)) * 2;
+
+    traffic->sketch[cell] += length;
+    traffic->sketch[cell + 1]++;
+  }
+} /* End of sketch_add() */
+
+/***************************************************************************
+ * read_entry:
+ *
+ * Populate a snapshot entry from a counter, rates are computed from the
+ * last complete interval and are zero if the key was not seen in it.
+ ***************************************************************************/
+static void
+read_entry (const SLtraffic *traffic, const TrafficCounter *counter,
+            uint64_t interval, SLtrafficentry *entry)
+{
+  double seconds = (double)traffic->interval / SLTMODULUS;
+
+  memcpy (entry->key, counter->key, sizeof (entry->key));
+  entry->key[sizeof (entry->key) - 1] = '\0';
+
+  entry->bytes       = counter->bytes;
+  entry->packets     = counter->packets;
+  entry->error       = counter->error;
+  entry->packeterror = counter->packeterror;
+  entry->lastseen    = counter->lastseen;
+  entry->rate        = 0.0;
+  entry->packetrate  = 0.0;
+
+  if (counter->interval == interval)
+  {
+    entry->rate       = counter->previousbytes / seconds;
+    entry->packetrate = counter->previouspackets / seconds;
+  }
+  else if (counter->interval + 1 == interval)
+  {
+    entry->rate       = counter->intervalbytes / seconds;
+    entry->packetrate = counter->intervalpackets / seconds;
+  }
+} /* End of read_entry() */
+
+/***************************************************************************
+ * compare_bytes:
+ *
+ * Compare entries for qsort(), descending by bytes.
+ ***************************************************************************/
+static int
+compare_bytes (const void *a, const void *b)
+{
+  const SLtrafficentry *entrya = (const SLtrafficentry *)a;
+  const SLtrafficentry *entryb = (const SLtrafficentry *)b;
+
+  if (entrya->bytes != entryb->bytes)
+    return (entrya->bytes < entryb->bytes) ? 1 : -1;
+
+  return strcmp (entrya->key, entryb->key);
+} /* End of compare_bytes() */
+
+/***************************************************************************
+ * compare_rate:
+ *
+ * Compare entries for qsort(), descending by rate then bytes.
+ ***************************************************************************/
+static int
+compare_rate (const void *a, const void *b)
+{
+  const SLtrafficentry *entrya = (const SLtrafficentry *)a;
+  const SLtrafficentry *entryb = (const SLtrafficentry *)b;
+
+  if (entrya->rate != entryb->rate)
+    return (entrya->rate < entryb->rate) ? 1 : -1;
+
+  return compare_bytes (a, b);
+} /* End of compare_rate() */
+
+/***************************************************************************
+ * hash_key:
+ *
+ * Compute the 64-bit FNV-1a hash of a station or source ID, with a
+ * final mix so that both halves are usable for double hashing.
+ ***************************************************************************/
+static uint64_t
+hash_key (const char *key)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  while (*key)
+  {
+    hash ^= (uint8_t)*key++;
+    hash *= 1099511628211ULL;
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+
+  return hash;
+} /* End of hash_key() */
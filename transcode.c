@@ -0,0 +1,511 @@
+/***************************************************************************
+ * transcode.c:
+ *
+ * Routines to transcode miniSEED 2 records to miniSEED 3.
+ *
+ * Records are rewritten without decoding the data samples: the fixed
+ * header and blockettes 100, 1000 and 1001 are mapped to the miniSEED
+ * 3 header and extra headers, the encoded data are copied and a CRC
+ * is computed.  No memory is allocated.
+ *
+ * This file is part of the SeedLink Library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024:
+ * @author Chad Trabant, EarthScope Data Services
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libslink.h"
+#include "mseedformat.h"
+
+#if defined(__SSE4_2__)
+  #include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+  #include <arm_acle.h>
+#endif
+
+/* Maximum length of miniSEED 3 extra headers generated from miniSEED 2 */
+#define MAXEXTRALENGTH 512
+
+static uint32_t crc32c (uint32_t crc, const uint8_t *data, size_t length);
+static void json_member (char *buffer, size_t size, int *length, const char *member);
+
+/**********************************************************************/ /**
+ * @brief Transcode a miniSEED 2 record to miniSEED 3
+ *
+ * The record in \a ms2 is rewritten as a miniSEED 3 record in \a ms3
+ * without decoding the data samples:
+ *  - Fixed header fields are mapped to the miniSEED 3 header, with the
+ *    data quality indicator mapped to the publication version (R = 1,
+ *    D = 2, Q = 3, M = 4) and SEED codes mapped to an FDSN Source
+ *    Identifier.
+ *  - An unapplied time correction is applied to the start time and
+ *    blockette 1001 microseconds are added.
+ *  - Blockette 100 sample rates replace the nominal rate.
+ *  - Blockette 1000 provides the encoding, byte order and record
+ *    length, records without blockette 1000 cannot be transcoded.
+ *  - Activity, I/O and data quality flags, the time correction and
+ *    blockette 1001 timing quality are mapped to the header flags and
+ *    reserved FDSN extra headers.
+ *  - Steim frames are copied unchanged, limited to the blockette 1001
+ *    frame count when present.  Integer and float samples are limited
+ *    to the sample count and converted to little endian.
+ *  - A CRC-32C of the record is computed.
+ *
+ * Other blockettes are not transcoded.  No memory is allocated and on
+ * error \a ms3 is not modified.  The buffers must not overlap.
+ *
+ * @param[in] log Use the logging parameters specified in ::SLlog
+ * @param[in] ms2 A buffer containing a miniSEED 2 record
+ * @param[in] ms2length The length of the miniSEED 2 record in bytes
+ * @param[out] ms3 A buffer for the miniSEED 3 record
+ * @param[in] ms3size The size of the miniSEED 3 buffer in bytes
+ *
+ * @returns The length of the miniSEED 3 record on success, -1 on error.
+ *
+ * @sa sl_set_transcode()
+ ***************************************************************************/
+int
+sl_payload_ms2to3 (const SLlog *log, const char *ms2, uint32_t ms2length,
+                   char *ms3, uint32_t ms3size)
+{
+  SLpacketinfo packetinfo;
+  char sourceid[64];
+  char extra[MAXEXTRALENGTH];
+  char timegroup[128];
+  char eventgroup[128];
+  char flagsgroup[320];
+  int extralength = 0;
+  int timelength  = 0;
+  int eventlength = 0;
+  int flagslength = 0;
+  uint8_t sourceidlength;
+  uint32_t reclen      = ms2length;
+  uint32_t samplecount = 0;
+  uint32_t datalength;
+  uint32_t ms3length;
+  uint32_t idx;
+  double samplerate    = 0.0;
+  int64_t nstime;
+  int year, yday, hour, min, sec;
+  uint32_t nsec;
+  uint16_t dataoffset;
+  uint16_t blkt_offset;
+  uint16_t blkt_type;
+  int32_t timecorrection;
+  uint8_t actflags;
+  uint8_t ioflags;
+  uint8_t dqflags;
+  uint8_t flags         = 0;
+  uint8_t pubversion;
+  uint8_t encoding      = 0;
+  uint8_t byteorder     = 1;
+  uint8_t framecount    = 0;
+  int8_t microsecond    = 0;
+  int timingquality     = -1;
+  int blkt_count        = 0;
+  int found1000         = 0;
+  int samplesize        = 0;
+  int swapflag          = 0;
+  int dataswapflag;
+  int bigendianhost     = (sl_littleendianhost ()) ? 0 : 1;
+
+  if (!ms2 || !ms3 || ms2length < 48)
+  {
+    sl_log_rl (log, 2, 1, "%s(): invalid input parameters\n", __func__);
+    return -1;
+  }
+
+  if (!MS2_ISVALIDHEADER (ms2))
+  {
+    sl_log_rl (log, 2, 1, "%s(): payload is not a miniSEEDv2 record\n", __func__);
+    return -1;
+  }
+
+  /* Check to see if byte swapping is needed by checking for sane year and day */
+  if (!MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (ms2), *pMS2FSDH_DAY (ms2)))
+    swapflag = 1;
+
+  dataoffset  = HO2u (*pMS2FSDH_DATAOFFSET (ms2), swapflag);
+  blkt_offset = HO2u (*pMS2FSDH_BLOCKETTEOFFSET (ms2), swapflag);
+
+  /* Traverse blockette chain for blockettes 100, 1000 and 1001 */
+  while (blkt_offset >= 48 && (uint32_t)blkt_offset + 8 <= ms2length &&
+         blkt_count++ < 64)
+  {
+    blkt_type = HO2u (*pMS2B1000_TYPE (ms2 + blkt_offset), swapflag);
+
+    if (blkt_type == 100 && (uint32_t)blkt_offset + 12 <= ms2length)
+    {
+      samplerate = HO4f (*pMS2B100_SAMPRATE (ms2 + blkt_offset), swapflag);
+    }
+    else if (blkt_type == 1000)
+    {
+      encoding  = *pMS2B1000_ENCODING (ms2 + blkt_offset);
+      byteorder = *pMS2B1000_BYTEORDER (ms2 + blkt_offset);
+      found1000 = 1;
+
+      if (*pMS2B1000_RECLEN (ms2 + blkt_offset) < 32 &&
+          (1u << *pMS2B1000_RECLEN (ms2 + blkt_offset)) < reclen)
+        reclen = 1u << *pMS2B1000_RECLEN (ms2 + blkt_offset);
+    }
+    else if (blkt_type == 1001)
+    {
+      timingquality = *pMS2B1001_TIMINGQUALITY (ms2 + blkt_offset);
+      microsecond   = *pMS2B1001_MICROSECOND (ms2 + blkt_offset);
+      framecount    = *pMS2B1001_FRAMECOUNT (ms2 + blkt_offset);
+    }
+
+    blkt_offset = HO2u (*pMS2B1000_NEXT (ms2 + blkt_offset), swapflag);
+  }
+
+  if (!found1000)
+  {
+    sl_log_rl (log, 2, 1, "%s(): miniSEEDv2 record without blockette 1000\n", __func__);
+    return -1;
+  }
+
+  if (dataoffset < 48 || dataoffset > reclen)
+  {
+    sl_log_rl (log, 2, 1, "%s(): invalid miniSEEDv2 data offset: %u\n", __func__, dataoffset);
+    return -1;
+  }
+
+  /* Source identifier, nominal sample rate and sample count */
+  memset (&packetinfo, 0, sizeof (packetinfo));
+  packetinfo.payloadformat = SLPAYLOAD_MSEED2;
+  packetinfo.payloadlength = ms2length;
+
+  if (sl_payload_info (log, &packetinfo, ms2, ms2length, sourceid, sizeof (sourceid),
+                       NULL, 0, (samplerate == 0.0) ? &samplerate : NULL, &samplecount))
+    return -1;
+
+  /* Encoded data length: Steim frames, fixed sample size or remainder of record */
+  datalength = reclen - dataoffset;
+
+  if (encoding == 10 || encoding == 11)
+  {
+    if (framecount > 0 && (uint32_t)framecount * 64 < datalength)
+      datalength = (uint32_t)framecount * 64;
+  }
+  else
+  {
+    if (encoding == 0)
+      samplesize = 1;
+    else if (encoding == 1)
+      samplesize = 2;
+    else if (encoding == 3 || encoding == 4)
+      samplesize = 4;
+    else if (encoding == 5)
+      samplesize = 8;
+
+    if (samplesize && (uint64_t)samplecount * samplesize < datalength)
+      datalength = samplecount * samplesize;
+  }
+
+  /* Start time including unapplied time correction and microseconds */
+  actflags       = *pMS2FSDH_ACTFLAGS (ms2);
+  ioflags        = *pMS2FSDH_IOFLAGS (ms2);
+  dqflags        = *pMS2FSDH_DQFLAGS (ms2);
+  timecorrection = HO4d (*pMS2FSDH_TIMECORRECT (ms2), swapflag);
+
+  nstime = sl_time2nstime (HO2u (*pMS2FSDH_YEAR (ms2), swapflag),
+                           HO2u (*pMS2FSDH_DAY (ms2), swapflag),
+                           *pMS2FSDH_HOUR (ms2),
+                           *pMS2FSDH_MIN (ms2),
+                           *pMS2FSDH_SEC (ms2),
+                           (uint32_t)HO2u (*pMS2FSDH_FSEC (ms2), swapflag) * 100000);
+
+  if (nstime == SLTERROR)
+  {
+    sl_log_rl (log, 2, 1, "%s(): invalid miniSEEDv2 start time\n", __func__);
+    return -1;
+  }
+
+  nstime += (int64_t)microsecond * 1000;
+
+  if (timecorrection != 0 && (actflags & 0x02) == 0)
+    nstime += (int64_t)timecorrection * 100000;
+
+  if (sl_nstime2time (nstime, &year, &yday, &hour, &min, &sec, &nsec))
+    return -1;
+
+  /* Publication version from data quality indicator */
+  switch (*pMS2FSDH_DATAQUALITY (ms2))
+  {
+  case 'R':
+    pubversion = 1;
+    break;
+  case 'Q':
+    pubversion = 3;
+    break;
+  case 'M':
+    pubversion = 4;
+    break;
+  default:
+    pubversion = 2;
+    break;
+  }
+
+  /* Header flags: calibration signals, time tag questionable, clock locked */
+  if (actflags & 0x01)
+    flags |= 0x01;
+  if (dqflags & 0x80)
+    flags |= 0x02;
+  if (ioflags & 0x20)
+    flags |= 0x04;
+
+  /* Extra headers from remaining flags, time correction and timing quality */
+  timegroup[0] = eventgroup[0] = flagsgroup[0] = '\0';
+
+  if (timingquality >= 0)
+  {
+    snprintf (extra, sizeof (extra), "\"Quality\":%d", timingquality);
+    json_member (timegroup, sizeof (timegroup), &timelength, extra);
+  }
+  if (timecorrection != 0)
+  {
+    snprintf (extra, sizeof (extra), "\"Correction\":%.4f", timecorrection / 10000.0);
+    json_member (timegroup, sizeof (timegroup), &timelength, extra);
+  }
+  if (actflags & 0x10)
+    json_member (timegroup, sizeof (timegroup), &timelength, "\"LeapSecond\":1");
+  if (actflags & 0x20)
+    json_member (timegroup, sizeof (timegroup), &timelength, "\"LeapSecond\":-1");
+
+  if (actflags & 0x04)
+    json_member (eventgroup, sizeof (eventgroup), &eventlength, "\"Begin\":true");
+  if (actflags & 0x08)
+    json_member (eventgroup, sizeof (eventgroup), &eventlength, "\"End\":true");
+  if (actflags & 0x40)
+    json_member (eventgroup, sizeof (eventgroup), &eventlength, "\"InProgress\":true");
+
+  if (ioflags & 0x01)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"StationVolumeParityError\":true");
+  if (ioflags & 0x02)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"LongRecordRead\":true");
+  if (ioflags & 0x04)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"ShortRecordRead\":true");
+  if (ioflags & 0x08)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"StartOfTimeSeries\":true");
+  if (ioflags & 0x10)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"EndOfTimeSeries\":true");
+  if (dqflags & 0x01)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"AmplifierSaturation\":true");
+  if (dqflags & 0x02)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"DigitizerClipping\":true");
+  if (dqflags & 0x04)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"Spikes\":true");
+  if (dqflags & 0x08)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"Glitches\":true");
+  if (dqflags & 0x10)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"MissingData\":true");
+  if (dqflags & 0x20)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"TelemetrySyncError\":true");
+  if (dqflags & 0x40)
+    json_member (flagsgroup, sizeof (flagsgroup), &flagslength, "\"FilterCharging\":true");
+
+  if (timelength || eventlength || flagslength)
+  {
+    extralength = snprintf (extra, sizeof (extra), "{\"FDSN\":{%s%s%s%s%s%s%s%s%s%s%s}}",
+                            (timelength) ? "\"Time\":{" : "", timegroup, (timelength) ? "}" : "",
+                            (timelength && eventlength) ? "," : "",
+                            (eventlength) ? "\"Event\":{" : "", eventgroup, (eventlength) ? "}" : "",
+                            ((timelength || eventlength) && flagslength) ? "," : "",
+                            (flagslength) ? "\"Flags\":{" : "", flagsgroup, (flagslength) ? "}" : "");
+
+    if (extralength < 0 || extralength >= (int)sizeof (extra))
+    {
+      sl_log_rl (log, 2, 1, "%s(): cannot generate extra headers\n", __func__);
+      return -1;
+    }
+  }
+
+  sourceidlength = (uint8_t)strlen (sourceid);
+  ms3length      = MS3FSDH_LENGTH + sourceidlength + extralength + datalength;
+
+  if (ms3length > ms3size)
+  {
+    sl_log_rl (log, 2, 1, "%s(): miniSEEDv3 record (%u bytes) larger than buffer (%u bytes)\n",
+               __func__, ms3length, ms3size);
+    return -1;
+  }
+
+  /* Fixed header, little endian */
+  memcpy (pMS3FSDH_INDICATOR (ms3), "MS", 2);
+  *pMS3FSDH_FORMATVERSION (ms3) = 3;
+  *pMS3FSDH_FLAGS (ms3)         = flags;
+  *pMS3FSDH_NSEC (ms3)          = HO4u (nsec, bigendianhost);
+  *pMS3FSDH_YEAR (ms3)          = HO2u ((uint16_t)year, bigendianhost);
+  *pMS3FSDH_DAY (ms3)           = HO2u ((uint16_t)yday, bigendianhost);
+  *pMS3FSDH_HOUR (ms3)          = (uint8_t)hour;
+  *pMS3FSDH_MIN (ms3)           = (uint8_t)min;
+  *pMS3FSDH_SEC (ms3)           = (uint8_t)sec;
+  *pMS3FSDH_ENCODING (ms3)      = encoding;
+  *pMS3FSDH_SAMPLERATE (ms3)    = HO8f (samplerate, bigendianhost);
+  *pMS3FSDH_NUMSAMPLES (ms3)    = HO4u (samplecount, bigendianhost);
+  *pMS3FSDH_CRC (ms3)           = 0;
+  *pMS3FSDH_PUBVERSION (ms3)    = pubversion;
+  *pMS3FSDH_SIDLENGTH (ms3)     = sourceidlength;
+  *pMS3FSDH_EXTRALENGTH (ms3)   = HO2u ((uint16_t)extralength, bigendianhost);
+  *pMS3FSDH_DATALENGTH (ms3)    = HO4u (datalength, bigendianhost);
+
+  memcpy (pMS3FSDH_SID (ms3), sourceid, sourceidlength);
+  memcpy (pMS3FSDH_SID (ms3) + sourceidlength, extra, extralength);
+
+  /* Encoded data, integer and float samples converted to little endian */
+  ms3 += MS3FSDH_LENGTH + sourceidlength + extralength;
+  memcpy (ms3, ms2 + dataoffset, datalength);
+
+  dataswapflag = (byteorder != 0 && samplesize > 1) ? 1 : 0;
+
+  if (dataswapflag)
+  {
+    for (idx = 0; idx + samplesize <= datalength; idx += samplesize)
+    {
+      if (samplesize == 2)
+        sl_gswap2 (ms3 + idx);
+      else if (samplesize == 4)
+        sl_gswap4 (ms3 + idx);
+      else
+        sl_gswap8 (ms3 + idx);
+    }
+  }
+
+  /* CRC of complete record with CRC field set to zero */
+  ms3 -= MS3FSDH_LENGTH + sourceidlength + extralength;
+  *pMS3FSDH_CRC (ms3) = HO4u (crc32c (0, (const uint8_t *)ms3, ms3length), bigendianhost);
+
+  return (int)ms3length;
+} /* End of sl_payload_ms2to3() */
+
+/***************************************************************************
+ * json_member:
+ *
+ * Append a member to a comma-separated list of JSON members.
+ ***************************************************************************/
+static void
+json_member (char *buffer, size_t size, int *length, const char *member)
+{
+  int printed;
+
+  printed = snprintf (buffer + *length, size - *length, "%s%s",
+                      (*length) ? "," : "", member);
+
+  if (printed > 0 && (size_t)(*length + printed) < size)
+    *length += printed;
+} /* End of json_member() */
+
+/***************************************************************************
+ * crc32c:
+ *
+ * Compute the CRC-32C (Castagnoli) of a buffer, as used by miniSEED 3.
+ * The hardware instruction is used when the library is compiled for a
+ * target supporting it, otherwise a lookup table.
+ *
+ * Returns the updated CRC.
+ ***************************************************************************/
+static uint32_t
+crc32c (uint32_t crc, const uint8_t *data, size_t length)
+{
+#if defined(__SSE4_2__) && defined(__x86_64__)
+  uint64_t crc64 = (uint32_t)~crc;
+  uint64_t word;
+
+  for (; length >= 8; data += 8, length -= 8)
+  {
+    memcpy (&word, data, 8);
+    crc64 = _mm_crc32_u64 (crc64, word);
+  }
+
+  crc = (uint32_t)crc64;
+
+  for (; length > 0; data++, length--)
+    crc = _mm_crc32_u8 (crc, *data);
+
+  return ~crc;
+#elif defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+  uint64_t word;
+
+  crc = ~crc;
+
+  for (; length >= 8; data += 8, length -= 8)
+  {
+    memcpy (&word, data, 8);
+    crc = __crc32cd (crc, word);
+  }
+
+  for (; length > 0; data++, length--)
+    crc = __crc32cb (crc, *data);
+
+  return ~crc;
+#else
+  static const uint32_t table[256] = {
+  0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+  0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+  0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+  0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+  0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+  0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+  0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+  0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+  0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+  0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+  0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+  0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+  0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+  0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+  0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+  0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+  0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+  0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+  0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+  0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+  0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+  0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+  0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+  0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+  0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+  0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+  0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+  0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+  0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+  0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+  0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+  0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+  0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+  0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+  0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+  0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+  0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+  0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+  0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+  0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+  0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+  0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+  0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+  };
+
+  crc = ~crc;
+
+  for (; length > 0; data++, length--)
+    crc = table[(crc ^ *data) & 0xFF] ^ (crc >> 8);
+
+  return ~crc;
+#endif
+} /* End of crc32c() */